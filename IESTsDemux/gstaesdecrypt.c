@@ -0,0 +1,429 @@
+#include "gstaesdecrypt.h"
+
+#include <string.h>
+
+// AES-NI is picked at runtime. The other CPUs and compilers use the tables.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AES_HAVE_AESNI			1
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#define AES_TARGET_AESNI		__attribute__((target("aes,sse2")))
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_aesdecrypt_debug);
+#define GST_CAT_DEFAULT gst_aesdecrypt_debug
+
+#define AES_GETU32(p)			(((guint32)(p)[0] << 24) | ((guint32)(p)[1] << 16) | ((guint32)(p)[2] << 8) | (guint32)(p)[3])
+#define AES_PUTU32(p, v)		G_STMT_START { (p)[0] = (guint8)((v) >> 24); (p)[1] = (guint8)((v) >> 16); \
+									(p)[2] = (guint8)((v) >> 8); (p)[3] = (guint8)(v); } G_STMT_END
+#define AES_ROTL8(x, s)			((guint8)(((x) << (s)) | ((x) >> (8 - (s)))))
+#define AES_ROTR32(x, s)		(((x) >> (s)) | ((x) << (32 - (s))))
+
+// The tables are built when the plugin is loaded
+static guint8 aes_sbox[256];
+static guint8 aes_inv_sbox[256];
+static guint32 aes_td[4][256];
+static gboolean aes_has_aesni = FALSE;
+
+static void aes_secure_zero(gpointer data, gsize size);
+static void aes_decrypt_cbc_table(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks);
+#ifdef AES_HAVE_AESNI
+static void aes_decrypt_cbc_aesni(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks);
+#endif
+
+/*
+* Allocate a new decryptor. It has no key until one is set.
+*/
+GstAesDecryptor *
+gst_aes_decryptor_new(void)
+{
+	GstAesDecryptor *decryptor = g_new0(GstAesDecryptor, 1);
+
+	decryptor->use_aesni = aes_has_aesni;
+
+	return decryptor;
+}
+
+void
+gst_aes_decryptor_free(GstAesDecryptor * decryptor)
+{
+	// The key does not stay around in the freed memory
+	aes_secure_zero(decryptor, sizeof(GstAesDecryptor));
+	g_free(decryptor);
+}
+
+/*
+* Set the key and the IV of the beginning of the input. The round keys of the equivalent inverse cipher are the
+* ones of AESDEC, so both paths share them.
+*/
+void
+gst_aes_decryptor_set_key(GstAesDecryptor * decryptor, const guint8 * key, const guint8 * iv)
+{
+	static const guint32 rcon[AES_ROUNDS] = {
+		0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000,
+		0x20000000, 0x40000000, 0x80000000, 0x1b000000, 0x36000000
+	};
+	guint32 ek[4 * (AES_ROUNDS + 1)];
+	guint32 *dk = decryptor->round_keys;
+
+	// The key expansion of the cipher
+	for (guint i = 0; i < 4; i++)
+		ek[i] = AES_GETU32(key + 4 * i);
+
+	for (guint i = 0; i < AES_ROUNDS; i++) {
+		guint32 temp = ek[4 * i + 3];
+
+		ek[4 * i + 4] = ek[4 * i] ^
+			((guint32)aes_sbox[(temp >> 16) & 0xff] << 24) ^ ((guint32)aes_sbox[(temp >> 8) & 0xff] << 16) ^
+			((guint32)aes_sbox[temp & 0xff] << 8) ^ (guint32)aes_sbox[temp >> 24] ^ rcon[i];
+		ek[4 * i + 5] = ek[4 * i + 1] ^ ek[4 * i + 4];
+		ek[4 * i + 6] = ek[4 * i + 2] ^ ek[4 * i + 5];
+		ek[4 * i + 7] = ek[4 * i + 3] ^ ek[4 * i + 6];
+	}
+
+	// The inverse cipher takes the round keys backwards with InvMixColumns applied to the middle ones
+	for (guint round = 0; round <= AES_ROUNDS; round++) {
+		for (guint i = 0; i < 4; i++)
+			dk[4 * round + i] = ek[4 * (AES_ROUNDS - round) + i];
+	}
+
+	for (guint i = 4; i < 4 * AES_ROUNDS; i++) {
+		guint32 w = dk[i];
+
+		dk[i] = aes_td[0][aes_sbox[w >> 24]] ^ aes_td[1][aes_sbox[(w >> 16) & 0xff]] ^
+			aes_td[2][aes_sbox[(w >> 8) & 0xff]] ^ aes_td[3][aes_sbox[w & 0xff]];
+	}
+
+	for (guint round = 0; round <= AES_ROUNDS; round++) {
+		for (guint i = 0; i < 4; i++)
+			AES_PUTU32(decryptor->aesni_keys[round] + 4 * i, dk[4 * round + i]);
+	}
+
+	aes_secure_zero(ek, sizeof(ek));
+
+	memcpy(decryptor->initial_iv, iv, AES_BLOCK_SIZE);
+	gst_aes_decryptor_reset(decryptor);
+}
+
+/*
+* Start over from the beginning of the input
+*/
+void
+gst_aes_decryptor_reset(GstAesDecryptor * decryptor)
+{
+	gst_aes_decryptor_set_iv(decryptor, decryptor->initial_iv, 0);
+}
+
+/*
+* Change the IV the chain starts over with. The blocks decrypted until the next reset keep the chain they are in.
+*/
+void
+gst_aes_decryptor_set_initial_iv(GstAesDecryptor * decryptor, const guint8 * iv)
+{
+	memcpy(decryptor->initial_iv, iv, AES_BLOCK_SIZE);
+}
+
+/*
+* Continue from the block at the offset. Its IV is the previous block of the input.
+*/
+void
+gst_aes_decryptor_set_iv(GstAesDecryptor * decryptor, const guint8 * iv, guint64 offset)
+{
+	memmove(decryptor->iv, iv, AES_BLOCK_SIZE);
+	decryptor->has_last_iv = FALSE;
+	decryptor->next_offset = offset;
+}
+
+/*
+* Go back to the last block decrypted. It is read again when a read ends in the middle of it.
+*/
+gboolean
+gst_aes_decryptor_step_back(GstAesDecryptor * decryptor)
+{
+	if (!decryptor->has_last_iv)
+		return FALSE;
+
+	memcpy(decryptor->iv, decryptor->last_iv, AES_BLOCK_SIZE);
+	decryptor->has_last_iv = FALSE;
+	decryptor->next_offset -= AES_BLOCK_SIZE;
+
+	return TRUE;
+}
+
+/*
+* Decrypt the blocks following the IV. The input and the output may be the same memory.
+*/
+void
+gst_aes_decryptor_decrypt(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks)
+{
+	if (blocks == 0)
+		return;
+
+#ifdef AES_HAVE_AESNI
+	if (decryptor->use_aesni)
+		aes_decrypt_cbc_aesni(decryptor, in, out, blocks);
+	else
+#endif
+		aes_decrypt_cbc_table(decryptor, in, out, blocks);
+
+	decryptor->has_last_iv = TRUE;
+	decryptor->next_offset += blocks * AES_BLOCK_SIZE;
+}
+
+/*
+* Find the PKCS#7 padding of the last block. It is 0 when the block is not padded right.
+*/
+gsize
+gst_aes_decryptor_get_padding(const guint8 * last_block)
+{
+	guint8 padding = last_block[AES_BLOCK_SIZE - 1];
+
+	if (padding == 0 || padding > AES_BLOCK_SIZE)
+		return 0;
+
+	for (guint i = AES_BLOCK_SIZE - padding; i < AES_BLOCK_SIZE; i++) {
+		if (last_block[i] != padding)
+			return 0;
+	}
+
+	return padding;
+}
+
+/*
+* Parse a key or an IV written in 32 hex digits. The 0x prefix of the HLS playlists is allowed.
+*/
+gboolean
+gst_aes_parse_hex(const gchar * hex, guint8 * out)
+{
+	if (hex == NULL)
+		return FALSE;
+
+	if (hex[0] == '0' && (hex[1] == 'x' || hex[1] == 'X'))
+		hex += 2;
+
+	if (strlen(hex) != 2 * AES_BLOCK_SIZE)
+		return FALSE;
+
+	for (guint i = 0; i < AES_BLOCK_SIZE; i++) {
+		gint high = g_ascii_xdigit_value(hex[2 * i]);
+		gint low = g_ascii_xdigit_value(hex[2 * i + 1]);
+
+		if (high < 0 || low < 0)
+			return FALSE;
+
+		out[i] = (guint8)((high << 4) | low);
+	}
+
+	return TRUE;
+}
+
+/*
+* Decrypt a block with the tables. The rounds are the ones of the equivalent inverse cipher.
+*/
+static void
+aes_decrypt_block(const guint32 * rk, const guint8 * in, guint8 * out)
+{
+	guint32 s0, s1, s2, s3, t0, t1, t2, t3;
+
+	s0 = AES_GETU32(in) ^ rk[0];
+	s1 = AES_GETU32(in + 4) ^ rk[1];
+	s2 = AES_GETU32(in + 8) ^ rk[2];
+	s3 = AES_GETU32(in + 12) ^ rk[3];
+
+	for (guint round = 1; round < AES_ROUNDS; round++) {
+		rk += 4;
+		t0 = aes_td[0][s0 >> 24] ^ aes_td[1][(s3 >> 16) & 0xff] ^ aes_td[2][(s2 >> 8) & 0xff] ^ aes_td[3][s1 & 0xff] ^ rk[0];
+		t1 = aes_td[0][s1 >> 24] ^ aes_td[1][(s0 >> 16) & 0xff] ^ aes_td[2][(s3 >> 8) & 0xff] ^ aes_td[3][s2 & 0xff] ^ rk[1];
+		t2 = aes_td[0][s2 >> 24] ^ aes_td[1][(s1 >> 16) & 0xff] ^ aes_td[2][(s0 >> 8) & 0xff] ^ aes_td[3][s3 & 0xff] ^ rk[2];
+		t3 = aes_td[0][s3 >> 24] ^ aes_td[1][(s2 >> 16) & 0xff] ^ aes_td[2][(s1 >> 8) & 0xff] ^ aes_td[3][s0 & 0xff] ^ rk[3];
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+
+	// The last round has no InvMixColumns
+	rk += 4;
+	t0 = ((guint32)aes_inv_sbox[s0 >> 24] << 24) ^ ((guint32)aes_inv_sbox[(s3 >> 16) & 0xff] << 16) ^
+		((guint32)aes_inv_sbox[(s2 >> 8) & 0xff] << 8) ^ (guint32)aes_inv_sbox[s1 & 0xff] ^ rk[0];
+	t1 = ((guint32)aes_inv_sbox[s1 >> 24] << 24) ^ ((guint32)aes_inv_sbox[(s0 >> 16) & 0xff] << 16) ^
+		((guint32)aes_inv_sbox[(s3 >> 8) & 0xff] << 8) ^ (guint32)aes_inv_sbox[s2 & 0xff] ^ rk[1];
+	t2 = ((guint32)aes_inv_sbox[s2 >> 24] << 24) ^ ((guint32)aes_inv_sbox[(s1 >> 16) & 0xff] << 16) ^
+		((guint32)aes_inv_sbox[(s0 >> 8) & 0xff] << 8) ^ (guint32)aes_inv_sbox[s3 & 0xff] ^ rk[2];
+	t3 = ((guint32)aes_inv_sbox[s3 >> 24] << 24) ^ ((guint32)aes_inv_sbox[(s2 >> 16) & 0xff] << 16) ^
+		((guint32)aes_inv_sbox[(s1 >> 8) & 0xff] << 8) ^ (guint32)aes_inv_sbox[s0 & 0xff] ^ rk[3];
+
+	AES_PUTU32(out, t0);
+	AES_PUTU32(out + 4, t1);
+	AES_PUTU32(out + 8, t2);
+	AES_PUTU32(out + 12, t3);
+}
+
+/*
+* Clear the key material. The stores go through a volatile pointer, so the compiler does not drop them as dead
+* like a memset right before the free.
+*/
+static void
+aes_secure_zero(gpointer data, gsize size)
+{
+	volatile guint8 *bytes = (volatile guint8 *)data;
+
+	while (size-- > 0)
+		*bytes++ = 0;
+}
+
+/*
+* CBC with the tables. The block is copied first since the output may overwrite it.
+*/
+static void
+aes_decrypt_cbc_table(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks)
+{
+	guint8 cipher[AES_BLOCK_SIZE];
+	guint8 plain[AES_BLOCK_SIZE];
+
+	for (; blocks > 0; blocks--) {
+		memcpy(cipher, in, AES_BLOCK_SIZE);
+		aes_decrypt_block(decryptor->round_keys, cipher, plain);
+
+		for (guint i = 0; i < AES_BLOCK_SIZE; i++)
+			out[i] = plain[i] ^ decryptor->iv[i];
+
+		memcpy(decryptor->last_iv, decryptor->iv, AES_BLOCK_SIZE);
+		memcpy(decryptor->iv, cipher, AES_BLOCK_SIZE);
+
+		in += AES_BLOCK_SIZE;
+		out += AES_BLOCK_SIZE;
+	}
+}
+
+#ifdef AES_HAVE_AESNI
+/*
+* CBC with AES-NI. The blocks of CBC decryption do not depend on each other, so 8 of them are in flight
+* to hide the latency of AESDEC.
+*/
+static void AES_TARGET_AESNI
+aes_decrypt_cbc_aesni(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks)
+{
+	__m128i keys[AES_ROUNDS + 1];
+	__m128i iv = _mm_loadu_si128((const __m128i *)decryptor->iv);
+	__m128i last_iv = _mm_loadu_si128((const __m128i *)decryptor->last_iv);
+
+	for (guint round = 0; round <= AES_ROUNDS; round++)
+		keys[round] = _mm_loadu_si128((const __m128i *)decryptor->aesni_keys[round]);
+
+	for (; blocks >= 8; blocks -= 8) {
+		__m128i cipher[8], state[8];
+
+		for (guint i = 0; i < 8; i++) {
+			cipher[i] = _mm_loadu_si128((const __m128i *)(in + i * AES_BLOCK_SIZE));
+			state[i] = _mm_xor_si128(cipher[i], keys[0]);
+		}
+
+		for (guint round = 1; round < AES_ROUNDS; round++) {
+			for (guint i = 0; i < 8; i++)
+				state[i] = _mm_aesdec_si128(state[i], keys[round]);
+		}
+
+		for (guint i = 0; i < 8; i++) {
+			state[i] = _mm_aesdeclast_si128(state[i], keys[AES_ROUNDS]);
+			state[i] = _mm_xor_si128(state[i], i == 0 ? iv : cipher[i - 1]);
+			_mm_storeu_si128((__m128i *)(out + i * AES_BLOCK_SIZE), state[i]);
+		}
+
+		last_iv = cipher[6];
+		iv = cipher[7];
+		in += 8 * AES_BLOCK_SIZE;
+		out += 8 * AES_BLOCK_SIZE;
+	}
+
+	for (; blocks > 0; blocks--) {
+		__m128i cipher = _mm_loadu_si128((const __m128i *)in);
+		__m128i state = _mm_xor_si128(cipher, keys[0]);
+
+		for (guint round = 1; round < AES_ROUNDS; round++)
+			state = _mm_aesdec_si128(state, keys[round]);
+
+		state = _mm_aesdeclast_si128(state, keys[AES_ROUNDS]);
+		_mm_storeu_si128((__m128i *)out, _mm_xor_si128(state, iv));
+
+		last_iv = iv;
+		iv = cipher;
+		in += AES_BLOCK_SIZE;
+		out += AES_BLOCK_SIZE;
+	}
+
+	_mm_storeu_si128((__m128i *)decryptor->iv, iv);
+	_mm_storeu_si128((__m128i *)decryptor->last_iv, last_iv);
+}
+#endif
+
+/*
+* Multiply in GF(2^8)
+*/
+static guint8
+aes_gf_mul(guint8 a, guint8 b)
+{
+	guint8 result = 0;
+
+	while (b != 0) {
+		if (b & 1)
+			result ^= a;
+		a = (guint8)((a << 1) ^ ((a & 0x80) ? 0x1b : 0));
+		b >>= 1;
+	}
+
+	return result;
+}
+
+/*
+* Build the tables and check the CPU. Set the debug category.
+*/
+void
+init_aesdecrypt(void)
+{
+	guint8 p = 1, q = 1;
+
+	GST_DEBUG_CATEGORY_INIT(gst_aesdecrypt_debug, "aesdecrypt", 0, "AES-128-CBC Decryptor");
+
+	// p walks the multiplicative group by 3 and q by its inverse, so q is always the inverse of p
+	do {
+		p = (guint8)(p ^ (p << 1) ^ ((p & 0x80) ? 0x1b : 0));
+
+		q ^= (guint8)(q << 1);
+		q ^= (guint8)(q << 2);
+		q ^= (guint8)(q << 4);
+		if (q & 0x80)
+			q ^= 0x09;
+
+		aes_sbox[p] = q ^ AES_ROTL8(q, 1) ^ AES_ROTL8(q, 2) ^ AES_ROTL8(q, 3) ^ AES_ROTL8(q, 4) ^ 0x63;
+	} while (p != 1);
+
+	aes_sbox[0] = 0x63;
+
+	for (guint i = 0; i < 256; i++)
+		aes_inv_sbox[aes_sbox[i]] = (guint8)i;
+
+	// InvSubBytes and InvMixColumns of a byte in each row
+	for (guint i = 0; i < 256; i++) {
+		guint8 s = aes_inv_sbox[i];
+		guint32 column = ((guint32)aes_gf_mul(s, 0x0e) << 24) | ((guint32)aes_gf_mul(s, 0x09) << 16) |
+			((guint32)aes_gf_mul(s, 0x0d) << 8) | (guint32)aes_gf_mul(s, 0x0b);
+
+		aes_td[0][i] = column;
+		aes_td[1][i] = AES_ROTR32(column, 8);
+		aes_td[2][i] = AES_ROTR32(column, 16);
+		aes_td[3][i] = AES_ROTR32(column, 24);
+	}
+
+#ifdef AES_HAVE_AESNI
+	{
+		guint eax, ebx, ecx, edx;
+
+		if (__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			aes_has_aesni = (ecx & bit_AES) != 0;
+	}
+#endif
+
+	GST_INFO("AES-128 is decrypted with %s", aes_has_aesni ? "AES-NI" : "the tables");
+}
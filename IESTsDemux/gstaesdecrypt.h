@@ -0,0 +1,59 @@
+#ifndef __GST_AESDECRYPT_H__
+#define __GST_AESDECRYPT_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define AES_BLOCK_SIZE			16
+#define AES_KEY_SIZE			16
+#define AES_ROUNDS				10
+
+typedef struct _GstAesDecryptor GstAesDecryptor;
+
+/*
+* Decrypts AES-128-CBC as in the HLS segments. The input is given in whole blocks. The IV of the next block is kept
+* so the following blocks are decrypted as they come.
+*/
+struct _GstAesDecryptor
+{
+	// The round keys of the inverse cipher. The table ones are in the big endian words.
+	guint32		round_keys[4 * (AES_ROUNDS + 1)];
+	guint8		aesni_keys[AES_ROUNDS + 1][AES_BLOCK_SIZE];
+	gboolean	use_aesni;
+
+	// The IV given with the key. The chain starts over with it at the beginning of the input.
+	guint8		initial_iv[AES_BLOCK_SIZE];
+
+	// The IV of the block at the next offset and the one of the block before it
+	guint8		iv[AES_BLOCK_SIZE];
+	guint8		last_iv[AES_BLOCK_SIZE];
+	gboolean	has_last_iv;
+	guint64		next_offset;
+};
+
+void init_aesdecrypt(void);
+
+GstAesDecryptor * gst_aes_decryptor_new(void);
+
+void gst_aes_decryptor_free(GstAesDecryptor * decryptor);
+
+void gst_aes_decryptor_set_key(GstAesDecryptor * decryptor, const guint8 * key, const guint8 * iv);
+
+void gst_aes_decryptor_reset(GstAesDecryptor * decryptor);
+
+void gst_aes_decryptor_set_initial_iv(GstAesDecryptor * decryptor, const guint8 * iv);
+
+void gst_aes_decryptor_set_iv(GstAesDecryptor * decryptor, const guint8 * iv, guint64 offset);
+
+gboolean gst_aes_decryptor_step_back(GstAesDecryptor * decryptor);
+
+void gst_aes_decryptor_decrypt(GstAesDecryptor * decryptor, const guint8 * in, guint8 * out, gsize blocks);
+
+gsize gst_aes_decryptor_get_padding(const guint8 * last_block);
+
+gboolean gst_aes_parse_hex(const gchar * hex, guint8 * out);
+
+G_END_DECLS
+
+#endif /* __GST_AESDECRYPT_H__ */
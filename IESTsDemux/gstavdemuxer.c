@@ -9,6 +9,10 @@ GST_DEBUG_CATEGORY_STATIC(gst_avdemux_debug);
 static int av_bufferedio_read_from_upstream(void *opaque, uint8_t *buf, int size);
 static int av_bufferedio_read_from_adapter(void *opaque, uint8_t * buf, int size);
 static int64_t av_bufferedio_seek(void *opaque, int64_t pos, int whence);
+static GstFlowReturn av_bufferedio_pull_decrypted(GstBufferedIOInfo * buffio_info, uint8_t * buf, int size, gsize * bytes_read);
+static gsize av_bufferedio_get_segment(GstBufferedIOInfo * buffio_info, gsize bytes_available, gboolean * is_end);
+static void av_bufferedio_flush_adapter(GstBufferedIOInfo * buffio_info, gsize size);
+static void av_bufferedio_take_arrivals(GstBufferedIOInfo * buffio_info, gsize size, GArray * taken);
 
 /*
 * Start the buffered io operation. The read operation will different between push and pull mode.
@@ -17,7 +21,7 @@ int
 av_bufferedio_open(GstBufferedIOInfo * buffio_info)
 {
 	int result = 0;
-	static const int buffio_size = 4096;
+	int buffio_size = buffio_info->io_buffer_size;
 	unsigned char *buffio_buffer = NULL;
 	int flags = AVIO_FLAG_READ;
 
@@ -28,6 +32,16 @@ av_bufferedio_open(GstBufferedIOInfo * buffio_info)
 		g_return_val_if_fail(GST_IS_ADAPTER(buffio_info->gst_adapter), AVERROR(EINVAL));
 	}
 
+	// libav starts reading from the beginning of the input
+	buffio_info->io_read_offset = 0;
+	buffio_info->io_adapter_offset = 0;
+	buffio_info->io_boundary = BUFFERED_IO_NO_OFFSET;
+	buffio_info->io_padding_removed = 0;
+
+	// The decryption starts over with the IV of the key
+	if (buffio_info->decryptor != NULL)
+		gst_aes_decryptor_reset(buffio_info->decryptor);
+
 	// Allocate the IO Buffer memory
 	buffio_buffer = av_malloc(buffio_size);
 	g_return_val_if_fail(buffio_buffer != NULL, AVERROR(ENOMEM));
@@ -102,14 +116,22 @@ av_bufferedio_read_from_upstream(void *opaque, uint8_t *buf, int size)
 	GstBufferedIOInfo *buffio_info = (GstBufferedIOInfo *)opaque;
 	g_assert_nonnull(buffio_info);
 
-	// Pull a buffer from the peer pad
-	GstFlowReturn ret = gst_pad_pull_range(buffio_info->target_pad, buffio_info->io_read_offset, (guint)size, &buff_read);
-	if (ret == GST_FLOW_OK) {
-		bytes_read = gst_buffer_get_size(buff_read);
-		gst_buffer_extract(buff_read, 0, buf, bytes_read);
-		gst_buffer_unref(buff_read);
+	GstFlowReturn ret;
+
+	// Pull a buffer from the peer pad. The encrypted input is decrypted on the way.
+	if (buffio_info->decryptor != NULL) {
+		ret = av_bufferedio_pull_decrypted(buffio_info, buf, size, &bytes_read);
+	}
+	else {
+		ret = gst_pad_pull_range(buffio_info->target_pad, buffio_info->io_read_offset, (guint)size, &buff_read);
+		if (ret == GST_FLOW_OK) {
+			bytes_read = gst_buffer_get_size(buff_read);
+			gst_buffer_extract(buff_read, 0, buf, bytes_read);
+			gst_buffer_unref(buff_read);
+		}
 	}
-	else if (ret == GST_FLOW_EOS) {
+
+	if (ret == GST_FLOW_EOS) {
 		bytes_read = 0;
 	}
 
@@ -117,6 +139,9 @@ av_bufferedio_read_from_upstream(void *opaque, uint8_t *buf, int size)
 		buffio_info->io_read_offset += bytes_read;
 	}
 
+	if (ret == GST_FLOW_OK && bytes_read > 0 && buffio_info->io_observer != NULL)
+		buffio_info->io_observer(buffio_info->io_observer_data, buf, bytes_read);
+
 	GST_DEBUG("Read %d bytes and the total bytes read is %d", bytes_read, buffio_info->io_read_offset);
 
 	return (int)bytes_read;
@@ -130,18 +155,56 @@ av_bufferedio_read_from_adapter(void *opaque, uint8_t * buf, int size)
 {
 	gsize bytes_available = 0;
 	gsize bytes_read = 0;
+	gsize bytes_needed = 0;
+	gsize bytes_segment = 0;
+	gsize bytes_partial = 0;
+	gboolean is_last = FALSE;
+	gboolean is_end = FALSE;
 
 	GstBufferedIOInfo * buffio_info = (GstBufferedIOInfo *)opaque;
 	g_assert_nonnull(buffio_info);
 
+	GstAesDecryptor *decryptor = buffio_info->decryptor;
+
+	// The live input hands over whatever has arrived instead of filling the whole buffer
+	bytes_needed = size;
+	if (buffio_info->io_read_min > 0)
+		bytes_needed = MIN(size, buffio_info->io_read_min);
+
+	// The decryption takes whole blocks. The last block is held back until it is known whether it carries the padding.
+	if (decryptor != NULL) {
+		if (size < AES_BLOCK_SIZE) {
+			GST_ERROR("The read of %d bytes is smaller than an AES block", size);
+			return AVERROR(EINVAL);
+		}
+
+		bytes_needed = GST_ROUND_UP_16(bytes_needed) + AES_BLOCK_SIZE;
+	}
+
 	g_mutex_lock(&buffio_info->io_sync_mutex);
 
-	// Wait until the requested size of data is available
+	g_array_set_size(buffio_info->io_read_arrivals, 0);
+
+read_segment:
+	// The next segment starts over with the IV
+	if (buffio_info->io_boundary != BUFFERED_IO_NO_OFFSET && buffio_info->io_boundary <= buffio_info->io_adapter_offset) {
+		if (decryptor != NULL)
+			gst_aes_decryptor_reset(decryptor);
+		buffio_info->io_boundary = BUFFERED_IO_NO_OFFSET;
+	}
+
+	// Wait until the requested size of data is available, or the whole encrypted segment
 	// The Chain function will notify that the data is available in the adapter
-	while ((bytes_available = gst_adapter_available(buffio_info->gst_adapter)) < (gsize)size &&
+	while ((bytes_available = gst_adapter_available(buffio_info->gst_adapter)) < bytes_needed &&
 		buffio_info->is_eos == FALSE) {
 
-		buffio_info->io_read_needed = size;
+		if (decryptor != NULL) {
+			av_bufferedio_get_segment(buffio_info, bytes_available, &is_end);
+			if (is_end)
+				break;
+		}
+
+		buffio_info->io_read_needed = bytes_needed;
 
 		g_cond_signal(&buffio_info->io_sync_cond);
 		g_cond_wait(&buffio_info->io_sync_cond, &buffio_info->io_sync_mutex);
@@ -149,16 +212,183 @@ av_bufferedio_read_from_adapter(void *opaque, uint8_t * buf, int size)
 
 	// Copy media data from the adapter to the buffer which will be accessed by libav
 	bytes_read = MIN(size, bytes_available);
+	if (decryptor != NULL) {
+		// A block followed by more data of the segment is not the last one
+		bytes_segment = av_bufferedio_get_segment(buffio_info, bytes_available, &is_end);
+
+		gsize bytes_usable = is_end ? bytes_segment : (bytes_segment > 0 ? bytes_segment - 1 : 0);
+
+		bytes_usable -= bytes_usable % AES_BLOCK_SIZE;
+		bytes_read = MIN((gsize)size - size % AES_BLOCK_SIZE, bytes_usable);
+		is_last = is_end && bytes_read == bytes_usable;
+
+		// The partial block can not be decrypted. It is dropped so the next segment starts at its boundary.
+		if (is_last && bytes_segment % AES_BLOCK_SIZE != 0) {
+			bytes_partial = bytes_segment % AES_BLOCK_SIZE;
+			GST_WARNING("The encrypted segment ends with a partial block of %" G_GSIZE_FORMAT " bytes", bytes_partial);
+		}
+	}
+
 	if (bytes_read) {
 		gst_adapter_copy(buffio_info->gst_adapter, buf, 0, bytes_read);
-		gst_adapter_flush(buffio_info->gst_adapter, bytes_read);
+		av_bufferedio_flush_adapter(buffio_info, bytes_read);
+		av_bufferedio_take_arrivals(buffio_info, bytes_read, buffio_info->io_read_arrivals);
+	}
+
+	if (bytes_partial) {
+		av_bufferedio_flush_adapter(buffio_info, bytes_partial);
+		av_bufferedio_take_arrivals(buffio_info, bytes_partial, NULL);
+		buffio_info->io_padding_removed += bytes_partial;
+		bytes_partial = 0;
 	}
 
+	// Nothing is left of the segment. libav goes on with the next one instead of taking it for the end.
+	if (bytes_read == 0 && is_last && !buffio_info->is_eos)
+		goto read_segment;
+
 	g_mutex_unlock(&buffio_info->io_sync_mutex);
 
+	// Decrypt in place out of the lock so the chain function goes on filling the adapter
+	if (decryptor != NULL && bytes_read > 0) {
+		gst_aes_decryptor_decrypt(decryptor, buf, buf, bytes_read / AES_BLOCK_SIZE);
+
+		// The padding of the last block is cut off
+		if (is_last) {
+			gsize padding = gst_aes_decryptor_get_padding(buf + bytes_read - AES_BLOCK_SIZE);
+
+			if (padding == 0)
+				GST_WARNING("The last block of the encrypted segment has no valid padding");
+			bytes_read -= padding;
+			buffio_info->io_padding_removed += padding;
+
+			// A block of padding alone ends the segment, not the input
+			if (bytes_read == 0 && !buffio_info->is_eos)
+				return av_bufferedio_read_from_adapter(opaque, buf, size);
+		}
+	}
+
+	buffio_info->io_read_offset += bytes_read;
+
+	if (bytes_read > 0 && buffio_info->io_observer != NULL)
+		buffio_info->io_observer(buffio_info->io_observer_data, buf, bytes_read);
+
 	return (int)bytes_read;
 }
 
+/*
+* Pull the blocks covering the read and decrypt them straight into the libav buffer. The offsets are the same in
+* the encrypted and the plain input. One more block is pulled to find whether the last one carries the padding.
+*/
+static GstFlowReturn
+av_bufferedio_pull_decrypted(GstBufferedIOInfo * buffio_info, uint8_t * buf, int size, gsize * bytes_read)
+{
+	GstAesDecryptor *decryptor = buffio_info->decryptor;
+	guint64 offset = buffio_info->io_read_offset;
+	guint64 start = offset - offset % AES_BLOCK_SIZE;
+	gsize skip = (gsize)(offset - start);
+	gsize length = GST_ROUND_UP_16(skip + size) + AES_BLOCK_SIZE;
+	GstBuffer *buff_read = NULL;
+	GstMapInfo map;
+	GstFlowReturn ret;
+	guint8 block[AES_BLOCK_SIZE];
+	const guint8 *in;
+	guint8 *out = buf;
+	gsize blocks, available, remaining, whole;
+	gsize padding = 0;
+	gboolean is_last;
+
+	*bytes_read = 0;
+
+	// The read ended in the middle of a block last time. This one starts there.
+	if (start + AES_BLOCK_SIZE == decryptor->next_offset)
+		gst_aes_decryptor_step_back(decryptor);
+
+	// The IV of a block is the block before it. It is pulled again after a seek.
+	if (start != decryptor->next_offset) {
+		if (start == 0) {
+			gst_aes_decryptor_reset(decryptor);
+		}
+		else {
+			ret = gst_pad_pull_range(buffio_info->target_pad, start - AES_BLOCK_SIZE, AES_BLOCK_SIZE, &buff_read);
+			if (ret != GST_FLOW_OK)
+				return ret;
+
+			if (gst_buffer_extract(buff_read, 0, block, AES_BLOCK_SIZE) != AES_BLOCK_SIZE) {
+				gst_buffer_unref(buff_read);
+				return GST_FLOW_EOS;
+			}
+
+			gst_buffer_unref(buff_read);
+			gst_aes_decryptor_set_iv(decryptor, block, start);
+		}
+	}
+
+	ret = gst_pad_pull_range(buffio_info->target_pad, start, (guint)length, &buff_read);
+	if (ret != GST_FLOW_OK)
+		return ret;
+
+	if (!gst_buffer_map(buff_read, &map, GST_MAP_READ)) {
+		gst_buffer_unref(buff_read);
+		return GST_FLOW_ERROR;
+	}
+
+	// A short buffer is the end of the input. Otherwise the extra block is left for the next read.
+	is_last = map.size < length;
+	blocks = map.size / AES_BLOCK_SIZE;
+	if (!is_last)
+		blocks--;
+
+	// The padding is not part of the input. The last block is decrypted ahead on a copy of the chain to find it.
+	if (is_last && blocks > 0) {
+		GstAesDecryptor last = *decryptor;
+		const guint8 *last_block = map.data + (blocks - 1) * AES_BLOCK_SIZE;
+
+		if (blocks > 1)
+			gst_aes_decryptor_set_iv(&last, last_block - AES_BLOCK_SIZE, 0);
+		gst_aes_decryptor_decrypt(&last, last_block, block, 1);
+
+		padding = gst_aes_decryptor_get_padding(block);
+		if (padding == 0)
+			GST_WARNING("The last block of the encrypted input has no valid padding");
+	}
+
+	available = blocks * AES_BLOCK_SIZE > skip + padding ? blocks * AES_BLOCK_SIZE - skip - padding : 0;
+	remaining = MIN((gsize)size, available);
+	in = map.data;
+
+	// The block where the read starts
+	if (skip > 0 && remaining > 0) {
+		gsize head = MIN(AES_BLOCK_SIZE - skip, remaining);
+
+		gst_aes_decryptor_decrypt(decryptor, in, block, 1);
+		memcpy(out, block + skip, head);
+		in += AES_BLOCK_SIZE;
+		out += head;
+		remaining -= head;
+	}
+
+	// The whole blocks are decrypted straight into the libav buffer
+	whole = remaining / AES_BLOCK_SIZE;
+	gst_aes_decryptor_decrypt(decryptor, in, out, whole);
+	in += whole * AES_BLOCK_SIZE;
+	out += whole * AES_BLOCK_SIZE;
+	remaining -= whole * AES_BLOCK_SIZE;
+
+	// The block where the read ends
+	if (remaining > 0) {
+		gst_aes_decryptor_decrypt(decryptor, in, block, 1);
+		memcpy(out, block, remaining);
+		out += remaining;
+	}
+
+	*bytes_read = out - buf;
+
+	gst_buffer_unmap(buff_read, &map);
+	gst_buffer_unref(buff_read);
+
+	return GST_FLOW_OK;
+}
+
 /*
 * It is a seek callback for the buffered IO operation.
 */
@@ -200,6 +430,9 @@ av_bufferedio_seek(void *opaque, int64_t pos, int whence)
 
 	// According to the comment in avio.h, AVSEEK_SIZE should return the filesize without seeking anywhere.
 	if (whence != AVSEEK_SIZE) {
+		if (new_pos != buffio_info->io_read_offset && buffio_info->io_observer != NULL)
+			buffio_info->io_observer(buffio_info->io_observer_data, NULL, 0);
+
 		buffio_info->io_read_offset = new_pos;
 	}
 
@@ -208,6 +441,193 @@ av_bufferedio_seek(void *opaque, int64_t pos, int whence)
 	return new_pos;
 }
 
+/*
+* Start keeping the data read by libav from the offset on. The data kept before is dropped.
+* Called with the IO lock held.
+*/
+void
+av_bufferedio_keep_from(GstBufferedIOInfo * buffio_info, guint64 offset)
+{
+	gst_adapter_clear(buffio_info->io_replay_adapter);
+	buffio_info->io_replay_offset = offset;
+}
+
+/*
+* Put the data kept back in front of the adapter, so libav reads it again once it is opened again.
+* Called with the IO lock held.
+*/
+void
+av_bufferedio_replay(GstBufferedIOInfo * buffio_info)
+{
+	GstAdapter *adapter = buffio_info->gst_adapter;
+	gsize kept = gst_adapter_available(buffio_info->io_replay_adapter);
+	gsize rest = gst_adapter_available(adapter);
+
+	GST_DEBUG("Replaying %" G_GSIZE_FORMAT " bytes from the offset %" G_GUINT64_FORMAT, kept, buffio_info->io_replay_offset);
+
+	if (kept > 0) {
+		if (rest > 0)
+			gst_adapter_push(buffio_info->io_replay_adapter, gst_adapter_take_buffer(adapter, rest));
+
+		// The data kept is followed by the rest and becomes the adapter
+		buffio_info->gst_adapter = buffio_info->io_replay_adapter;
+		buffio_info->io_replay_adapter = adapter;
+		buffio_info->io_adapter_offset -= kept;
+
+		// The data read again arrived long ago. It is not timed.
+		if (buffio_info->io_track_arrivals) {
+			GstBufferedIOArrival *arrival = g_new(GstBufferedIOArrival, 1);
+
+			arrival->bytes = kept;
+			arrival->time = GST_CLOCK_TIME_NONE;
+			g_queue_push_head(&buffio_info->io_arrivals, arrival);
+		}
+	}
+
+	buffio_info->io_replay_offset = BUFFERED_IO_NO_OFFSET;
+}
+
+/*
+* Stop keeping the data read by libav. Called with the IO lock held.
+*/
+void
+av_bufferedio_drop_kept(GstBufferedIOInfo * buffio_info)
+{
+	gst_adapter_clear(buffio_info->io_replay_adapter);
+	buffio_info->io_replay_offset = BUFFERED_IO_NO_OFFSET;
+}
+
+/*
+* The size of the encrypted data up to the boundary. The segment ends when the boundary is in the adapter.
+* Otherwise it is all the data available and it ends with the input.
+*/
+static gsize
+av_bufferedio_get_segment(GstBufferedIOInfo * buffio_info, gsize bytes_available, gboolean * is_end)
+{
+	guint64 boundary = buffio_info->io_boundary;
+
+	if (boundary != BUFFERED_IO_NO_OFFSET && boundary - buffio_info->io_adapter_offset <= bytes_available) {
+		*is_end = TRUE;
+		return (gsize)(boundary - buffio_info->io_adapter_offset);
+	}
+
+	*is_end = buffio_info->is_eos;
+	return bytes_available;
+}
+
+/*
+* Take the data read by libav out of the adapter. The part from the replay offset on is kept.
+*/
+static void
+av_bufferedio_flush_adapter(GstBufferedIOInfo * buffio_info, gsize size)
+{
+	guint64 keep = buffio_info->io_replay_offset;
+	guint64 end = buffio_info->io_adapter_offset + size;
+	gsize skip = 0;
+
+	if (keep == BUFFERED_IO_NO_OFFSET || keep >= end) {
+		gst_adapter_flush(buffio_info->gst_adapter, size);
+	}
+	else {
+		if (keep > buffio_info->io_adapter_offset)
+			skip = (gsize)(keep - buffio_info->io_adapter_offset);
+
+		gst_adapter_flush(buffio_info->gst_adapter, skip);
+		gst_adapter_push(buffio_info->io_replay_adapter, gst_adapter_take_buffer(buffio_info->gst_adapter, size - skip));
+	}
+
+	buffio_info->io_adapter_offset = end;
+}
+
+/*
+* Start or stop noting the arrival of the data. The data already in the adapter is not timed.
+* Called with the IO lock held.
+*/
+void
+av_bufferedio_track_arrivals(GstBufferedIOInfo * buffio_info, gboolean track)
+{
+	av_bufferedio_clear_arrivals(buffio_info);
+	buffio_info->io_track_arrivals = track;
+	av_bufferedio_push_arrival(buffio_info, gst_adapter_available(buffio_info->gst_adapter), GST_CLOCK_TIME_NONE);
+}
+
+/*
+* Note the arrival time of the data just pushed into the adapter. Called with the IO lock held.
+*/
+void
+av_bufferedio_push_arrival(GstBufferedIOInfo * buffio_info, gsize size, GstClockTime time)
+{
+	GstBufferedIOArrival *arrival;
+
+	if (!buffio_info->io_track_arrivals || size == 0)
+		return;
+
+	arrival = g_new(GstBufferedIOArrival, 1);
+	arrival->bytes = size;
+	arrival->time = time;
+	g_queue_push_tail(&buffio_info->io_arrivals, arrival);
+}
+
+/*
+* Forget the arrivals along with the data of the adapter. Called with the IO lock held.
+*/
+void
+av_bufferedio_clear_arrivals(GstBufferedIOInfo * buffio_info)
+{
+	GstBufferedIOArrival *arrival;
+
+	while ((arrival = g_queue_pop_head(&buffio_info->io_arrivals)) != NULL)
+		g_free(arrival);
+}
+
+/*
+* Take the arrivals of the data flushed from the head of the adapter. They are appended to taken with the end
+* of each run in the data read, if it is given.
+*/
+static void
+av_bufferedio_take_arrivals(GstBufferedIOInfo * buffio_info, gsize size, GArray * taken)
+{
+	GstBufferedIOArrival *arrival;
+	GstBufferedIOArrival run;
+	gsize end = 0;
+
+	while (size > 0 && (arrival = g_queue_peek_head(&buffio_info->io_arrivals)) != NULL) {
+		gsize bytes = MIN(size, arrival->bytes);
+
+		end += bytes;
+		size -= bytes;
+		if (taken != NULL) {
+			run.bytes = end;
+			run.time = arrival->time;
+			g_array_append_val(taken, run);
+		}
+
+		arrival->bytes -= bytes;
+		if (arrival->bytes == 0)
+			g_free(g_queue_pop_head(&buffio_info->io_arrivals));
+	}
+}
+
+/*
+* The arrival time of the byte at the position in the data of the last read, GST_CLOCK_TIME_NONE if it is not known.
+* Called from the observer, in the thread reading for libav.
+*/
+GstClockTime
+av_bufferedio_get_read_arrival(GstBufferedIOInfo * buffio_info, gsize position)
+{
+	GArray *runs = buffio_info->io_read_arrivals;
+	guint i;
+
+	for (i = 0; i < runs->len; i++) {
+		GstBufferedIOArrival *run = &g_array_index(runs, GstBufferedIOArrival, i);
+
+		if (position < run->bytes)
+			return run->time;
+	}
+
+	return GST_CLOCK_TIME_NONE;
+}
+
 /*
 * Set the debug category
 */
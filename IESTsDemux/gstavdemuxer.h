@@ -6,6 +6,14 @@
 #include <libavutil/mathematics.h>
 #include <gst/base/gstadapter.h>
 
+#include "gstaesdecrypt.h"
+
+// The size of the IO buffer handed to libav
+#define BUFFERED_IO_DEFAULT_SIZE	4096
+
+// No input offset
+#define BUFFERED_IO_NO_OFFSET		G_MAXUINT64
+
 // Macros
 #define GST_PRINT_AVERROR(errorcode) G_STMT_START {		\
 	gchar err_msg[512];									\
@@ -15,6 +23,18 @@
 
 typedef struct _GstBufferedIOInfo GstBufferedIOInfo;
 
+// Called with the data handed to libav. The data is NULL when the read position jumps.
+// io_read_offset has already moved past the data when it is called.
+typedef void (*GstBufferedIOObserver)(gpointer user_data, const guint8 * data, gsize size);
+
+// The arrival time of a run of bytes. In the queue of the adapter, bytes is the size left of the run.
+// In the array of the last read, it is where the run ends in the data handed to libav.
+typedef struct
+{
+	gsize		bytes;
+	GstClockTime	time;
+} GstBufferedIOArrival;
+
 struct _GstBufferedIOInfo
 {
 	GstPad		*target_pad;
@@ -29,8 +49,38 @@ struct _GstBufferedIOInfo
 
 	guint64		io_read_offset;
 
+	// The input offset of the data at the head of the adapter
+	guint64		io_adapter_offset;
+
 	guint64		io_read_needed;
+
+	gint		io_buffer_size;
+
+	// The adapter read returns once this many bytes are available. It waits for the whole request if it is 0.
+	gint		io_read_min;
+
+	GstBufferedIOObserver	io_observer;
+	gpointer	io_observer_data;
+
+	// The encrypted input is decrypted as libav reads it. NULL for the plain input.
+	GstAesDecryptor	*decryptor;
+
+	// The input offset where the next encrypted segment starts. The decryption ends there with the padding
+	// and starts over with the IV. The offsets seen by libav are behind the input ones by the padding and the
+	// partial blocks cut off.
+	guint64		io_boundary;
+	guint64		io_padding_removed;
+
+	// The data read by libav from this offset on is kept, so it can be read again once libav is opened again
+	GstAdapter	*io_replay_adapter;
+	guint64		io_replay_offset;
 	
+	// The arrival of the data in the adapter, oldest first, kept while io_track_arrivals is set.
+	// The arrivals of the data of the last read are moved to io_read_arrivals for the observer.
+	gboolean	io_track_arrivals;
+	GQueue		io_arrivals;
+	GArray		*io_read_arrivals;
+
 	gboolean	is_seekable;
 
 	gboolean	is_pullmode;
@@ -46,6 +96,20 @@ int av_bufferedio_open(GstBufferedIOInfo *device_info);
 
 int av_bufferedio_close(AVIOContext * context);
 
+void av_bufferedio_keep_from(GstBufferedIOInfo * buffio_info, guint64 offset);
+
+void av_bufferedio_replay(GstBufferedIOInfo * buffio_info);
+
+void av_bufferedio_drop_kept(GstBufferedIOInfo * buffio_info);
+
+void av_bufferedio_track_arrivals(GstBufferedIOInfo * buffio_info, gboolean track);
+
+void av_bufferedio_push_arrival(GstBufferedIOInfo * buffio_info, gsize size, GstClockTime time);
+
+void av_bufferedio_clear_arrivals(GstBufferedIOInfo * buffio_info);
+
+GstClockTime av_bufferedio_get_read_arrival(GstBufferedIOInfo * buffio_info, gsize position);
+
 /*
 * Allocate a new GstBufferedIOInfo instance and initialize it
 */
@@ -56,7 +120,19 @@ static GstBufferedIOInfo* alloc_bufferedio_info(GstPad *pad)
 	buffio_info->target_pad = pad;
 
 	buffio_info->io_read_offset = 0;
+	buffio_info->io_adapter_offset = 0;
 	buffio_info->io_read_needed = 0;
+	buffio_info->io_buffer_size = BUFFERED_IO_DEFAULT_SIZE;
+	buffio_info->io_read_min = 0;
+	buffio_info->io_observer = NULL;
+	buffio_info->io_observer_data = NULL;
+	buffio_info->decryptor = NULL;
+	buffio_info->io_boundary = BUFFERED_IO_NO_OFFSET;
+	buffio_info->io_padding_removed = 0;
+	buffio_info->io_replay_offset = BUFFERED_IO_NO_OFFSET;
+	buffio_info->io_track_arrivals = FALSE;
+	g_queue_init(&buffio_info->io_arrivals);
+	buffio_info->io_read_arrivals = g_array_new(FALSE, FALSE, sizeof(GstBufferedIOArrival));
 	buffio_info->is_seekable = FALSE;
 	buffio_info->is_eos = FALSE;
 
@@ -64,6 +140,7 @@ static GstBufferedIOInfo* alloc_bufferedio_info(GstPad *pad)
 	g_cond_init(&buffio_info->io_sync_cond);
 
 	buffio_info->gst_adapter = gst_adapter_new();
+	buffio_info->io_replay_adapter = gst_adapter_new();
 
 	return buffio_info;
 }
@@ -77,6 +154,10 @@ static void free_bufferedio_info(GstBufferedIOInfo * buffio_info)
 	g_cond_clear(&buffio_info->io_sync_cond);
 
 	gst_object_unref(&buffio_info->gst_adapter);
+	g_object_unref(buffio_info->io_replay_adapter);
+
+	av_bufferedio_clear_arrivals(buffio_info);
+	g_array_free(buffio_info->io_read_arrivals, TRUE);
 
 	g_free(buffio_info);
 }
@@ -0,0 +1,716 @@
+#include "gsth26xparse.h"
+
+#include <string.h>
+
+// SSE2 is there on every x86-64 CPU. The other CPUs skip the start codes bytewise.
+#if defined(__GNUC__) && defined(__SSE2__)
+#define H26X_HAVE_SSE2			1
+#include <emmintrin.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_h26xparse_debug);
+#define GST_CAT_DEFAULT gst_h26xparse_debug
+
+#define H264_NAL_SLICE			1
+#define H264_NAL_IDR			5
+#define H264_NAL_SPS			7
+#define H264_NAL_PPS			8
+
+#define H265_NAL_BLA_W_LP		16
+#define H265_NAL_RSV_IRAP_23	23
+#define H265_NAL_VCL_MAX		31
+#define H265_NAL_VPS			32
+#define H265_NAL_SPS			33
+#define H265_NAL_PPS			34
+
+// The SPS fields used here are well within the first bytes
+#define H26X_SPS_PARSE_SIZE		128
+
+// The general profile_tier_level of H.265 up to general_level_idc
+#define H265_PTL_SIZE			12
+
+#define H26X_LENGTH_SIZE		4
+
+typedef struct
+{
+	const guint8	*data;
+	gsize			size;
+	gsize			bit;
+} H26xBitReader;
+
+typedef struct
+{
+	guint		id;
+
+	// H.264
+	guint8		profile_idc;
+	guint8		constraint_flags;
+	guint8		level_idc;
+
+	// H.265
+	guint8		ptl[H265_PTL_SIZE];
+	guint		max_sub_layers_minus1;
+	guint		temporal_id_nesting;
+	guint		chroma_format_idc;
+	guint		bit_depth_luma_minus8;
+	guint		bit_depth_chroma_minus8;
+} H26xSpsInfo;
+
+static void h26x_parser_parse_nal(GstH26xParser * parser, const guint8 * nal, gsize size, gboolean * has_picture);
+static void h26x_parser_store(GstH26xParser * parser, GstBuffer ** slot, const guint8 * nal, gsize size);
+static gboolean h26x_parser_parse_sps(GstH26xParser * parser, const guint8 * nal, gsize size, H26xSpsInfo * info);
+static void h26x_parser_update_config(GstH26xParser * parser);
+static GstBuffer * h26x_parser_make_avcc(GstH26xParser * parser, const H26xSpsInfo * info);
+static GstBuffer * h26x_parser_make_hvcc(GstH26xParser * parser, const H26xSpsInfo * info);
+static void h26x_append_nals(GByteArray * out, GstBuffer ** sets, guint count, gboolean with_count16);
+static gsize h26x_unescape(const guint8 * data, gsize size, guint8 * out, gsize max_size);
+static guint32 h26x_read_bits(H26xBitReader * reader, guint bits);
+static guint32 h26x_read_ue(H26xBitReader * reader);
+
+/*
+* Allocate a new parser. The packetized one keeps the codec_data for avc or hvc1.
+*/
+GstH26xParser *
+gst_h26x_parser_new(GstH26xCodec codec, gboolean packetized)
+{
+	GstH26xParser *parser = g_new0(GstH26xParser, 1);
+
+	parser->codec = codec;
+	parser->packetized = packetized;
+	parser->last_sps = -1;
+	parser->nals = g_array_new(FALSE, FALSE, sizeof(GstH26xNal));
+
+	return parser;
+}
+
+void
+gst_h26x_parser_free(GstH26xParser * parser)
+{
+	if (parser == NULL)
+		return;
+
+	for (guint i = 0; i < H26X_MAX_VPS; i++)
+		gst_buffer_replace(&parser->vps[i], NULL);
+	for (guint i = 0; i < H26X_MAX_SPS; i++)
+		gst_buffer_replace(&parser->sps[i], NULL);
+	for (guint i = 0; i < H26X_MAX_PPS; i++)
+		gst_buffer_replace(&parser->pps[i], NULL);
+	gst_buffer_replace(&parser->codec_data, NULL);
+
+	g_array_free(parser->nals, TRUE);
+	g_free(parser);
+}
+
+/*
+* Find the next 00 00 01 from the position. It returns the size when there is none.
+*/
+gsize
+gst_h26x_find_start_code(const guint8 * data, gsize size, gsize pos)
+{
+#ifdef H26X_HAVE_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+
+	// 16 positions at once. The loads at +1 and +2 stay within the data.
+	while (pos + 18 <= size) {
+		__m128i byte0 = _mm_loadu_si128((const __m128i *)(data + pos));
+		__m128i byte1 = _mm_loadu_si128((const __m128i *)(data + pos + 1));
+		__m128i byte2 = _mm_loadu_si128((const __m128i *)(data + pos + 2));
+		__m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(byte0, zero), _mm_cmpeq_epi8(byte1, zero)),
+			_mm_cmpeq_epi8(byte2, one));
+		gint mask = _mm_movemask_epi8(match);
+
+		if (mask != 0)
+			return pos + __builtin_ctz(mask);
+
+		pos += 16;
+	}
+#endif
+
+	// A byte above 1 rules out the start codes overlapping it
+	while (pos + 3 <= size) {
+		if (data[pos + 2] > 1)
+			pos += 3;
+		else if (data[pos + 1] != 0)
+			pos += 2;
+		else if (data[pos] != 0 || data[pos + 2] != 1)
+			pos++;
+		else
+			return pos;
+	}
+
+	return size;
+}
+
+/*
+* Split the access unit into the NAL units and take the parameter sets. It returns TRUE when the caps have changed.
+* The access unit is aligned when it starts with a start code and holds exactly one picture.
+*/
+gboolean
+gst_h26x_parser_parse(GstH26xParser * parser, const guint8 * data, gsize size)
+{
+	gsize header_size = parser->codec == GST_H26X_CODEC_H264 ? 1 : 2;
+	gsize pos = gst_h26x_find_start_code(data, size, 0);
+	gboolean has_picture = FALSE;
+	gboolean params_changed;
+
+	g_array_set_size(parser->nals, 0);
+	parser->is_keyframe = FALSE;
+
+	// The leading zero of a 4-byte start code is the zero_byte
+	parser->is_aligned = pos == 0 || (pos == 1 && data[0] == 0x00);
+	params_changed = parser->caps_changed;
+	parser->caps_changed = FALSE;
+
+	while (pos < size) {
+		gsize start = pos + 3;
+		gsize end;
+		GstH26xNal nal;
+
+		pos = gst_h26x_find_start_code(data, size, start);
+
+		// The zeros before the next start code are not part of the NAL unit
+		end = pos;
+		while (end > start && data[end - 1] == 0x00)
+			end--;
+
+		if (end - start < header_size)
+			continue;
+
+		nal.offset = (guint)start;
+		nal.size = (guint)(end - start);
+		if (parser->codec == GST_H26X_CODEC_H264)
+			nal.type = data[start] & 0x1f;
+		else
+			nal.type = (data[start] >> 1) & 0x3f;
+
+		g_array_append_val(parser->nals, nal);
+		h26x_parser_parse_nal(parser, data + start, nal.size, &has_picture);
+	}
+
+	// The parameter sets alone are not an access unit
+	if (has_picture) {
+		parser->access_units++;
+
+		if (!parser->is_aligned) {
+			parser->misaligned_units++;
+			if (parser->misaligned_units == 1)
+				GST_WARNING("The access unit %" G_GUINT64_FORMAT " is not aligned. A parser is needed downstream.",
+					parser->access_units);
+		}
+	}
+	else {
+		parser->is_aligned = FALSE;
+	}
+
+	if (parser->caps_changed)
+		h26x_parser_update_config(parser);
+
+	parser->caps_changed = parser->caps_changed || params_changed;
+
+	return parser->caps_changed;
+}
+
+gboolean
+gst_h26x_parser_has_codec_data(GstH26xParser * parser)
+{
+	return parser->codec_data != NULL;
+}
+
+/*
+* Set the stream format, the profile and the level found in the SPS. The packetized output carries the codec_data.
+*/
+void
+gst_h26x_parser_update_caps(GstH26xParser * parser, GstCaps * caps)
+{
+	const gchar *stream_format = "byte-stream";
+
+	if (parser->packetized)
+		stream_format = parser->codec == GST_H26X_CODEC_H264 ? "avc" : "hvc1";
+
+	gst_caps_set_simple(caps, "alignment", G_TYPE_STRING, "au",
+		"stream-format", G_TYPE_STRING, stream_format, NULL);
+
+	if (parser->profile != NULL)
+		gst_caps_set_simple(caps, "profile", G_TYPE_STRING, parser->profile, NULL);
+	if (parser->tier != NULL)
+		gst_caps_set_simple(caps, "tier", G_TYPE_STRING, parser->tier, NULL);
+	if (parser->level[0] != '\0')
+		gst_caps_set_simple(caps, "level", G_TYPE_STRING, parser->level, NULL);
+
+	if (parser->packetized && parser->codec_data != NULL)
+		gst_caps_set_simple(caps, "codec_data", GST_TYPE_BUFFER, parser->codec_data, NULL);
+
+	parser->caps_changed = FALSE;
+}
+
+/*
+* Rewrite the latest access unit with 4-byte lengths in place of the start codes. The parameter sets are left to the
+* codec_data.
+*/
+GstBuffer *
+gst_h26x_parser_make_packetized(GstH26xParser * parser, const guint8 * data)
+{
+	GstBuffer *buffer;
+	GstMapInfo map;
+	gsize size = 0, pos = 0;
+
+	for (guint i = 0; i < parser->nals->len; i++) {
+		GstH26xNal *nal = &g_array_index(parser->nals, GstH26xNal, i);
+		size += H26X_LENGTH_SIZE + nal->size;
+	}
+
+	buffer = gst_buffer_new_allocate(NULL, size, NULL);
+	gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+
+	for (guint i = 0; i < parser->nals->len; i++) {
+		GstH26xNal *nal = &g_array_index(parser->nals, GstH26xNal, i);
+
+		if (parser->codec == GST_H26X_CODEC_H264 ? (nal->type == H264_NAL_SPS || nal->type == H264_NAL_PPS) :
+			(nal->type >= H265_NAL_VPS && nal->type <= H265_NAL_PPS))
+			continue;
+
+		GST_WRITE_UINT32_BE(map.data + pos, nal->size);
+		memcpy(map.data + pos + H26X_LENGTH_SIZE, data + nal->offset, nal->size);
+		pos += H26X_LENGTH_SIZE + nal->size;
+	}
+
+	gst_buffer_unmap(buffer, &map);
+	gst_buffer_set_size(buffer, pos);
+
+	return buffer;
+}
+
+void
+init_h26xparse(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_h26xparse_debug, "h26xparse", 0, "H.264/H.265 Access Unit Parser");
+}
+
+/*
+* Take the parameter sets and check the pictures of a NAL unit
+*/
+static void
+h26x_parser_parse_nal(GstH26xParser * parser, const guint8 * nal, gsize size, gboolean * has_picture)
+{
+	H26xSpsInfo info;
+	guint8 rbsp[8];
+	H26xBitReader reader = { rbsp, 0, 0 };
+	gboolean is_vcl, is_first_slice;
+
+	if (parser->codec == GST_H26X_CODEC_H264) {
+		guint8 type = nal[0] & 0x1f;
+
+		switch (type) {
+		case H264_NAL_SPS:
+			if (h26x_parser_parse_sps(parser, nal, size, &info)) {
+				h26x_parser_store(parser, &parser->sps[info.id], nal, size);
+				parser->last_sps = info.id;
+			}
+			return;
+
+		case H264_NAL_PPS:
+			reader.size = h26x_unescape(nal + 1, size - 1, rbsp, sizeof(rbsp));
+			info.id = h26x_read_ue(&reader);
+			if (info.id < H26X_MAX_PPS)
+				h26x_parser_store(parser, &parser->pps[info.id], nal, size);
+			return;
+		}
+
+		// first_mb_in_slice is 0 when the first bit of the slice header is set
+		is_vcl = type >= H264_NAL_SLICE && type <= H264_NAL_IDR;
+		is_first_slice = size > 1 && (nal[1] & 0x80) != 0;
+		if (type == H264_NAL_IDR)
+			parser->is_keyframe = TRUE;
+	}
+	else {
+		guint8 type = (nal[0] >> 1) & 0x3f;
+
+		switch (type) {
+		case H265_NAL_VPS:
+			if (size > 2 && (nal[2] >> 4) < H26X_MAX_VPS)
+				h26x_parser_store(parser, &parser->vps[nal[2] >> 4], nal, size);
+			return;
+
+		case H265_NAL_SPS:
+			if (h26x_parser_parse_sps(parser, nal, size, &info)) {
+				h26x_parser_store(parser, &parser->sps[info.id], nal, size);
+				parser->last_sps = info.id;
+			}
+			return;
+
+		case H265_NAL_PPS:
+			reader.size = h26x_unescape(nal + 2, size - 2, rbsp, sizeof(rbsp));
+			info.id = h26x_read_ue(&reader);
+			if (info.id < H26X_MAX_PPS)
+				h26x_parser_store(parser, &parser->pps[info.id], nal, size);
+			return;
+		}
+
+		// first_slice_segment_in_pic_flag is the first bit of the slice header
+		is_vcl = type <= H265_NAL_VCL_MAX;
+		is_first_slice = size > 2 && (nal[2] & 0x80) != 0;
+		if (type >= H265_NAL_BLA_W_LP && type <= H265_NAL_RSV_IRAP_23)
+			parser->is_keyframe = TRUE;
+	}
+
+	if (!is_vcl)
+		return;
+
+	// A slice without the first one before it, or a second picture, breaks the alignment
+	if (is_first_slice && *has_picture)
+		parser->is_aligned = FALSE;
+	else if (!is_first_slice && !*has_picture)
+		parser->is_aligned = FALSE;
+
+	*has_picture = TRUE;
+}
+
+/*
+* Keep a parameter set. An identical one is not a change.
+*/
+static void
+h26x_parser_store(GstH26xParser * parser, GstBuffer ** slot, const guint8 * nal, gsize size)
+{
+	if (*slot != NULL && gst_buffer_get_size(*slot) == size && gst_buffer_memcmp(*slot, 0, nal, size) == 0)
+		return;
+
+	gst_buffer_replace(slot, NULL);
+	*slot = gst_buffer_new_allocate(NULL, size, NULL);
+	gst_buffer_fill(*slot, 0, nal, size);
+
+	parser->caps_changed = TRUE;
+}
+
+/*
+* Read the SPS up to the fields of the caps and the codec_data
+*/
+static gboolean
+h26x_parser_parse_sps(GstH26xParser * parser, const guint8 * nal, gsize size, H26xSpsInfo * info)
+{
+	guint8 rbsp[H26X_SPS_PARSE_SIZE];
+	H26xBitReader reader = { rbsp, 0, 0 };
+
+	memset(info, 0, sizeof(H26xSpsInfo));
+
+	if (parser->codec == GST_H26X_CODEC_H264) {
+		reader.size = h26x_unescape(nal + 1, size - 1, rbsp, sizeof(rbsp));
+		if (reader.size < 4)
+			return FALSE;
+
+		info->profile_idc = rbsp[0];
+		info->constraint_flags = rbsp[1];
+		info->level_idc = rbsp[2];
+
+		reader.bit = 24;
+		info->id = h26x_read_ue(&reader);
+	}
+	else {
+		guint sub_layer_flags[8];
+
+		reader.size = h26x_unescape(nal + 2, size - 2, rbsp, sizeof(rbsp));
+		if (reader.size < 1 + H265_PTL_SIZE + 1)
+			return FALSE;
+
+		h26x_read_bits(&reader, 4);
+		info->max_sub_layers_minus1 = h26x_read_bits(&reader, 3);
+		info->temporal_id_nesting = h26x_read_bits(&reader, 1);
+		memcpy(info->ptl, rbsp + 1, H265_PTL_SIZE);
+		reader.bit += H265_PTL_SIZE * 8;
+
+		// The profile and the level of the sub-layers are skipped
+		for (guint i = 0; i < info->max_sub_layers_minus1; i++)
+			sub_layer_flags[i] = h26x_read_bits(&reader, 2);
+		if (info->max_sub_layers_minus1 > 0)
+			reader.bit += (8 - info->max_sub_layers_minus1) * 2;
+		for (guint i = 0; i < info->max_sub_layers_minus1; i++)
+			reader.bit += ((sub_layer_flags[i] & 0x2) ? 88 : 0) + ((sub_layer_flags[i] & 0x1) ? 8 : 0);
+
+		info->id = h26x_read_ue(&reader);
+		info->chroma_format_idc = h26x_read_ue(&reader);
+		if (info->chroma_format_idc == 3)
+			h26x_read_bits(&reader, 1);
+
+		// The picture size and the conformance window
+		h26x_read_ue(&reader);
+		h26x_read_ue(&reader);
+		if (h26x_read_bits(&reader, 1)) {
+			for (guint i = 0; i < 4; i++)
+				h26x_read_ue(&reader);
+		}
+
+		info->bit_depth_luma_minus8 = h26x_read_ue(&reader);
+		info->bit_depth_chroma_minus8 = h26x_read_ue(&reader);
+	}
+
+	if (reader.bit > reader.size * 8 || info->id >= H26X_MAX_SPS) {
+		GST_DEBUG("Ignoring a broken SPS");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+* Find the profile and the level of the latest SPS and build the codec_data again
+*/
+static void
+h26x_parser_update_config(GstH26xParser * parser)
+{
+	H26xSpsInfo info;
+	GstMapInfo map;
+	gboolean has_sps;
+
+	if (parser->last_sps < 0 || parser->sps[parser->last_sps] == NULL)
+		return;
+
+	gst_buffer_map(parser->sps[parser->last_sps], &map, GST_MAP_READ);
+	has_sps = h26x_parser_parse_sps(parser, map.data, map.size, &info);
+	gst_buffer_unmap(parser->sps[parser->last_sps], &map);
+
+	if (!has_sps)
+		return;
+
+	parser->profile = NULL;
+	parser->tier = NULL;
+
+	if (parser->codec == GST_H26X_CODEC_H264) {
+		gboolean constraint_set1 = (info.constraint_flags & 0x40) != 0;
+		gboolean constraint_set3 = (info.constraint_flags & 0x10) != 0;
+
+		switch (info.profile_idc) {
+		case 66:	parser->profile = constraint_set1 ? "constrained-baseline" : "baseline"; break;
+		case 77:	parser->profile = "main"; break;
+		case 88:	parser->profile = "extended"; break;
+		case 100:	parser->profile = "high"; break;
+		case 110:	parser->profile = "high-10"; break;
+		case 122:	parser->profile = "high-4:2:2"; break;
+		case 244:	parser->profile = "high-4:4:4"; break;
+		case 44:	parser->profile = "cavlc-4:4:4-intra"; break;
+		}
+
+		// Level 1b is 11 with constraint_set3 in the baseline, the main and the extended profiles
+		if (info.level_idc == 9 || (info.level_idc == 11 && constraint_set3 &&
+			(info.profile_idc == 66 || info.profile_idc == 77 || info.profile_idc == 88)))
+			g_strlcpy(parser->level, "1b", H26X_LEVEL_SIZE);
+		else if (info.level_idc % 10 == 0)
+			g_snprintf(parser->level, H26X_LEVEL_SIZE, "%u", info.level_idc / 10);
+		else
+			g_snprintf(parser->level, H26X_LEVEL_SIZE, "%u.%u", info.level_idc / 10, info.level_idc % 10);
+	}
+	else {
+		guint profile_idc = info.ptl[0] & 0x1f;
+		guint level_idc = info.ptl[H265_PTL_SIZE - 1];
+
+		// The profile may be given by the compatibility flags alone
+		for (guint i = 1; profile_idc == 0 && i <= 3; i++) {
+			if (info.ptl[1 + i / 8] & (0x80 >> (i % 8)))
+				profile_idc = i;
+		}
+
+		switch (profile_idc) {
+		case 1:	parser->profile = "main"; break;
+		case 2:	parser->profile = "main-10"; break;
+		case 3:	parser->profile = "main-still-picture"; break;
+		}
+
+		parser->tier = (info.ptl[0] & 0x20) ? "high" : "main";
+
+		// general_level_idc is 30 times the level
+		if ((level_idc % 30) == 0)
+			g_snprintf(parser->level, H26X_LEVEL_SIZE, "%u", level_idc / 30);
+		else
+			g_snprintf(parser->level, H26X_LEVEL_SIZE, "%u.%u", level_idc / 30, (level_idc % 30) / 3);
+	}
+
+	if (!parser->packetized)
+		return;
+
+	gst_buffer_replace(&parser->codec_data, NULL);
+	if (parser->codec == GST_H26X_CODEC_H264)
+		parser->codec_data = h26x_parser_make_avcc(parser, &info);
+	else
+		parser->codec_data = h26x_parser_make_hvcc(parser, &info);
+}
+
+/*
+* AVCDecoderConfigurationRecord of ISO/IEC 14496-15
+*/
+static GstBuffer *
+h26x_parser_make_avcc(GstH26xParser * parser, const H26xSpsInfo * info)
+{
+	GByteArray *out;
+	guint8 header[5];
+	gsize size;
+
+	out = g_byte_array_new();
+
+	header[0] = 1;
+	header[1] = info->profile_idc;
+	header[2] = info->constraint_flags;
+	header[3] = info->level_idc;
+	header[4] = 0xfc | (H26X_LENGTH_SIZE - 1);
+	g_byte_array_append(out, header, sizeof(header));
+
+	// The counts are in the low bits of a byte
+	h26x_append_nals(out, parser->sps, H26X_MAX_SPS, FALSE);
+	if (out->len == sizeof(header) + 1)
+		goto ex_incomplete;
+	out->data[sizeof(header)] |= 0xe0;
+
+	size = out->len;
+	h26x_append_nals(out, parser->pps, H26X_MAX_PPS, FALSE);
+	if (out->len == size + 1)
+		goto ex_incomplete;
+
+	size = out->len;
+	return gst_buffer_new_wrapped(g_byte_array_free(out, FALSE), size);
+
+ex_incomplete:
+	GST_DEBUG("Waiting for the SPS and the PPS");
+	g_byte_array_free(out, TRUE);
+	return NULL;
+}
+
+/*
+* HEVCDecoderConfigurationRecord of ISO/IEC 14496-15
+*/
+static GstBuffer *
+h26x_parser_make_hvcc(GstH26xParser * parser, const H26xSpsInfo * info)
+{
+	static const guint8 types[3] = { H265_NAL_VPS, H265_NAL_SPS, H265_NAL_PPS };
+	GstBuffer **sets[3] = { parser->vps, parser->sps, parser->pps };
+	const guint counts[3] = { H26X_MAX_VPS, H26X_MAX_SPS, H26X_MAX_PPS };
+	GByteArray *out;
+	guint8 header[23];
+	gsize size;
+
+	out = g_byte_array_new();
+
+	header[0] = 1;
+	memcpy(header + 1, info->ptl, H265_PTL_SIZE);
+	// No min_spatial_segmentation_idc and no parallelism
+	header[13] = 0xf0;
+	header[14] = 0x00;
+	header[15] = 0xfc;
+	header[16] = 0xfc | (info->chroma_format_idc & 0x3);
+	header[17] = 0xf8 | (info->bit_depth_luma_minus8 & 0x7);
+	header[18] = 0xf8 | (info->bit_depth_chroma_minus8 & 0x7);
+	// No avgFrameRate and no constantFrameRate
+	header[19] = 0x00;
+	header[20] = 0x00;
+	header[21] = ((info->max_sub_layers_minus1 + 1) << 3) | (info->temporal_id_nesting << 2) | (H26X_LENGTH_SIZE - 1);
+	header[22] = G_N_ELEMENTS(types);
+	g_byte_array_append(out, header, sizeof(header));
+
+	for (guint i = 0; i < G_N_ELEMENTS(types); i++) {
+		// array_completeness is set since the parameter sets are not repeated in the samples
+		guint8 array_type = 0x80 | types[i];
+
+		g_byte_array_append(out, &array_type, 1);
+		size = out->len;
+		h26x_append_nals(out, sets[i], counts[i], TRUE);
+		if (out->len == size + 2)
+			goto ex_incomplete;
+	}
+
+	size = out->len;
+	return gst_buffer_new_wrapped(g_byte_array_free(out, FALSE), size);
+
+ex_incomplete:
+	GST_DEBUG("Waiting for the VPS, the SPS and the PPS");
+	g_byte_array_free(out, TRUE);
+	return NULL;
+}
+
+/*
+* Append the count of the parameter sets followed by each of them with its 16-bit length. The count takes 16 bits in
+* hvcC and 8 in avcC.
+*/
+static void
+h26x_append_nals(GByteArray * out, GstBuffer ** sets, guint count, gboolean with_count16)
+{
+	gsize count_pos = out->len;
+	guint num = 0;
+	guint8 bytes[2] = { 0, 0 };
+
+	g_byte_array_append(out, bytes, with_count16 ? 2 : 1);
+
+	for (guint i = 0; i < count; i++) {
+		GstMapInfo map;
+
+		if (sets[i] == NULL)
+			continue;
+
+		gst_buffer_map(sets[i], &map, GST_MAP_READ);
+		GST_WRITE_UINT16_BE(bytes, map.size);
+		g_byte_array_append(out, bytes, 2);
+		g_byte_array_append(out, map.data, map.size);
+		gst_buffer_unmap(sets[i], &map);
+		num++;
+	}
+
+	if (with_count16)
+		GST_WRITE_UINT16_BE(out->data + count_pos, num);
+	else
+		out->data[count_pos] = (guint8)MIN(num, 0x1f);
+}
+
+/*
+* Remove the emulation prevention bytes
+*/
+static gsize
+h26x_unescape(const guint8 * data, gsize size, guint8 * out, gsize max_size)
+{
+	gsize out_size = 0;
+	guint zeros = 0;
+
+	for (gsize i = 0; i < size && out_size < max_size; i++) {
+		if (zeros >= 2 && data[i] == 0x03) {
+			zeros = 0;
+			continue;
+		}
+
+		zeros = data[i] == 0x00 ? zeros + 1 : 0;
+		out[out_size++] = data[i];
+	}
+
+	return out_size;
+}
+
+/*
+* Read the bits in the big endian order. The bits past the end read as zero.
+*/
+static guint32
+h26x_read_bits(H26xBitReader * reader, guint bits)
+{
+	guint32 value = 0;
+
+	while (bits-- > 0) {
+		guint bit = 0;
+
+		if (reader->bit < reader->size * 8)
+			bit = (reader->data[reader->bit >> 3] >> (7 - (reader->bit & 7))) & 1;
+
+		value = (value << 1) | bit;
+		reader->bit++;
+	}
+
+	return value;
+}
+
+/*
+* Read an unsigned Exp-Golomb code. A broken one reads as G_MAXUINT32.
+*/
+static guint32
+h26x_read_ue(H26xBitReader * reader)
+{
+	guint zeros = 0;
+
+	while (h26x_read_bits(reader, 1) == 0) {
+		if (++zeros >= 32 || reader->bit > reader->size * 8)
+			return G_MAXUINT32;
+	}
+
+	return ((1u << zeros) - 1) + h26x_read_bits(reader, zeros);
+}
@@ -0,0 +1,84 @@
+#ifndef __GST_H26XPARSE_H__
+#define __GST_H26XPARSE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// The parameter set IDs of both codecs. H.265 uses fewer of them.
+#define H26X_MAX_VPS			16
+#define H26X_MAX_SPS			32
+#define H26X_MAX_PPS			256
+
+// The level strings are like "5.1"
+#define H26X_LEVEL_SIZE			8
+
+typedef enum
+{
+	GST_H26X_CODEC_H264,
+	GST_H26X_CODEC_H265
+} GstH26xCodec;
+
+typedef struct _GstH26xNal		GstH26xNal;
+typedef struct _GstH26xParser	GstH26xParser;
+
+/*
+* A NAL unit of the access unit. The offset is the one of the NAL header. The trailing zeros are not in the size.
+*/
+struct _GstH26xNal
+{
+	guint		offset;
+	guint		size;
+	guint8		type;
+};
+
+/*
+* Splits the access units of a byte stream into the NAL units. The parameter sets are kept for the caps and,
+* when the output is packetized, for the codec_data of avc or hvc1.
+*/
+struct _GstH26xParser
+{
+	GstH26xCodec	codec;
+	gboolean		packetized;
+
+	GstBuffer	*vps[H26X_MAX_VPS];
+	GstBuffer	*sps[H26X_MAX_SPS];
+	GstBuffer	*pps[H26X_MAX_PPS];
+	gint		last_sps;
+
+	// From the latest SPS. The profile and the tier are NULL when unknown.
+	const gchar	*profile;
+	const gchar	*tier;
+	gchar		level[H26X_LEVEL_SIZE];
+	GstBuffer	*codec_data;
+	gboolean	caps_changed;
+
+	// The NAL units of the latest access unit
+	GArray		*nals;
+	gboolean	is_keyframe;
+	gboolean	is_aligned;
+
+	// Statistics
+	guint64		access_units;
+	guint64		misaligned_units;
+};
+
+void init_h26xparse(void);
+
+GstH26xParser * gst_h26x_parser_new(GstH26xCodec codec, gboolean packetized);
+
+void gst_h26x_parser_free(GstH26xParser * parser);
+
+gsize gst_h26x_find_start_code(const guint8 * data, gsize size, gsize pos);
+
+gboolean gst_h26x_parser_parse(GstH26xParser * parser, const guint8 * data, gsize size);
+
+gboolean gst_h26x_parser_has_codec_data(GstH26xParser * parser);
+
+void gst_h26x_parser_update_caps(GstH26xParser * parser, GstCaps * caps);
+
+GstBuffer * gst_h26x_parser_make_packetized(GstH26xParser * parser, const guint8 * data);
+
+G_END_DECLS
+
+#endif /* __GST_H26XPARSE_H__ */
@@ -18,6 +18,7 @@
 #include <gst/gst.h>
 
 #include "gstiestsdemux.h"
+#include "gstiestsmultidemux.h"
 #include "gstavdemuxer.h"
 
 GST_DEBUG_CATEGORY_STATIC(gst_iestsdemux_debug);
@@ -33,9 +34,127 @@ enum
 enum
 {
 	PROP_0,
-	PROP_SILENT
+	PROP_SILENT,
+	PROP_LOOP_CACHE_SIZE,
+	PROP_LOOP_CACHE_RANGES,
+	PROP_SCRUB_CACHE_DURATION,
+	PROP_SCRUB_CACHE_MAX_BYTES,
+	PROP_SCRUB_CACHE_HIT_RATE,
+	PROP_SCRUB_CACHE_BYTES,
+	PROP_SCAN_MODE,
+	PROP_SCAN_THREADS,
+	PROP_BUILD_INDEX,
+	PROP_LIVE,
+	PROP_PCR_CLOCK,
+	PROP_PCR_JITTER,
+	PROP_PCR_DRIFT,
+	PROP_TS_PASSTHROUGH,
+	PROP_TS_PIDS,
+	PROP_TS_BATCH_PACKETS,
+	PROP_TS_MONITOR,
+	PROP_TS_MONITOR_INTERVAL,
+	PROP_TS_STATS,
+	PROP_AES_KEY,
+	PROP_AES_IV,
+	PROP_AES_KEY_FILE,
+	PROP_VIDEO_STREAM_FORMAT,
+	PROP_AUDIO_STREAM_FORMAT
 };
 
+#define DEFAULT_LOOP_CACHE_SIZE		0
+#define DEFAULT_LOOP_CACHE_RANGES	1
+#define DEFAULT_SCRUB_CACHE_DURATION	0
+#define DEFAULT_SCRUB_CACHE_MAX_BYTES	(64 * 1024 * 1024)
+#define DEFAULT_SCAN_MODE				GST_IESTSDEMUX_SCAN_MODE_NORMAL
+#define DEFAULT_SCAN_THREADS			0
+#define DEFAULT_BUILD_INDEX				FALSE
+#define DEFAULT_LIVE					FALSE
+#define DEFAULT_PCR_CLOCK				FALSE
+#define DEFAULT_TS_PASSTHROUGH			GST_IESTSDEMUX_TS_PASSTHROUGH_DISABLED
+#define DEFAULT_TS_BATCH_PACKETS		TS_FILTER_DEFAULT_BATCH_PACKETS
+#define DEFAULT_TS_MONITOR				FALSE
+#define DEFAULT_TS_MONITOR_INTERVAL		(1 * GST_SECOND)
+#define DEFAULT_VIDEO_STREAM_FORMAT		GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_BYTE_STREAM
+#define DEFAULT_AUDIO_STREAM_FORMAT		GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_ADTS
+
+// The sampling_frequency_index of the AAC configurations
+static const gint aac_sample_rates[] = {
+	96000, 88200, 64000, 48000, 44100, 32000, 24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+#define GST_TYPE_IESTSDEMUX_SCAN_MODE (gst_iestsdemux_scan_mode_get_type())
+static GType
+gst_iestsdemux_scan_mode_get_type(void)
+{
+	static GType scan_mode_type = 0;
+	static const GEnumValue scan_modes[] = {
+		{GST_IESTSDEMUX_SCAN_MODE_NORMAL, "Demux every stream", "normal"},
+		{GST_IESTSDEMUX_SCAN_MODE_METADATA_ONLY, "Demux only the timed metadata stream without probing", "metadata-only"},
+		{0, NULL, NULL}
+	};
+
+	if (!scan_mode_type) {
+		scan_mode_type = g_enum_register_static("GstiestsdemuxScanMode", scan_modes);
+	}
+
+	return scan_mode_type;
+}
+
+#define GST_TYPE_IESTSDEMUX_TS_PASSTHROUGH (gst_iestsdemux_ts_passthrough_get_type())
+static GType
+gst_iestsdemux_ts_passthrough_get_type(void)
+{
+	static GType ts_passthrough_type = 0;
+	static const GEnumValue ts_passthrough_modes[] = {
+		{GST_IESTSDEMUX_TS_PASSTHROUGH_DISABLED, "No TS pad", "disabled"},
+		{GST_IESTSDEMUX_TS_PASSTHROUGH_ENABLED, "Add the TS pad next to the demuxed streams", "enabled"},
+		{GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY, "Forward the TS packets only without demuxing", "only"},
+		{0, NULL, NULL}
+	};
+
+	if (!ts_passthrough_type) {
+		ts_passthrough_type = g_enum_register_static("GstiestsdemuxTsPassthrough", ts_passthrough_modes);
+	}
+
+	return ts_passthrough_type;
+}
+
+#define GST_TYPE_IESTSDEMUX_VIDEO_STREAM_FORMAT (gst_iestsdemux_video_stream_format_get_type())
+static GType
+gst_iestsdemux_video_stream_format_get_type(void)
+{
+	static GType video_stream_format_type = 0;
+	static const GEnumValue video_stream_formats[] = {
+		{GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_BYTE_STREAM, "Start codes with the parameter sets in the stream", "byte-stream"},
+		{GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_PACKETIZED, "Lengths with the parameter sets in the codec_data (avc or hvc1)", "packetized"},
+		{0, NULL, NULL}
+	};
+
+	if (!video_stream_format_type) {
+		video_stream_format_type = g_enum_register_static("GstiestsdemuxVideoStreamFormat", video_stream_formats);
+	}
+
+	return video_stream_format_type;
+}
+
+#define GST_TYPE_IESTSDEMUX_AUDIO_STREAM_FORMAT (gst_iestsdemux_audio_stream_format_get_type())
+static GType
+gst_iestsdemux_audio_stream_format_get_type(void)
+{
+	static GType audio_stream_format_type = 0;
+	static const GEnumValue audio_stream_formats[] = {
+		{GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_ADTS, "AAC frames with the ADTS headers", "adts"},
+		{GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_RAW, "AAC frames without the headers and the AudioSpecificConfig in the codec_data", "raw"},
+		{0, NULL, NULL}
+	};
+
+	if (!audio_stream_format_type) {
+		audio_stream_format_type = g_enum_register_static("GstiestsdemuxAudioStreamFormat", audio_stream_formats);
+	}
+
+	return audio_stream_format_type;
+}
+
 /* the capabilities of the inputs and outputs.
  *
  * describe the real formats here.
@@ -54,6 +173,10 @@ GST_STATIC_PAD_TEMPLATE("audio_%u", GST_PAD_SRC, GST_PAD_SOMETIMES, GST_STATIC_C
 static GstStaticPadTemplate metadata_src_factory =
 GST_STATIC_PAD_TEMPLATE("metadata_%u", GST_PAD_SRC, GST_PAD_SOMETIMES, GST_STATIC_CAPS("application/x-id3"));
 
+static GstStaticPadTemplate ts_src_factory =
+GST_STATIC_PAD_TEMPLATE("ts_%u", GST_PAD_SRC, GST_PAD_SOMETIMES,
+	GST_STATIC_CAPS("video/mpegts, systemstream = (boolean) true, packetsize = (int) 188"));
+
 #define gst_iestsdemux_parent_class parent_class
 G_DEFINE_TYPE(Gstiestsdemux, gst_iestsdemux, GST_TYPE_ELEMENT);
 
@@ -63,6 +186,8 @@ G_DEFINE_TYPE(Gstiestsdemux, gst_iestsdemux, GST_TYPE_ELEMENT);
 static void gst_iestsdemux_finalize(GObject * object);
 static void gst_iestsdemux_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
 static void gst_iestsdemux_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
+static GstClock * gst_iestsdemux_provide_clock(GstElement * element);
+static void gst_iestsdemux_update_clock_flag(Gstiestsdemux * demux);
 static GstStateChangeReturn gst_iestsdemux_change_state(GstElement *element, GstStateChange transition);
 static gboolean gst_iestsdemux_send_event(GstElement * element, GstEvent * event);
 static void gst_iestsdemux_type_find(GstTypeFind * find, gpointer user_data);
@@ -91,6 +216,15 @@ static gboolean gst_iestsdemux_sink_activate_pullmode(GstPad * sinkpad, GstObjec
 static gboolean gst_iestsdemux_push_event_to_srcpads(Gstiestsdemux * demux, GstEvent * event);
 static gboolean gst_iestsdemux_do_seek(Gstiestsdemux * demux, GstEvent * event);
 static void gst_iestsdemux_push_tags_to_srcpads(Gstiestsdemux * demux);
+static void gst_iestsdemux_push_eos(Gstiestsdemux * demux);
+static gboolean gst_iestsdemux_seek_loop_cache(Gstiestsdemux * demux, GstSegment * segment);
+static gboolean gst_iestsdemux_seek_scrub_cache(Gstiestsdemux * demux, GstSegment * segment);
+static void gst_iestsdemux_stop_replay(Gstiestsdemux * demux);
+static GstAVStream * gst_iestsdemux_replay_cache(Gstiestsdemux * demux, GList ** cursor, GstBuffer ** buff);
+static void gst_iestsdemux_push_gaps(Gstiestsdemux * demux, GstClockTime position);
+static void gst_iestsdemux_observe_io(gpointer user_data, const guint8 * data, gsize size);
+static void gst_iestsdemux_observe_pcr(guint16 pid, guint64 pcr, gboolean discontinuity, gpointer user_data);
+static GstFlowReturn gst_iestsdemux_push_ts(Gstiestsdemux * demux);
 
 //-------------------------------------
 // LibAV Supported Functions
@@ -99,10 +233,32 @@ static gboolean av_streams_open(Gstiestsdemux * demux);
 static void av_streams_close(Gstiestsdemux * demux);
 static gboolean av_streams_seek(Gstiestsdemux * demux, GstSegment * segment);
 static GstAVStream * av_streams_demux(Gstiestsdemux * demux, GstBuffer ** buff);
+static void av_streams_passthrough(Gstiestsdemux * demux);
+static void av_streams_resync(Gstiestsdemux * demux);
+static gboolean av_streams_follow_segments(Gstiestsdemux * demux, AVPacket * packet);
+static gboolean av_streams_has_same_codecs(Gstiestsdemux * demux);
+static gint64 av_streams_unwrap_pts(Gstiestsdemux * demux, gint64 pts, AVRational time_base);
+static void av_streams_open_ts_pad(Gstiestsdemux * demux);
+static gboolean av_streams_load_aes_key(Gstiestsdemux * demux, const gchar * key_hex, const gchar * iv_hex, const gchar * key_file);
+static void av_streams_start_segment(Gstiestsdemux * demux);
+static GstEvent * av_streams_new_stream_start(Gstiestsdemux * demux, GstPad * pad, const gchar * stream_name);
 static gboolean av_streams_parse_stream(Gstiestsdemux * demux, AVStream * avstream, int index);
+static gint av_streams_open_metadata_scan(Gstiestsdemux * demux);
+static void av_streams_run_scan(Gstiestsdemux * demux, GstiestsdemuxScanMode scan_mode);
+static GstAVStream * av_streams_demux_scanned(Gstiestsdemux * demux, GstBuffer ** buff);
+static GstClockTime av_streams_get_latency(Gstiestsdemux * demux, gboolean live);
+static gint av_streams_get_pcr_pid(Gstiestsdemux * demux, gint stream_index);
+static void av_streams_reset_qos(Gstiestsdemux * demux, GstAVStream * gst_stream);
+static gboolean av_streams_qos_drop(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet, GstClockTime position, GstClockTime duration);
+static gboolean av_streams_is_reference_unit(enum AVCodecID codec_id, const guint8 * data, gint size);
+static gboolean av_streams_parse_access_unit(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet);
+static GstBuffer * av_streams_make_aac_buffer(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet);
+static gboolean av_streams_parse_adts_header(const guint8 * data, gint size, guint * header_size, guint16 * config, gboolean * is_single);
+static guint16 av_streams_get_aac_config(AVCodecContext * codec_context);
+static void av_streams_free_packet_buffer(gpointer data);
 static void av_streams_parse_metadata_to_taglists(Gstiestsdemux * demux);
 static GstCaps* av_streams_make_videocaps(enum AVCodecID codec_id, int width, int height, double frame_rate);
-static GstCaps* av_streams_make_audiocaps(enum AVCodecID codec_id, int channels, int sample_rate);
+static GstCaps* av_streams_make_audiocaps(enum AVCodecID codec_id, int channels, int sample_rate, guint16 aac_config, gboolean raw);
 static GstCaps* av_streams_make_metadatacaps();
 
 /*
@@ -118,6 +274,7 @@ gst_iestsdemux_class_init(GstiestsdemuxClass * klass)
 	gstelement_class = (GstElementClass *)klass;
 
 	gstelement_class->change_state = gst_iestsdemux_change_state;
+	gstelement_class->provide_clock = GST_DEBUG_FUNCPTR(gst_iestsdemux_provide_clock);
 
 	gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_iestsdemux_finalize);
 	gobject_class->set_property = gst_iestsdemux_set_property;
@@ -126,6 +283,132 @@ gst_iestsdemux_class_init(GstiestsdemuxClass * klass)
 	g_object_class_install_property(gobject_class, PROP_SILENT,
 		g_param_spec_boolean("silent", "Silent", "Produce verbose output ?", FALSE, G_PARAM_READWRITE));
 
+	g_object_class_install_property(gobject_class, PROP_LOOP_CACHE_SIZE,
+		g_param_spec_uint64("loop-cache-size", "Loop cache size",
+			"Maximum bytes of demuxed buffers kept to replay the segment seeks from memory (0 = disabled)",
+			0, G_MAXUINT64, DEFAULT_LOOP_CACHE_SIZE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_LOOP_CACHE_RANGES,
+		g_param_spec_uint("loop-cache-ranges", "Loop cache ranges",
+			"Maximum number of segment ranges kept in the loop cache. The least recently used range is evicted first",
+			1, 64, DEFAULT_LOOP_CACHE_RANGES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCRUB_CACHE_DURATION,
+		g_param_spec_uint64("scrub-cache-duration", "Scrub cache duration",
+			"Duration of the latest demuxed packets kept to serve the short seeks from memory (0 = disabled)",
+			0, G_MAXUINT64, DEFAULT_SCRUB_CACHE_DURATION, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCRUB_CACHE_MAX_BYTES,
+		g_param_spec_uint64("scrub-cache-max-bytes", "Scrub cache max bytes",
+			"Maximum bytes kept in the scrub cache. The oldest GOPs are dropped first, the whole cache if no GOP fits (0 = no limit)",
+			0, G_MAXUINT64, DEFAULT_SCRUB_CACHE_MAX_BYTES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCRUB_CACHE_HIT_RATE,
+		g_param_spec_double("scrub-cache-hit-rate", "Scrub cache hit rate",
+			"Ratio of the seeks served from the scrub cache",
+			0.0, 1.0, 0.0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCRUB_CACHE_BYTES,
+		g_param_spec_uint64("scrub-cache-bytes", "Scrub cache bytes",
+			"Bytes of the packets kept in the scrub cache",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCAN_MODE,
+		g_param_spec_enum("scan-mode", "Scan mode",
+			"Demux every stream or scan only the timed metadata stream at the disk speed",
+			GST_TYPE_IESTSDEMUX_SCAN_MODE, DEFAULT_SCAN_MODE,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SCAN_THREADS,
+		g_param_spec_uint("scan-threads", "Scan threads",
+			"Number of workers scanning the pull mode input in parallel (0 = number of processors)",
+			0, 64, DEFAULT_SCAN_THREADS, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BUILD_INDEX,
+		g_param_spec_boolean("build-index", "Build index",
+			"Scan the whole pull mode input for the keyframes of the video stream before demuxing",
+			DEFAULT_BUILD_INDEX, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_LIVE,
+		g_param_spec_boolean("live", "Live",
+			"Probe only the beginning of the input and push every packet as soon as its PES completes",
+			DEFAULT_LIVE, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PCR_CLOCK,
+		g_param_spec_boolean("pcr-clock", "PCR clock",
+			"Provide a clock following the PCR of the selected program when live in the push mode",
+			DEFAULT_PCR_CLOCK, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PCR_JITTER,
+		g_param_spec_uint64("pcr-jitter", "PCR jitter",
+			"Running estimate of the PCR arrival jitter in nanoseconds",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PCR_DRIFT,
+		g_param_spec_double("pcr-drift", "PCR drift",
+			"Drift of the PCR against the system clock in ppm",
+			-G_MAXDOUBLE, G_MAXDOUBLE, 0.0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_PASSTHROUGH,
+		g_param_spec_enum("ts-passthrough", "TS passthrough",
+			"Forward the raw TS packets of the selected PIDs on the ts_0 pad",
+			GST_TYPE_IESTSDEMUX_TS_PASSTHROUGH, DEFAULT_TS_PASSTHROUGH,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_PIDS,
+		g_param_spec_string("ts-pids", "TS PIDs",
+			"Comma separated PIDs forwarded on the ts pad with their PAT and PMT (empty = every stream of the first program)",
+			NULL, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_BATCH_PACKETS,
+		g_param_spec_uint("ts-batch-packets", "TS batch packets",
+			"Number of TS packets pushed at once on the ts pad",
+			1, G_MAXUINT / TS_PACKET_SIZE, DEFAULT_TS_BATCH_PACKETS,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_MONITOR,
+		g_param_spec_boolean("ts-monitor", "TS monitor",
+			"Check the continuity, the PCR and the table repetition of every PID and post the ts-monitor messages",
+			DEFAULT_TS_MONITOR, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_MONITOR_INTERVAL,
+		g_param_spec_uint64("ts-monitor-interval", "TS monitor interval",
+			"Interval of the ts-monitor messages in nanoseconds of the PCR timeline",
+			GST_MSECOND, G_MAXUINT64, DEFAULT_TS_MONITOR_INTERVAL,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_TS_STATS,
+		g_param_spec_boxed("ts-stats", "TS stats",
+			"The last statistics posted by the transport monitor",
+			GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_AES_KEY,
+		g_param_spec_string("aes-key", "AES key",
+			"AES-128 key of the CBC encrypted input in 32 hex digits (empty = not encrypted unless aes-key-file is set)",
+			NULL, G_PARAM_WRITABLE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_AES_IV,
+		g_param_spec_string("aes-iv", "AES IV",
+			"IV of the encrypted input in 32 hex digits, with or without 0x (empty = zero)",
+			NULL, G_PARAM_WRITABLE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_AES_KEY_FILE,
+		g_param_spec_string("aes-key-file", "AES key file",
+			"Local file holding the AES-128 key in 16 bytes or in hex as served to the HLS clients",
+			NULL, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_VIDEO_STREAM_FORMAT,
+		g_param_spec_enum("video-stream-format", "Video stream format",
+			"Stream format of the H.264 and H.265 pads. The access units are aligned either way.",
+			GST_TYPE_IESTSDEMUX_VIDEO_STREAM_FORMAT, DEFAULT_VIDEO_STREAM_FORMAT,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_AUDIO_STREAM_FORMAT,
+		g_param_spec_enum("audio-stream-format", "Audio stream format",
+			"Stream format of the AAC pads. Each buffer is one AAC frame either way.",
+			GST_TYPE_IESTSDEMUX_AUDIO_STREAM_FORMAT, DEFAULT_AUDIO_STREAM_FORMAT,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
 	gst_element_class_set_metadata(gstelement_class,
 		"MPEG traansport stream demuxer", "Demuxer",
 		"Demux MPEG2 transport stream", "Intel Sports <<UNKNOWN-TODO@intel.com>>");
@@ -135,11 +418,13 @@ gst_iestsdemux_class_init(GstiestsdemuxClass * klass)
 	klass->video_src_template = gst_static_pad_template_get(&video_src_factory);
 	klass->audio_src_template = gst_static_pad_template_get(&audio_src_factory);
 	klass->metadata_src_template = gst_static_pad_template_get(&metadata_src_factory);
+	klass->ts_src_template = gst_static_pad_template_get(&ts_src_factory);
 		
 	gst_element_class_add_pad_template(gstelement_class, klass->sink_template);
 	gst_element_class_add_pad_template(gstelement_class, klass->video_src_template);
 	gst_element_class_add_pad_template(gstelement_class, klass->audio_src_template);
 	gst_element_class_add_pad_template(gstelement_class, klass->metadata_src_template);
+	gst_element_class_add_pad_template(gstelement_class, klass->ts_src_template);
 }
 
 /*
@@ -172,6 +457,8 @@ gst_iestsdemux_init(Gstiestsdemux * demux)
 	demux->active_video_stream_index = -1;
 	demux->active_audio_stream_index = -1;
 	demux->active_metadata_stream_index = -1;
+	demux->pending_packet = NULL;
+	demux->scan_mode = DEFAULT_SCAN_MODE;
 	demux->silent = FALSE;
 
 	demux->metadata_id3_prefix_size = 5;
@@ -189,6 +476,59 @@ gst_iestsdemux_init(Gstiestsdemux * demux)
 	gst_task_set_lock(demux->push_task, &demux->push_task_lock);
 
 	demux->sink_buffio_info = alloc_bufferedio_info(demux->sinkpad);
+
+	demux->loop_cache = gst_loop_cache_new();
+	demux->loop_cache_cursor = NULL;
+	demux->is_replaying_loop_cache = FALSE;
+	demux->loop_cache_size = DEFAULT_LOOP_CACHE_SIZE;
+	demux->loop_cache_ranges = DEFAULT_LOOP_CACHE_RANGES;
+
+	demux->scrub_cache = gst_scrub_cache_new();
+	demux->scrub_cache_cursor = NULL;
+	demux->is_replaying_scrub_cache = FALSE;
+	demux->scrub_cache_duration = DEFAULT_SCRUB_CACHE_DURATION;
+	demux->scrub_cache_max_bytes = DEFAULT_SCRUB_CACHE_MAX_BYTES;
+
+	demux->scan_threads = DEFAULT_SCAN_THREADS;
+	demux->build_index = DEFAULT_BUILD_INDEX;
+
+	demux->scan_entries = NULL;
+	demux->scan_cursor = 0;
+
+	demux->live = DEFAULT_LIVE;
+	demux->latency = 0;
+
+	demux->ts_inspector = gst_ts_inspector_new();
+	demux->pcr_clock = gst_pcr_clock_new("IESTsDemuxPcrClock");
+	demux->use_pcr_clock = DEFAULT_PCR_CLOCK;
+	demux->sink_buffio_info->io_observer = gst_iestsdemux_observe_io;
+	demux->sink_buffio_info->io_observer_data = demux;
+
+	demux->ts_passthrough = DEFAULT_TS_PASSTHROUGH;
+	demux->ts_pids = NULL;
+	demux->ts_batch_packets = DEFAULT_TS_BATCH_PACKETS;
+	demux->ts_filter = gst_ts_filter_new();
+	demux->ts_srcpad = NULL;
+	demux->ts_read_buffer = NULL;
+
+	demux->ts_monitor = DEFAULT_TS_MONITOR;
+	demux->ts_monitor_interval = DEFAULT_TS_MONITOR_INTERVAL;
+	demux->ts_stats = NULL;
+
+	demux->aes_key = NULL;
+	demux->aes_iv = NULL;
+	demux->aes_key_file = NULL;
+	demux->aes_decryptor = gst_aes_decryptor_new();
+
+	demux->video_stream_format = DEFAULT_VIDEO_STREAM_FORMAT;
+	demux->audio_stream_format = DEFAULT_AUDIO_STREAM_FORMAT;
+
+	demux->concat_boundary = 0;
+	demux->concat_pending = FALSE;
+	demux->concat_flushed = FALSE;
+	demux->concat_resync = FALSE;
+	demux->concat_new_segment = FALSE;
+	demux->pts_unwrap_valid = FALSE;
 }
 
 /*
@@ -206,6 +546,23 @@ gst_iestsdemux_finalize(GObject * object)
 
 	free_bufferedio_info(demux->sink_buffio_info);
 
+	gst_loop_cache_free(demux->loop_cache);
+	gst_scrub_cache_free(demux->scrub_cache);
+
+	gst_ts_inspector_free(demux->ts_inspector);
+	gst_pcr_clock_free(demux->pcr_clock);
+
+	gst_ts_filter_free(demux->ts_filter);
+	g_free(demux->ts_pids);
+
+	if (demux->ts_stats != NULL)
+		gst_structure_free(demux->ts_stats);
+
+	gst_aes_decryptor_free(demux->aes_decryptor);
+	g_free(demux->aes_key);
+	g_free(demux->aes_iv);
+	g_free(demux->aes_key_file);
+
 	g_free(demux->metadata_id3_prefix_buff);
 
 	// Revisit later
@@ -224,6 +581,107 @@ gst_iestsdemux_set_property(GObject * object, guint prop_id, const GValue * valu
 	case PROP_SILENT:
 		demux->silent = g_value_get_boolean(value);
 		break;
+	case PROP_LOOP_CACHE_SIZE:
+		GST_OBJECT_LOCK(demux);
+		demux->loop_cache_size = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_LOOP_CACHE_RANGES:
+		GST_OBJECT_LOCK(demux);
+		demux->loop_cache_ranges = g_value_get_uint(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCRUB_CACHE_DURATION:
+		GST_OBJECT_LOCK(demux);
+		demux->scrub_cache_duration = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCRUB_CACHE_MAX_BYTES:
+		GST_OBJECT_LOCK(demux);
+		demux->scrub_cache_max_bytes = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCAN_MODE:
+		GST_OBJECT_LOCK(demux);
+		demux->scan_mode = g_value_get_enum(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCAN_THREADS:
+		GST_OBJECT_LOCK(demux);
+		demux->scan_threads = g_value_get_uint(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_BUILD_INDEX:
+		GST_OBJECT_LOCK(demux);
+		demux->build_index = g_value_get_boolean(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_LIVE:
+		GST_OBJECT_LOCK(demux);
+		demux->live = g_value_get_boolean(value);
+		gst_iestsdemux_update_clock_flag(demux);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_PCR_CLOCK:
+		GST_OBJECT_LOCK(demux);
+		demux->use_pcr_clock = g_value_get_boolean(value);
+		gst_iestsdemux_update_clock_flag(demux);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_PASSTHROUGH:
+		GST_OBJECT_LOCK(demux);
+		demux->ts_passthrough = g_value_get_enum(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_PIDS:
+		GST_OBJECT_LOCK(demux);
+		g_free(demux->ts_pids);
+		demux->ts_pids = g_value_dup_string(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_BATCH_PACKETS:
+		GST_OBJECT_LOCK(demux);
+		demux->ts_batch_packets = g_value_get_uint(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_MONITOR:
+		GST_OBJECT_LOCK(demux);
+		demux->ts_monitor = g_value_get_boolean(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_MONITOR_INTERVAL:
+		GST_OBJECT_LOCK(demux);
+		demux->ts_monitor_interval = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_AES_KEY:
+		GST_OBJECT_LOCK(demux);
+		g_free(demux->aes_key);
+		demux->aes_key = g_value_dup_string(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_AES_IV:
+		GST_OBJECT_LOCK(demux);
+		g_free(demux->aes_iv);
+		demux->aes_iv = g_value_dup_string(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_AES_KEY_FILE:
+		GST_OBJECT_LOCK(demux);
+		g_free(demux->aes_key_file);
+		demux->aes_key_file = g_value_dup_string(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_VIDEO_STREAM_FORMAT:
+		GST_OBJECT_LOCK(demux);
+		demux->video_stream_format = g_value_get_enum(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_AUDIO_STREAM_FORMAT:
+		GST_OBJECT_LOCK(demux);
+		demux->audio_stream_format = g_value_get_enum(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -242,6 +700,122 @@ gst_iestsdemux_get_property(GObject * object, guint prop_id, GValue * value, GPa
 	case PROP_SILENT:
 		g_value_set_boolean(value, demux->silent);
 		break;
+	case PROP_LOOP_CACHE_SIZE:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->loop_cache_size);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_LOOP_CACHE_RANGES:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint(value, demux->loop_cache_ranges);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCRUB_CACHE_DURATION:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->scrub_cache_duration);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCRUB_CACHE_MAX_BYTES:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->scrub_cache_max_bytes);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCRUB_CACHE_HIT_RATE:
+	{
+		guint64 lookups;
+
+		GST_OBJECT_LOCK(demux);
+		lookups = demux->scrub_cache->hits + demux->scrub_cache->misses;
+		g_value_set_double(value, lookups > 0 ? (gdouble)demux->scrub_cache->hits / lookups : 0.0);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	}
+	case PROP_SCRUB_CACHE_BYTES:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->scrub_cache->bytes);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCAN_MODE:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_enum(value, demux->scan_mode);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SCAN_THREADS:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint(value, demux->scan_threads);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_BUILD_INDEX:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_boolean(value, demux->build_index);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_LIVE:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_boolean(value, demux->live);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_PCR_CLOCK:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_boolean(value, demux->use_pcr_clock);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_PCR_JITTER:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->pcr_clock->jitter);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_PCR_DRIFT:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_double(value, demux->pcr_clock->drift);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_PASSTHROUGH:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_enum(value, demux->ts_passthrough);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_PIDS:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_string(value, demux->ts_pids);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_BATCH_PACKETS:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint(value, demux->ts_batch_packets);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_MONITOR:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_boolean(value, demux->ts_monitor);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_MONITOR_INTERVAL:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->ts_monitor_interval);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_TS_STATS:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_boxed(value, demux->ts_stats);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	/* the key and the IV are write-only, so neither gst-launch -v nor a dump of the properties shows them */
+	case PROP_AES_KEY_FILE:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_string(value, demux->aes_key_file);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_VIDEO_STREAM_FORMAT:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_enum(value, demux->video_stream_format);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_AUDIO_STREAM_FORMAT:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_enum(value, demux->audio_stream_format);
+		GST_OBJECT_UNLOCK(demux);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -267,6 +841,16 @@ gst_iestsdemux_sink_event(GstPad * pad, GstObject * parent, GstEvent * event)
 	switch (GST_EVENT_TYPE(event)) {
 	case GST_EVENT_STREAM_START:
 	{
+		// A new segment follows the data received so far. The streams go on unless its codecs differ.
+		if (!buffio_info->is_pullmode)
+		{
+			g_mutex_lock(&buffio_info->io_sync_mutex);
+			demux->concat_boundary = buffio_info->io_adapter_offset + gst_adapter_available(buffio_info->gst_adapter);
+			demux->concat_pending = TRUE;
+			av_streams_start_segment(demux);
+			g_mutex_unlock(&buffio_info->io_sync_mutex);
+		}
+
 		gst_event_unref(event);
 		break;
 	}
@@ -306,6 +890,16 @@ gst_iestsdemux_sink_event(GstPad * pad, GstObject * parent, GstEvent * event)
 			g_mutex_lock(&buffio_info->io_sync_mutex);
 			// Clear any queued data in the adapter
 			gst_adapter_clear(buffio_info->gst_adapter);
+			av_bufferedio_clear_arrivals(buffio_info);
+
+			// The data after the flush is a new segment. libav drops what it holds and keeps the streams.
+			buffio_info->is_eos = FALSE;
+			demux->concat_boundary = buffio_info->io_adapter_offset;
+			demux->concat_pending = TRUE;
+			demux->concat_flushed = TRUE;
+			demux->concat_resync = TRUE;
+			av_streams_start_segment(demux);
+
 			// TODO: Double-check it
 			gst_task_start(demux->push_task);
 			g_mutex_unlock(&buffio_info->io_sync_mutex);
@@ -321,6 +915,7 @@ gst_iestsdemux_sink_event(GstPad * pad, GstObject * parent, GstEvent * event)
 			buffio_info->is_eos = TRUE;
 			// Clear any queued data in the adapter
 			gst_adapter_clear(buffio_info->gst_adapter);		// TODO: Double-check
+			av_bufferedio_clear_arrivals(buffio_info);
 			g_cond_signal(&buffio_info->io_sync_cond);
 			g_mutex_unlock(&buffio_info->io_sync_mutex);
 		}
@@ -358,8 +953,37 @@ gst_iestsdemux_src_event(GstPad * pad, GstObject * parent, GstEvent * event)
 		result = gst_pad_push_event(demux->sinkpad, event);
 		break;
 
-	case GST_EVENT_NAVIGATION:
 	case GST_EVENT_QOS:
+	{
+		GstAVStream *gst_stream = gst_pad_get_element_private(pad);
+		GstQOSType qos_type;
+		gdouble proportion;
+		GstClockTimeDiff diff;
+		GstClockTime timestamp;
+
+		gst_event_parse_qos(event, &qos_type, &proportion, &diff, &timestamp);
+
+		// Only the video is dropped under overload
+		if (gst_stream != NULL && gst_stream->av_media_type == AVMEDIA_TYPE_VIDEO) {
+			GST_OBJECT_LOCK(demux);
+			gst_stream->qos_proportion = proportion;
+			if (!GST_CLOCK_TIME_IS_VALID(timestamp))
+				gst_stream->qos_earliest_time = GST_CLOCK_TIME_NONE;
+			else if (diff > 0)
+				// A late sink keeps falling behind for a while. Skip twice the lateness.
+				gst_stream->qos_earliest_time = timestamp + 2 * diff;
+			else if ((GstClockTime)-diff < timestamp)
+				gst_stream->qos_earliest_time = timestamp + diff;
+			else
+				gst_stream->qos_earliest_time = 0;
+			GST_OBJECT_UNLOCK(demux);
+		}
+
+		gst_event_unref(event);
+		break;
+	}
+
+	case GST_EVENT_NAVIGATION:
 	default:
 		result = FALSE;
 		gst_event_unref(event);
@@ -505,6 +1129,33 @@ gboolean gst_iestsdemux_src_query(GstPad * pad, GstObject * parent, GstQuery * q
 			break;
 		}
 
+		case GST_QUERY_LATENCY:
+		{
+			gboolean live;
+			GstClockTime min_latency, max_latency, latency;
+
+			result = gst_pad_peer_query(demux->sinkpad, query);
+			if (!result)
+				break;
+
+			// Add the latency of the demux to the upstream one. The streaming thread sets it when the input is opened.
+			gst_query_parse_latency(query, &live, &min_latency, &max_latency);
+
+			GST_OBJECT_LOCK(demux);
+			latency = demux->latency;
+			GST_OBJECT_UNLOCK(demux);
+
+			min_latency += latency;
+			if (GST_CLOCK_TIME_IS_VALID(max_latency))
+				max_latency += latency;
+
+			GST_DEBUG_OBJECT(pad, "Latency: live=%d / min=%" GST_TIME_FORMAT " / max=%" GST_TIME_FORMAT,
+				live, GST_TIME_ARGS(min_latency), GST_TIME_ARGS(max_latency));
+
+			gst_query_set_latency(query, live, min_latency, max_latency);
+			break;
+		}
+
 		case GST_QUERY_SEGMENT:
 		{
 			gdouble playback_rate;
@@ -578,6 +1229,7 @@ gst_iestsdemux_change_state(GstElement * element, GstStateChange transition)
 	case GST_STATE_CHANGE_PAUSED_TO_READY:
 		GST_DEBUG("State Change: PAUSED to READY.");
 		gst_adapter_clear(demux->sink_buffio_info->gst_adapter);
+		av_bufferedio_clear_arrivals(demux->sink_buffio_info);
 		av_streams_close(demux);
 
 		// TODO: Revisit
@@ -649,12 +1301,18 @@ gst_iestsdemux_chain(GstPad * pad, GstObject * parent, GstBuffer * buf)
 	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
 	g_assert_nonnull(buffio_info);
 
+	gsize size = gst_buffer_get_size(buf);
+
 	g_mutex_lock(&buffio_info->io_sync_mutex);
 
 	// Push the buffer to the adapter
-	GST_DEBUG("Push the buffer to the adapter. Buff Size=%" G_GSIZE_FORMAT " bytes", gst_buffer_get_size(buf));
+	GST_DEBUG("Push the buffer to the adapter. Buff Size=%" G_GSIZE_FORMAT " bytes", size);
 	gst_adapter_push(buffio_info->gst_adapter, buf);
 
+	// The PCR clock is fed with the time the PCR arrived, not the time libav reads it
+	if (buffio_info->io_track_arrivals)
+		av_bufferedio_push_arrival(buffio_info, size, gst_clock_get_internal_time(demux->pcr_clock->clock));
+
 	// Notify that the adapter has enough data to be processed
 	buf = NULL;
 	while (gst_adapter_available(buffio_info->gst_adapter) >= buffio_info->io_read_needed) {
@@ -677,20 +1335,82 @@ gst_iestsdemux_loop(Gstiestsdemux * demux)
 	GstAVStream *gst_stream = NULL;
 	GstBuffer *buff_push = NULL;
 
-	gst_stream = av_streams_demux(demux, &buff_push);
+	if (demux->is_replaying_loop_cache) {
+		// The whole segment has been served from the loop cache
+		if (demux->loop_cache_cursor == NULL) {
+			demux->is_replaying_loop_cache = FALSE;
+			gst_iestsdemux_push_eos(demux);
+			return;
+		}
+
+		gst_stream = gst_iestsdemux_replay_cache(demux, &demux->loop_cache_cursor, &buff_push);
+	}
+	else if (demux->is_replaying_scrub_cache && demux->scrub_cache_cursor != NULL) {
+		gst_stream = gst_iestsdemux_replay_cache(demux, &demux->scrub_cache_cursor, &buff_push);
+	}
+	else if (demux->scan_entries != NULL) {
+		// Every packet found by the parallel scan has been delivered
+		if (demux->scan_cursor >= demux->scan_entries->len) {
+			g_array_free(demux->scan_entries, TRUE);
+			demux->scan_entries = NULL;
+			gst_iestsdemux_push_eos(demux);
+			return;
+		}
+
+		gst_stream = av_streams_demux_scanned(demux, &buff_push);
+	}
+	else if (demux->ts_passthrough == GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY) {
+		av_streams_passthrough(demux);
+		return;
+	}
+	else {
+		// libav continues from the packet following the last cached one
+		demux->is_replaying_scrub_cache = FALSE;
+		gst_stream = av_streams_demux(demux, &buff_push);
+	}
 
 	// Pushed the buffer to the downstream
 	if (gst_stream != NULL && buff_push != NULL) {
 		GstFlowReturn result;
+		GstClockTime position = GST_BUFFER_TIMESTAMP(buff_push);
+
+		// Keep the buffer to replay the segment next time
+		if (gst_loop_cache_is_recording(demux->loop_cache))
+			gst_loop_cache_record(demux->loop_cache, gst_stream->avstream->index, buff_push);
+
+		// Keep the latest packets to serve the short seeks
+		if (!demux->is_replaying_loop_cache && !demux->is_replaying_scrub_cache &&
+			gst_scrub_cache_is_enabled(demux->scrub_cache)) {
+			GST_OBJECT_LOCK(demux);
+			gst_scrub_cache_record(demux->scrub_cache, gst_stream->avstream->index, buff_push);
+			GST_OBJECT_UNLOCK(demux);
+		}
+
+		// The segment position is the base of the running time for the next non-flushing seek
+		if (GST_CLOCK_TIME_IS_VALID(position) && position > demux->segment.position)
+			demux->segment.position = position;
+
+		// The sparse stream is covered up to its latest buffer
+		if (gst_stream->is_sparse && GST_CLOCK_TIME_IS_VALID(position))
+			gst_stream->ts_gap_pos = MAX(gst_stream->ts_gap_pos, position);
+
 		GST_DEBUG("Pushing the buffer");
 		result = gst_pad_push(gst_stream->srcpad, buff_push);
 
+		// The other streams drive the time of the sparse streams
+		if (!gst_stream->is_sparse && GST_CLOCK_TIME_IS_VALID(position))
+			gst_iestsdemux_push_gaps(demux, position);
+
 		result = gst_flow_combiner_update_flow(demux->flow_combiner, result);
 		if (result != GST_FLOW_OK) {
 			GST_WARNING("Fail to update the flow combiner: %s", gst_flow_get_name(result));
 		}
 	}
 
+	// The TS packets read along with the packet
+	if (demux->ts_srcpad != NULL)
+		gst_iestsdemux_push_ts(demux);
+
 	return;
 }
 
@@ -833,6 +1553,11 @@ gst_iestsdemux_do_seek(Gstiestsdemux * demux, GstEvent * sk_event)
 		return FALSE;
 	}
 
+	if (demux->ts_passthrough == GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY) {
+		GST_DEBUG("The seeking is not supported without demuxing.");
+		return FALSE;
+	}
+
 	if (sk_event) {
 		gst_event_parse_seek(sk_event, &playback_rate, &stream_format, &sk_flags, 
 			&sk_start_type, &sk_start_pos, &sk_stop_type, &sk_stop_pos);
@@ -867,7 +1592,31 @@ gst_iestsdemux_do_seek(Gstiestsdemux * demux, GstEvent * sk_event)
 		gst_pad_push_event(demux->sinkpad, gst_event_new_flush_stop(TRUE));
 	}
 
-	result = av_streams_seek(demux, &sk_segment);
+	gst_iestsdemux_stop_replay(demux);
+
+	// The segment which has been looped before or the recent packets are replayed from the memory
+	result = gst_iestsdemux_seek_loop_cache(demux, &sk_segment);
+	if (!result)
+		result = gst_iestsdemux_seek_scrub_cache(demux, &sk_segment);
+
+	if (!result) {
+		GstClockTime req_start = sk_segment.start;
+		GstClockTime req_stop = sk_segment.stop;
+
+		result = av_streams_seek(demux, &sk_segment);
+
+		// The TS pad continues from the new read position
+		if (demux->ts_srcpad != NULL)
+			gst_ts_filter_reset(demux->ts_filter, demux->sink_buffio_info->io_read_offset);
+
+		// The cached packets are not followed by the new read position anymore
+		GST_OBJECT_LOCK(demux);
+		gst_scrub_cache_clear(demux->scrub_cache);
+		GST_OBJECT_UNLOCK(demux);
+
+		if (result && (sk_segment.flags & GST_SEEK_FLAG_SEGMENT))
+			gst_loop_cache_begin_range(demux->loop_cache, req_start, req_stop, sk_segment.start);
+	}
 
 	if (flush) {
 		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_flush_stop(TRUE));
@@ -882,6 +1631,14 @@ gst_iestsdemux_do_seek(Gstiestsdemux * demux, GstEvent * sk_event)
 		}
 
 		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_segment(&demux->segment));
+
+		// The sparse streams are covered from the start of the new segment and the QoS of the old one is stale
+		for (int i = 0; i < demux->num_of_all_streams; i++) {
+			if (demux->av_streams[i] != NULL) {
+				demux->av_streams[i]->ts_gap_pos = demux->segment.start;
+				av_streams_reset_qos(demux, demux->av_streams[i]);
+			}
+		}
 	}
 
 	gst_flow_combiner_reset(demux->flow_combiner);
@@ -909,6 +1666,11 @@ gst_iestsdemux_push_event_to_srcpads(Gstiestsdemux * demux, GstEvent * gst_event
 		}
 	}
 
+	if (demux->ts_srcpad != NULL) {
+		gst_event_ref(gst_event);
+		result &= gst_pad_push_event(demux->ts_srcpad, gst_event);
+	}
+
 	gst_event_unref(gst_event);
 
 	return result;
@@ -942,345 +1704,1551 @@ gst_iestsdemux_push_tags_to_srcpads(Gstiestsdemux * demux)
 	}
 }
 
-/* 
- * Entry point to initialize the plug-in.
- * initialize the plug-in itself and register the element factories and other features
+/*
+ * Pause the task and notify the end of the segment or the stream to the downstream
  */
-static gboolean
-iestsdemux_init(GstPlugin * iestsdemux)
+static void
+gst_iestsdemux_push_eos(Gstiestsdemux * demux)
 {
-	// debug category for fltering log messages
-	GST_DEBUG_CATEGORY_INIT(gst_iestsdemux_debug, "IESTsDemux", 1, "IES MPEG TS Demuxer");
-
-#ifdef __APPLE__
-    av_register_all();
-#endif
-
-	init_avdemux();
+	gst_pad_pause_task(demux->sinkpad);
 
-	GstStaticCaps sink_static_caps = TSDEMUX_SINK_STATIC_CAPS;
-	GstCaps * possible_caps = gst_static_caps_get(&sink_static_caps);
+	// The push mode waits for a flush to go on with the next segment
+	if (!demux->is_sink_pullmode)
+		gst_task_pause(demux->push_task);
 
-	if (!gst_element_register(iestsdemux, "iestsdemux", GST_RANK_NONE, GST_TYPE_IESTSDEMUX) ||
-		!gst_type_find_register(iestsdemux, TSDEMUX_TYPEFIND_NAME, GST_RANK_NONE, 
-			gst_iestsdemux_type_find, NULL, possible_caps, NULL, NULL)) {
-		gst_caps_unref(possible_caps);
-		return FALSE;
+	// The partial batch goes out before the end
+	if (demux->ts_srcpad != NULL) {
+		gst_ts_filter_flush(demux->ts_filter);
+		gst_iestsdemux_push_ts(demux);
 	}
 
-	gst_caps_unref(possible_caps);
-	return TRUE;
-}
+	if (demux->segment.flags & GST_SEEK_FLAG_SEGMENT) {
+		gint64 stop;
 
-/* PACKAGE: this is usually set by autotools depending on some _INIT macro
- * in configure.ac and then written into and defined in config.h, but we can
- * just set it ourselves here in case someone doesn't use autotools to
- * compile this code. GST_PLUGIN_DEFINE needs PACKAGE to be defined.
- */
-#ifndef PACKAGE
-#define PACKAGE "IES PlugIns"
-#endif
+		if ((stop = demux->segment.stop) == -1)
+			stop = demux->segment.duration;
 
- /* gstreamer looks for this structure to register iestsdemuxs */
-GST_PLUGIN_DEFINE(
-	GST_VERSION_MAJOR,
-	GST_VERSION_MINOR,
-	iestsdemux,
-	"Plugin is used to demux the MPEG TS",
-	iestsdemux_init,
-	"V0.0.1",
-	"LGPL",
-	"Immersive Experiences SDK",
-	"Unknown - TODO"
-)
+		// The next loop over the segment continues the running time from the end of this one
+		if (stop != -1)
+			demux->segment.position = stop;
+
+		GST_LOG("Post a message to notify the end segment.");
+		GstMessage *gst_msg = gst_message_new_segment_done(GST_OBJECT(demux), demux->segment.format, stop);
+		gst_element_post_message(GST_ELEMENT(demux), gst_msg);
+
+		GST_LOG("Send an event to notify the end segment.");
+		GstEvent *gst_event = gst_event_new_segment_done(demux->segment.format, stop);
+		gst_iestsdemux_push_event_to_srcpads(demux, gst_event);
+	}
+	else {
+		GST_LOG("pushing eos");
+		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_eos());
+	}
+}
 
 /*
- * Open the stream through libav
+ * Look up the loop cache for the segment seek and prepare the replay when the range is cached
  */
-static gboolean 
-av_streams_open(Gstiestsdemux * demux)
+static gboolean
+gst_iestsdemux_seek_loop_cache(Gstiestsdemux * demux, GstSegment * segment)
 {
-	gboolean success = TRUE;
-	gint av_error = 0;
-
-	GstiestsdemuxClass *klass = (GstiestsdemuxClass *)G_OBJECT_GET_CLASS(demux);
-	GstBufferedIOInfo * buffio_info = demux->sink_buffio_info;
-	AVFormatContext * fmt_ctx = NULL;
+	GstLoopCacheRange *range = NULL;
 
-	g_assert_nonnull(demux);
-	g_assert_nonnull(klass);
-	g_assert_nonnull(buffio_info);
+	// Any seek stops the range being recorded
+	gst_loop_cache_abort_range(demux->loop_cache);
 
-	if (demux->is_opened)
-		av_streams_close(demux);
+	GST_OBJECT_LOCK(demux);
+	gst_loop_cache_set_limits(demux->loop_cache, demux->loop_cache_size, demux->loop_cache_ranges);
+	GST_OBJECT_UNLOCK(demux);
 
-	// Open the IO context
-	av_error = av_bufferedio_open(buffio_info);
-	if (av_error < 0) {
-		goto ex_averror;
-	}
+	if (!(segment->flags & GST_SEEK_FLAG_SEGMENT))
+		return FALSE;
 
-	// Allocate the memory for the video format
-	demux->av_format_context = avformat_alloc_context();
-	fmt_ctx = demux->av_format_context;
-	fmt_ctx->pb = buffio_info->io_context;
-	fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+	range = gst_loop_cache_lookup(demux->loop_cache, segment->start, segment->stop);
+	if (range == NULL)
+		return FALSE;
 
-	// Open the video stream
-	av_error = avformat_open_input(&fmt_ctx, NULL, klass->av_in_format, NULL);
-	if (av_error < 0) goto ex_averror;
+	GST_DEBUG("Replay the segment from the loop cache. start=%" GST_TIME_FORMAT, GST_TIME_ARGS(range->seg_start));
 
-	// Retrieve stream information
-	av_error = avformat_find_stream_info(fmt_ctx, NULL);
-	if (av_error < 0) goto ex_averror;
+	// Set the time&position as if libav has sought to the range
+	segment->position = range->seg_start;
+	segment->time = range->seg_start;
+	segment->start = range->seg_start;
 
-	demux->num_of_all_streams = fmt_ctx->nb_streams;
 	for (int i = 0; i < demux->num_of_all_streams; i++) {
-		av_streams_parse_stream(demux, fmt_ctx->streams[i], i);
+		if (demux->av_streams[i] != NULL)
+			demux->av_streams[i]->has_discontinuity = TRUE;
 	}
 
-	gst_element_no_more_pads(GST_ELEMENT(demux));
+	demux->loop_cache_cursor = range->entries.head;
+	demux->is_replaying_loop_cache = TRUE;
 
-	// TODO: Revisit. Need to convert some useful info to GstClockTime and keep it
-	demux->start_time = gst_util_uint64_scale_int(fmt_ctx->start_time, GST_SECOND, AV_TIME_BASE);
-	GST_DEBUG("start time: %" GST_TIME_FORMAT, GST_TIME_ARGS(demux->start_time));
-	if (fmt_ctx->duration > 0)
-		demux->duration = gst_util_uint64_scale_int(fmt_ctx->duration, GST_SECOND, AV_TIME_BASE);
-	else
-		demux->duration = GST_CLOCK_TIME_NONE;
+	return TRUE;
+}
 
-	GST_DEBUG("duration: %" GST_TIME_FORMAT, GST_TIME_ARGS(demux->duration));
+/*
+ * Look up the scrub cache for the seek and prepare the replay from the GOP containing the position
+ */
+static gboolean
+gst_iestsdemux_seek_scrub_cache(Gstiestsdemux * demux, GstSegment * segment)
+{
+	GList *cursor = NULL;
+	GstPacketCacheEntry *entry = NULL;
+
+	// The cache is changed with the object lock held since the properties read its statistics
+	GST_OBJECT_LOCK(demux);
+	gst_scrub_cache_configure(demux->scrub_cache, demux->scrub_cache_duration, demux->scrub_cache_max_bytes,
+		demux->active_video_stream_index);
+	GST_OBJECT_UNLOCK(demux);
+
+	// Only the seeks for the normal playback are served from the cache
+	if (!gst_scrub_cache_is_enabled(demux->scrub_cache) ||
+		(segment->flags & GST_SEEK_FLAG_SEGMENT) || segment->rate != 1.0)
+		return FALSE;
 
-	/* store duration in the segment as well */
-	demux->segment.duration = demux->duration;
+	GST_OBJECT_LOCK(demux);
+	cursor = gst_scrub_cache_lookup(demux->scrub_cache, segment->position);
+	GST_OBJECT_UNLOCK(demux);
 
-	// TODO: what are the seek_event and cached event?
+	if (cursor == NULL)
+		return FALSE;
 
-	// Send the segment
-	GST_DEBUG("Sending segment %" GST_SEGMENT_FORMAT, &demux->segment);
-	gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_segment(&demux->segment));
+	entry = (GstPacketCacheEntry *)cursor->data;
+	GST_DEBUG("Replay from the scrub cache. position=%" GST_TIME_FORMAT " / keyframe=%" GST_TIME_FORMAT,
+		GST_TIME_ARGS(segment->position), GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(entry->buffer)));
 
-	// Parse metadata to GST Tags and send tag events
-	av_streams_parse_metadata_to_taglists(demux);
-	gst_iestsdemux_push_tags_to_srcpads(demux);
+	// Set the time&position as if libav has sought to the position
+	segment->time = segment->position;
+	segment->start = segment->position;
 
-	demux->is_opened = TRUE;
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		if (demux->av_streams[i] != NULL)
+			demux->av_streams[i]->has_discontinuity = TRUE;
+	}
 
-	goto fn_done;
+	demux->scrub_cache_cursor = cursor;
+	demux->is_replaying_scrub_cache = TRUE;
 
-ex_averror:
-	GST_PRINT_AVERROR(av_error);
-	success = FALSE;
+	return TRUE;
+}
 
-fn_done:
-	return success;
+/*
+ * Stop replaying the cached packets
+ */
+static void
+gst_iestsdemux_stop_replay(Gstiestsdemux * demux)
+{
+	demux->loop_cache_cursor = NULL;
+	demux->is_replaying_loop_cache = FALSE;
+
+	demux->scrub_cache_cursor = NULL;
+	demux->is_replaying_scrub_cache = FALSE;
+
+	// The scan results are delivered only from the start of the input
+	if (demux->scan_entries != NULL) {
+		g_array_free(demux->scan_entries, TRUE);
+		demux->scan_entries = NULL;
+	}
 }
 
 /*
- * Close the stream
+ * Provide the clock following the PCR. The PCR is timed when libav reads it, which is its arrival only when the
+ * live input is pushed. A file or a pulled input is read as fast as downstream takes it.
  */
-static void 
-av_streams_close(Gstiestsdemux * demux)
+static GstClock *
+gst_iestsdemux_provide_clock(GstElement * element)
 {
-	g_assert_nonnull(demux);
+	Gstiestsdemux *demux = GST_IESTSDEMUX(element);
+	GstClock *clock = NULL;
 
-	if (!demux->is_opened)
+	GST_OBJECT_LOCK(demux);
+	if (demux->use_pcr_clock && demux->live && !demux->is_sink_pullmode)
+		clock = gst_object_ref(demux->pcr_clock->clock);
+	GST_OBJECT_UNLOCK(demux);
+
+	return clock;
+}
+
+/*
+ * Offer the clock to the pipeline only when it can follow the PCR. Called with the object lock.
+ */
+static void
+gst_iestsdemux_update_clock_flag(Gstiestsdemux * demux)
+{
+	if (demux->use_pcr_clock && demux->live)
+		GST_OBJECT_FLAG_SET(demux, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+	else
+		GST_OBJECT_FLAG_UNSET(demux, GST_ELEMENT_FLAG_PROVIDE_CLOCK);
+}
+
+/*
+ * Inspect the TS packets handed to libav
+ */
+static void
+gst_iestsdemux_observe_io(gpointer user_data, const guint8 * data, gsize size)
+{
+	Gstiestsdemux *demux = GST_IESTSDEMUX(user_data);
+	GstStructure *stats;
+
+	// The read position has jumped. The statistics go on.
+	if (data == NULL)
+		gst_ts_inspector_discontinue(demux->ts_inspector);
+	else
+		gst_ts_inspector_parse(demux->ts_inspector, data, size);
+
+	// The monitor publishes a window once the PCR has moved by the interval
+	stats = data != NULL ? gst_ts_inspector_take_stats(demux->ts_inspector) : NULL;
+	if (stats != NULL) {
+		GST_OBJECT_LOCK(demux);
+		if (demux->ts_stats != NULL)
+			gst_structure_free(demux->ts_stats);
+		demux->ts_stats = gst_structure_copy(stats);
+		GST_OBJECT_UNLOCK(demux);
+
+		gst_element_post_message(GST_ELEMENT(demux), gst_message_new_element(GST_OBJECT(demux), stats));
+	}
+
+	// The TS pad takes the data at its offset in the input
+	if (data != NULL && demux->ts_srcpad != NULL)
+		gst_ts_filter_parse(demux->ts_filter, demux->sink_buffio_info->io_read_offset - size, data, size);
+}
+
+/*
+ * The PCR is found when it is handed to libav, which may be well after it arrived. It is observed at the arrival
+ * of the buffer its last byte came in, noted by the chain function. The PCR completing a packet carried over from
+ * the previous read is taken as arriving with the first byte of this one.
+ */
+static void
+gst_iestsdemux_observe_pcr(guint16 pid, guint64 pcr, gboolean discontinuity, gpointer user_data)
+{
+	Gstiestsdemux *demux = GST_IESTSDEMUX(user_data);
+	gint64 position = demux->ts_inspector->packet_position + TS_INSPECT_PCR_END;
+	GstClockTime arrival;
+
+	arrival = av_bufferedio_get_read_arrival(demux->sink_buffio_info, (gsize)MAX(position, 0));
+	if (!GST_CLOCK_TIME_IS_VALID(arrival)) {
+		GST_LOG_OBJECT(demux, "The arrival of the PCR %" G_GUINT64_FORMAT " is not known", pcr);
 		return;
-	
-	// Remove pads
-	for (int i = 0; i < demux->num_of_all_streams; i++) {
-		GstAVStream* stream = demux->av_streams[i];
-		if (stream != NULL) {
-			if (stream->srcpad != NULL) {
-				// Remove the src pad from the flow combiner
-				gst_flow_combiner_remove_pad(demux->flow_combiner, stream->srcpad);
+	}
 
-				// Remove the src pad from the element
-				gst_element_remove_pad(GST_ELEMENT(demux), stream->srcpad);
-			}
+	GST_OBJECT_LOCK(demux);
+	gst_pcr_clock_observe(demux->pcr_clock, pcr, arrival, discontinuity);
+	GST_OBJECT_UNLOCK(demux);
+}
 
-			if (stream->tags)
-				gst_tag_list_unref(stream->tags);
+/*
+ * Push the complete batches of the TS packets
+ */
+static GstFlowReturn
+gst_iestsdemux_push_ts(Gstiestsdemux * demux)
+{
+	GstFlowReturn result = GST_FLOW_OK;
+	GstBuffer *batch;
 
-			g_free(stream);
+	while ((batch = gst_ts_filter_pop(demux->ts_filter)) != NULL) {
+		result = gst_pad_push(demux->ts_srcpad, batch);
+		result = gst_flow_combiner_update_pad_flow(demux->flow_combiner, demux->ts_srcpad, result);
+		if (result != GST_FLOW_OK) {
+			GST_WARNING("Fail to push the TS packets: %s", gst_flow_get_name(result));
+			break;
 		}
-		demux->av_streams[i] = NULL;
 	}
 
-	av_bufferedio_close(demux->av_format_context->pb);
-	demux->av_format_context->pb = NULL;
+	return result;
+}
 
-	if (demux->av_format_context != NULL) {
-		avformat_close_input(&demux->av_format_context);
-		avformat_free_context(demux->av_format_context);
-		demux->av_format_context = NULL;
-	}
+/*
+ * Send the GAP events to the sparse streams lagging behind the position of the other streams
+ */
+static void
+gst_iestsdemux_push_gaps(Gstiestsdemux * demux, GstClockTime position)
+{
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		GstAVStream *gst_stream = demux->av_streams[i];
+		GstClockTime gap_start, gap_stop;
 
-	if (demux->tags)
-		gst_tag_list_unref(demux->tags);
+		if (gst_stream == NULL || gst_stream->srcpad == NULL || !gst_stream->is_sparse)
+			continue;
 
-	demux->is_opened = FALSE;
+		gap_start = gst_stream->ts_gap_pos;
+		if (!GST_CLOCK_TIME_IS_VALID(gap_start) || position < gap_start + TSDEMUX_SPARSE_GAP_THRESHOLD)
+			continue;
 
-	gst_segment_init(&demux->segment, GST_FORMAT_TIME);
+		gap_stop = position - TSDEMUX_SPARSE_GAP_MARGIN;
+
+		GST_LOG_OBJECT(gst_stream->srcpad, "Sending a gap %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT,
+			GST_TIME_ARGS(gap_start), GST_TIME_ARGS(gap_stop));
+
+		gst_pad_push_event(gst_stream->srcpad, gst_event_new_gap(gap_start, gap_stop - gap_start));
+		gst_stream->ts_gap_pos = gap_stop;
+	}
 }
 
 /*
- * Parse each stream and collect its infos
+ * Take the next buffer from the cache being replayed
+ */
+static GstAVStream *
+gst_iestsdemux_replay_cache(Gstiestsdemux * demux, GList ** cursor, GstBuffer ** gst_buff)
+{
+	GstPacketCacheEntry *entry = (GstPacketCacheEntry *)(*cursor)->data;
+	GstAVStream *gst_stream = demux->av_streams[entry->stream_index];
+	GstBuffer *buff_push = NULL;
+
+	*cursor = (*cursor)->next;
+
+	if (gst_stream == NULL || gst_stream->srcpad == NULL)
+		return NULL;
+
+	// Only the metadata is copied. The memory is shared with the cached buffer.
+	buff_push = gst_buffer_copy(entry->buffer);
+	GST_BUFFER_FLAG_UNSET(buff_push, GST_BUFFER_FLAG_DISCONT);
+
+	if (gst_stream->has_discontinuity) {
+		GST_BUFFER_FLAG_SET(buff_push, GST_BUFFER_FLAG_DISCONT);
+		gst_stream->has_discontinuity = FALSE;
+	}
+
+	if (GST_BUFFER_TIMESTAMP_IS_VALID(buff_push))
+		gst_stream->ts_last_pos = GST_BUFFER_TIMESTAMP(buff_push) + demux->start_time;
+
+	*gst_buff = buff_push;
+
+	return gst_stream;
+}
+
+/* 
+ * Entry point to initialize the plug-in.
+ * initialize the plug-in itself and register the element factories and other features
  */
 static gboolean
-av_streams_parse_stream(Gstiestsdemux * demux, AVStream * av_stream, int index)
+iestsdemux_init(GstPlugin * iestsdemux)
 {
-	gboolean result = FALSE;
-	AVCodecContext *codec_context = NULL;
-	GstAVStream *gst_stream = NULL;
+	// debug category for fltering log messages
+	GST_DEBUG_CATEGORY_INIT(gst_iestsdemux_debug, "IESTsDemux", 1, "IES MPEG TS Demuxer");
+
+#ifdef __APPLE__
+    av_register_all();
+#endif
 
-	GstPadTemplate *templ = NULL;
-	GstPad *pad = NULL;
-	GstCaps *caps = NULL;
-	int pad_index = -1;
-	int av_error = 0;
+	init_avdemux();
+	init_packetcache();
+	init_tsscan();
+	init_tsinspect();
+	init_pcrclock();
+	init_tsfilter();
+	init_aesdecrypt();
+	init_h26xparse();
+
+	GstStaticCaps sink_static_caps = TSDEMUX_SINK_STATIC_CAPS;
+	GstCaps * possible_caps = gst_static_caps_get(&sink_static_caps);
+
+	if (!gst_element_register(iestsdemux, "iestsdemux", GST_RANK_NONE, GST_TYPE_IESTSDEMUX) ||
+		!gst_element_register(iestsdemux, "iestsmultidemux", GST_RANK_NONE, GST_TYPE_IESTSMULTIDEMUX) ||
+		!gst_type_find_register(iestsdemux, TSDEMUX_TYPEFIND_NAME, GST_RANK_NONE, 
+			gst_iestsdemux_type_find, NULL, possible_caps, NULL, NULL)) {
+		gst_caps_unref(possible_caps);
+		return FALSE;
+	}
+
+	gst_caps_unref(possible_caps);
+	return TRUE;
+}
+
+/* PACKAGE: this is usually set by autotools depending on some _INIT macro
+ * in configure.ac and then written into and defined in config.h, but we can
+ * just set it ourselves here in case someone doesn't use autotools to
+ * compile this code. GST_PLUGIN_DEFINE needs PACKAGE to be defined.
+ */
+#ifndef PACKAGE
+#define PACKAGE "IES PlugIns"
+#endif
+
+ /* gstreamer looks for this structure to register iestsdemuxs */
+GST_PLUGIN_DEFINE(
+	GST_VERSION_MAJOR,
+	GST_VERSION_MINOR,
+	iestsdemux,
+	"Plugin is used to demux the MPEG TS",
+	iestsdemux_init,
+	"V0.0.1",
+	"LGPL",
+	"Immersive Experiences SDK",
+	"Unknown - TODO"
+)
+
+/*
+ * Open the stream through libav
+ */
+static gboolean 
+av_streams_open(Gstiestsdemux * demux)
+{
+	gboolean success = TRUE;
+	gint av_error = 0;
 
 	GstiestsdemuxClass *klass = (GstiestsdemuxClass *)G_OBJECT_GET_CLASS(demux);
+	GstBufferedIOInfo * buffio_info = demux->sink_buffio_info;
+	AVFormatContext * fmt_ctx = NULL;
+	GstiestsdemuxScanMode scan_mode;
+	gboolean live;
+	gboolean use_pcr_clock;
+	GstClockTime latency;
+	GstiestsdemuxTsPassthrough ts_passthrough;
+	gchar *ts_pids;
+	guint ts_batch_packets;
+	gboolean ts_monitor;
+	GstClockTime ts_monitor_interval;
+	gchar *aes_key, *aes_iv, *aes_key_file;
+	gboolean is_encrypted;
 
 	g_assert_nonnull(demux);
 	g_assert_nonnull(klass);
+	g_assert_nonnull(buffio_info);
 
-	codec_context = avcodec_alloc_context3(NULL);
-	if (codec_context == NULL) {
-		GST_DEBUG("Failed to allocate the codec context!");
-		av_error = AVERROR(EINVAL);
+	if (demux->is_opened)
+		av_streams_close(demux);
+
+	GST_OBJECT_LOCK(demux);
+	scan_mode = demux->scan_mode;
+	live = demux->live;
+	use_pcr_clock = demux->use_pcr_clock;
+	ts_passthrough = demux->ts_passthrough;
+	ts_pids = g_strdup(demux->ts_pids);
+	ts_batch_packets = demux->ts_batch_packets;
+	ts_monitor = demux->ts_monitor;
+	ts_monitor_interval = demux->ts_monitor_interval;
+	aes_key = g_strdup(demux->aes_key);
+	aes_iv = g_strdup(demux->aes_iv);
+	aes_key_file = g_strdup(demux->aes_key_file);
+	GST_OBJECT_UNLOCK(demux);
+
+	// The encrypted input is decrypted as libav reads it
+	is_encrypted = (aes_key != NULL && aes_key[0] != '\0') || (aes_key_file != NULL && aes_key_file[0] != '\0');
+	buffio_info->decryptor = NULL;
+	if (is_encrypted) {
+		gboolean has_key = av_streams_load_aes_key(demux, aes_key, aes_iv, aes_key_file);
+
+		g_free(aes_key);
+		g_free(aes_iv);
+		g_free(aes_key_file);
+
+		if (!has_key) {
+			g_free(ts_pids);
+			av_error = AVERROR(EINVAL);
+			goto ex_averror;
+		}
+
+		buffio_info->decryptor = demux->aes_decryptor;
+	}
+	else {
+		g_free(aes_key);
+		g_free(aes_iv);
+		g_free(aes_key_file);
+	}
+
+	// The monitor sees every packet read from the input, the probed ones included
+	gst_ts_inspector_set_monitor(demux->ts_inspector, ts_monitor, ts_monitor_interval);
+
+	// The input starts over at the offset 0
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	demux->concat_pending = FALSE;
+	demux->concat_flushed = FALSE;
+	demux->concat_resync = FALSE;
+	av_bufferedio_drop_kept(buffio_info);
+	av_bufferedio_track_arrivals(buffio_info, use_pcr_clock && live && !demux->is_sink_pullmode);
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+	demux->concat_new_segment = FALSE;
+	demux->pts_unwrap_valid = FALSE;
+
+	// The metadata scan and the passthrough read the source in large sequential chunks
+	if (scan_mode == GST_IESTSDEMUX_SCAN_MODE_METADATA_ONLY)
+		buffio_info->io_buffer_size = TSDEMUX_SCAN_IO_BUFFER_SIZE;
+	else if (live)
+		buffio_info->io_buffer_size = TSDEMUX_LIVE_IO_BUFFER_SIZE;
+	else if (ts_passthrough == GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY)
+		buffio_info->io_buffer_size = TSDEMUX_SCAN_IO_BUFFER_SIZE;
+	else
+		buffio_info->io_buffer_size = BUFFERED_IO_DEFAULT_SIZE;
+
+	// The live input is read packet by packet as it arrives
+	buffio_info->io_read_min = live ? TS_PACKET_SIZE : 0;
+
+	// Open the IO context
+	av_error = av_bufferedio_open(buffio_info);
+	if (av_error < 0) {
+		g_free(ts_pids);
 		goto ex_averror;
 	}
-	avcodec_parameters_to_context(codec_context, av_stream->codecpar);
 
-	gst_stream = g_new0(GstAVStream, 1);
-	demux->av_streams[av_stream->index] = gst_stream;
+	// The TS pad is added first so it gets the data probed by libav as well
+	if (ts_passthrough != GST_IESTSDEMUX_TS_PASSTHROUGH_DISABLED) {
+		if (!gst_ts_filter_configure(demux->ts_filter, ts_pids, ts_batch_packets))
+			GST_WARNING("Some of the TS PIDs (%s) are ignored", ts_pids);
 
-	gst_stream->srcpad = NULL;
-	gst_stream->avstream = av_stream;
-	gst_stream->av_media_type = codec_context->codec_type;
-	gst_stream->has_discontinuity = TRUE;
-	gst_stream->ts_last_pos = GST_CLOCK_TIME_NONE;
-	gst_stream->tags = NULL;
+		av_streams_open_ts_pad(demux);
+	}
+	g_free(ts_pids);
+
+	if (ts_passthrough == GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY) {
+		demux->ts_read_buffer = g_malloc(buffio_info->io_buffer_size);
+		gst_element_no_more_pads(GST_ELEMENT(demux));
+
+		demux->start_time = 0;
+		demux->duration = GST_CLOCK_TIME_NONE;
+		demux->segment.duration = GST_CLOCK_TIME_NONE;
+
+		GST_DEBUG("Sending segment %" GST_SEGMENT_FORMAT, &demux->segment);
+		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_segment(&demux->segment));
+
+		demux->is_opened = TRUE;
+		goto fn_done;
+	}
+
+	// Allocate the memory for the video format
+	demux->av_format_context = avformat_alloc_context();
+	fmt_ctx = demux->av_format_context;
+	fmt_ctx->pb = buffio_info->io_context;
+	fmt_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	// Probe as little as possible and do not keep the probed packets
+	if (live) {
+		fmt_ctx->probesize = TSDEMUX_LIVE_PROBE_SIZE;
+		fmt_ctx->max_analyze_duration = TSDEMUX_LIVE_ANALYZE_DURATION;
+		fmt_ctx->fps_probe_size = 0;
+		fmt_ctx->flags |= AVFMT_FLAG_NOBUFFER;
+	}
+
+	// Open the video stream
+	av_error = avformat_open_input(&fmt_ctx, NULL, klass->av_in_format, NULL);
+	if (av_error < 0) goto ex_averror;
+
+	// The parser takes a PES as a complete frame instead of holding it until the next start code
+	if (live) {
+		for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+			if (fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+				fmt_ctx->streams[i]->need_parsing = AVSTREAM_PARSE_HEADERS;
+		}
+	}
+
+	if (scan_mode == GST_IESTSDEMUX_SCAN_MODE_METADATA_ONLY) {
+		// The PMT parsed while opening the input is enough to find the metadata stream
+		av_error = av_streams_open_metadata_scan(demux);
+		if (av_error < 0) goto ex_averror;
+	}
+	else {
+		// Retrieve stream information
+		av_error = avformat_find_stream_info(fmt_ctx, NULL);
+		if (av_error < 0) goto ex_averror;
+	}
+
+	demux->num_of_all_streams = fmt_ctx->nb_streams;
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		// The discarded streams do not get any pad
+		if (fmt_ctx->streams[i]->discard == AVDISCARD_ALL)
+			continue;
+
+		av_streams_parse_stream(demux, fmt_ctx->streams[i], i);
+	}
+
+	gst_element_no_more_pads(GST_ELEMENT(demux));
+
+	// The GOPs of the active video stream are kept in the scrub cache
+	GST_OBJECT_LOCK(demux);
+	gst_scrub_cache_configure(demux->scrub_cache, demux->scrub_cache_duration, demux->scrub_cache_max_bytes,
+		demux->active_video_stream_index);
+	GST_OBJECT_UNLOCK(demux);
+
+	// The clock follows the PCR of the program carrying the selected streams. Read from a file or pulled, the PCR
+	// comes as fast as downstream takes the data and would speed the clock up.
+	if (use_pcr_clock && (!live || demux->is_sink_pullmode)) {
+		GST_WARNING("The PCR clock only follows a live input in the push mode. It runs with the system clock.");
+	}
+	else if (use_pcr_clock) {
+		gint stream_index = demux->active_video_stream_index >= 0 ?
+			demux->active_video_stream_index : demux->active_audio_stream_index;
+		gint pcr_pid = av_streams_get_pcr_pid(demux, stream_index);
+
+		GST_INFO("The clock follows the PCR on PID %d", pcr_pid);
+		gst_ts_inspector_set_pcr_func(demux->ts_inspector, pcr_pid, gst_iestsdemux_observe_pcr, demux);
+	}
+
+	// Index the keyframes or collect the metadata with the parallel workers. They read the raw input, so the
+	// encrypted one is left to libav.
+	if (demux->is_sink_pullmode && buffio_info->decryptor == NULL)
+		av_streams_run_scan(demux, scan_mode);
+
+	// TODO: Revisit. Need to convert some useful info to GstClockTime and keep it
+	if (fmt_ctx->start_time != AV_NOPTS_VALUE)
+		demux->start_time = gst_util_uint64_scale_int(fmt_ctx->start_time, GST_SECOND, AV_TIME_BASE);
+	else
+		demux->start_time = 0;
+	GST_DEBUG("start time: %" GST_TIME_FORMAT, GST_TIME_ARGS(demux->start_time));
+	if (fmt_ctx->duration > 0)
+		demux->duration = gst_util_uint64_scale_int(fmt_ctx->duration, GST_SECOND, AV_TIME_BASE);
+	else
+		demux->duration = GST_CLOCK_TIME_NONE;
+
+	GST_DEBUG("duration: %" GST_TIME_FORMAT, GST_TIME_ARGS(demux->duration));
+
+	/* store duration in the segment as well */
+	demux->segment.duration = demux->duration;
+
+	// The pipeline queries the latency again
+	latency = av_streams_get_latency(demux, live);
+	GST_OBJECT_LOCK(demux);
+	demux->latency = latency;
+	GST_OBJECT_UNLOCK(demux);
+	GST_DEBUG("latency: %" GST_TIME_FORMAT, GST_TIME_ARGS(latency));
+	if (live)
+		gst_element_post_message(GST_ELEMENT(demux), gst_message_new_latency(GST_OBJECT(demux)));
+
+	// TODO: what are the seek_event and cached event?
+
+	// Send the segment
+	GST_DEBUG("Sending segment %" GST_SEGMENT_FORMAT, &demux->segment);
+	gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_segment(&demux->segment));
+
+	// Parse metadata to GST Tags and send tag events
+	av_streams_parse_metadata_to_taglists(demux);
+	gst_iestsdemux_push_tags_to_srcpads(demux);
+
+	demux->is_opened = TRUE;
+
+	goto fn_done;
+
+ex_averror:
+	GST_PRINT_AVERROR(av_error);
+	success = FALSE;
+
+fn_done:
+	return success;
+}
+
+/*
+ * Close the stream
+ */
+static void 
+av_streams_close(Gstiestsdemux * demux)
+{
+	g_assert_nonnull(demux);
+
+	if (!demux->is_opened)
+		return;
+	
+	// Remove pads
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		GstAVStream* stream = demux->av_streams[i];
+		if (stream != NULL) {
+			if (stream->srcpad != NULL) {
+				// Remove the src pad from the flow combiner
+				gst_flow_combiner_remove_pad(demux->flow_combiner, stream->srcpad);
+
+				// Remove the src pad from the element
+				gst_element_remove_pad(GST_ELEMENT(demux), stream->srcpad);
+			}
+
+			if (stream->tags)
+				gst_tag_list_unref(stream->tags);
+
+			gst_h26x_parser_free(stream->h26x_parser);
+
+			g_free(stream);
+		}
+		demux->av_streams[i] = NULL;
+	}
+
+	if (demux->ts_srcpad != NULL) {
+		gst_flow_combiner_remove_pad(demux->flow_combiner, demux->ts_srcpad);
+		gst_element_remove_pad(GST_ELEMENT(demux), demux->ts_srcpad);
+		demux->ts_srcpad = NULL;
+	}
+	gst_ts_filter_reset(demux->ts_filter, TS_FILTER_NO_OFFSET);
+	g_free(demux->ts_read_buffer);
+	demux->ts_read_buffer = NULL;
+
+	// The passthrough reads the IO context without the format context
+	av_bufferedio_close(demux->sink_buffio_info->io_context);
+	demux->sink_buffio_info->io_context = NULL;
+	if (demux->av_format_context != NULL)
+		demux->av_format_context->pb = NULL;
+
+	if (demux->av_format_context != NULL) {
+		avformat_close_input(&demux->av_format_context);
+		avformat_free_context(demux->av_format_context);
+		demux->av_format_context = NULL;
+	}
+
+	if (demux->tags)
+		gst_tag_list_unref(demux->tags);
+
+	av_packet_free(&demux->pending_packet);
+
+	// The next input may carry another program
+	gst_ts_inspector_set_pcr_func(demux->ts_inspector, -1, NULL, NULL);
+	g_mutex_lock(&demux->sink_buffio_info->io_sync_mutex);
+	av_bufferedio_track_arrivals(demux->sink_buffio_info, FALSE);
+	g_mutex_unlock(&demux->sink_buffio_info->io_sync_mutex);
+	gst_ts_inspector_reset(demux->ts_inspector);
+	GST_OBJECT_LOCK(demux);
+	gst_pcr_clock_reset(demux->pcr_clock);
+	GST_OBJECT_UNLOCK(demux);
+
+	// The cached buffers refer to the streams being closed
+	gst_iestsdemux_stop_replay(demux);
+	gst_loop_cache_clear(demux->loop_cache);
+	GST_OBJECT_LOCK(demux);
+	gst_scrub_cache_clear(demux->scrub_cache);
+	GST_OBJECT_UNLOCK(demux);
+
+	demux->is_opened = FALSE;
+
+	gst_segment_init(&demux->segment, GST_FORMAT_TIME);
+}
+
+/*
+ * Parse each stream and collect its infos
+ */
+static gboolean
+av_streams_parse_stream(Gstiestsdemux * demux, AVStream * av_stream, int index)
+{
+	gboolean result = FALSE;
+	AVCodecContext *codec_context = NULL;
+	GstAVStream *gst_stream = NULL;
+
+	GstPadTemplate *templ = NULL;
+	GstPad *pad = NULL;
+	GstCaps *caps = NULL;
+	int pad_index = -1;
+	int av_error = 0;
+	gboolean packetized;
+
+	GstiestsdemuxClass *klass = (GstiestsdemuxClass *)G_OBJECT_GET_CLASS(demux);
+
+	g_assert_nonnull(demux);
+	g_assert_nonnull(klass);
+
+	codec_context = avcodec_alloc_context3(NULL);
+	if (codec_context == NULL) {
+		GST_DEBUG("Failed to allocate the codec context!");
+		av_error = AVERROR(EINVAL);
+		goto ex_averror;
+	}
+	avcodec_parameters_to_context(codec_context, av_stream->codecpar);
+
+	gst_stream = g_new0(GstAVStream, 1);
+	demux->av_streams[av_stream->index] = gst_stream;
+
+	gst_stream->srcpad = NULL;
+	gst_stream->avstream = av_stream;
+	gst_stream->av_media_type = codec_context->codec_type;
+	gst_stream->has_discontinuity = TRUE;
+	gst_stream->is_sparse = FALSE;
+	gst_stream->ts_gap_pos = 0;
+	gst_stream->ts_last_pos = GST_CLOCK_TIME_NONE;
+	gst_stream->tags = NULL;
+	av_streams_reset_qos(demux, gst_stream);
+
+	gst_stream->codec_id = codec_context->codec_id;
+	gst_stream->codec_width = codec_context->width;
+	gst_stream->codec_height = codec_context->height;
+	gst_stream->codec_channels = codec_context->channels;
+	gst_stream->codec_sample_rate = codec_context->sample_rate;
+
+	// TODO: Currently we are getting the first stream of the each media type
+	switch (codec_context->codec_type) {
+		case AVMEDIA_TYPE_VIDEO:
+		{
+			double fps = av_q2d(av_stream->avg_frame_rate);
+			caps = av_streams_make_videocaps(codec_context->codec_id, codec_context->width, codec_context->height, fps);
+			if (!caps)
+				break;
+
+			// The parameter sets probed by libav give the profile and the level of the first caps
+			GST_OBJECT_LOCK(demux);
+			packetized = demux->video_stream_format == GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_PACKETIZED;
+			GST_OBJECT_UNLOCK(demux);
+
+			gst_stream->h26x_parser = gst_h26x_parser_new(
+				codec_context->codec_id == AV_CODEC_ID_H264 ? GST_H26X_CODEC_H264 : GST_H26X_CODEC_H265, packetized);
+			if (codec_context->extradata != NULL)
+				gst_h26x_parser_parse(gst_stream->h26x_parser, codec_context->extradata, codec_context->extradata_size);
+			gst_h26x_parser_update_caps(gst_stream->h26x_parser, caps);
+
+			if (demux->active_video_stream_index == -1)
+				demux->active_video_stream_index = index;
+			pad_index = demux->num_of_video_streams++;
+			templ = klass->video_src_template;
+			break;
+		}
+
+		case AVMEDIA_TYPE_AUDIO:
+		{
+			// The configuration probed by libav gives the first caps. The ADTS headers update it.
+			GST_OBJECT_LOCK(demux);
+			gst_stream->aac_raw = demux->audio_stream_format == GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_RAW;
+			GST_OBJECT_UNLOCK(demux);
+			gst_stream->aac_config = av_streams_get_aac_config(codec_context);
+
+			caps = av_streams_make_audiocaps(codec_context->codec_id, codec_context->channels, codec_context->sample_rate,
+				gst_stream->aac_config, gst_stream->aac_raw);
+			if (!caps)
+				break;
+
+			if (demux->active_audio_stream_index == -1)
+				demux->active_audio_stream_index = index;
+			pad_index = demux->num_of_audio_streams++;
+			templ = klass->audio_src_template;
+			break;
+		}
+
+		case AVMEDIA_TYPE_DATA:
+		{
+			caps = av_streams_make_metadatacaps();
+			if (!caps)
+				break;
+
+			if (demux->active_metadata_stream_index == -1)
+				demux->active_metadata_stream_index = index;
+			pad_index = demux->num_of_metadata_streams++;
+			templ = klass->metadata_src_template;
+
+			// The ID3 frames can be minutes apart
+			gst_stream->is_sparse = TRUE;
+			break;
+		}
+
+		default:
+			goto ex_stream_ignored;
+	}
+
+	if (caps == NULL)
+		goto ex_stream_ignored;
+
+	// Create new pad
+	gchar * padname = g_strdup_printf(GST_PAD_TEMPLATE_NAME_TEMPLATE(templ), pad_index);
+	GST_DEBUG("Creating a pad (%s)", padname);
+
+	pad = gst_pad_new_from_template(templ, padname);
+	g_free(padname);
+
+	gst_pad_use_fixed_caps(pad);
+	gst_pad_set_active(pad, TRUE);
+
+	gst_pad_set_query_function(pad, gst_iestsdemux_src_query);
+	gst_pad_set_event_function(pad, gst_iestsdemux_src_event);
+
+	gst_stream->srcpad = pad;
+	gst_pad_set_element_private(pad, gst_stream);
+
+	// TODO: Rewrite
+	gchar *stream_name = g_strdup_printf("%03u", av_stream->index);
+	GstEvent *gst_event = av_streams_new_stream_start(demux, pad, stream_name);
+	g_free(stream_name);
+
+	if (gst_stream->is_sparse)
+		gst_event_set_stream_flags(gst_event, GST_STREAM_FLAG_SPARSE);
+
+	gst_pad_push_event(pad, gst_event);
+
+	GST_INFO_OBJECT(pad, "adding pad with caps %" GST_PTR_FORMAT, caps);
+	gst_pad_set_caps(pad, caps);
+	gst_caps_unref(caps);
+
+	// Add and activate the pad
+	gst_element_add_pad(GST_ELEMENT(demux), pad);
+
+	// Add the pad to the flow combiner
+	gst_flow_combiner_add_pad(demux->flow_combiner, pad);
+
+	result = TRUE;
+	goto done;
+
+ex_averror:
+	GST_PRINT_AVERROR(av_error);
+	if (gst_stream)
+		g_free(gst_stream);
+	result = FALSE;
+	goto done;
+
+ex_stream_ignored:
+	GST_INFO("The media type (%d) will be ignored.", codec_context->codec_type);
+	result = FALSE;
+	goto done;
+
+done:
+	if (codec_context)
+		avcodec_free_context(&codec_context);
+
+	return result;
+}
+
+/*
+ * Create the stream-start event of a source pad. The group follows the one of the upstream.
+ */
+static GstEvent *
+av_streams_new_stream_start(Gstiestsdemux * demux, GstPad * pad, const gchar * stream_name)
+{
+	gchar *stream_id = gst_pad_create_stream_id(pad, GST_ELEMENT_CAST(demux), stream_name);
+
+	GstEvent *gst_event = gst_pad_get_sticky_event(demux->sinkpad, GST_EVENT_STREAM_START, 0);
+	if (gst_event) {
+		if (gst_event_parse_group_id(gst_event, &demux->group_id))
+			demux->have_group_id = TRUE;
+		else
+			demux->have_group_id = FALSE;
+		gst_event_unref(gst_event);
+	}
+	else if (!demux->have_group_id) {
+		demux->have_group_id = TRUE;
+		demux->group_id = gst_util_group_id_next();
+	}
+	gst_event = gst_event_new_stream_start(stream_id);
+	if (demux->have_group_id)
+		gst_event_set_group_id(gst_event, demux->group_id);
+
+	g_free(stream_id);
+
+	return gst_event;
+}
+
+/*
+ * Add the pad forwarding the TS packets of the selected PIDs
+ */
+static void
+av_streams_open_ts_pad(Gstiestsdemux * demux)
+{
+	GstiestsdemuxClass *klass = (GstiestsdemuxClass *)G_OBJECT_GET_CLASS(demux);
+	GstPadTemplate *templ = klass->ts_src_template;
+	GstPad *pad = NULL;
+	GstCaps *caps = NULL;
+
+	gchar * padname = g_strdup_printf(GST_PAD_TEMPLATE_NAME_TEMPLATE(templ), 0);
+	GST_DEBUG("Creating a pad (%s)", padname);
+
+	pad = gst_pad_new_from_template(templ, padname);
+	g_free(padname);
+
+	gst_pad_use_fixed_caps(pad);
+	gst_pad_set_active(pad, TRUE);
+
+	// The seeks are handled as on the other pads
+	gst_pad_set_event_function(pad, gst_iestsdemux_src_event);
+
+	gst_pad_push_event(pad, av_streams_new_stream_start(demux, pad, "ts"));
+
+	caps = gst_pad_template_get_caps(templ);
+	GST_INFO_OBJECT(pad, "adding pad with caps %" GST_PTR_FORMAT, caps);
+	gst_pad_set_caps(pad, caps);
+	gst_caps_unref(caps);
+
+	gst_element_add_pad(GST_ELEMENT(demux), pad);
+	gst_flow_combiner_add_pad(demux->flow_combiner, pad);
+
+	demux->ts_srcpad = pad;
+}
+
+/*
+ * Set the AES-128 key of the encrypted input. The key property comes before the key file.
+ */
+static gboolean
+av_streams_load_aes_key(Gstiestsdemux * demux, const gchar * key_hex, const gchar * iv_hex, const gchar * key_file)
+{
+	guint8 key[AES_KEY_SIZE];
+	guint8 iv[AES_BLOCK_SIZE] = { 0 };
+	gchar *contents = NULL;
+	gsize length = 0;
+	GError *error = NULL;
+	gboolean success = TRUE;
+
+	if (key_hex != NULL && key_hex[0] != '\0') {
+		if (!gst_aes_parse_hex(key_hex, key)) {
+			GST_ERROR_OBJECT(demux, "The AES key is not 32 hex digits");
+			return FALSE;
+		}
+	}
+	else {
+		if (!g_file_get_contents(key_file, &contents, &length, &error)) {
+			GST_ERROR_OBJECT(demux, "Failed to read the AES key file %s: %s", key_file, error->message);
+			g_error_free(error);
+			return FALSE;
+		}
+
+		// The HLS key files hold the raw 16 bytes
+		if (length == AES_KEY_SIZE)
+			memcpy(key, contents, AES_KEY_SIZE);
+		else
+			success = gst_aes_parse_hex(g_strstrip(contents), key);
+
+		memset(contents, 0, length);
+		g_free(contents);
+
+		if (!success) {
+			GST_ERROR_OBJECT(demux, "The AES key file %s holds neither 16 bytes nor 32 hex digits", key_file);
+			return FALSE;
+		}
+	}
+
+	if (iv_hex != NULL && iv_hex[0] != '\0' && !gst_aes_parse_hex(iv_hex, iv)) {
+		GST_ERROR_OBJECT(demux, "The AES IV is not 32 hex digits");
+		memset(key, 0, sizeof(key));
+		return FALSE;
+	}
+
+	gst_aes_decryptor_set_key(demux->aes_decryptor, key, iv);
+	memset(key, 0, sizeof(key));
+
+	GST_INFO_OBJECT(demux, "The input is decrypted with AES-128-CBC");
+
+	return TRUE;
+}
+
+/*
+ * A new segment starts at the concat boundary. What libav reads from there on is kept in case the streams are
+ * opened again. The encrypted segment ends with its padding and the next one starts over with the IV of the property.
+ * Called with the IO lock held.
+ */
+static void
+av_streams_start_segment(Gstiestsdemux * demux)
+{
+	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
+	guint8 iv[AES_BLOCK_SIZE] = { 0 };
+	gchar *iv_hex;
+
+	av_bufferedio_keep_from(buffio_info, demux->concat_boundary);
+	buffio_info->io_boundary = demux->concat_boundary;
+
+	if (buffio_info->decryptor == NULL)
+		return;
+
+	GST_OBJECT_LOCK(demux);
+	iv_hex = g_strdup(demux->aes_iv);
+	GST_OBJECT_UNLOCK(demux);
+
+	if (iv_hex != NULL && iv_hex[0] != '\0' && !gst_aes_parse_hex(iv_hex, iv))
+		GST_WARNING_OBJECT(demux, "The AES IV is not 32 hex digits. The next segment keeps the IV it has.");
+	else
+		gst_aes_decryptor_set_initial_iv(buffio_info->decryptor, iv);
+
+	g_free(iv_hex);
+}
+
+/*
+ * Prepare the metadata scan. Every stream except the metadata is discarded so libav skips their payload.
+ */
+static gint
+av_streams_open_metadata_scan(Gstiestsdemux * demux)
+{
+	AVFormatContext *fmt_ctx = demux->av_format_context;
+	AVPacket *packet = NULL;
+	gint av_error = 0;
+	gint num_of_metadata_streams = 0;
+
+	packet = av_packet_alloc();
+	if (packet == NULL)
+		return AVERROR(ENOMEM);
+
+	// The start time is not probed. Read ahead until the first timestamp of any stream.
+	while ((av_error = av_read_frame(fmt_ctx, packet)) >= 0) {
+		if (packet->pts != AV_NOPTS_VALUE) {
+			AVStream *av_stream = fmt_ctx->streams[packet->stream_index];
+			fmt_ctx->start_time = av_rescale_q(packet->pts, av_stream->time_base, AV_TIME_BASE_Q);
+			break;
+		}
+		av_packet_unref(packet);
+	}
+
+	if (av_error < 0) {
+		av_packet_free(&packet);
+		if (av_error != (int)AVERROR_EOF)
+			return av_error;
+	}
+	else if (fmt_ctx->streams[packet->stream_index]->codecpar->codec_type == AVMEDIA_TYPE_DATA) {
+		// The metadata packet is delivered first
+		demux->pending_packet = packet;
+	}
+	else {
+		av_packet_free(&packet);
+	}
+
+	for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+		if (fmt_ctx->streams[i]->codecpar->codec_type == AVMEDIA_TYPE_DATA)
+			num_of_metadata_streams++;
+		else
+			fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	if (num_of_metadata_streams == 0)
+		GST_WARNING("There is no metadata stream to scan.");
+
+	GST_INFO("Scanning %d metadata stream(s) out of %u streams", num_of_metadata_streams, fmt_ctx->nb_streams);
+
+	return 0;
+}
+
+/*
+ * Scan the whole input with the parallel workers. The keyframes are added to the index of libav and
+ * the metadata packets are delivered from the scan results in the metadata-only mode.
+ */
+static void
+av_streams_run_scan(Gstiestsdemux * demux, GstiestsdemuxScanMode scan_mode)
+{
+	AVFormatContext *fmt_ctx = demux->av_format_context;
+	AVStream *video_stream = NULL;
+	GstTsScanConfig config;
+	GArray *entries = NULL;
+	gboolean build_index;
+	gint64 size = 0;
+	gint64 first_pcr = GST_TS_SCAN_NO_VALUE, last_pcr = GST_TS_SCAN_NO_VALUE;
+	gint stream_index;
+	guint num_keyframes = 0;
+
+	GST_OBJECT_LOCK(demux);
+	build_index = demux->build_index;
+	config.num_threads = demux->scan_threads;
+	GST_OBJECT_UNLOCK(demux);
+
+	config.video_pid = -1;
+	config.is_hevc = FALSE;
+	config.pcr_pid = -1;
+	config.metadata_pid = -1;
+
+	if (build_index && demux->active_video_stream_index >= 0) {
+		video_stream = fmt_ctx->streams[demux->active_video_stream_index];
+		config.video_pid = video_stream->id;
+		config.is_hevc = video_stream->codecpar->codec_id == AV_CODEC_ID_HEVC;
+	}
+
+	if (scan_mode == GST_IESTSDEMUX_SCAN_MODE_METADATA_ONLY && demux->active_metadata_stream_index >= 0)
+		config.metadata_pid = fmt_ctx->streams[demux->active_metadata_stream_index]->id;
+
+	if (config.video_pid < 0 && config.metadata_pid < 0)
+		return;
+
+	// The PCR samples of the program give the duration when it has not been probed
+	stream_index = video_stream != NULL ? video_stream->index : demux->active_metadata_stream_index;
+	config.pcr_pid = av_streams_get_pcr_pid(demux, stream_index);
+
+	if (!gst_pad_peer_query_duration(demux->sinkpad, GST_FORMAT_BYTES, &size) || size <= 0) {
+		GST_WARNING("The input size is unknown. The input is not scanned.");
+		return;
+	}
+
+	entries = gst_ts_scan_run(demux->sinkpad, (guint64)size, &config);
+	if (entries == NULL)
+		return;
+
+	for (guint i = 0; i < entries->len; i++) {
+		GstTsScanEntry *entry = &g_array_index(entries, GstTsScanEntry, i);
+
+		if (entry->value == GST_TS_SCAN_NO_VALUE)
+			continue;
+
+		if (entry->type == GST_TS_SCAN_ENTRY_KEYFRAME && video_stream != NULL) {
+			av_add_index_entry(video_stream, (int64_t)entry->offset, entry->value, 0, 0, AVINDEX_KEYFRAME);
+			num_keyframes++;
+		}
+		else if (entry->type == GST_TS_SCAN_ENTRY_PCR) {
+			if (first_pcr == GST_TS_SCAN_NO_VALUE)
+				first_pcr = entry->value;
+			last_pcr = entry->value;
+		}
+	}
+
+	if (fmt_ctx->duration <= 0 && last_pcr > first_pcr)
+		fmt_ctx->duration = av_rescale(last_pcr - first_pcr, AV_TIME_BASE, 27000000);
+
+	GST_INFO("Added %u keyframes to the index", num_keyframes);
+
+	if (config.metadata_pid >= 0) {
+		// The packet read ahead is in the scan results as well
+		av_packet_free(&demux->pending_packet);
+		demux->scan_entries = entries;
+		demux->scan_cursor = 0;
+	}
+	else {
+		g_array_free(entries, TRUE);
+	}
+}
+
+/*
+ * Find the PCR PID of the program carrying the stream
+ */
+static gint
+av_streams_get_pcr_pid(Gstiestsdemux * demux, gint stream_index)
+{
+	AVFormatContext *fmt_ctx = demux->av_format_context;
+
+	if (stream_index < 0)
+		return -1;
+
+	for (unsigned int i = 0; i < fmt_ctx->nb_programs; i++) {
+		for (unsigned int j = 0; j < fmt_ctx->programs[i]->nb_stream_indexes; j++) {
+			if (fmt_ctx->programs[i]->stream_index[j] == (unsigned int)stream_index)
+				return fmt_ctx->programs[i]->pcr_pid;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Forget the QoS reported for the previous segment
+ */
+static void
+av_streams_reset_qos(Gstiestsdemux * demux, GstAVStream * gst_stream)
+{
+	GST_OBJECT_LOCK(demux);
+	gst_stream->qos_proportion = 1.0;
+	gst_stream->qos_earliest_time = GST_CLOCK_TIME_NONE;
+	GST_OBJECT_UNLOCK(demux);
+
+	gst_stream->qos_waiting_keyframe = FALSE;
+	gst_stream->qos_processed = 0;
+	gst_stream->qos_dropped = 0;
+}
+
+/*
+ * Decide if the video packet is dropped. A late delta unit breaks the references, so everything is dropped
+ * until the next keyframe. A non-reference unit is dropped alone when it is late or downstream is overloaded.
+ */
+static gboolean
+av_streams_qos_drop(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet, GstClockTime position, GstClockTime duration)
+{
+	GstClockTime running_time = GST_CLOCK_TIME_NONE, earliest_time;
+	GstClockTime stream_time;
+	gdouble proportion;
+	gboolean is_keyframe = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+	gboolean is_late = FALSE;
+	GstMessage *msg;
+
+	if (gst_stream->av_media_type != AVMEDIA_TYPE_VIDEO)
+		return FALSE;
+
+	GST_OBJECT_LOCK(demux);
+	earliest_time = gst_stream->qos_earliest_time;
+	proportion = gst_stream->qos_proportion;
+	GST_OBJECT_UNLOCK(demux);
+
+	if (GST_CLOCK_TIME_IS_VALID(position)) {
+		running_time = gst_segment_to_running_time(&demux->segment, GST_FORMAT_TIME, position);
+		if (GST_CLOCK_TIME_IS_VALID(running_time) && GST_CLOCK_TIME_IS_VALID(duration))
+			running_time += duration;
+	}
+
+	if (gst_stream->qos_waiting_keyframe) {
+		if (!is_keyframe)
+			goto ex_dropped;
+
+		// The decoder starts over from the keyframe
+		GST_DEBUG_OBJECT(gst_stream->srcpad, "Resume at the keyframe %" GST_TIME_FORMAT, GST_TIME_ARGS(position));
+		gst_stream->qos_waiting_keyframe = FALSE;
+		gst_stream->has_discontinuity = TRUE;
+	}
+
+	if (is_keyframe)
+		goto fn_processed;
+
+	is_late = GST_CLOCK_TIME_IS_VALID(running_time) && GST_CLOCK_TIME_IS_VALID(earliest_time) &&
+		running_time < earliest_time;
+
+	if (!is_late && proportion <= TSDEMUX_QOS_OVERLOAD_PROPORTION)
+		goto fn_processed;
+
+	if (!av_streams_is_reference_unit(gst_stream->avstream->codecpar->codec_id, packet->data, packet->size))
+		goto ex_dropped;
+
+	// The overloaded decoder still gets the reference units in time
+	if (!is_late)
+		goto fn_processed;
+
+	gst_stream->qos_waiting_keyframe = TRUE;
+	goto ex_dropped;
+
+fn_processed:
+	gst_stream->qos_processed++;
+	return FALSE;
+
+ex_dropped:
+	gst_stream->qos_dropped++;
+
+	GST_LOG_OBJECT(gst_stream->srcpad, "Dropping %" GST_TIME_FORMAT " (earliest %" GST_TIME_FORMAT ", proportion %f)",
+		GST_TIME_ARGS(running_time), GST_TIME_ARGS(earliest_time), proportion);
+
+	// The caches must not replay the hole. The range being recorded is not kept and the scrub window starts over.
+	if (gst_loop_cache_is_recording(demux->loop_cache)) {
+		GST_DEBUG_OBJECT(gst_stream->srcpad, "The loop cache range is incomplete after the drop");
+		gst_loop_cache_abort_range(demux->loop_cache);
+	}
+	GST_OBJECT_LOCK(demux);
+	gst_scrub_cache_clear(demux->scrub_cache);
+	GST_OBJECT_UNLOCK(demux);
+
+	stream_time = gst_segment_to_stream_time(&demux->segment, GST_FORMAT_TIME, position);
+	msg = gst_message_new_qos(GST_OBJECT(demux), demux->live, running_time, stream_time, position, duration);
+	gst_message_set_qos_values(msg, GST_CLOCK_DIFF(running_time, earliest_time), proportion, 1000000);
+	gst_message_set_qos_stats(msg, GST_FORMAT_BUFFERS, gst_stream->qos_processed, gst_stream->qos_dropped);
+	gst_element_post_message(GST_ELEMENT(demux), msg);
+
+	return TRUE;
+}
+
+/*
+ * Check the first slice of the access unit. Unknown codecs are handled as the reference.
+ */
+static gboolean
+av_streams_is_reference_unit(enum AVCodecID codec_id, const guint8 * data, gint size)
+{
+	for (gint pos = 0; pos + 4 < size; pos++) {
+		guint8 nal_type;
+
+		if (data[pos] != 0x00 || data[pos + 1] != 0x00 || data[pos + 2] != 0x01)
+			continue;
+
+		switch (codec_id) {
+		case AV_CODEC_ID_H264:
+			// The coded slices carry nal_ref_idc
+			nal_type = data[pos + 3] & 0x1f;
+			if (nal_type >= 1 && nal_type <= 5)
+				return (data[pos + 3] & 0x60) != 0;
+			break;
+
+		case AV_CODEC_ID_HEVC:
+			// The even VCL types up to 14 are the sub-layer non-reference pictures
+			nal_type = (data[pos + 3] >> 1) & 0x3f;
+			if (nal_type < 32)
+				return nal_type > 14 || (nal_type % 2) != 0;
+			break;
+
+		default:
+			return TRUE;
+		}
+
+		pos += 2;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Split the video packet into the NAL units. A new parameter set updates the caps before the access unit goes out.
+ * The packetized output waits for the codec_data.
+ */
+static gboolean
+av_streams_parse_access_unit(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet)
+{
+	GstH26xParser *parser = gst_stream->h26x_parser;
+
+	if (gst_h26x_parser_parse(parser, packet->data, packet->size)) {
+		GstCaps *caps = gst_pad_get_current_caps(gst_stream->srcpad);
+
+		if (caps != NULL) {
+			caps = gst_caps_make_writable(caps);
+			gst_h26x_parser_update_caps(parser, caps);
+
+			GST_INFO_OBJECT(gst_stream->srcpad, "updating caps %" GST_PTR_FORMAT, caps);
+			gst_pad_set_caps(gst_stream->srcpad, caps);
+			gst_caps_unref(caps);
+		}
+	}
+
+	// The IDR and IRAP pictures found are added to what libav flags. libav also flags the random access points
+	// of the streams without them, like the I slices with a recovery point SEI, so its flag is kept.
+	if (parser->is_keyframe)
+		packet->flags |= AV_PKT_FLAG_KEY;
+
+	if (parser->packetized && !gst_h26x_parser_has_codec_data(parser)) {
+		GST_DEBUG_OBJECT(gst_stream->srcpad, "Dropping the access unit before the parameter sets");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Wrap the AAC frame of the packet without copying it. The raw output starts after the ADTS header.
+ * A new configuration in the header updates the caps first.
+ */
+static GstBuffer *
+av_streams_make_aac_buffer(Gstiestsdemux * demux, GstAVStream * gst_stream, AVPacket * packet)
+{
+	GstBuffer *buffer;
+	guint header_size;
+	guint16 config;
+	gboolean is_single;
+	gsize offset;
+
+	if (!av_streams_parse_adts_header(packet->data, packet->size, &header_size, &config, &is_single)) {
+		GST_WARNING_OBJECT(gst_stream->srcpad, "Dropping a packet without the ADTS header (%d bytes)", packet->size);
+		return NULL;
+	}
+
+	// The AAC parser of libav gives the frames one by one. The raw output cannot carry more at once.
+	if (gst_stream->aac_raw && !is_single) {
+		GST_WARNING_OBJECT(gst_stream->srcpad, "Dropping a packet which is not a single ADTS frame (%d bytes)", packet->size);
+		return NULL;
+	}
+
+	if (config != gst_stream->aac_config) {
+		GstCaps *caps;
+
+		gst_stream->aac_config = config;
+		// The probed channels stay when the header leaves them to a PCE, and the caps always keep a rate
+		caps = av_streams_make_audiocaps(AV_CODEC_ID_AAC, gst_stream->codec_channels, gst_stream->codec_sample_rate,
+			config, gst_stream->aac_raw);
+
+		GST_INFO_OBJECT(gst_stream->srcpad, "updating caps %" GST_PTR_FORMAT, caps);
+		gst_pad_set_caps(gst_stream->srcpad, caps);
+		gst_caps_unref(caps);
+	}
+
+	offset = gst_stream->aac_raw ? header_size : 0;
+
+	if (packet->buf == NULL) {
+		buffer = gst_buffer_new_and_alloc(packet->size - offset);
+		gst_buffer_fill(buffer, 0, packet->data + offset, packet->size - offset);
+		return buffer;
+	}
+
+	// The memory stays with libav until the buffer is freed
+	return gst_buffer_new_wrapped_full(GST_MEMORY_FLAG_READONLY, packet->data, packet->size, offset,
+		packet->size - offset, av_buffer_ref(packet->buf), av_streams_free_packet_buffer);
+}
+
+/*
+ * Read the ADTS header at the beginning of the packet. The configuration is the AudioSpecificConfig of the frame.
+ * The packet is a single frame when it holds exactly one frame with one raw data block.
+ */
+static gboolean
+av_streams_parse_adts_header(const guint8 * data, gint size, guint * header_size, guint16 * config, gboolean * is_single)
+{
+	guint object_type, sf_index, channel_config, frame_length;
 
-	// TODO: Currently we are getting the first stream of the each media type
-	switch (codec_context->codec_type) {
-		case AVMEDIA_TYPE_VIDEO:
-		{
-			double fps = av_q2d(av_stream->avg_frame_rate);
-			caps = av_streams_make_videocaps(codec_context->codec_id, codec_context->width, codec_context->height, fps);
-			if (!caps)
-				break;
+	if (size < TSDEMUX_ADTS_HEADER_SIZE || data[0] != 0xff || (data[1] & 0xf6) != 0xf0)
+		return FALSE;
 
-			if (demux->active_video_stream_index == -1)
-				demux->active_video_stream_index = index;
-			pad_index = demux->num_of_video_streams++;
-			templ = klass->video_src_template;
-			break;
-		}
+	// The profile is the object type minus one
+	object_type = ((data[2] >> 6) & 0x3) + 1;
+	sf_index = (data[2] >> 2) & 0xf;
+	channel_config = ((data[2] & 0x1) << 2) | ((data[3] >> 6) & 0x3);
+	frame_length = ((data[3] & 0x3) << 11) | (data[4] << 3) | ((data[5] >> 5) & 0x7);
 
-		case AVMEDIA_TYPE_AUDIO:
-		{
-			caps = av_streams_make_audiocaps(codec_context->codec_id, codec_context->channels, codec_context->sample_rate);
-			if (!caps)
-				break;
+	*header_size = TSDEMUX_ADTS_HEADER_SIZE + ((data[1] & 0x1) ? 0 : TSDEMUX_ADTS_CRC_SIZE);
+	*config = (guint16)((object_type << 11) | (sf_index << 7) | (channel_config << 3));
 
-			if (demux->active_audio_stream_index == -1)
-				demux->active_audio_stream_index = index;
-			pad_index = demux->num_of_audio_streams++;
-			templ = klass->audio_src_template;
-			break;
-		}
+	*is_single = frame_length == (guint)size && frame_length > *header_size && (data[6] & 0x3) == 0;
 
-		case AVMEDIA_TYPE_DATA:
-		{
-			caps = av_streams_make_metadatacaps();
-			if (!caps)
-				break;
+	return sf_index < G_N_ELEMENTS(aac_sample_rates);
+}
 
-			if (demux->active_metadata_stream_index == -1)
-				demux->active_metadata_stream_index = index;
-			pad_index = demux->num_of_metadata_streams++;
-			templ = klass->metadata_src_template;
-			break;
-		}
+/*
+ * Make the AudioSpecificConfig of the stream probed by libav. It is 0 when the sample rate is not an AAC one.
+ */
+static guint16
+av_streams_get_aac_config(AVCodecContext * codec_context)
+{
+	guint object_type = codec_context->profile >= 0 ? codec_context->profile + 1 : 2;
+	guint channel_config = codec_context->channels == 8 ? 7 : codec_context->channels;
 
-		default:
-			goto ex_stream_ignored;
+	if (codec_context->extradata != NULL && codec_context->extradata_size >= 2 &&
+		((GST_READ_UINT16_BE(codec_context->extradata) >> 7) & 0xf) < G_N_ELEMENTS(aac_sample_rates))
+		return GST_READ_UINT16_BE(codec_context->extradata);
+
+	for (guint sf_index = 0; sf_index < G_N_ELEMENTS(aac_sample_rates); sf_index++) {
+		if (aac_sample_rates[sf_index] == codec_context->sample_rate && channel_config <= 7)
+			return (guint16)((object_type << 11) | (sf_index << 7) | (channel_config << 3));
 	}
 
-	if (caps == NULL)
-		goto ex_stream_ignored;
+	return 0;
+}
 
-	// Create new pad
-	gchar * padname = g_strdup_printf(GST_PAD_TEMPLATE_NAME_TEMPLATE(templ), pad_index);
-	GST_DEBUG("Creating a pad (%s)", padname);
+static void
+av_streams_free_packet_buffer(gpointer data)
+{
+	AVBufferRef *buf = data;
 
-	pad = gst_pad_new_from_template(templ, padname);
-	g_free(padname);
+	av_buffer_unref(&buf);
+}
 
-	gst_pad_use_fixed_caps(pad);
-	gst_pad_set_active(pad, TRUE);
+/*
+ * Take the next metadata packet found by the parallel scan
+ */
+static GstAVStream *
+av_streams_demux_scanned(Gstiestsdemux * demux, GstBuffer ** gst_buff)
+{
+	GstAVStream *gst_stream = demux->av_streams[demux->active_metadata_stream_index];
+	GstTsScanEntry *entry = NULL;
+	GstBuffer *buff_push = NULL;
+	GstClockTime position = GST_CLOCK_TIME_NONE;
 
-	gst_pad_set_query_function(pad, gst_iestsdemux_src_query);
-	gst_pad_set_event_function(pad, gst_iestsdemux_src_event);
+	while (demux->scan_cursor < demux->scan_entries->len) {
+		entry = &g_array_index(demux->scan_entries, GstTsScanEntry, demux->scan_cursor);
+		demux->scan_cursor++;
 
-	gst_stream->srcpad = pad;
-	gst_pad_set_element_private(pad, gst_stream);
+		if (entry->type == GST_TS_SCAN_ENTRY_METADATA)
+			break;
+		entry = NULL;
+	}
 
-	// TODO: Rewrite
-	gchar *stream_id = gst_pad_create_stream_id_printf(pad, GST_ELEMENT_CAST(demux), "%03u",
-			av_stream->index);
+	if (entry == NULL || gst_stream == NULL)
+		return NULL;
 
-	GstEvent *gst_event = gst_pad_get_sticky_event(demux->sinkpad, GST_EVENT_STREAM_START, 0);
-	if (gst_event) {
-		if (gst_event_parse_group_id(gst_event, &demux->group_id))
-			demux->have_group_id = TRUE;
+	// Adjust the timestamp
+	if (entry->value != GST_TS_SCAN_NO_VALUE) {
+		position = convert_timestamp_from_av_to_gst(entry->value, gst_stream->avstream->time_base);
+		gst_stream->ts_last_pos = position;
+
+		if (demux->start_time >= position)
+			position = 0;
 		else
-			demux->have_group_id = FALSE;
-		gst_event_unref(gst_event);
+			position -= demux->start_time;
 	}
-	else if (!demux->have_group_id) {
-		demux->have_group_id = TRUE;
-		demux->group_id = gst_util_group_id_next();
+
+	// Check if the stream is out of range
+	if (demux->segment.stop != -1 && GST_CLOCK_TIME_IS_VALID(position) && position > demux->segment.stop) {
+		demux->scan_cursor = demux->scan_entries->len;
+		return NULL;
 	}
-	gst_event = gst_event_new_stream_start(stream_id);
-	if (demux->have_group_id)
-		gst_event_set_group_id(gst_event, demux->group_id);
 
-	gst_pad_push_event(pad, gst_event);
-	g_free(stream_id);
+	// The payload is shared with the scan results
+	buff_push = gst_buffer_new_and_alloc(demux->metadata_id3_prefix_size);
+	gst_buffer_fill(buff_push, 0, demux->metadata_id3_prefix_buff, demux->metadata_id3_prefix_size);
+	buff_push = gst_buffer_append(buff_push, gst_buffer_ref(entry->payload));
 
-	GST_INFO_OBJECT(pad, "adding pad with caps %" GST_PTR_FORMAT, caps);
-	gst_pad_set_caps(pad, caps);
-	gst_caps_unref(caps);
+	GST_BUFFER_TIMESTAMP(buff_push) = position;
 
-	// Add and activate the pad
-	gst_element_add_pad(GST_ELEMENT(demux), pad);
+	if (gst_stream->has_discontinuity) {
+		GST_BUFFER_FLAG_SET(buff_push, GST_BUFFER_FLAG_DISCONT);
+		gst_stream->has_discontinuity = FALSE;
+	}
 
-	// Add the pad to the flow combiner
-	gst_flow_combiner_add_pad(demux->flow_combiner, pad);
+	*gst_buff = buff_push;
 
-	result = TRUE;
-	goto done;
+	return gst_stream;
+}
 
-ex_averror:
-	GST_PRINT_AVERROR(av_error);
-	if (gst_stream)
-		g_free(gst_stream);
-	result = FALSE;
-	goto done;
+/*
+ * Estimate the latency added by the demux. A frame is held until its PES completes and the IO buffer is filled before parsing.
+ */
+static GstClockTime
+av_streams_get_latency(Gstiestsdemux * demux, gboolean live)
+{
+	AVFormatContext *fmt_ctx = demux->av_format_context;
+	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
+	GstClockTime frame_duration = TSDEMUX_DEFAULT_FRAME_DURATION;
+	GstClockTime io_duration = 0;
+	gint io_bytes;
 
-ex_stream_ignored:
-	GST_INFO("The media type (%d) will be ignored.", codec_context->codec_type);
-	result = FALSE;
-	goto done;
+	if (demux->active_video_stream_index >= 0) {
+		AVRational frame_rate = fmt_ctx->streams[demux->active_video_stream_index]->avg_frame_rate;
+		if (frame_rate.num > 0 && frame_rate.den > 0)
+			frame_duration = gst_util_uint64_scale_int(GST_SECOND, frame_rate.den, frame_rate.num);
+	}
 
-done:
-	if (codec_context)
-		avcodec_free_context(&codec_context);
+	io_bytes = buffio_info->io_read_min > 0 ? buffio_info->io_read_min : buffio_info->io_buffer_size;
+	if (fmt_ctx->bit_rate > 0)
+		io_duration = gst_util_uint64_scale(io_bytes * 8, GST_SECOND, fmt_ctx->bit_rate);
 
-	return result;
+	// The full parser holds one more frame to find its end
+	return (live ? frame_duration : frame_duration * 2) + io_duration;
 }
 
 /*
@@ -1295,6 +3263,9 @@ av_streams_seek(Gstiestsdemux * demux, GstSegment * segment)
 	int av_error = 0;
 	gboolean result = FALSE;
 
+	// The packet read ahead is not at the new position
+	av_packet_free(&demux->pending_packet);
+
 	// Find the default stream used for the seeking
 	index = av_find_default_stream_index(demux->av_format_context);
 	g_return_val_if_fail(index >= 0, FALSE);
@@ -1370,8 +3341,16 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 			GST_ERROR("Fail to open the stream!!!");
 			goto fn_done;
 		}
+
+		// The packets are delivered from the scan results
+		if (demux->scan_entries != NULL)
+			goto fn_done;
 	}
 
+	// The input has been flushed for the next segment
+	if (!demux->is_sink_pullmode)
+		av_streams_resync(demux);
+
 	// Allocate a packet
 	packet = av_packet_alloc();
 	if (packet == NULL) {
@@ -1379,8 +3358,15 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 		goto ex_averror;
 	}
 
-	// Read the frame
-	av_error = av_read_frame(demux->av_format_context, packet);
+	// Read the frame. The packet read ahead while opening goes first.
+	if (demux->pending_packet != NULL) {
+		av_packet_move_ref(packet, demux->pending_packet);
+		av_packet_free(&demux->pending_packet);
+	}
+	else {
+		av_error = av_read_frame(demux->av_format_context, packet);
+	}
+
 	if (av_error < 0) {
 		if (av_error == (int)AVERROR_EOF)
 			goto ex_eos;
@@ -1389,13 +3375,22 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 		goto ex_averror;
 	}
 
-	gst_stream = demux->av_streams[packet->stream_index];
+	// The segments concatenated in the push mode go on with the same streams
+	if (!demux->is_sink_pullmode && !av_streams_follow_segments(demux, packet))
+		goto fn_done;
+
+	gst_stream = packet->stream_index < demux->num_of_all_streams ? demux->av_streams[packet->stream_index] : NULL;
 	if (gst_stream == NULL) {
 		GST_WARNING("Could not find the stream with the specified index:%d", packet->stream_index);
 		goto fn_done;
 	}
 
 	packet_pts = packet->pts;
+
+	// The concatenated segments continue the timestamps of the previous ones
+	if (!demux->is_sink_pullmode && packet_pts != AV_NOPTS_VALUE)
+		packet_pts = av_streams_unwrap_pts(demux, packet_pts, gst_stream->avstream->time_base);
+
 	if (packet_pts < 0) packet_pts = 0;
 
 	// Get the postion and duration
@@ -1422,12 +3417,35 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 			position -= demux->start_time;
 	}
 
+	// The downstream has been flushed. The segment starts again at the first buffer after the flush.
+	if (demux->concat_new_segment && GST_CLOCK_TIME_IS_VALID(position)) {
+		demux->concat_new_segment = FALSE;
+		demux->segment.start = position;
+		demux->segment.time = position;
+		demux->segment.position = position;
+
+		GST_DEBUG("Sending segment %" GST_SEGMENT_FORMAT, &demux->segment);
+		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_segment(&demux->segment));
+	}
+
 	// Check if the stream is out of range.
 	if (demux->segment.stop != -1 && position > demux->segment.stop) {
 		//TODO: Assume EOS
 		goto ex_eos;
 	}
 
+	// The keyframes are the IDR and IRAP pictures of the access unit
+	if (gst_stream->h26x_parser != NULL && !av_streams_parse_access_unit(demux, gst_stream, packet)) {
+		gst_stream = NULL;
+		goto fn_done;
+	}
+
+	// Drop the video which would be late anyway before copying it
+	if (av_streams_qos_drop(demux, gst_stream, packet, position, duration)) {
+		gst_stream = NULL;
+		goto fn_done;
+	}
+
 	// Gather data/information about the buffer to be pushed
 	if (packet->stream_index == demux->active_metadata_stream_index) {
 		GST_DEBUG("Manipulate the id3 metadata");
@@ -1439,6 +3457,20 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 		gst_buffer_fill(buff_push, 0, demux->metadata_id3_prefix_buff, offset);
 		gst_buffer_fill(buff_push, offset, packet->data, packet->size);
 	}
+	else if (gst_stream->h26x_parser != NULL && gst_stream->h26x_parser->packetized) {
+		GST_DEBUG("Handle the packetized video data");
+
+		buff_push = gst_h26x_parser_make_packetized(gst_stream->h26x_parser, packet->data);
+	}
+	else if (gst_stream->avstream->codecpar->codec_id == AV_CODEC_ID_AAC) {
+		GST_DEBUG("Handle the AAC frame");
+
+		buff_push = av_streams_make_aac_buffer(demux, gst_stream, packet);
+		if (buff_push == NULL) {
+			gst_stream = NULL;
+			goto fn_done;
+		}
+	}
 	else {
 		GST_DEBUG("Handle the video/audio data");
 
@@ -1468,40 +3500,224 @@ av_streams_demux(Gstiestsdemux * demux, GstBuffer ** gst_buff)
 ex_eos:
 	GST_DEBUG("The stream reaches the end.");
 
-	gst_pad_pause_task(demux->sinkpad);
-
-	if (demux->segment.flags & GST_SEEK_FLAG_SEGMENT) {
-		gint64 stop;
-
-		if ((stop = demux->segment.stop) == -1)
-			stop = demux->segment.duration;
+	// The whole range has been recorded and can be looped from the memory
+	gst_loop_cache_end_range(demux->loop_cache);
 
-		GST_LOG("Post a message to notify the end segment.");
-		GstMessage *gst_msg = gst_message_new_segment_done(GST_OBJECT(demux), demux->segment.format, stop);
-		gst_element_post_message(GST_ELEMENT(demux), gst_msg);
-
-		GST_LOG("Send an event to notify the end segment.");
-		GstEvent *gst_event = gst_event_new_segment_done(demux->segment.format, stop);
-		gst_iestsdemux_push_event_to_srcpads(demux, gst_event);
-	}
-	else {
-		GST_LOG("pushing eos");
-		gst_iestsdemux_push_event_to_srcpads(demux, gst_event_new_eos());
-	}
+	gst_iestsdemux_push_eos(demux);
 
 	goto fn_done;
 
 ex_averror:
+	gst_loop_cache_abort_range(demux->loop_cache);
 	gst_pad_pause_task(demux->sinkpad);
 	GST_PRINT_AVERROR(av_error);
 
 fn_done:
 	if (packet != NULL)
-		av_packet_unref(packet);
+		av_packet_free(&packet);
 
 	return gst_stream;
 }
 
+/*
+ * Read the input without demuxing. The TS filter takes the packets on their way through the IO.
+ */
+static void
+av_streams_passthrough(Gstiestsdemux * demux)
+{
+	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
+	GstFlowReturn result;
+	gint bytes_read;
+
+	if (!demux->is_opened && !av_streams_open(demux)) {
+		GST_ERROR("Fail to open the stream!!!");
+		gst_pad_pause_task(demux->sinkpad);
+		return;
+	}
+
+	if (!demux->is_sink_pullmode)
+		av_streams_resync(demux);
+
+	// A single read of the IO. The live input is forwarded as it arrives.
+	bytes_read = avio_read_partial(buffio_info->io_context, demux->ts_read_buffer, buffio_info->io_buffer_size);
+	if (bytes_read <= 0) {
+		if (bytes_read < 0 && bytes_read != (int)AVERROR_EOF)
+			GST_PRINT_AVERROR(bytes_read);
+
+		GST_DEBUG("The stream reaches the end.");
+		gst_iestsdemux_push_eos(demux);
+		return;
+	}
+
+	result = gst_iestsdemux_push_ts(demux);
+	if (result != GST_FLOW_OK) {
+		GST_WARNING("Pausing the passthrough: %s", gst_flow_get_name(result));
+		gst_pad_pause_task(demux->sinkpad);
+	}
+}
+
+/*
+ * Drop what libav holds from before the flush. The format context and the pads are kept.
+ */
+static void
+av_streams_resync(Gstiestsdemux * demux)
+{
+	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
+	gboolean resync;
+
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	resync = demux->concat_resync;
+	demux->concat_resync = FALSE;
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	if (!resync)
+		return;
+
+	GST_DEBUG("Resync libav after the flush");
+
+	av_packet_free(&demux->pending_packet);
+	if (demux->av_format_context != NULL)
+		avformat_flush(demux->av_format_context);
+
+	// The input goes on after the end it may have reached
+	if (buffio_info->io_context != NULL)
+		buffio_info->io_context->eof_reached = 0;
+}
+
+/*
+ * Find the first packet of the new segment. The streams are opened again only when the new segment carries
+ * other codecs. It returns FALSE for the packet to be dropped.
+ */
+static gboolean
+av_streams_follow_segments(Gstiestsdemux * demux, AVPacket * packet)
+{
+	GstBufferedIOInfo *buffio_info = demux->sink_buffio_info;
+	gboolean is_flushed, is_new_segment, is_same;
+	guint64 boundary;
+
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	// The padding of the encrypted segments read so far is not in the positions of the packets
+	boundary = demux->concat_boundary - MIN(demux->concat_boundary, buffio_info->io_padding_removed);
+	is_flushed = demux->concat_flushed;
+	is_new_segment = demux->concat_pending && packet->pos >= 0 && (guint64)packet->pos >= boundary;
+	if (is_new_segment) {
+		demux->concat_pending = FALSE;
+		demux->concat_flushed = FALSE;
+	}
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	// The data before the flush has been thrown away downstream
+	if (!is_new_segment)
+		return !is_flushed;
+
+	GST_DEBUG("A new segment starts at the input offset %" G_GUINT64_FORMAT, boundary);
+
+	is_same = av_streams_has_same_codecs(demux);
+
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	if (is_same)
+		av_bufferedio_drop_kept(buffio_info);
+	else
+		av_bufferedio_replay(buffio_info);
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	// libav reads the segment again from its boundary, so the streams are opened with its PAT, PMT and first PES
+	if (!is_same) {
+		GST_INFO("The new segment carries other streams. Opening the streams again.");
+		av_streams_close(demux);
+		return FALSE;
+	}
+
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		if (demux->av_streams[i] != NULL)
+			demux->av_streams[i]->has_discontinuity = TRUE;
+	}
+
+	demux->concat_new_segment = is_flushed;
+
+	return TRUE;
+}
+
+/*
+ * Check that the streams have kept the codecs they were opened with. A new PMT adds the streams of its PIDs.
+ */
+static gboolean
+av_streams_has_same_codecs(Gstiestsdemux * demux)
+{
+	AVFormatContext *fmt_ctx = demux->av_format_context;
+
+	if (fmt_ctx->nb_streams != (unsigned int)demux->num_of_all_streams)
+		return FALSE;
+
+	for (int i = 0; i < demux->num_of_all_streams; i++) {
+		GstAVStream *gst_stream = demux->av_streams[i];
+		AVCodecParameters *codecpar;
+
+		if (gst_stream == NULL || gst_stream->srcpad == NULL)
+			continue;
+
+		codecpar = gst_stream->avstream->codecpar;
+		if (codecpar->codec_id != gst_stream->codec_id ||
+			codecpar->width != gst_stream->codec_width || codecpar->height != gst_stream->codec_height ||
+			codecpar->channels != gst_stream->codec_channels || codecpar->sample_rate != gst_stream->codec_sample_rate)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*
+ * Unwrap the 33-bit PTS and continue it over the discontinuities between the concatenated segments.
+ * The first segment keeps the PTS from libav so it matches the start time.
+ */
+static gint64
+av_streams_unwrap_pts(Gstiestsdemux * demux, gint64 pts, AVRational time_base)
+{
+	gint64 pts_33bit, delta, threshold;
+
+	// Only the 90 kHz PTS of the TS wraps
+	if (time_base.num != 1 || time_base.den != 90000)
+		return pts;
+
+	pts_33bit = pts & (TSDEMUX_PTS_WRAP - 1);
+
+	if (!demux->pts_unwrap_valid) {
+		demux->pts_unwrap_valid = TRUE;
+		demux->pts_unwrap_last = pts_33bit;
+		demux->pts_unwrap_value = pts;
+		demux->pts_unwrap_max = pts;
+		return pts;
+	}
+
+	// The shorter way around the wrap
+	delta = (pts_33bit - demux->pts_unwrap_last) & (TSDEMUX_PTS_WRAP - 1);
+	if (delta >= TSDEMUX_PTS_WRAP / 2)
+		delta -= TSDEMUX_PTS_WRAP;
+
+	threshold = convert_timestamp_from_gst_to_av(TSDEMUX_PTS_DISCONT_THRESHOLD, time_base);
+	if (delta > threshold || delta < -threshold) {
+		// The new segment starts a frame after the latest PTS of the previous one
+		demux->pts_unwrap_value = demux->pts_unwrap_max +
+			convert_timestamp_from_gst_to_av(TSDEMUX_DEFAULT_FRAME_DURATION, time_base);
+
+		GST_INFO("PTS discontinuity of %" G_GINT64_FORMAT " ticks. The timestamps go on from %" G_GINT64_FORMAT,
+			delta, demux->pts_unwrap_value);
+
+		for (int i = 0; i < demux->num_of_all_streams; i++) {
+			if (demux->av_streams[i] != NULL)
+				demux->av_streams[i]->has_discontinuity = TRUE;
+		}
+	}
+	else {
+		demux->pts_unwrap_value += delta;
+	}
+
+	demux->pts_unwrap_last = pts_33bit;
+	demux->pts_unwrap_max = MAX(demux->pts_unwrap_max, demux->pts_unwrap_value);
+
+	return demux->pts_unwrap_value;
+}
+
 static void
 av_streams_parse_metadata_to_taglists(Gstiestsdemux * demux)
 {
@@ -1583,8 +3799,26 @@ av_streams_make_videocaps(enum AVCodecID codec_id, int width, int height, double
 
 
 static GstCaps*
-av_streams_make_audiocaps(enum AVCodecID codec_id, int channels, int sample_rate) {
+av_streams_make_audiocaps(enum AVCodecID codec_id, int channels, int sample_rate, guint16 aac_config, gboolean raw) {
 	GstCaps *caps = NULL;
+	const gchar *profile = "lc";
+
+	// The configuration of the frames wins over the probed one
+	if (aac_config != 0) {
+		guint object_type = aac_config >> 11;
+		guint channel_config = (aac_config >> 3) & 0xf;
+
+		// The channels given in a PCE are left to the probed ones
+		sample_rate = aac_sample_rates[(aac_config >> 7) & 0xf];
+		if (channel_config != 0)
+			channels = channel_config == 7 ? 8 : (gint)channel_config;
+
+		switch (object_type) {
+		case 1:	profile = "main"; break;
+		case 3:	profile = "ssr"; break;
+		case 4:	profile = "ltp"; break;
+		}
+	}
 
 	switch (codec_id) {
 	case AV_CODEC_ID_AAC:
@@ -1603,7 +3837,20 @@ av_streams_make_audiocaps(enum AVCodecID codec_id, int channels, int sample_rate
 
 	if (caps) {
 		gst_caps_set_simple(caps, "mpegversion", G_TYPE_INT, 4,
-			"base-profile", G_TYPE_STRING, "lc", NULL);
+			"base-profile", G_TYPE_STRING, profile,
+			"profile", G_TYPE_STRING, profile,
+			"framed", G_TYPE_BOOLEAN, TRUE,
+			"stream-format", G_TYPE_STRING, raw ? "raw" : "adts", NULL);
+
+		if (raw && aac_config != 0) {
+			GstBuffer *codec_data = gst_buffer_new_and_alloc(2);
+			guint8 asc[2];
+
+			GST_WRITE_UINT16_BE(asc, aac_config);
+			gst_buffer_fill(codec_data, 0, asc, sizeof(asc));
+			gst_caps_set_simple(caps, "codec_data", GST_TYPE_BUFFER, codec_data, NULL);
+			gst_buffer_unref(codec_data);
+		}
 	}
 
 	return caps;
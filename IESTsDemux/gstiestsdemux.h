@@ -3,6 +3,12 @@
 #define __GST_IESTSDEMUX_H__
 
 #include "gstavdemuxer.h"
+#include "gstpacketcache.h"
+#include "gsttsscan.h"
+#include "gsttsinspect.h"
+#include "gstpcrclock.h"
+#include "gsttsfilter.h"
+#include "gsth26xparse.h"
 
 #include <gst/gst.h>
 #include <libavformat/avformat.h>
@@ -29,6 +35,58 @@ G_BEGIN_DECLS
 #define TSDEMUX_SINK_MEDIA_TYPE			"mpegts"
 #define TSDEMUX_TYPEFIND_NAME			"ies_mpegts"
 
+// The IO buffer used by the metadata scan reads many TS packets at once
+#define TSDEMUX_SCAN_IO_BUFFER_SIZE		(188 * 4096)
+
+// A sparse stream gets a GAP event once it lags the other streams by the threshold.
+// The gap stops short of the position by the margin since the TS muxer interleaves the streams loosely.
+#define TSDEMUX_SPARSE_GAP_THRESHOLD	(1 * GST_SECOND)
+#define TSDEMUX_SPARSE_GAP_MARGIN		(500 * GST_MSECOND)
+
+// The live mode probes only the beginning of the input and reads a UDP datagram worth of TS packets at once
+#define TSDEMUX_LIVE_PROBE_SIZE			(188 * 256)
+#define TSDEMUX_LIVE_ANALYZE_DURATION	(100 * 1000)
+#define TSDEMUX_LIVE_IO_BUFFER_SIZE		(188 * 7)
+
+// The video pad is overloaded when downstream reports a higher proportion. The non-reference units are dropped then.
+#define TSDEMUX_QOS_OVERLOAD_PROPORTION	1.2
+
+// Used for the latency when the frame rate is unknown
+#define TSDEMUX_DEFAULT_FRAME_DURATION	(40 * GST_MSECOND)
+
+// The PTS of the TS wraps at 33 bits. A larger jump between the concatenated segments is a discontinuity.
+#define TSDEMUX_PTS_WRAP				(G_GINT64_CONSTANT(1) << 33)
+#define TSDEMUX_PTS_DISCONT_THRESHOLD	(10 * GST_SECOND)
+
+// The ADTS header of an AAC frame. The CRC follows it unless protection_absent is set.
+#define TSDEMUX_ADTS_HEADER_SIZE		7
+#define TSDEMUX_ADTS_CRC_SIZE			2
+
+typedef enum
+{
+	GST_IESTSDEMUX_SCAN_MODE_NORMAL,
+	GST_IESTSDEMUX_SCAN_MODE_METADATA_ONLY
+} GstiestsdemuxScanMode;
+
+typedef enum
+{
+	GST_IESTSDEMUX_TS_PASSTHROUGH_DISABLED,
+	GST_IESTSDEMUX_TS_PASSTHROUGH_ENABLED,
+	GST_IESTSDEMUX_TS_PASSTHROUGH_ONLY
+} GstiestsdemuxTsPassthrough;
+
+typedef enum
+{
+	GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_BYTE_STREAM,
+	GST_IESTSDEMUX_VIDEO_STREAM_FORMAT_PACKETIZED
+} GstiestsdemuxVideoStreamFormat;
+
+typedef enum
+{
+	GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_ADTS,
+	GST_IESTSDEMUX_AUDIO_STREAM_FORMAT_RAW
+} GstiestsdemuxAudioStreamFormat;
+
 typedef enum AVMediaType		   GstMediaType;
 typedef struct _GstAVStream		   GstAVStream;
 typedef struct _Gstiestsdemux      Gstiestsdemux;
@@ -43,8 +101,33 @@ struct _GstAVStream
 
 	gboolean		has_discontinuity;
 
+	// The stream produces buffers only now and then. Its time is advanced by GAP events.
+	gboolean		is_sparse;
+	GstClockTime	ts_gap_pos;
+
 	GstClockTime	ts_last_pos;
 	GstTagList		*tags;
+
+	// QoS reported by downstream. The earliest time is in the running time.
+	gdouble			qos_proportion;
+	GstClockTime	qos_earliest_time;
+	gboolean		qos_waiting_keyframe;
+	guint64			qos_processed;
+	guint64			qos_dropped;
+
+	// The codec found when the stream was opened. A new segment with another one opens the streams again.
+	enum AVCodecID	codec_id;
+	gint			codec_width;
+	gint			codec_height;
+	gint			codec_channels;
+	gint			codec_sample_rate;
+
+	// Splits the H.264 and H.265 access units for the caps, the keyframes and the packetized output
+	GstH26xParser	*h26x_parser;
+
+	// The AudioSpecificConfig in the AAC caps. The raw output carries it in the codec_data.
+	guint16			aac_config;
+	gboolean		aac_raw;
 };
 
 struct _Gstiestsdemux
@@ -87,9 +170,82 @@ struct _Gstiestsdemux
 	gint	active_audio_stream_index;
 	gint	active_metadata_stream_index;
 
+	// The packet read ahead while opening the streams
+	AVPacket	*pending_packet;
+
+	GstiestsdemuxScanMode	scan_mode;
+
+	// Live input. The latency is what the demux adds to the upstream one.
+	gboolean		live;
+	GstClockTime	latency;
+
+	// The clock following the PCR of the selected program
+	GstTsInspector	*ts_inspector;
+	GstPcrClock		*pcr_clock;
+	gboolean		use_pcr_clock;
+
 	gchar	*metadata_id3_prefix_buff;
 	gint	metadata_id3_prefix_size;
 
+	// Loop cache for the segment seeks
+	GstLoopCache	*loop_cache;
+	GList			*loop_cache_cursor;
+	gboolean		is_replaying_loop_cache;
+	guint64			loop_cache_size;
+	guint			loop_cache_ranges;
+
+	// Scrub cache for the short backward seeks
+	GstScrubCache	*scrub_cache;
+	GList			*scrub_cache_cursor;
+	gboolean		is_replaying_scrub_cache;
+	GstClockTime	scrub_cache_duration;
+	guint64			scrub_cache_max_bytes;
+
+	// Parallel scan of the pull mode input
+	guint			scan_threads;
+	gboolean		build_index;
+	GArray			*scan_entries;
+	guint			scan_cursor;
+
+	// The TS packets of the selected PIDs forwarded as they are read
+	GstiestsdemuxTsPassthrough	ts_passthrough;
+	gchar			*ts_pids;
+	guint			ts_batch_packets;
+	GstTsFilter		*ts_filter;
+	GstPad			*ts_srcpad;
+	guint8			*ts_read_buffer;
+
+	// Transport monitoring. The last statistics posted are kept for the ts-stats property.
+	gboolean		ts_monitor;
+	GstClockTime	ts_monitor_interval;
+	GstStructure	*ts_stats;
+
+	// The AES-128-CBC encrypted input. The key is taken from the property or the key file.
+	gchar			*aes_key;
+	gchar			*aes_iv;
+	gchar			*aes_key_file;
+	GstAesDecryptor	*aes_decryptor;
+
+	// The segments concatenated in the push mode go on with the same streams. The boundary is the input offset
+	// where the latest segment starts. The data before it is dropped when the input has been flushed.
+	guint64			concat_boundary;
+	gboolean		concat_pending;
+	gboolean		concat_flushed;
+	gboolean		concat_resync;
+	gboolean		concat_new_segment;
+
+	// The PTS unwrapped over the 33 bits and continued over the discontinuities, in 90 kHz
+	gboolean		pts_unwrap_valid;
+	gint64			pts_unwrap_last;
+	gint64			pts_unwrap_value;
+	gint64			pts_unwrap_max;
+
+	// The H.264 and H.265 output as in the TS or with the lengths and the codec_data of avc and hvc1
+	GstiestsdemuxVideoStreamFormat	video_stream_format;
+
+	// The AAC output with the ADTS headers or without them
+	GstiestsdemuxAudioStreamFormat	audio_stream_format;
+
 	// General properties
 	gboolean silent;
 };
@@ -104,6 +260,7 @@ struct _GstiestsdemuxClass
 	GstPadTemplate *video_src_template;
 	GstPadTemplate *audio_src_template;
 	GstPadTemplate *metadata_src_template;
+	GstPadTemplate *ts_src_template;
 };
 
 GType gst_iestsdemux_get_type(void);
@@ -0,0 +1,1263 @@
+/**
+ * SECTION:element-iestsmultidemux
+ *
+ * Demux the video of several MPEG TS camera feeds and emit their frames in synchronized sets.
+ * Every feed gets its own video pad. The frames of a time slot are pushed as one buffer list per pad
+ * before any frame of the next slot. A feed without a frame in the slot gets a GAP event.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch -v udpsrc port=5000 ! m.sink_0 udpsrc port=5001 ! m.sink_1 iestsmultidemux name=m \
+ *   m.video_0 ! queue ! avdec_h264 ! autovideosink m.video_1 ! queue ! avdec_h264 ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <gst/gst.h>
+#include <stdio.h>
+
+#include "gstiestsmultidemux.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_iestsmultidemux_debug);
+#define GST_CAT_DEFAULT gst_iestsmultidemux_debug
+
+enum
+{
+	PROP_0,
+	PROP_MAX_QUEUE,
+	PROP_MAX_LAG,
+	PROP_SLOT_DURATION
+};
+
+#define DEFAULT_MAX_QUEUE		32
+#define DEFAULT_MAX_LAG			(200 * GST_MSECOND)
+#define DEFAULT_SLOT_DURATION	0
+
+static GstStaticPadTemplate sink_factory =
+GST_STATIC_PAD_TEMPLATE("sink_%u", GST_PAD_SINK, GST_PAD_REQUEST, TSDEMUX_SINK_STATIC_CAPS);
+
+static GstStaticPadTemplate video_src_factory =
+GST_STATIC_PAD_TEMPLATE("video_%u", GST_PAD_SRC, GST_PAD_SOMETIMES,
+	GST_STATIC_CAPS("video/x-h264, stream-format = (string) byte-stream, alignment = (string) au; "
+		"video/x-h265, stream-format = (string) byte-stream, alignment = (string) au"));
+
+#define gst_iestsmultidemux_parent_class parent_class
+G_DEFINE_TYPE(Gstiestsmultidemux, gst_iestsmultidemux, GST_TYPE_ELEMENT);
+
+//-------------------------------------
+// Element Callback Functions
+//-------------------------------------
+static void gst_iestsmultidemux_finalize(GObject * object);
+static void gst_iestsmultidemux_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_iestsmultidemux_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn gst_iestsmultidemux_change_state(GstElement * element, GstStateChange transition);
+static GstPad * gst_iestsmultidemux_request_new_pad(GstElement * element, GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_iestsmultidemux_release_pad(GstElement * element, GstPad * pad);
+
+//-------------------------------------
+// Sink Pad Callback Functions
+//-------------------------------------
+static GstFlowReturn gst_iestsmultidemux_chain(GstPad * pad, GstObject * parent, GstBuffer * buf);
+static gboolean gst_iestsmultidemux_sink_event(GstPad * pad, GstObject * parent, GstEvent * event);
+static gboolean gst_iestsmultidemux_sink_activate(GstPad * sinkpad, GstObject * parent);
+static gboolean gst_iestsmultidemux_sink_activate_mode(GstPad * sinkpad, GstObject * parent, GstPadMode mode, gboolean active);
+
+//-------------------------------------
+// Private Functions
+//-------------------------------------
+static void gst_iestsmultidemux_output(Gstiestsmultidemux * demux);
+static GstClockTime gst_iestsmultidemux_get_arrival(Gstiestsmultidemux * demux);
+static void gst_iestsmultidemux_stop(Gstiestsmultidemux * demux);
+
+static GstMultiDemuxFeed * gst_multidemux_feed_new(Gstiestsmultidemux * demux, guint index);
+static void gst_multidemux_feed_free(GstMultiDemuxFeed * feed);
+static gboolean gst_multidemux_feed_open(GstMultiDemuxFeed * feed);
+static void gst_multidemux_feed_close(GstMultiDemuxFeed * feed);
+static void gst_multidemux_feed_read(GstMultiDemuxFeed * feed);
+static void gst_multidemux_feed_set_eos(GstMultiDemuxFeed * feed);
+static gboolean gst_multidemux_feed_push_event(GstMultiDemuxFeed * feed, GstEvent * event);
+static void gst_multidemux_feed_flush_start(GstMultiDemuxFeed * feed);
+static gboolean gst_multidemux_feed_flush_stop(GstMultiDemuxFeed * feed, GstEvent * event);
+static GstClockTime gst_multidemux_feed_map_pts(GstMultiDemuxFeed * feed, GstClockTime pts);
+static GstCaps * gst_multidemux_feed_make_caps(AVStream * av_stream);
+static void gst_multidemux_feed_observe_io(gpointer user_data, const guint8 * data, gsize size);
+static void gst_multidemux_feed_observe_pcr(guint16 pid, guint64 pcr, gboolean discontinuity, gpointer user_data);
+static void gst_multidemux_feed_set_pcr_ref(GstMultiDemuxFeed * feed, const GstMultiDemuxPcr * first);
+
+/*
+ * Initialize the class
+ */
+static void
+gst_iestsmultidemux_class_init(GstiestsmultidemuxClass * klass)
+{
+	GObjectClass *gobject_class = (GObjectClass *)klass;
+	GstElementClass *gstelement_class = (GstElementClass *)klass;
+
+	GST_DEBUG_CATEGORY_INIT(gst_iestsmultidemux_debug, "IESTsMultiDemux", 1, "IES MPEG TS Multi-input Demuxer");
+
+	gobject_class->finalize = GST_DEBUG_FUNCPTR(gst_iestsmultidemux_finalize);
+	gobject_class->set_property = gst_iestsmultidemux_set_property;
+	gobject_class->get_property = gst_iestsmultidemux_get_property;
+
+	gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_iestsmultidemux_change_state);
+	gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_iestsmultidemux_request_new_pad);
+	gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_iestsmultidemux_release_pad);
+
+	g_object_class_install_property(gobject_class, PROP_MAX_QUEUE,
+		g_param_spec_uint("max-queue", "Max queue",
+			"Maximum number of frames queued per feed. A full queue blocks the feed.",
+			1, G_MAXUINT, DEFAULT_MAX_QUEUE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_MAX_LAG,
+		g_param_spec_uint64("max-lag", "Max lag",
+			"How far the leading feed may get ahead before the slots are emitted without the lagging feeds",
+			0, G_MAXUINT64, DEFAULT_MAX_LAG, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_SLOT_DURATION,
+		g_param_spec_uint64("slot-duration", "Slot duration",
+			"Duration of the time slot emitted as a set (0 = the frame duration of the first feed)",
+			0, G_MAXUINT64, DEFAULT_SLOT_DURATION, G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	gst_element_class_set_metadata(gstelement_class,
+		"MPEG transport stream multi-input demuxer", "Demuxer",
+		"Demux the video of several MPEG2 transport streams in lockstep", "Intel Sports <<UNKNOWN-TODO@intel.com>>");
+
+	gst_element_class_add_static_pad_template(gstelement_class, &sink_factory);
+	gst_element_class_add_static_pad_template(gstelement_class, &video_src_factory);
+}
+
+/*
+ * Initialize the new element
+ */
+static void
+gst_iestsmultidemux_init(Gstiestsmultidemux * demux)
+{
+	demux->feeds = g_ptr_array_new();
+	demux->next_feed_index = 0;
+	demux->group_id = G_MAXUINT;
+
+	g_mutex_init(&demux->lock);
+	g_cond_init(&demux->cond);
+	demux->is_flushing = TRUE;
+
+	demux->output_task = gst_task_new((GstTaskFunction)gst_iestsmultidemux_output, demux, NULL);
+	g_rec_mutex_init(&demux->output_task_lock);
+	gst_task_set_lock(demux->output_task, &demux->output_task_lock);
+	demux->flow_combiner = gst_flow_combiner_new();
+
+	demux->next_slot = GST_CLOCK_TIME_NONE;
+	demux->active_slot_duration = 0;
+	demux->epoch = GST_CLOCK_TIME_NONE;
+
+	demux->max_queue = DEFAULT_MAX_QUEUE;
+	demux->max_lag = DEFAULT_MAX_LAG;
+	demux->slot_duration = DEFAULT_SLOT_DURATION;
+}
+
+/*
+ * Finalize the element
+ */
+static void
+gst_iestsmultidemux_finalize(GObject * object)
+{
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(object);
+
+	for (guint i = 0; i < demux->feeds->len; i++)
+		gst_multidemux_feed_free(g_ptr_array_index(demux->feeds, i));
+	g_ptr_array_free(demux->feeds, TRUE);
+
+	gst_flow_combiner_free(demux->flow_combiner);
+	gst_object_unref(demux->output_task);
+	g_rec_mutex_clear(&demux->output_task_lock);
+
+	g_mutex_clear(&demux->lock);
+	g_cond_clear(&demux->cond);
+
+	G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+/*
+ * Set properties for the element
+ */
+static void
+gst_iestsmultidemux_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(object);
+
+	switch (prop_id) {
+	case PROP_MAX_QUEUE:
+		GST_OBJECT_LOCK(demux);
+		demux->max_queue = g_value_get_uint(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_MAX_LAG:
+		GST_OBJECT_LOCK(demux);
+		demux->max_lag = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SLOT_DURATION:
+		GST_OBJECT_LOCK(demux);
+		demux->slot_duration = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+/*
+ * Get properties for the element
+ */
+static void
+gst_iestsmultidemux_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(object);
+
+	switch (prop_id) {
+	case PROP_MAX_QUEUE:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint(value, demux->max_queue);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_MAX_LAG:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->max_lag);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	case PROP_SLOT_DURATION:
+		GST_OBJECT_LOCK(demux);
+		g_value_set_uint64(value, demux->slot_duration);
+		GST_OBJECT_UNLOCK(demux);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
+
+/*
+ * Change the state. The output task runs while the element is in PAUSED or PLAYING.
+ */
+static GstStateChangeReturn
+gst_iestsmultidemux_change_state(GstElement * element, GstStateChange transition)
+{
+	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(element);
+
+	switch (transition) {
+	case GST_STATE_CHANGE_READY_TO_PAUSED:
+		g_mutex_lock(&demux->lock);
+		demux->is_flushing = FALSE;
+		demux->next_slot = GST_CLOCK_TIME_NONE;
+		demux->epoch = GST_CLOCK_TIME_NONE;
+		demux->group_id = gst_util_group_id_next();
+		GST_OBJECT_LOCK(demux);
+		demux->active_slot_duration = demux->slot_duration;
+		GST_OBJECT_UNLOCK(demux);
+		g_mutex_unlock(&demux->lock);
+
+		gst_flow_combiner_reset(demux->flow_combiner);
+		gst_task_start(demux->output_task);
+		break;
+
+	case GST_STATE_CHANGE_PAUSED_TO_READY:
+		// Wake up the tasks before the pads are deactivated
+		g_mutex_lock(&demux->lock);
+		demux->is_flushing = TRUE;
+		g_cond_broadcast(&demux->cond);
+		g_mutex_unlock(&demux->lock);
+		break;
+
+	default:
+		break;
+	}
+
+	ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition) {
+	case GST_STATE_CHANGE_PAUSED_TO_READY:
+		gst_iestsmultidemux_stop(demux);
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+/*
+ * Add a new feed with its sink pad
+ */
+static GstPad *
+gst_iestsmultidemux_request_new_pad(GstElement * element, GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(element);
+	GstMultiDemuxFeed *feed;
+	gchar *padname;
+	guint index;
+
+	g_mutex_lock(&demux->lock);
+	if (name == NULL || sscanf(name, "sink_%u", &index) != 1)
+		index = demux->next_feed_index;
+	demux->next_feed_index = MAX(demux->next_feed_index, index + 1);
+	g_mutex_unlock(&demux->lock);
+
+	feed = gst_multidemux_feed_new(demux, index);
+
+	padname = g_strdup_printf("sink_%u", index);
+	feed->sinkpad = gst_pad_new_from_template(templ, padname);
+	g_free(padname);
+
+	gst_pad_set_chain_function(feed->sinkpad, GST_DEBUG_FUNCPTR(gst_iestsmultidemux_chain));
+	gst_pad_set_event_function(feed->sinkpad, GST_DEBUG_FUNCPTR(gst_iestsmultidemux_sink_event));
+	gst_pad_set_activate_function(feed->sinkpad, GST_DEBUG_FUNCPTR(gst_iestsmultidemux_sink_activate));
+	gst_pad_set_activatemode_function(feed->sinkpad, GST_DEBUG_FUNCPTR(gst_iestsmultidemux_sink_activate_mode));
+	gst_pad_set_element_private(feed->sinkpad, feed);
+
+	feed->buffio_info = alloc_bufferedio_info(feed->sinkpad);
+	feed->buffio_info->io_observer = gst_multidemux_feed_observe_io;
+	feed->buffio_info->io_observer_data = feed;
+
+	g_mutex_lock(&demux->lock);
+	g_ptr_array_add(demux->feeds, feed);
+	g_mutex_unlock(&demux->lock);
+
+	if (GST_STATE(demux) > GST_STATE_READY)
+		gst_pad_set_active(feed->sinkpad, TRUE);
+
+	gst_element_add_pad(element, feed->sinkpad);
+
+	GST_INFO_OBJECT(demux, "Added the feed %u", index);
+
+	return feed->sinkpad;
+}
+
+/*
+ * Remove the feed of the sink pad
+ */
+static void
+gst_iestsmultidemux_release_pad(GstElement * element, GstPad * pad)
+{
+	Gstiestsmultidemux *demux = GST_IESTSMULTIDEMUX(element);
+	GstMultiDemuxFeed *feed = gst_pad_get_element_private(pad);
+
+	g_return_if_fail(feed != NULL);
+
+	g_mutex_lock(&demux->lock);
+	g_ptr_array_remove(demux->feeds, feed);
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	// Stop the reader task
+	gst_pad_set_active(pad, FALSE);
+	gst_element_remove_pad(element, pad);
+
+	if (feed->srcpad != NULL) {
+		g_mutex_lock(&demux->lock);
+		gst_flow_combiner_remove_pad(demux->flow_combiner, feed->srcpad);
+		g_mutex_unlock(&demux->lock);
+
+		gst_element_remove_pad(element, feed->srcpad);
+	}
+
+	GST_INFO_OBJECT(demux, "Released the feed %u", feed->index);
+
+	gst_multidemux_feed_free(feed);
+}
+
+/*
+ * Transfer the data to the adapter of the feed. It is read by libav in the reader task.
+ */
+static GstFlowReturn
+gst_iestsmultidemux_chain(GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+	GstMultiDemuxFeed *feed = gst_pad_get_element_private(pad);
+	GstBufferedIOInfo *buffio_info = feed->buffio_info;
+	gboolean is_flushing;
+
+	g_mutex_lock(&feed->demux->lock);
+	is_flushing = feed->is_flushing;
+	g_mutex_unlock(&feed->demux->lock);
+
+	if (is_flushing) {
+		gst_buffer_unref(buf);
+		return GST_FLOW_FLUSHING;
+	}
+
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+
+	gst_adapter_push(buffio_info->gst_adapter, buf);
+
+	// Notify that the adapter has enough data to be processed
+	while (gst_adapter_available(buffio_info->gst_adapter) >= buffio_info->io_read_needed &&
+		!buffio_info->is_eos) {
+		g_cond_signal(&buffio_info->io_sync_cond);
+		g_cond_wait(&buffio_info->io_sync_cond, &buffio_info->io_sync_mutex);
+	}
+
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	return GST_FLOW_OK;
+}
+
+/*
+ * Handle the events in the sink pads. The output pads get their own stream-start, caps and segment.
+ * The other events, the flushes included, only go to the video pad of the same feed.
+ */
+static gboolean
+gst_iestsmultidemux_sink_event(GstPad * pad, GstObject * parent, GstEvent * event)
+{
+	GstMultiDemuxFeed *feed = gst_pad_get_element_private(pad);
+	GstBufferedIOInfo *buffio_info = feed->buffio_info;
+	gboolean ret_val = TRUE;
+
+	GST_DEBUG_OBJECT(pad, "Received %s event: %" GST_PTR_FORMAT, GST_EVENT_TYPE_NAME(event), event);
+
+	switch (GST_EVENT_TYPE(event)) {
+	case GST_EVENT_STREAM_START:
+	case GST_EVENT_CAPS:
+	case GST_EVENT_SEGMENT:
+		gst_event_unref(event);
+		break;
+
+	case GST_EVENT_FLUSH_START:
+		gst_multidemux_feed_flush_start(feed);
+		ret_val = gst_multidemux_feed_push_event(feed, event);
+		break;
+
+	case GST_EVENT_FLUSH_STOP:
+		ret_val = gst_multidemux_feed_flush_stop(feed, event);
+		break;
+
+	case GST_EVENT_EOS:
+		// libav reads the rest of the adapter and finishes
+		g_mutex_lock(&buffio_info->io_sync_mutex);
+		buffio_info->is_eos = TRUE;
+		g_cond_signal(&buffio_info->io_sync_cond);
+		g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+		gst_event_unref(event);
+		break;
+
+	default:
+		ret_val = gst_multidemux_feed_push_event(feed, event);
+		break;
+	}
+
+	return ret_val;
+}
+
+/*
+ * The feeds are always pushed
+ */
+static gboolean
+gst_iestsmultidemux_sink_activate(GstPad * sinkpad, GstObject * parent)
+{
+	return gst_pad_activate_mode(sinkpad, GST_PAD_MODE_PUSH, TRUE);
+}
+
+/*
+ * Start or stop the reader task of the feed
+ */
+static gboolean
+gst_iestsmultidemux_sink_activate_mode(GstPad * sinkpad, GstObject * parent, GstPadMode mode, gboolean active)
+{
+	GstMultiDemuxFeed *feed = gst_pad_get_element_private(sinkpad);
+	Gstiestsmultidemux *demux = feed->demux;
+	GstBufferedIOInfo *buffio_info = feed->buffio_info;
+
+	if (mode != GST_PAD_MODE_PUSH)
+		return FALSE;
+
+	if (active) {
+		buffio_info->is_eos = FALSE;
+		buffio_info->is_pullmode = FALSE;
+
+		g_mutex_lock(&demux->lock);
+		feed->is_active = TRUE;
+		feed->is_eos = FALSE;
+		feed->is_flushing = FALSE;
+		g_mutex_unlock(&demux->lock);
+
+		return gst_task_start(feed->reader_task);
+	}
+
+	// Unblock the reader waiting for the data or for the room in the queue
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	buffio_info->is_eos = TRUE;
+	g_cond_broadcast(&buffio_info->io_sync_cond);
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	g_mutex_lock(&demux->lock);
+	feed->is_active = FALSE;
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	gst_task_stop(feed->reader_task);
+	return gst_task_join(feed->reader_task);
+}
+
+/*
+ * Emit the frames of the next slot. It waits until every feed has passed the slot,
+ * the leading feed is ahead by the maximum lag or a queue is full.
+ */
+static void
+gst_iestsmultidemux_output(Gstiestsmultidemux * demux)
+{
+	GPtrArray *srcpads = NULL;
+	GPtrArray *lists = NULL;
+	GstClockTime slot_start, slot_end = GST_CLOCK_TIME_NONE;
+	GstClockTime first_slot = GST_CLOCK_TIME_NONE;
+	GstClockTime max_lag;
+	guint max_queue;
+	gboolean is_eos = FALSE;
+	GstFlowReturn ret = GST_FLOW_OK;
+
+	GST_OBJECT_LOCK(demux);
+	max_lag = demux->max_lag;
+	max_queue = demux->max_queue;
+	GST_OBJECT_UNLOCK(demux);
+
+	g_mutex_lock(&demux->lock);
+
+	while (!demux->is_flushing) {
+		GstClockTime leading = 0;
+		gboolean is_complete = TRUE;
+		gboolean is_full = FALSE;
+		gboolean is_all_eos = demux->feeds->len > 0;
+
+		// The first slot starts at the earliest frame
+		for (guint i = 0; i < demux->feeds->len && !GST_CLOCK_TIME_IS_VALID(demux->next_slot); i++) {
+			GstMultiDemuxFeed *feed = g_ptr_array_index(demux->feeds, i);
+			GstBuffer *head = g_queue_peek_head(&feed->frames);
+
+			if (head != NULL && (!GST_CLOCK_TIME_IS_VALID(first_slot) || GST_BUFFER_PTS(head) < first_slot))
+				first_slot = GST_BUFFER_PTS(head);
+		}
+
+		if (!GST_CLOCK_TIME_IS_VALID(demux->next_slot))
+			demux->next_slot = first_slot;
+
+		if (GST_CLOCK_TIME_IS_VALID(demux->next_slot))
+			slot_end = demux->next_slot + demux->active_slot_duration;
+
+		for (guint i = 0; i < demux->feeds->len; i++) {
+			GstMultiDemuxFeed *feed = g_ptr_array_index(demux->feeds, i);
+			GstBuffer *tail = g_queue_peek_tail(&feed->frames);
+
+			if (!feed->is_eos || !g_queue_is_empty(&feed->frames))
+				is_all_eos = FALSE;
+
+			if (tail != NULL)
+				leading = MAX(leading, GST_BUFFER_PTS(tail));
+
+			if (g_queue_get_length(&feed->frames) >= max_queue)
+				is_full = TRUE;
+
+			if (!feed->is_eos && (tail == NULL || !GST_CLOCK_TIME_IS_VALID(slot_end) || GST_BUFFER_PTS(tail) < slot_end))
+				is_complete = FALSE;
+		}
+
+		if (is_all_eos) {
+			is_eos = TRUE;
+			break;
+		}
+
+		if (GST_CLOCK_TIME_IS_VALID(slot_end) &&
+			(is_complete || is_full || leading >= slot_end + max_lag))
+			break;
+
+		g_cond_wait(&demux->cond, &demux->lock);
+		slot_end = GST_CLOCK_TIME_NONE;
+	}
+
+	if (demux->is_flushing) {
+		g_mutex_unlock(&demux->lock);
+		gst_task_pause(demux->output_task);
+		return;
+	}
+
+	// Take the frames of the slot. The pads are referenced so they are pushed outside the lock.
+	slot_start = demux->next_slot;
+	srcpads = g_ptr_array_new_with_free_func(gst_object_unref);
+	lists = g_ptr_array_new();
+
+	for (guint i = 0; i < demux->feeds->len; i++) {
+		GstMultiDemuxFeed *feed = g_ptr_array_index(demux->feeds, i);
+		GstBufferList *list;
+		GstBuffer *buffer;
+
+		if (feed->srcpad == NULL)
+			continue;
+
+		list = gst_buffer_list_new();
+		while (!is_eos && (buffer = g_queue_peek_head(&feed->frames)) != NULL && GST_BUFFER_PTS(buffer) < slot_end) {
+			g_queue_pop_head(&feed->frames);
+
+			// The frame arrived after its slot had been emitted
+			if (GST_BUFFER_PTS(buffer) < slot_start) {
+				feed->late_frames++;
+				gst_buffer_unref(buffer);
+				continue;
+			}
+
+			gst_buffer_list_add(list, buffer);
+		}
+
+		if (!is_eos && gst_buffer_list_length(list) == 0 && !feed->is_eos) {
+			feed->lagged_slots++;
+			GST_LOG_OBJECT(feed->srcpad, "Lagging at %" GST_TIME_FORMAT " (%" G_GUINT64_FORMAT " slots)",
+				GST_TIME_ARGS(slot_start), feed->lagged_slots);
+		}
+
+		g_ptr_array_add(srcpads, gst_object_ref(feed->srcpad));
+		g_ptr_array_add(lists, list);
+	}
+
+	if (!is_eos)
+		demux->next_slot = slot_end;
+
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	// Push the set of the slot. The feeds without a frame get a gap.
+	for (guint i = 0; i < srcpads->len; i++) {
+		GstPad *srcpad = g_ptr_array_index(srcpads, i);
+		GstBufferList *list = g_ptr_array_index(lists, i);
+		GstFlowReturn result;
+
+		if (is_eos) {
+			gst_buffer_list_unref(list);
+			gst_pad_push_event(srcpad, gst_event_new_eos());
+			continue;
+		}
+
+		if (gst_buffer_list_length(list) == 0) {
+			gst_buffer_list_unref(list);
+			gst_pad_push_event(srcpad, gst_event_new_gap(slot_start, slot_end - slot_start));
+			continue;
+		}
+
+		result = gst_pad_push_list(srcpad, list);
+
+		g_mutex_lock(&demux->lock);
+		ret = gst_flow_combiner_update_pad_flow(demux->flow_combiner, srcpad, result);
+		g_mutex_unlock(&demux->lock);
+	}
+
+	g_ptr_array_free(srcpads, TRUE);
+	g_ptr_array_free(lists, TRUE);
+
+	if (is_eos) {
+		GST_INFO_OBJECT(demux, "Every feed reaches the end.");
+		gst_task_pause(demux->output_task);
+	}
+	else if (ret != GST_FLOW_OK) {
+		GST_WARNING_OBJECT(demux, "Pausing the output: %s", gst_flow_get_name(ret));
+		if (ret == GST_FLOW_NOT_NEGOTIATED || ret < GST_FLOW_EOS)
+			GST_ELEMENT_FLOW_ERROR(demux, ret);
+		gst_task_pause(demux->output_task);
+	}
+}
+
+/*
+ * The arrival time on the timeline shared by the feeds
+ */
+static GstClockTime
+gst_iestsmultidemux_get_arrival(Gstiestsmultidemux * demux)
+{
+	GstClockTime now = g_get_monotonic_time() * GST_USECOND;
+	GstClockTime arrival;
+
+	g_mutex_lock(&demux->lock);
+	if (!GST_CLOCK_TIME_IS_VALID(demux->epoch))
+		demux->epoch = now;
+	arrival = now - demux->epoch;
+	g_mutex_unlock(&demux->lock);
+
+	return arrival;
+}
+
+/*
+ * Stop the output and close every feed. The reader tasks have been stopped with the sink pads.
+ */
+static void
+gst_iestsmultidemux_stop(Gstiestsmultidemux * demux)
+{
+	gst_task_stop(demux->output_task);
+	gst_task_join(demux->output_task);
+
+	for (guint i = 0; i < demux->feeds->len; i++) {
+		GstMultiDemuxFeed *feed = g_ptr_array_index(demux->feeds, i);
+
+		if (feed->srcpad != NULL) {
+			gst_flow_combiner_remove_pad(demux->flow_combiner, feed->srcpad);
+			gst_element_remove_pad(GST_ELEMENT(demux), feed->srcpad);
+			feed->srcpad = NULL;
+		}
+
+		gst_multidemux_feed_close(feed);
+	}
+}
+
+/*
+ * Allocate a new feed
+ */
+static GstMultiDemuxFeed *
+gst_multidemux_feed_new(Gstiestsmultidemux * demux, guint index)
+{
+	GstMultiDemuxFeed *feed = g_new0(GstMultiDemuxFeed, 1);
+
+	feed->demux = demux;
+	feed->index = index;
+
+	feed->sinkpad = NULL;
+	feed->srcpad = NULL;
+	feed->buffio_info = NULL;
+	feed->av_format_context = NULL;
+	feed->video_stream_index = -1;
+
+	feed->reader_task = gst_task_new((GstTaskFunction)gst_multidemux_feed_read, feed, NULL);
+	g_rec_mutex_init(&feed->reader_task_lock);
+	gst_task_set_lock(feed->reader_task, &feed->reader_task_lock);
+	feed->is_active = FALSE;
+
+	feed->ts_inspector = gst_ts_inspector_new();
+	feed->first_pcrs = g_array_new(FALSE, FALSE, sizeof(GstMultiDemuxPcr));
+	feed->pcr_ref = GST_CLOCK_TIME_NONE;
+	feed->arrival_ref = GST_CLOCK_TIME_NONE;
+	feed->pts_ref = GST_CLOCK_TIME_NONE;
+
+	g_queue_init(&feed->frames);
+	feed->is_eos = FALSE;
+	feed->is_flushing = FALSE;
+
+	return feed;
+}
+
+/*
+ * De-allocate the feed. Its reader task has been stopped.
+ */
+static void
+gst_multidemux_feed_free(GstMultiDemuxFeed * feed)
+{
+	gst_multidemux_feed_close(feed);
+
+	gst_object_unref(feed->reader_task);
+	g_rec_mutex_clear(&feed->reader_task_lock);
+
+	if (feed->buffio_info != NULL)
+		free_bufferedio_info(feed->buffio_info);
+
+	gst_ts_inspector_free(feed->ts_inspector);
+	g_array_free(feed->first_pcrs, TRUE);
+
+	g_free(feed);
+}
+
+/*
+ * Open the feed through libav and add its video pad. The pad is kept when the feed is opened again after a flush.
+ */
+static gboolean
+gst_multidemux_feed_open(GstMultiDemuxFeed * feed)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+	AVFormatContext *fmt_ctx = NULL;
+	AVStream *av_stream = NULL;
+	GstCaps *caps = NULL;
+	GstPad *srcpad;
+	GstEvent *event;
+	GstSegment segment;
+	gchar *name, *stream_id;
+	gchar err_msg[512];
+	gint av_error = 0;
+	gint pcr_pid = -1;
+	gboolean is_stopping;
+
+	// libav probes well into the stream before the program is known. The PCR is watched on every PID from the first byte.
+	g_array_set_size(feed->first_pcrs, 0);
+	gst_ts_inspector_set_pcr_func(feed->ts_inspector, TS_INSPECT_ANY_PID, gst_multidemux_feed_observe_pcr, feed);
+
+	av_error = av_bufferedio_open(feed->buffio_info);
+	if (av_error < 0)
+		goto ex_averror;
+
+	feed->av_format_context = avformat_alloc_context();
+	feed->av_format_context->pb = feed->buffio_info->io_context;
+	feed->av_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+	av_error = avformat_open_input(&feed->av_format_context, NULL, av_get_input_format(TSDEMUX_SINK_MEDIA_TYPE), NULL);
+	if (av_error < 0)
+		goto ex_averror;
+
+	fmt_ctx = feed->av_format_context;
+
+	av_error = avformat_find_stream_info(fmt_ctx, NULL);
+	if (av_error < 0)
+		goto ex_averror;
+
+	av_error = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0);
+	if (av_error < 0)
+		goto ex_averror;
+
+	feed->video_stream_index = av_error;
+	av_stream = fmt_ctx->streams[feed->video_stream_index];
+
+	// Only the video is demuxed
+	for (unsigned int i = 0; i < fmt_ctx->nb_streams; i++) {
+		if ((gint)i != feed->video_stream_index)
+			fmt_ctx->streams[i]->discard = AVDISCARD_ALL;
+	}
+
+	caps = gst_multidemux_feed_make_caps(av_stream);
+	if (caps == NULL) {
+		GST_ELEMENT_WARNING(demux, STREAM, CODEC_NOT_FOUND, ("The video of the feed %u is not supported.", feed->index),
+			("The video codec (%d) is not supported.", av_stream->codecpar->codec_id));
+		return FALSE;
+	}
+
+	// The PCR of the program carrying the video aligns the feed to the others. It may have been seen while probing.
+	for (unsigned int i = 0; i < fmt_ctx->nb_programs && pcr_pid < 0; i++) {
+		for (unsigned int j = 0; j < fmt_ctx->programs[i]->nb_stream_indexes; j++) {
+			if (fmt_ctx->programs[i]->stream_index[j] == (unsigned int)feed->video_stream_index) {
+				pcr_pid = fmt_ctx->programs[i]->pcr_pid;
+				break;
+			}
+		}
+	}
+
+	for (guint i = 0; i < feed->first_pcrs->len; i++) {
+		GstMultiDemuxPcr *first = &g_array_index(feed->first_pcrs, GstMultiDemuxPcr, i);
+
+		if (first->pid == pcr_pid) {
+			gst_multidemux_feed_set_pcr_ref(feed, first);
+			break;
+		}
+	}
+
+	g_array_set_size(feed->first_pcrs, 0);
+	gst_ts_inspector_set_pcr_func(feed->ts_inspector, pcr_pid, gst_multidemux_feed_observe_pcr, feed);
+
+	// The pad kept over a flush only takes the caps. The stream may have changed.
+	if (feed->srcpad != NULL) {
+		GST_INFO_OBJECT(feed->srcpad, "reopened with caps %" GST_PTR_FORMAT, caps);
+		gst_pad_set_caps(feed->srcpad, caps);
+		gst_caps_unref(caps);
+		return TRUE;
+	}
+
+	// Create the video pad of the feed
+	name = g_strdup_printf("video_%u", feed->index);
+	srcpad = gst_pad_new_from_static_template(&video_src_factory, name);
+	g_free(name);
+
+	gst_pad_use_fixed_caps(srcpad);
+	gst_pad_set_element_private(srcpad, feed);
+	gst_pad_set_active(srcpad, TRUE);
+
+	stream_id = gst_pad_create_stream_id_printf(srcpad, GST_ELEMENT_CAST(demux), "%03u", feed->index);
+	event = gst_event_new_stream_start(stream_id);
+	gst_event_set_group_id(event, demux->group_id);
+	gst_pad_push_event(srcpad, event);
+	g_free(stream_id);
+
+	GST_INFO_OBJECT(srcpad, "adding pad with caps %" GST_PTR_FORMAT, caps);
+	gst_pad_set_caps(srcpad, caps);
+	gst_caps_unref(caps);
+
+	// Every feed is on the common timeline
+	gst_segment_init(&segment, GST_FORMAT_TIME);
+	gst_pad_push_event(srcpad, gst_event_new_segment(&segment));
+
+	gst_element_add_pad(GST_ELEMENT(demux), srcpad);
+
+	g_mutex_lock(&demux->lock);
+	feed->srcpad = srcpad;
+	gst_flow_combiner_add_pad(demux->flow_combiner, feed->srcpad);
+
+	// The first feed sets the slot duration
+	if (demux->active_slot_duration == 0) {
+		AVRational frame_rate = av_stream->avg_frame_rate;
+
+		if (frame_rate.num > 0 && frame_rate.den > 0)
+			demux->active_slot_duration = gst_util_uint64_scale_int(GST_SECOND, frame_rate.den, frame_rate.num);
+		else
+			demux->active_slot_duration = TSDEMUX_DEFAULT_FRAME_DURATION;
+
+		GST_INFO_OBJECT(demux, "Slot duration: %" GST_TIME_FORMAT, GST_TIME_ARGS(demux->active_slot_duration));
+	}
+	g_mutex_unlock(&demux->lock);
+
+	return TRUE;
+
+ex_averror:
+	GST_PRINT_AVERROR(av_error);
+
+	// The reads are cut short when the feed is flushed or stopped. That is not a failure of the feed.
+	g_mutex_lock(&demux->lock);
+	is_stopping = feed->is_flushing || !feed->is_active || demux->is_flushing;
+	g_mutex_unlock(&demux->lock);
+
+	if (!is_stopping) {
+		av_strerror(av_error, err_msg, sizeof(err_msg));
+		GST_ELEMENT_WARNING(demux, STREAM, DEMUX, ("Failed to open the feed %u.", feed->index),
+			("libav: %s", err_msg));
+	}
+
+	return FALSE;
+}
+
+/*
+ * Close libav and drop the queued frames
+ */
+static void
+gst_multidemux_feed_close(GstMultiDemuxFeed * feed)
+{
+	GstBuffer *buffer;
+
+	if (feed->av_format_context != NULL)
+		avformat_close_input(&feed->av_format_context);
+
+	if (feed->buffio_info != NULL && feed->buffio_info->io_context != NULL) {
+		av_bufferedio_close(feed->buffio_info->io_context);
+		feed->buffio_info->io_context = NULL;
+		gst_adapter_clear(feed->buffio_info->gst_adapter);
+	}
+
+	g_mutex_lock(&feed->demux->lock);
+	while ((buffer = g_queue_pop_head(&feed->frames)) != NULL)
+		gst_buffer_unref(buffer);
+	g_mutex_unlock(&feed->demux->lock);
+
+	feed->video_stream_index = -1;
+	feed->pcr_ref = GST_CLOCK_TIME_NONE;
+	feed->arrival_ref = GST_CLOCK_TIME_NONE;
+	feed->pts_ref = GST_CLOCK_TIME_NONE;
+	g_array_set_size(feed->first_pcrs, 0);
+	gst_ts_inspector_set_pcr_func(feed->ts_inspector, -1, NULL, NULL);
+	gst_ts_inspector_reset(feed->ts_inspector);
+}
+
+/*
+ * Demux a frame of the feed and queue it for its slot
+ * This function will be called periodically by the reader task of the feed
+ */
+static void
+gst_multidemux_feed_read(GstMultiDemuxFeed * feed)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+	AVPacket *packet = NULL;
+	AVStream *av_stream;
+	GstBuffer *buffer;
+	GstClockTime pts, duration;
+	guint max_queue;
+	gint av_error = 0;
+
+	if (feed->av_format_context == NULL && !gst_multidemux_feed_open(feed))
+		goto ex_eos;
+
+	packet = av_packet_alloc();
+	if (packet == NULL)
+		goto ex_eos;
+
+	av_error = av_read_frame(feed->av_format_context, packet);
+	if (av_error < 0) {
+		if (av_error != (int)AVERROR_EOF)
+			GST_PRINT_AVERROR(av_error);
+		goto ex_eos;
+	}
+
+	if (packet->stream_index != feed->video_stream_index)
+		goto fn_done;
+
+	// The frame without a timestamp can not be placed in a slot
+	av_stream = feed->av_format_context->streams[packet->stream_index];
+	pts = convert_timestamp_from_av_to_gst(packet->pts, av_stream->time_base);
+	if (!GST_CLOCK_TIME_IS_VALID(pts))
+		goto fn_done;
+
+	duration = convert_timestamp_from_av_to_gst(packet->duration, av_stream->time_base);
+
+	buffer = gst_buffer_new_and_alloc(packet->size);
+	gst_buffer_fill(buffer, 0, packet->data, packet->size);
+
+	GST_BUFFER_PTS(buffer) = gst_multidemux_feed_map_pts(feed, pts);
+	GST_BUFFER_DURATION(buffer) = duration > 0 ? duration : GST_CLOCK_TIME_NONE;
+	if (!(packet->flags & AV_PKT_FLAG_KEY))
+		GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+
+	GST_OBJECT_LOCK(demux);
+	max_queue = demux->max_queue;
+	GST_OBJECT_UNLOCK(demux);
+
+	// Wait for the room in the queue. The memory stays bounded when another feed lags.
+	g_mutex_lock(&demux->lock);
+	while (g_queue_get_length(&feed->frames) >= max_queue && feed->is_active && !feed->is_flushing && !demux->is_flushing)
+		g_cond_wait(&demux->cond, &demux->lock);
+
+	if (!feed->is_active || feed->is_flushing || demux->is_flushing) {
+		g_mutex_unlock(&demux->lock);
+		gst_buffer_unref(buffer);
+		gst_task_pause(feed->reader_task);
+		goto fn_done;
+	}
+
+	g_queue_push_tail(&feed->frames, buffer);
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	goto fn_done;
+
+ex_eos:
+	GST_DEBUG_OBJECT(feed->sinkpad, "The feed reaches the end.");
+	gst_multidemux_feed_set_eos(feed);
+	gst_task_pause(feed->reader_task);
+
+fn_done:
+	if (packet != NULL)
+		av_packet_free(&packet);
+}
+
+/*
+ * Mark the feed finished so the slots do not wait for it. The flushed feed starts over instead.
+ */
+static void
+gst_multidemux_feed_set_eos(GstMultiDemuxFeed * feed)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+
+	g_mutex_lock(&demux->lock);
+	if (!feed->is_flushing)
+		feed->is_eos = TRUE;
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+}
+
+/*
+ * Push the event on the video pad of the feed. It is dropped while the feed has no pad yet.
+ */
+static gboolean
+gst_multidemux_feed_push_event(GstMultiDemuxFeed * feed, GstEvent * event)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+	GstPad *srcpad = NULL;
+	gboolean ret_val = TRUE;
+
+	g_mutex_lock(&demux->lock);
+	if (feed->srcpad != NULL)
+		srcpad = gst_object_ref(feed->srcpad);
+	g_mutex_unlock(&demux->lock);
+
+	if (srcpad == NULL) {
+		gst_event_unref(event);
+		return TRUE;
+	}
+
+	ret_val = gst_pad_push_event(srcpad, event);
+	gst_object_unref(srcpad);
+
+	return ret_val;
+}
+
+/*
+ * Unblock the chain function and the reader task of the feed. The other feeds go on.
+ */
+static void
+gst_multidemux_feed_flush_start(GstMultiDemuxFeed * feed)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+	GstBufferedIOInfo *buffio_info = feed->buffio_info;
+
+	g_mutex_lock(&demux->lock);
+	feed->is_flushing = TRUE;
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	// libav gets to the end of the data and returns
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	buffio_info->is_eos = TRUE;
+	g_cond_broadcast(&buffio_info->io_sync_cond);
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+}
+
+/*
+ * Start the feed over. libav is opened again on the data after the flush and the video pad is kept.
+ */
+static gboolean
+gst_multidemux_feed_flush_stop(GstMultiDemuxFeed * feed, GstEvent * event)
+{
+	Gstiestsmultidemux *demux = feed->demux;
+	GstBufferedIOInfo *buffio_info = feed->buffio_info;
+	GstSegment segment;
+	gboolean is_active, is_running;
+	gboolean ret_val;
+
+	// The reader task is unblocked again in case the flush start did not come first
+	gst_multidemux_feed_flush_start(feed);
+	gst_task_stop(feed->reader_task);
+	gst_task_join(feed->reader_task);
+
+	gst_multidemux_feed_close(feed);
+
+	g_mutex_lock(&buffio_info->io_sync_mutex);
+	gst_adapter_clear(buffio_info->gst_adapter);
+	buffio_info->io_read_needed = 0;
+	buffio_info->is_eos = FALSE;
+	g_mutex_unlock(&buffio_info->io_sync_mutex);
+
+	g_mutex_lock(&demux->lock);
+	feed->is_flushing = FALSE;
+	feed->is_eos = FALSE;
+	is_active = feed->is_active;
+	is_running = !demux->is_flushing;
+
+	// The pad of the feed returned flushing to the output task. It is not an error anymore.
+	if (feed->srcpad != NULL)
+		gst_flow_combiner_update_pad_flow(demux->flow_combiner, feed->srcpad, GST_FLOW_OK);
+	g_cond_broadcast(&demux->cond);
+	g_mutex_unlock(&demux->lock);
+
+	// The flush clears the segment of the pad
+	ret_val = gst_multidemux_feed_push_event(feed, event);
+
+	gst_segment_init(&segment, GST_FORMAT_TIME);
+	gst_multidemux_feed_push_event(feed, gst_event_new_segment(&segment));
+
+	if (is_active)
+		gst_task_start(feed->reader_task);
+
+	// The output task pauses when a pad returns flushing
+	if (is_running)
+		gst_task_start(demux->output_task);
+
+	return ret_val;
+}
+
+/*
+ * Map the PTS of the feed to the common timeline. The frames captured at the same time arrive
+ * at the same time, so the arrival of the PCR aligns the feeds.
+ */
+static GstClockTime
+gst_multidemux_feed_map_pts(GstMultiDemuxFeed * feed, GstClockTime pts)
+{
+	// The mapping is kept once it has been chosen
+	if (!GST_CLOCK_TIME_IS_VALID(feed->pts_ref) && GST_CLOCK_TIME_IS_VALID(feed->pcr_ref)) {
+		if (pts + feed->arrival_ref < feed->pcr_ref)
+			return 0;
+
+		return pts + feed->arrival_ref - feed->pcr_ref;
+	}
+
+	// The feed without PCR starts at 0
+	if (!GST_CLOCK_TIME_IS_VALID(feed->pts_ref)) {
+		GST_WARNING_OBJECT(feed->sinkpad, "No PCR before the first frame. The feed is aligned by its first PTS.");
+		feed->pts_ref = pts;
+	}
+
+	return pts > feed->pts_ref ? pts - feed->pts_ref : 0;
+}
+
+/*
+ * Build the caps of the video pad
+ */
+static GstCaps *
+gst_multidemux_feed_make_caps(AVStream * av_stream)
+{
+	AVCodecParameters *codecpar = av_stream->codecpar;
+	GstCaps *caps = NULL;
+
+	switch (codecpar->codec_id) {
+	case AV_CODEC_ID_H264:
+		caps = gst_caps_new_simple("video/x-h264",
+			"stream-format", G_TYPE_STRING, "byte-stream",
+			"alignment", G_TYPE_STRING, "au", NULL);
+		break;
+
+	case AV_CODEC_ID_HEVC:
+		caps = gst_caps_new_simple("video/x-h265",
+			"stream-format", G_TYPE_STRING, "byte-stream",
+			"alignment", G_TYPE_STRING, "au", NULL);
+		break;
+
+	default:
+		return NULL;
+	}
+
+	if (codecpar->width > 0 && codecpar->height > 0) {
+		gst_caps_set_simple(caps,
+			"width", G_TYPE_INT, codecpar->width,
+			"height", G_TYPE_INT, codecpar->height, NULL);
+	}
+
+	if (av_stream->avg_frame_rate.num > 0 && av_stream->avg_frame_rate.den > 0) {
+		gst_caps_set_simple(caps, "framerate", GST_TYPE_FRACTION,
+			av_stream->avg_frame_rate.num, av_stream->avg_frame_rate.den, NULL);
+	}
+
+	return caps;
+}
+
+/*
+ * Inspect the TS packets of the feed handed to libav
+ */
+static void
+gst_multidemux_feed_observe_io(gpointer user_data, const guint8 * data, gsize size)
+{
+	GstMultiDemuxFeed *feed = (GstMultiDemuxFeed *)user_data;
+
+	if (data == NULL)
+		gst_ts_inspector_reset(feed->ts_inspector);
+	else
+		gst_ts_inspector_parse(feed->ts_inspector, data, size);
+}
+
+/*
+ * Keep the first PCR of the feed and when it arrived. The first PCR of every PID is kept until the program is known.
+ */
+static void
+gst_multidemux_feed_observe_pcr(guint16 pid, guint64 pcr, gboolean discontinuity, gpointer user_data)
+{
+	GstMultiDemuxFeed *feed = (GstMultiDemuxFeed *)user_data;
+	GstMultiDemuxPcr first;
+
+	if (GST_CLOCK_TIME_IS_VALID(feed->pcr_ref))
+		return;
+
+	first.pid = pid;
+	first.pcr = gst_util_uint64_scale(pcr, GST_SECOND, 27000000);
+	first.arrival = gst_iestsmultidemux_get_arrival(feed->demux);
+
+	if (feed->ts_inspector->pcr_pid != TS_INSPECT_ANY_PID) {
+		gst_multidemux_feed_set_pcr_ref(feed, &first);
+		return;
+	}
+
+	for (guint i = 0; i < feed->first_pcrs->len; i++) {
+		if (g_array_index(feed->first_pcrs, GstMultiDemuxPcr, i).pid == pid)
+			return;
+	}
+
+	g_array_append_val(feed->first_pcrs, first);
+}
+
+/*
+ * Map the PTS of the feed through the PCR
+ */
+static void
+gst_multidemux_feed_set_pcr_ref(GstMultiDemuxFeed * feed, const GstMultiDemuxPcr * first)
+{
+	feed->pcr_ref = first->pcr;
+	feed->arrival_ref = first->arrival;
+
+	GST_DEBUG_OBJECT(feed->sinkpad, "PCR %" GST_TIME_FORMAT " on PID %u arrived at %" GST_TIME_FORMAT,
+		GST_TIME_ARGS(feed->pcr_ref), first->pid, GST_TIME_ARGS(feed->arrival_ref));
+}
@@ -0,0 +1,116 @@
+#ifndef __GST_IESTSMULTIDEMUX_H__
+#define __GST_IESTSMULTIDEMUX_H__
+
+#include "gstiestsdemux.h"
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_IESTSMULTIDEMUX \
+  (gst_iestsmultidemux_get_type())
+#define GST_IESTSMULTIDEMUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_IESTSMULTIDEMUX,Gstiestsmultidemux))
+#define GST_IESTSMULTIDEMUX_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_IESTSMULTIDEMUX,GstiestsmultidemuxClass))
+#define GST_IS_IESTSMULTIDEMUX(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_IESTSMULTIDEMUX))
+#define GST_IS_IESTSMULTIDEMUX_CLASS(obj) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_IESTSMULTIDEMUX))
+
+typedef struct _GstMultiDemuxPcr			GstMultiDemuxPcr;
+typedef struct _GstMultiDemuxFeed			GstMultiDemuxFeed;
+typedef struct _Gstiestsmultidemux			Gstiestsmultidemux;
+typedef struct _GstiestsmultidemuxClass		GstiestsmultidemuxClass;
+
+/*
+* The first PCR seen on a PID and when it arrived
+*/
+struct _GstMultiDemuxPcr
+{
+	guint16		pid;
+	GstClockTime	pcr;
+	GstClockTime	arrival;
+};
+
+/*
+* One camera feed. It is demuxed by libav in its own reader task.
+*/
+struct _GstMultiDemuxFeed
+{
+	Gstiestsmultidemux	*demux;
+	guint		index;
+
+	GstPad		*sinkpad;
+	GstPad		*srcpad;
+
+	// LibAV Properties
+	GstBufferedIOInfo	*buffio_info;
+	AVFormatContext		*av_format_context;
+	gint		video_stream_index;
+
+	GstTask		*reader_task;
+	GRecMutex	reader_task_lock;
+	gboolean	is_active;
+
+	// The first PCR and its arrival map the PTS of the feed to the common timeline.
+	// The first PTS is used instead when the PCR has not been seen.
+	// The PCR of every PID is kept from the first byte until libav finds the program.
+	GstTsInspector	*ts_inspector;
+	GArray		*first_pcrs;
+	GstClockTime	pcr_ref;
+	GstClockTime	arrival_ref;
+	GstClockTime	pts_ref;
+
+	// The demuxed frames waiting for their slot. They are protected by the lock of the element.
+	GQueue		frames;
+	gboolean	is_eos;
+	gboolean	is_flushing;
+
+	// Statistics
+	guint64		lagged_slots;
+	guint64		late_frames;
+};
+
+struct _Gstiestsmultidemux
+{
+	// Parent class
+	GstElement		element;
+
+	GPtrArray		*feeds;
+	guint			next_feed_index;
+	guint			group_id;
+
+	// Protects the feeds, their frames and the slot. The cond is signalled whenever a frame is queued or taken.
+	GMutex			lock;
+	GCond			cond;
+	gboolean		is_flushing;
+
+	// The output task emits the frames of all the feeds slot by slot
+	GstTask			*output_task;
+	GRecMutex		output_task_lock;
+	GstFlowCombiner	*flow_combiner;
+
+	GstClockTime	next_slot;
+	GstClockTime	active_slot_duration;
+
+	// The reference of the arrival times shared by the feeds
+	GstClockTime	epoch;
+
+	// Properties
+	guint			max_queue;
+	GstClockTime	max_lag;
+	GstClockTime	slot_duration;
+};
+
+struct _GstiestsmultidemuxClass
+{
+	GstElementClass parent_class;
+};
+
+GType gst_iestsmultidemux_get_type(void);
+
+G_END_DECLS
+
+#endif /* __GST_IESTSMULTIDEMUX_H__ */
@@ -0,0 +1,441 @@
+#include "gstpacketcache.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_packetcache_debug);
+#define GST_CAT_DEFAULT gst_packetcache_debug
+
+static void gst_packet_cache_entry_free(gpointer data, gpointer user_data);
+static void gst_loop_cache_range_free(GstLoopCacheRange * range);
+static void gst_loop_cache_evict(GstLoopCache * cache, guint64 incoming_bytes);
+static void gst_scrub_cache_evict(GstScrubCache * cache);
+static void gst_scrub_cache_drop_until(GstScrubCache * cache, GList * key_link);
+static gboolean gst_scrub_cache_is_keyframe(GstScrubCache * cache, GstPacketCacheEntry * entry);
+
+/*
+* Allocate a new loop cache. It is disabled until the limits are set.
+*/
+GstLoopCache *
+gst_loop_cache_new(void)
+{
+	GstLoopCache *cache = g_new0(GstLoopCache, 1);
+
+	cache->max_bytes = 0;
+	cache->max_ranges = 1;
+	cache->bytes = 0;
+	cache->recording = NULL;
+	g_queue_init(&cache->ranges);
+
+	return cache;
+}
+
+/*
+* De-allocate the loop cache and every buffer kept in it
+*/
+void
+gst_loop_cache_free(GstLoopCache * cache)
+{
+	if (cache == NULL)
+		return;
+
+	gst_loop_cache_clear(cache);
+	g_free(cache);
+}
+
+/*
+* Drop all the ranges including the one being recorded
+*/
+void
+gst_loop_cache_clear(GstLoopCache * cache)
+{
+	GstLoopCacheRange *range;
+
+	gst_loop_cache_abort_range(cache);
+
+	while ((range = g_queue_pop_head(&cache->ranges)) != NULL) {
+		gst_loop_cache_range_free(range);
+	}
+
+	cache->bytes = 0;
+}
+
+/*
+* Update the limits. The least recently used ranges are evicted if the cache does not fit anymore.
+*/
+void
+gst_loop_cache_set_limits(GstLoopCache * cache, guint64 max_bytes, guint max_ranges)
+{
+	cache->max_bytes = max_bytes;
+	cache->max_ranges = MAX(max_ranges, 1);
+
+	if (cache->max_bytes == 0) {
+		gst_loop_cache_clear(cache);
+		return;
+	}
+
+	gst_loop_cache_evict(cache, 0);
+}
+
+/*
+* Start recording the buffers of a new segment range
+*/
+void
+gst_loop_cache_begin_range(GstLoopCache * cache, GstClockTime req_start, GstClockTime req_stop, GstClockTime seg_start)
+{
+	GstLoopCacheRange *range;
+
+	gst_loop_cache_abort_range(cache);
+
+	if (cache->max_bytes == 0)
+		return;
+
+	range = g_new0(GstLoopCacheRange, 1);
+	range->req_start = req_start;
+	range->req_stop = req_stop;
+	range->seg_start = seg_start;
+	range->bytes = 0;
+	g_queue_init(&range->entries);
+
+	cache->recording = range;
+
+	GST_DEBUG("Start recording the range %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT,
+		GST_TIME_ARGS(req_start), GST_TIME_ARGS(req_stop));
+}
+
+/*
+* Keep a reference of the buffer in the range being recorded
+*/
+void
+gst_loop_cache_record(GstLoopCache * cache, gint stream_index, GstBuffer * buffer)
+{
+	GstLoopCacheRange *range = cache->recording;
+	GstPacketCacheEntry *entry;
+	gsize size;
+
+	if (range == NULL)
+		return;
+
+	size = gst_buffer_get_size(buffer);
+
+	// A range which can never fit is not worth keeping
+	if (range->bytes + size > cache->max_bytes) {
+		GST_INFO("The range %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT " exceeds %" G_GUINT64_FORMAT " bytes. Stop recording.",
+			GST_TIME_ARGS(range->req_start), GST_TIME_ARGS(range->req_stop), cache->max_bytes);
+		gst_loop_cache_abort_range(cache);
+		return;
+	}
+
+	entry = g_new0(GstPacketCacheEntry, 1);
+	entry->stream_index = stream_index;
+	entry->buffer = gst_buffer_ref(buffer);
+
+	g_queue_push_tail(&range->entries, entry);
+	range->bytes += size;
+}
+
+/*
+* Complete the range being recorded and make it available for the lookup
+*/
+void
+gst_loop_cache_end_range(GstLoopCache * cache)
+{
+	GstLoopCacheRange *range = cache->recording;
+
+	if (range == NULL)
+		return;
+
+	cache->recording = NULL;
+
+	if (g_queue_is_empty(&range->entries)) {
+		gst_loop_cache_range_free(range);
+		return;
+	}
+
+	// Make room for the new range
+	gst_loop_cache_evict(cache, range->bytes);
+
+	g_queue_push_head(&cache->ranges, range);
+	cache->bytes += range->bytes;
+
+	GST_DEBUG("Cached the range %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT " (%u buffers, %" G_GUINT64_FORMAT " bytes)",
+		GST_TIME_ARGS(range->req_start), GST_TIME_ARGS(range->req_stop),
+		g_queue_get_length(&range->entries), range->bytes);
+}
+
+/*
+* Discard the range being recorded
+*/
+void
+gst_loop_cache_abort_range(GstLoopCache * cache)
+{
+	if (cache->recording == NULL)
+		return;
+
+	gst_loop_cache_range_free(cache->recording);
+	cache->recording = NULL;
+}
+
+/*
+* Find the range which was recorded for the same segment seek. The found range becomes the most recently used one.
+*/
+GstLoopCacheRange *
+gst_loop_cache_lookup(GstLoopCache * cache, GstClockTime req_start, GstClockTime req_stop)
+{
+	for (GList *item = cache->ranges.head; item != NULL; item = item->next) {
+		GstLoopCacheRange *range = (GstLoopCacheRange *)item->data;
+
+		if (range->req_start == req_start && range->req_stop == req_stop) {
+			g_queue_unlink(&cache->ranges, item);
+			g_queue_push_head_link(&cache->ranges, item);
+			return range;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+* Evict the least recently used ranges until the incoming bytes fit in the limits
+*/
+static void
+gst_loop_cache_evict(GstLoopCache * cache, guint64 incoming_bytes)
+{
+	guint max_ranges = incoming_bytes > 0 ? cache->max_ranges - 1 : cache->max_ranges;
+
+	while (!g_queue_is_empty(&cache->ranges) &&
+		(cache->bytes + incoming_bytes > cache->max_bytes || g_queue_get_length(&cache->ranges) > max_ranges)) {
+		GstLoopCacheRange *range = g_queue_pop_tail(&cache->ranges);
+
+		GST_DEBUG("Evict the range %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT,
+			GST_TIME_ARGS(range->req_start), GST_TIME_ARGS(range->req_stop));
+
+		cache->bytes -= range->bytes;
+		gst_loop_cache_range_free(range);
+	}
+}
+
+/*
+* Allocate a new scrub cache. It is disabled until the window is configured.
+*/
+GstScrubCache *
+gst_scrub_cache_new(void)
+{
+	GstScrubCache *cache = g_new0(GstScrubCache, 1);
+
+	cache->window = 0;
+	cache->max_bytes = 0;
+	cache->key_stream_index = -1;
+	cache->bytes = 0;
+	cache->latest_pts = GST_CLOCK_TIME_NONE;
+	cache->hits = 0;
+	cache->misses = 0;
+	g_queue_init(&cache->entries);
+	g_queue_init(&cache->keyframes);
+
+	return cache;
+}
+
+/*
+* De-allocate the scrub cache and every packet kept in it
+*/
+void
+gst_scrub_cache_free(GstScrubCache * cache)
+{
+	if (cache == NULL)
+		return;
+
+	gst_scrub_cache_clear(cache);
+	g_free(cache);
+}
+
+/*
+* Drop all the packets. The statistics are kept.
+*/
+void
+gst_scrub_cache_clear(GstScrubCache * cache)
+{
+	g_queue_foreach(&cache->entries, gst_packet_cache_entry_free, NULL);
+	g_queue_clear(&cache->entries);
+	g_queue_clear(&cache->keyframes);
+
+	cache->bytes = 0;
+	cache->latest_pts = GST_CLOCK_TIME_NONE;
+}
+
+/*
+* Set the window, the size limit and the stream which decides the GOP boundaries
+*/
+void
+gst_scrub_cache_configure(GstScrubCache * cache, GstClockTime window, guint64 max_bytes, gint key_stream_index)
+{
+	if (cache->key_stream_index != key_stream_index || window == 0)
+		gst_scrub_cache_clear(cache);
+
+	cache->window = window;
+	cache->max_bytes = max_bytes;
+	cache->key_stream_index = key_stream_index;
+
+	gst_scrub_cache_evict(cache);
+}
+
+/*
+* Append the packet which is being pushed and evict the GOPs falling out of the window
+*/
+void
+gst_scrub_cache_record(GstScrubCache * cache, gint stream_index, GstBuffer * buffer)
+{
+	GstPacketCacheEntry *entry;
+	GstClockTime pts = GST_BUFFER_TIMESTAMP(buffer);
+
+	if (cache->window == 0)
+		return;
+
+	entry = g_new0(GstPacketCacheEntry, 1);
+	entry->stream_index = stream_index;
+	entry->buffer = gst_buffer_ref(buffer);
+
+	g_queue_push_tail(&cache->entries, entry);
+	cache->bytes += gst_buffer_get_size(buffer);
+
+	if (gst_scrub_cache_is_keyframe(cache, entry))
+		g_queue_push_tail(&cache->keyframes, cache->entries.tail);
+
+	if (GST_CLOCK_TIME_IS_VALID(pts) &&
+		(!GST_CLOCK_TIME_IS_VALID(cache->latest_pts) || pts > cache->latest_pts))
+		cache->latest_pts = pts;
+
+	gst_scrub_cache_evict(cache);
+}
+
+/*
+* Find the GOP containing the position. The returned link is the first packet to replay.
+*/
+GList *
+gst_scrub_cache_lookup(GstScrubCache * cache, GstClockTime position)
+{
+	GList *found = NULL;
+
+	if (cache->window == 0)
+		return NULL;
+
+	if (!GST_CLOCK_TIME_IS_VALID(position) ||
+		!GST_CLOCK_TIME_IS_VALID(cache->latest_pts) || position > cache->latest_pts)
+		goto done;
+
+	// Search the latest keyframe at or before the position
+	for (GList *item = cache->keyframes.tail; item != NULL; item = item->prev) {
+		GList *link = (GList *)item->data;
+		GstPacketCacheEntry *entry = (GstPacketCacheEntry *)link->data;
+
+		if (GST_BUFFER_TIMESTAMP(entry->buffer) <= position) {
+			found = link;
+			break;
+		}
+	}
+
+done:
+	if (found != NULL)
+		cache->hits++;
+	else
+		cache->misses++;
+
+	return found;
+}
+
+/*
+* Drop the oldest GOPs as long as the remaining packets still cover the window. Over the size limit, the oldest
+* GOPs are dropped even if the window is not covered any more. All the packets are dropped when no keyframe
+* is left to start from.
+*/
+static void
+gst_scrub_cache_evict(GstScrubCache * cache)
+{
+	while (cache->max_bytes > 0 && cache->bytes > cache->max_bytes) {
+		GList *key_link = g_queue_peek_head(&cache->keyframes);
+
+		if (key_link != NULL && key_link == cache->entries.head)
+			key_link = g_queue_peek_nth(&cache->keyframes, 1);
+
+		if (key_link == NULL) {
+			GST_DEBUG("No GOP fits in %" G_GUINT64_FORMAT " bytes. Drop the scrub cache.", cache->max_bytes);
+			gst_scrub_cache_clear(cache);
+			return;
+		}
+
+		gst_scrub_cache_drop_until(cache, key_link);
+	}
+
+	while (!g_queue_is_empty(&cache->keyframes)) {
+		GList *key_link = g_queue_peek_head(&cache->keyframes);
+		GstPacketCacheEntry *key_entry;
+
+		// The head is already aligned to the GOP. Check if the next GOP covers the window by itself.
+		if (key_link == cache->entries.head) {
+			if (g_queue_get_length(&cache->keyframes) < 2)
+				break;
+			key_link = g_queue_peek_nth(&cache->keyframes, 1);
+		}
+
+		key_entry = (GstPacketCacheEntry *)key_link->data;
+		if (!GST_BUFFER_TIMESTAMP_IS_VALID(key_entry->buffer) ||
+			cache->latest_pts < GST_BUFFER_TIMESTAMP(key_entry->buffer) + cache->window)
+			break;
+
+		gst_scrub_cache_drop_until(cache, key_link);
+	}
+}
+
+/*
+* Drop the packets in front of the keyframe
+*/
+static void
+gst_scrub_cache_drop_until(GstScrubCache * cache, GList * key_link)
+{
+	while (cache->entries.head != key_link) {
+		GstPacketCacheEntry *entry;
+
+		if (g_queue_peek_head(&cache->keyframes) == cache->entries.head)
+			g_queue_pop_head(&cache->keyframes);
+
+		entry = g_queue_pop_head(&cache->entries);
+		cache->bytes -= gst_buffer_get_size(entry->buffer);
+		gst_packet_cache_entry_free(entry, NULL);
+	}
+}
+
+/*
+* Check if the packet starts a GOP
+*/
+static gboolean
+gst_scrub_cache_is_keyframe(GstScrubCache * cache, GstPacketCacheEntry * entry)
+{
+	if (GST_BUFFER_FLAG_IS_SET(entry->buffer, GST_BUFFER_FLAG_DELTA_UNIT) ||
+		!GST_BUFFER_TIMESTAMP_IS_VALID(entry->buffer))
+		return FALSE;
+
+	return cache->key_stream_index < 0 || entry->stream_index == cache->key_stream_index;
+}
+
+static void
+gst_loop_cache_range_free(GstLoopCacheRange * range)
+{
+	g_queue_foreach(&range->entries, gst_packet_cache_entry_free, NULL);
+	g_queue_clear(&range->entries);
+	g_free(range);
+}
+
+static void
+gst_packet_cache_entry_free(gpointer data, gpointer user_data)
+{
+	GstPacketCacheEntry *entry = (GstPacketCacheEntry *)data;
+
+	gst_buffer_unref(entry->buffer);
+	g_free(entry);
+}
+
+/*
+* Set the debug category
+*/
+void
+init_packetcache(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_packetcache_debug, "packetcache", 0, "IES TS Demuxer Packet Cache");
+}
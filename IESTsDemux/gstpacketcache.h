@@ -0,0 +1,133 @@
+#ifndef __GST_PACKETCACHE_H__
+#define __GST_PACKETCACHE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstPacketCacheEntry GstPacketCacheEntry;
+typedef struct _GstLoopCacheRange	GstLoopCacheRange;
+typedef struct _GstLoopCache		GstLoopCache;
+typedef struct _GstScrubCache		GstScrubCache;
+
+/*
+* A demuxed buffer kept in the cache together with the stream it belongs to
+*/
+struct _GstPacketCacheEntry
+{
+	gint		stream_index;
+
+	GstBuffer	*buffer;
+};
+
+/*
+* The buffers demuxed for one segment range, in the order they were pushed
+*/
+struct _GstLoopCacheRange
+{
+	// The range requested by the segment seek
+	GstClockTime	req_start;
+	GstClockTime	req_stop;
+
+	// The segment start after aligning the seek to the keyframe
+	GstClockTime	seg_start;
+
+	GQueue		entries;
+
+	guint64		bytes;
+};
+
+/*
+* Keeps the most recent segment ranges in memory so looping over them does not touch the source
+*/
+struct _GstLoopCache
+{
+	// Limits
+	guint64		max_bytes;
+	guint		max_ranges;
+
+	// The completed ranges. The most recently used one is at the head.
+	GQueue		ranges;
+	guint64		bytes;
+
+	// The range which is being recorded now
+	GstLoopCacheRange *recording;
+};
+
+/*
+* Keeps the packets demuxed during the last seconds so short backward seeks do not touch the source
+*/
+struct _GstScrubCache
+{
+	// How long the cache goes back from the latest packet, and the most bytes it keeps for that (0 = no limit)
+	GstClockTime	window;
+	guint64		max_bytes;
+
+	// The stream whose keyframes start a GOP. Every stream is used if it is -1.
+	gint		key_stream_index;
+
+	// The entries in the demuxed order and the links of the entries starting a GOP
+	GQueue		entries;
+	GQueue		keyframes;
+	guint64		bytes;
+
+	GstClockTime	latest_pts;
+
+	// Statistics
+	guint64		hits;
+	guint64		misses;
+};
+
+void init_packetcache(void);
+
+GstLoopCache * gst_loop_cache_new(void);
+
+void gst_loop_cache_free(GstLoopCache * cache);
+
+void gst_loop_cache_clear(GstLoopCache * cache);
+
+void gst_loop_cache_set_limits(GstLoopCache * cache, guint64 max_bytes, guint max_ranges);
+
+void gst_loop_cache_begin_range(GstLoopCache * cache, GstClockTime req_start, GstClockTime req_stop, GstClockTime seg_start);
+
+void gst_loop_cache_record(GstLoopCache * cache, gint stream_index, GstBuffer * buffer);
+
+void gst_loop_cache_end_range(GstLoopCache * cache);
+
+void gst_loop_cache_abort_range(GstLoopCache * cache);
+
+GstLoopCacheRange * gst_loop_cache_lookup(GstLoopCache * cache, GstClockTime req_start, GstClockTime req_stop);
+
+GstScrubCache * gst_scrub_cache_new(void);
+
+void gst_scrub_cache_free(GstScrubCache * cache);
+
+void gst_scrub_cache_clear(GstScrubCache * cache);
+
+void gst_scrub_cache_configure(GstScrubCache * cache, GstClockTime window, guint64 max_bytes, gint key_stream_index);
+
+void gst_scrub_cache_record(GstScrubCache * cache, gint stream_index, GstBuffer * buffer);
+
+GList * gst_scrub_cache_lookup(GstScrubCache * cache, GstClockTime position);
+
+/*
+* Check if the loop cache is recording a range
+*/
+static inline gboolean
+gst_loop_cache_is_recording(GstLoopCache * cache)
+{
+	return cache->recording != NULL;
+}
+
+/*
+* Check if the scrub cache keeps the packets
+*/
+static inline gboolean
+gst_scrub_cache_is_enabled(GstScrubCache * cache)
+{
+	return cache->window > 0;
+}
+
+G_END_DECLS
+
+#endif /* __GST_PACKETCACHE_H__ */
@@ -0,0 +1,120 @@
+#include "gstpcrclock.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_pcrclock_debug);
+#define GST_CAT_DEFAULT gst_pcrclock_debug
+
+// The PCR base wraps at 2^33 in 90 kHz
+#define PCR_WRAP_TIME		gst_util_uint64_scale(G_GUINT64_CONSTANT(1) << 33, GST_SECOND, 90000)
+
+// The weight of a new sample in the running jitter estimate
+#define PCR_JITTER_SHIFT	4
+
+/*
+* Allocate a new PCR clock. It runs with the system clock until the first observations.
+*/
+GstPcrClock *
+gst_pcr_clock_new(const gchar * name)
+{
+	GstPcrClock *pcr_clock = g_new0(GstPcrClock, 1);
+
+	pcr_clock->clock = g_object_new(GST_TYPE_SYSTEM_CLOCK, "name", name,
+		"clock-type", GST_CLOCK_TYPE_MONOTONIC, NULL);
+	gst_object_ref_sink(pcr_clock->clock);
+
+	gst_pcr_clock_reset(pcr_clock);
+
+	return pcr_clock;
+}
+
+void
+gst_pcr_clock_free(GstPcrClock * pcr_clock)
+{
+	if (pcr_clock == NULL)
+		return;
+
+	gst_object_unref(pcr_clock->clock);
+	g_free(pcr_clock);
+}
+
+/*
+* Start over with a new program. The calibration of the clock is kept so its time does not jump.
+*/
+void
+gst_pcr_clock_reset(GstPcrClock * pcr_clock)
+{
+	pcr_clock->last_pcr = GST_CLOCK_TIME_NONE;
+	pcr_clock->last_master = GST_CLOCK_TIME_NONE;
+	pcr_clock->last_slave = GST_CLOCK_TIME_NONE;
+
+	pcr_clock->jitter = 0;
+	pcr_clock->drift = 0.0;
+	pcr_clock->observations = 0;
+	pcr_clock->discontinuities = 0;
+}
+
+/*
+* Add the PCR as an observation. The arrival is the internal time of the clock when the packet carrying it arrived,
+* so the time it waited to be read is not taken for jitter. The regression of the clock filters the jitter.
+*/
+void
+gst_pcr_clock_observe(GstPcrClock * pcr_clock, guint64 pcr, GstClockTime arrival, gboolean discontinuity)
+{
+	GstClockTime pcr_time = gst_util_uint64_scale(pcr, GST_SECOND, 27000000);
+	GstClockTime slave = arrival;
+	GstClockTime master;
+	gdouble r_squared;
+
+	// The clock keeps the time it had at the arrival and only follows the rate of the PCR
+	if (!GST_CLOCK_TIME_IS_VALID(pcr_clock->last_pcr)) {
+		GstClockTime internal, external, rate_num, rate_denom;
+
+		gst_clock_get_calibration(pcr_clock->clock, &internal, &external, &rate_num, &rate_denom);
+		master = gst_clock_adjust_with_calibration(pcr_clock->clock, slave, internal, external, rate_num, rate_denom);
+	}
+	else {
+		GstClockTimeDiff pcr_delta = GST_CLOCK_DIFF(pcr_clock->last_pcr, pcr_time);
+		GstClockTimeDiff slave_delta = GST_CLOCK_DIFF(pcr_clock->last_slave, slave);
+		GstClockTimeDiff deviation;
+
+		if (pcr_delta < -(GstClockTimeDiff)(PCR_WRAP_TIME / 2))
+			pcr_delta += PCR_WRAP_TIME;
+
+		// The master continues from where it was as if the PCR had followed the arrival
+		if (discontinuity || pcr_delta < 0 || pcr_delta > (GstClockTimeDiff)PCR_CLOCK_MAX_GAP) {
+			GST_DEBUG("PCR discontinuity %" G_GINT64_FORMAT " ns", (gint64)pcr_delta);
+			pcr_clock->discontinuities++;
+			pcr_delta = slave_delta;
+		}
+
+		master = pcr_clock->last_master + pcr_delta;
+
+		// How much the arrival deviated from the PCR spacing
+		deviation = ABS(slave_delta - pcr_delta);
+		pcr_clock->jitter += ((gint64)deviation - (gint64)pcr_clock->jitter) >> PCR_JITTER_SHIFT;
+	}
+
+	pcr_clock->last_pcr = pcr_time;
+	pcr_clock->last_master = master;
+	pcr_clock->last_slave = slave;
+	pcr_clock->observations++;
+
+	if (gst_clock_add_observation(pcr_clock->clock, slave, master, &r_squared)) {
+		GstClockTime internal, external, rate_num, rate_denom;
+
+		gst_clock_get_calibration(pcr_clock->clock, &internal, &external, &rate_num, &rate_denom);
+		if (rate_denom > 0)
+			pcr_clock->drift = ((gdouble)rate_num / rate_denom - 1.0) * 1000000.0;
+
+		GST_LOG("Calibrated: drift=%.3f ppm / jitter=%" GST_TIME_FORMAT " / r_squared=%f",
+			pcr_clock->drift, GST_TIME_ARGS(pcr_clock->jitter), r_squared);
+	}
+}
+
+/*
+* Set the debug category
+*/
+void
+init_pcrclock(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_pcrclock_debug, "pcrclock", 0, "PCR Clock");
+}
@@ -0,0 +1,44 @@
+#ifndef __GST_PCRCLOCK_H__
+#define __GST_PCRCLOCK_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// A PCR further than this from the previous one is handled as a discontinuity
+#define PCR_CLOCK_MAX_GAP		(1 * GST_SECOND)
+
+typedef struct _GstPcrClock GstPcrClock;
+
+/*
+* A system clock calibrated against the PCR. The arrival of each PCR is an observation of the encoder clock.
+*/
+struct _GstPcrClock
+{
+	GstClock	*clock;
+
+	// The previous observation
+	GstClockTime	last_pcr;
+	GstClockTime	last_master;
+	GstClockTime	last_slave;
+
+	// Statistics
+	GstClockTime	jitter;
+	gdouble		drift;
+	guint64		observations;
+	guint64		discontinuities;
+};
+
+void init_pcrclock(void);
+
+GstPcrClock * gst_pcr_clock_new(const gchar * name);
+
+void gst_pcr_clock_free(GstPcrClock * pcr_clock);
+
+void gst_pcr_clock_reset(GstPcrClock * pcr_clock);
+
+void gst_pcr_clock_observe(GstPcrClock * pcr_clock, guint64 pcr, GstClockTime arrival, gboolean discontinuity);
+
+G_END_DECLS
+
+#endif /* __GST_PCRCLOCK_H__ */
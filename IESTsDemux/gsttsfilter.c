@@ -0,0 +1,493 @@
+#include "gsttsfilter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_tsfilter_debug);
+#define GST_CAT_DEFAULT gst_tsfilter_debug
+
+// Flags of a PID
+#define TS_FILTER_PID_REQUESTED		0x01
+#define TS_FILTER_PID_SELECTED		0x02
+#define TS_FILTER_PID_PMT			0x04
+
+#define TS_TABLE_ID_PAT				0x00
+#define TS_TABLE_ID_PMT				0x02
+
+// The length of the fixed part of the sections up to the loops
+#define TS_PAT_HEADER_SIZE			8
+#define TS_PMT_HEADER_SIZE			12
+#define TS_CRC_SIZE					4
+
+static guint32 crc32_table[256];
+
+static void gst_ts_filter_parse_packet(GstTsFilter * filter, const guint8 * packet);
+static void gst_ts_filter_parse_pat(GstTsFilter * filter, const guint8 * packet);
+static void gst_ts_filter_parse_pmt(GstTsFilter * filter, const guint8 * packet, guint16 pid);
+static void gst_ts_filter_output(GstTsFilter * filter, const guint8 * packet);
+static void gst_ts_filter_output_pat(GstTsFilter * filter);
+static void gst_ts_filter_output_pcr(GstTsFilter * filter, const guint8 * packet);
+static gboolean gst_ts_filter_find_section(const guint8 * packet, guint * section_pos, guint * section_size);
+static guint32 gst_ts_filter_crc32(const guint8 * data, gsize size);
+
+/*
+* Allocate a new filter. It forwards every stream of the first program until it is configured.
+*/
+GstTsFilter *
+gst_ts_filter_new(void)
+{
+	GstTsFilter *filter = g_new0(GstTsFilter, 1);
+
+	g_queue_init(&filter->batches);
+	gst_ts_filter_configure(filter, NULL, TS_FILTER_DEFAULT_BATCH_PACKETS);
+
+	return filter;
+}
+
+void
+gst_ts_filter_free(GstTsFilter * filter)
+{
+	if (filter == NULL)
+		return;
+
+	gst_ts_filter_reset(filter, TS_FILTER_NO_OFFSET);
+	g_free(filter);
+}
+
+/*
+* Select the PIDs given as a comma separated list. Every stream of the program is selected when the list is empty.
+* The program is looked up again.
+*/
+gboolean
+gst_ts_filter_configure(GstTsFilter * filter, const gchar * pids, guint batch_packets)
+{
+	gchar **tokens = NULL;
+	gboolean result = TRUE;
+
+	gst_ts_filter_reset(filter, TS_FILTER_NO_OFFSET);
+
+	memset(filter->pids, 0, sizeof(filter->pids));
+	filter->has_requested_pids = FALSE;
+
+	filter->program_number = -1;
+	filter->pmt_pid = -1;
+	filter->pcr_pid = -1;
+	filter->has_pat = FALSE;
+
+	filter->batch_packets = MAX(batch_packets, 1);
+	filter->packets_in = 0;
+	filter->packets_out = 0;
+
+	if (pids == NULL)
+		return TRUE;
+
+	tokens = g_strsplit(pids, ",", -1);
+	for (gint i = 0; tokens[i] != NULL; i++) {
+		gchar *token = g_strstrip(tokens[i]);
+		gchar *end = NULL;
+		gulong pid;
+
+		if (*token == '\0')
+			continue;
+
+		// The PIDs are given in decimal or with the 0x prefix
+		pid = strtoul(token, &end, 0);
+		if (*end != '\0' || pid == TS_PAT_PID || pid >= TS_NULL_PID) {
+			GST_WARNING("Invalid PID '%s'", token);
+			result = FALSE;
+			continue;
+		}
+
+		filter->pids[pid] |= TS_FILTER_PID_REQUESTED;
+		filter->has_requested_pids = TRUE;
+	}
+	g_strfreev(tokens);
+
+	return result;
+}
+
+/*
+* Drop the partial packet and the batches. The input is forwarded again from the offset.
+*/
+void
+gst_ts_filter_reset(GstTsFilter * filter, guint64 offset)
+{
+	GstBuffer *batch;
+
+	filter->carry_size = 0;
+	filter->next_offset = offset;
+
+	if (filter->batch != NULL) {
+		gst_buffer_unmap(filter->batch, &filter->batch_map);
+		gst_buffer_unref(filter->batch);
+		filter->batch = NULL;
+	}
+	filter->batch_filled = 0;
+
+	while ((batch = g_queue_pop_head(&filter->batches)) != NULL)
+		gst_buffer_unref(batch);
+}
+
+/*
+* Filter the data read from the source at the offset. libav reads some parts more than once while probing,
+* so only the data continuing the forwarded input is taken.
+*/
+void
+gst_ts_filter_parse(GstTsFilter * filter, guint64 offset, const guint8 * data, gsize size)
+{
+	gsize pos = 0;
+
+	if (filter->next_offset == TS_FILTER_NO_OFFSET)
+		filter->next_offset = offset;
+
+	if (offset > filter->next_offset || offset + size <= filter->next_offset)
+		return;
+
+	pos = (gsize)(filter->next_offset - offset);
+	filter->next_offset = offset + size;
+
+	// Complete the packet left over from the previous read
+	if (filter->carry_size > 0) {
+		gsize needed = TS_PACKET_SIZE - filter->carry_size;
+
+		if (size - pos < needed) {
+			memcpy(filter->carry + filter->carry_size, data + pos, size - pos);
+			filter->carry_size += (guint)(size - pos);
+			return;
+		}
+
+		memcpy(filter->carry + filter->carry_size, data + pos, needed);
+		gst_ts_filter_parse_packet(filter, filter->carry);
+		filter->carry_size = 0;
+		pos += needed;
+	}
+
+	while (pos < size) {
+		// Find the sync byte again
+		if (data[pos] != TS_SYNC_BYTE) {
+			while (pos < size && data[pos] != TS_SYNC_BYTE)
+				pos++;
+			continue;
+		}
+
+		if (size - pos < TS_PACKET_SIZE) {
+			memcpy(filter->carry, data + pos, size - pos);
+			filter->carry_size = (guint)(size - pos);
+			break;
+		}
+
+		gst_ts_filter_parse_packet(filter, data + pos);
+		pos += TS_PACKET_SIZE;
+	}
+}
+
+/*
+* Queue the partial batch. It is called at the end of the input.
+*/
+void
+gst_ts_filter_flush(GstTsFilter * filter)
+{
+	if (filter->batch == NULL)
+		return;
+
+	gst_buffer_unmap(filter->batch, &filter->batch_map);
+	gst_buffer_set_size(filter->batch, filter->batch_filled * TS_PACKET_SIZE);
+	g_queue_push_tail(&filter->batches, filter->batch);
+
+	filter->batch = NULL;
+	filter->batch_filled = 0;
+}
+
+/*
+* Take the next complete batch. NULL if there is none.
+*/
+GstBuffer *
+gst_ts_filter_pop(GstTsFilter * filter)
+{
+	return g_queue_pop_head(&filter->batches);
+}
+
+/*
+* Decide what to do with a TS packet
+*/
+static void
+gst_ts_filter_parse_packet(GstTsFilter * filter, const guint8 * packet)
+{
+	guint16 pid = ((packet[1] & 0x1f) << 8) | packet[2];
+
+	filter->packets_in++;
+
+	if (pid == TS_PAT_PID)
+		gst_ts_filter_parse_pat(filter, packet);
+	else if (pid == filter->pmt_pid || (filter->program_number < 0 && (filter->pids[pid] & TS_FILTER_PID_PMT)))
+		gst_ts_filter_parse_pmt(filter, packet, pid);
+	else if (filter->program_number < 0)
+		return;
+	else if (filter->pids[pid] & TS_FILTER_PID_SELECTED)
+		gst_ts_filter_output(filter, packet);
+	else if (pid == filter->pcr_pid)
+		gst_ts_filter_output_pcr(filter, packet);
+}
+
+/*
+* Keep the PAT and learn the PMT PIDs. Only the program being forwarded is listed in the output.
+*/
+static void
+gst_ts_filter_parse_pat(GstTsFilter * filter, const guint8 * packet)
+{
+	guint section_pos, section_size;
+
+	if (!gst_ts_filter_find_section(packet, &section_pos, &section_size) ||
+		packet[section_pos] != TS_TABLE_ID_PAT) {
+		// A PAT split across the packets is forwarded as it is
+		if (filter->program_number >= 0)
+			gst_ts_filter_output(filter, packet);
+		return;
+	}
+
+	// The PMTs of every program are looked into until the program is found
+	if (filter->program_number < 0) {
+		guint end = section_pos + section_size - TS_CRC_SIZE;
+
+		for (guint pos = section_pos + TS_PAT_HEADER_SIZE; pos + 4 <= end; pos += 4) {
+			guint16 number = (packet[pos] << 8) | packet[pos + 1];
+			guint16 pmt_pid = ((packet[pos + 2] & 0x1f) << 8) | packet[pos + 3];
+
+			// The program 0 is the network PID
+			if (number != 0)
+				filter->pids[pmt_pid] |= TS_FILTER_PID_PMT;
+		}
+	}
+
+	memcpy(filter->pat_packet, packet, TS_PACKET_SIZE);
+	filter->has_pat = TRUE;
+
+	if (filter->program_number >= 0)
+		gst_ts_filter_output_pat(filter);
+}
+
+/*
+* Find the program of the selected PIDs and forward its PMT listing only them
+*/
+static void
+gst_ts_filter_parse_pmt(GstTsFilter * filter, const guint8 * packet, guint16 pid)
+{
+	guint8 out[TS_PACKET_SIZE];
+	guint section_pos, section_size;
+	guint pos, end, out_pos, program_info_length, section_length;
+	guint16 program_number;
+	gboolean has_selected = FALSE;
+	guint32 crc;
+
+	if (!gst_ts_filter_find_section(packet, &section_pos, &section_size) ||
+		packet[section_pos] != TS_TABLE_ID_PMT || section_size < TS_PMT_HEADER_SIZE + TS_CRC_SIZE) {
+		// A PMT split across the packets is forwarded as it is
+		if (pid == filter->pmt_pid)
+			gst_ts_filter_output(filter, packet);
+		return;
+	}
+
+	program_number = (packet[section_pos + 3] << 8) | packet[section_pos + 4];
+	program_info_length = ((packet[section_pos + 10] & 0x0f) << 8) | packet[section_pos + 11];
+	pos = section_pos + TS_PMT_HEADER_SIZE + program_info_length;
+	end = section_pos + section_size - TS_CRC_SIZE;
+	if (pos > end)
+		return;
+
+	// Copy the header and the program descriptors and keep only the selected streams
+	memcpy(out, packet, pos);
+	out_pos = pos;
+
+	while (pos + 5 <= end) {
+		guint16 es_pid = ((packet[pos + 1] & 0x1f) << 8) | packet[pos + 2];
+		guint es_info_length = ((packet[pos + 3] & 0x0f) << 8) | packet[pos + 4];
+		guint entry_size = 5 + es_info_length;
+
+		if (pos + entry_size > end)
+			break;
+
+		if (!filter->has_requested_pids || (filter->pids[es_pid] & TS_FILTER_PID_REQUESTED)) {
+			memcpy(out + out_pos, packet + pos, entry_size);
+			out_pos += entry_size;
+			has_selected = TRUE;
+
+			if (filter->program_number < 0 || pid == filter->pmt_pid)
+				filter->pids[es_pid] |= TS_FILTER_PID_SELECTED;
+		}
+
+		pos += entry_size;
+	}
+
+	// The other programs are not forwarded
+	if (filter->program_number < 0) {
+		if (!has_selected)
+			return;
+
+		filter->program_number = program_number;
+		filter->pmt_pid = pid;
+		GST_INFO("Forwarding the program %u (PMT PID %u)", program_number, pid);
+
+		// The PAT goes out before the first PMT
+		if (filter->has_pat)
+			gst_ts_filter_output_pat(filter);
+	}
+	else if (program_number != filter->program_number) {
+		return;
+	}
+
+	filter->pcr_pid = ((packet[section_pos + 8] & 0x1f) << 8) | packet[section_pos + 9];
+
+	section_length = out_pos - (section_pos + 3) + TS_CRC_SIZE;
+	out[section_pos + 1] = (packet[section_pos + 1] & 0xf0) | ((section_length >> 8) & 0x0f);
+	out[section_pos + 2] = section_length & 0xff;
+
+	crc = gst_ts_filter_crc32(out + section_pos, out_pos - section_pos);
+	GST_WRITE_UINT32_BE(out + out_pos, crc);
+	out_pos += TS_CRC_SIZE;
+
+	memset(out + out_pos, 0xff, TS_PACKET_SIZE - out_pos);
+	gst_ts_filter_output(filter, out);
+}
+
+/*
+* Forward the latest PAT listing only the program being forwarded
+*/
+static void
+gst_ts_filter_output_pat(GstTsFilter * filter)
+{
+	guint8 out[TS_PACKET_SIZE];
+	guint section_pos, section_size, out_pos;
+	guint section_length;
+	guint32 crc;
+
+	gst_ts_filter_find_section(filter->pat_packet, &section_pos, &section_size);
+
+	memcpy(out, filter->pat_packet, section_pos + TS_PAT_HEADER_SIZE);
+	out_pos = section_pos + TS_PAT_HEADER_SIZE;
+
+	GST_WRITE_UINT16_BE(out + out_pos, filter->program_number);
+	GST_WRITE_UINT16_BE(out + out_pos + 2, 0xe000 | filter->pmt_pid);
+	out_pos += 4;
+
+	section_length = TS_PAT_HEADER_SIZE - 3 + 4 + TS_CRC_SIZE;
+	out[section_pos + 1] = (filter->pat_packet[section_pos + 1] & 0xf0) | ((section_length >> 8) & 0x0f);
+	out[section_pos + 2] = section_length & 0xff;
+
+	crc = gst_ts_filter_crc32(out + section_pos, out_pos - section_pos);
+	GST_WRITE_UINT32_BE(out + out_pos, crc);
+	out_pos += TS_CRC_SIZE;
+
+	memset(out + out_pos, 0xff, TS_PACKET_SIZE - out_pos);
+	gst_ts_filter_output(filter, out);
+}
+
+/*
+* The PCR of the program is on a stream which is not selected. Only its adaptation field is forwarded.
+* The packets without payload do not advance the continuity counter.
+*/
+static void
+gst_ts_filter_output_pcr(GstTsFilter * filter, const guint8 * packet)
+{
+	guint8 out[TS_PACKET_SIZE];
+
+	if (!(packet[3] & 0x20) || packet[4] < 7 || !(packet[5] & 0x10))
+		return;
+
+	out[0] = TS_SYNC_BYTE;
+	out[1] = packet[1] & 0x1f;
+	out[2] = packet[2];
+	out[3] = 0x20 | (packet[3] & 0x0f);
+
+	// Keep the discontinuity indicator and the PCR
+	out[4] = TS_PACKET_SIZE - 5;
+	out[5] = packet[5] & 0x90;
+	memcpy(out + 6, packet + 6, 6);
+	memset(out + 12, 0xff, TS_PACKET_SIZE - 12);
+
+	gst_ts_filter_output(filter, out);
+}
+
+/*
+* Copy the packet into the batch. The full batch is queued.
+*/
+static void
+gst_ts_filter_output(GstTsFilter * filter, const guint8 * packet)
+{
+	if (filter->batch == NULL) {
+		filter->batch = gst_buffer_new_allocate(NULL, filter->batch_packets * TS_PACKET_SIZE, NULL);
+		gst_buffer_map(filter->batch, &filter->batch_map, GST_MAP_WRITE);
+		filter->batch_filled = 0;
+	}
+
+	memcpy(filter->batch_map.data + filter->batch_filled * TS_PACKET_SIZE, packet, TS_PACKET_SIZE);
+	filter->batch_filled++;
+	filter->packets_out++;
+
+	if (filter->batch_filled == filter->batch_packets)
+		gst_ts_filter_flush(filter);
+}
+
+/*
+* Find the section starting in the packet. Only the sections contained in the packet are handled.
+*/
+static gboolean
+gst_ts_filter_find_section(const guint8 * packet, guint * section_pos, guint * section_size)
+{
+	guint pos = 4;
+	guint size;
+
+	// The section has to start in the payload right after the pointer field
+	if (!(packet[1] & 0x40) || !(packet[3] & 0x10))
+		return FALSE;
+
+	if (packet[3] & 0x20)
+		pos += 1 + packet[4];
+
+	if (pos >= TS_PACKET_SIZE - 1 || packet[pos] != 0)
+		return FALSE;
+	pos++;
+
+	if (pos + 3 > TS_PACKET_SIZE)
+		return FALSE;
+
+	size = 3 + (((packet[pos + 1] & 0x0f) << 8) | packet[pos + 2]);
+	if (pos + size > TS_PACKET_SIZE)
+		return FALSE;
+
+	*section_pos = pos;
+	*section_size = size;
+
+	return TRUE;
+}
+
+/*
+* CRC-32/MPEG-2 of the section
+*/
+static guint32
+gst_ts_filter_crc32(const guint8 * data, gsize size)
+{
+	guint32 crc = 0xffffffff;
+
+	for (gsize i = 0; i < size; i++)
+		crc = (crc << 8) ^ crc32_table[((crc >> 24) ^ data[i]) & 0xff];
+
+	return crc;
+}
+
+/*
+* Set the debug category and build the CRC table
+*/
+void
+init_tsfilter(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_tsfilter_debug, "tsfilter", 0, "TS Packet Filter");
+
+	for (guint32 i = 0; i < 256; i++) {
+		guint32 crc = i << 24;
+
+		for (gint bit = 0; bit < 8; bit++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04c11db7 : crc << 1;
+
+		crc32_table[i] = crc;
+	}
+}
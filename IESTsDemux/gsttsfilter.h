@@ -0,0 +1,74 @@
+#ifndef __GST_TSFILTER_H__
+#define __GST_TSFILTER_H__
+
+#include <gst/gst.h>
+
+#include "gsttsscan.h"
+
+G_BEGIN_DECLS
+
+// The size of the batches pushed on the TS pad by default. 348 packets fill 64 KiB.
+#define TS_FILTER_DEFAULT_BATCH_PACKETS	348
+
+// The filter follows the offset of the first data it gets
+#define TS_FILTER_NO_OFFSET		G_MAXUINT64
+
+typedef struct _GstTsFilter GstTsFilter;
+
+/*
+* Forwards the TS packets of the selected PIDs of one program. The PAT and the PMT are rewritten to list only them.
+* The packets are copied into batches of N x 188 bytes without looking into the PES.
+*/
+struct _GstTsFilter
+{
+	// The partial TS packet left over from the previous read
+	guint8		carry[TS_PACKET_SIZE];
+	guint		carry_size;
+
+	// The input is forwarded once. The reads behind or ahead of this offset are skipped.
+	guint64		next_offset;
+
+	// TS_FILTER_PID_* flags for every PID
+	guint8		pids[TS_MAX_PIDS];
+	gboolean	has_requested_pids;
+
+	// The program carrying the selected PIDs. It is -1 until its PMT has been seen.
+	gint		program_number;
+	gint		pmt_pid;
+	gint		pcr_pid;
+
+	// The latest PAT. It is sent once the program has been found.
+	guint8		pat_packet[TS_PACKET_SIZE];
+	gboolean	has_pat;
+
+	// The batch being filled and the batches ready to be pushed
+	guint		batch_packets;
+	GstBuffer	*batch;
+	GstMapInfo	batch_map;
+	guint		batch_filled;
+	GQueue		batches;
+
+	// Statistics
+	guint64		packets_in;
+	guint64		packets_out;
+};
+
+void init_tsfilter(void);
+
+GstTsFilter * gst_ts_filter_new(void);
+
+void gst_ts_filter_free(GstTsFilter * filter);
+
+gboolean gst_ts_filter_configure(GstTsFilter * filter, const gchar * pids, guint batch_packets);
+
+void gst_ts_filter_reset(GstTsFilter * filter, guint64 offset);
+
+void gst_ts_filter_parse(GstTsFilter * filter, guint64 offset, const guint8 * data, gsize size);
+
+void gst_ts_filter_flush(GstTsFilter * filter);
+
+GstBuffer * gst_ts_filter_pop(GstTsFilter * filter);
+
+G_END_DECLS
+
+#endif /* __GST_TSFILTER_H__ */
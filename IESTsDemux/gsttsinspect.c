@@ -0,0 +1,487 @@
+#include "gsttsinspect.h"
+
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_tsinspect_debug);
+#define GST_CAT_DEFAULT gst_tsinspect_debug
+
+// The PCR and the monitoring timeline are in 27 MHz
+#define TS_TICKS_TO_TIME(ticks)		gst_util_uint64_scale(ticks, GST_SECOND, 27000000)
+#define TS_TIME_TO_TICKS(time)		gst_util_uint64_scale(time, 27000000, GST_SECOND)
+
+// The PCR wraps at 2^33 * 300
+#define TS_PCR_WRAP					(G_GUINT64_CONSTANT(300) << 33)
+
+#define TS_INSPECT_NONE				G_MAXUINT64
+
+static void gst_ts_inspector_parse_packet(GstTsInspector * inspector, const guint8 * packet);
+static void gst_ts_inspector_monitor_packet(GstTsInspector * inspector, const guint8 * packet, guint16 pid,
+	gboolean has_pcr, guint64 pcr, gboolean discontinuity);
+static void gst_ts_inspector_monitor_pcr(GstTsInspector * inspector, GstTsPidStats * stats, guint16 pid,
+	guint64 pcr, gboolean discontinuity);
+static void gst_ts_inspector_monitor_pat(GstTsInspector * inspector, const guint8 * packet);
+static GstTsPidStats * gst_ts_inspector_get_pid_stats(GstTsInspector * inspector, guint16 pid);
+
+/*
+* Allocate a new inspector. It looks for nothing until a consumer is set.
+*/
+GstTsInspector *
+gst_ts_inspector_new(void)
+{
+	GstTsInspector *inspector = g_new0(GstTsInspector, 1);
+
+	inspector->pcr_pid = -1;
+	inspector->pcr_func = NULL;
+	inspector->pcr_user_data = NULL;
+
+	inspector->monitor = FALSE;
+	inspector->monitor_interval = GST_SECOND;
+	inspector->pid_stats = NULL;
+
+	gst_ts_inspector_reset(inspector);
+
+	return inspector;
+}
+
+void
+gst_ts_inspector_free(GstTsInspector * inspector)
+{
+	gst_ts_inspector_reset(inspector);
+	g_free(inspector->pid_stats);
+	g_free(inspector);
+}
+
+/*
+* Forget the partial packet and the statistics. It is called when the input changes.
+*/
+void
+gst_ts_inspector_reset(GstTsInspector * inspector)
+{
+	inspector->carry_size = 0;
+	inspector->packets = 0;
+	inspector->sync_losses = 0;
+
+	inspector->clock_pid = -1;
+	inspector->now = 0;
+	inspector->window_start = 0;
+	inspector->transport_errors = 0;
+
+	if (inspector->pid_stats != NULL) {
+		for (guint pid = 0; pid < TS_MAX_PIDS; pid++) {
+			g_free(inspector->pid_stats[pid]);
+			inspector->pid_stats[pid] = NULL;
+		}
+	}
+}
+
+/*
+* Forget the partial packet and the continuity of every PID. It is called when the read position jumps.
+* The counters are kept.
+*/
+void
+gst_ts_inspector_discontinue(GstTsInspector * inspector)
+{
+	inspector->carry_size = 0;
+
+	if (inspector->pid_stats == NULL)
+		return;
+
+	for (guint pid = 0; pid < TS_MAX_PIDS; pid++) {
+		GstTsPidStats *stats = inspector->pid_stats[pid];
+
+		if (stats == NULL)
+			continue;
+
+		stats->last_cc = -1;
+		stats->cc_repeats = 0;
+		stats->last_pcr_packet = TS_INSPECT_NONE;
+		stats->prev_pcr_packet = TS_INSPECT_NONE;
+		stats->table_last_seen = TS_INSPECT_NONE;
+	}
+}
+
+/*
+* Set the PID whose PCR is reported to the function. -1 disables it and TS_INSPECT_ANY_PID reports every PID.
+*/
+void
+gst_ts_inspector_set_pcr_func(GstTsInspector * inspector, gint pid, GstTsInspectorPcrFunc func, gpointer user_data)
+{
+	inspector->pcr_pid = pid;
+	inspector->pcr_func = func;
+	inspector->pcr_user_data = user_data;
+}
+
+/*
+* Turn the transport monitoring on or off. The statistics are taken every interval of the PCR timeline.
+*/
+void
+gst_ts_inspector_set_monitor(GstTsInspector * inspector, gboolean monitor, GstClockTime interval)
+{
+	inspector->monitor = monitor;
+	inspector->monitor_interval = interval;
+
+	if (monitor && inspector->pid_stats == NULL)
+		inspector->pid_stats = g_new0(GstTsPidStats *, TS_MAX_PIDS);
+}
+
+/*
+* Inspect the data read from the source. The TS packets may be split across the reads.
+*/
+void
+gst_ts_inspector_parse(GstTsInspector * inspector, const guint8 * data, gsize size)
+{
+	gsize pos = 0;
+
+	if (!inspector->monitor && (inspector->pcr_func == NULL || inspector->pcr_pid == -1))
+		return;
+
+	// Complete the packet left over from the previous read
+	if (inspector->carry_size > 0) {
+		gsize needed = TS_PACKET_SIZE - inspector->carry_size;
+
+		if (size < needed) {
+			memcpy(inspector->carry + inspector->carry_size, data, size);
+			inspector->carry_size += size;
+			return;
+		}
+
+		memcpy(inspector->carry + inspector->carry_size, data, needed);
+		inspector->packet_position = -(gint64)inspector->carry_size;
+		gst_ts_inspector_parse_packet(inspector, inspector->carry);
+		inspector->carry_size = 0;
+		pos = needed;
+	}
+
+	while (pos < size) {
+		// Find the sync byte again
+		if (data[pos] != TS_SYNC_BYTE) {
+			GST_DEBUG("Lost the TS sync after %" G_GUINT64_FORMAT " packets", inspector->packets);
+			inspector->sync_losses++;
+			while (pos < size && data[pos] != TS_SYNC_BYTE)
+				pos++;
+			continue;
+		}
+
+		if (size - pos < TS_PACKET_SIZE) {
+			memcpy(inspector->carry, data + pos, size - pos);
+			inspector->carry_size = (guint)(size - pos);
+			break;
+		}
+
+		inspector->packet_position = (gint64)pos;
+		gst_ts_inspector_parse_packet(inspector, data + pos);
+		pos += TS_PACKET_SIZE;
+	}
+}
+
+/*
+* Take the statistics of the window once the interval has passed. NULL until then.
+*/
+GstStructure *
+gst_ts_inspector_take_stats(GstTsInspector * inspector)
+{
+	GstStructure *structure;
+	GValue pid_array = G_VALUE_INIT;
+	guint64 window = inspector->now - inspector->window_start;
+	guint64 table_limit = TS_TIME_TO_TICKS(TS_INSPECT_TABLE_INTERVAL);
+	guint64 bitrate = 0;
+
+	if (!inspector->monitor || inspector->clock_pid < 0 || window == 0 ||
+		window < TS_TIME_TO_TICKS(inspector->monitor_interval))
+		return NULL;
+
+	g_value_init(&pid_array, GST_TYPE_ARRAY);
+
+	for (guint pid = 0; pid < TS_MAX_PIDS; pid++) {
+		GstTsPidStats *stats = inspector->pid_stats[pid];
+		GstStructure *pid_structure;
+		GValue value = G_VALUE_INIT;
+		guint64 pid_bitrate;
+
+		if (stats == NULL)
+			continue;
+
+		// The table which stopped repeating is reported without waiting for it to come back
+		if (stats->is_table && stats->table_last_seen != TS_INSPECT_NONE && !stats->table_missing &&
+			inspector->now - stats->table_last_seen > table_limit) {
+			stats->table_errors++;
+			stats->table_missing = TRUE;
+		}
+
+		pid_bitrate = gst_util_uint64_scale(stats->window_packets * TS_PACKET_SIZE * 8, 27000000, window);
+		bitrate += pid_bitrate;
+
+		pid_structure = gst_structure_new("pid",
+			"pid", G_TYPE_UINT, pid,
+			"packets", G_TYPE_UINT64, stats->packets,
+			"bitrate", G_TYPE_UINT64, pid_bitrate,
+			"cc-errors", G_TYPE_UINT64, stats->cc_errors, NULL);
+
+		if (stats->is_table) {
+			gst_structure_set(pid_structure,
+				"table-errors", G_TYPE_UINT64, stats->table_errors,
+				"table-max-interval", G_TYPE_UINT64, TS_TICKS_TO_TIME(stats->table_max_interval), NULL);
+		}
+
+		if (stats->pcr_count > 0) {
+			gst_structure_set(pid_structure,
+				"pcr-count", G_TYPE_UINT64, stats->pcr_count,
+				"pcr-interval-errors", G_TYPE_UINT64, stats->pcr_interval_errors,
+				"pcr-max-interval", G_TYPE_UINT64, TS_TICKS_TO_TIME(stats->pcr_max_interval),
+				"pcr-jitter-max", G_TYPE_UINT64, TS_TICKS_TO_TIME(stats->pcr_jitter_max),
+				"pcr-jitter-avg", G_TYPE_UINT64, stats->pcr_jitter_count > 0 ?
+					TS_TICKS_TO_TIME(stats->pcr_jitter_sum / stats->pcr_jitter_count) : 0, NULL);
+		}
+
+		g_value_init(&value, GST_TYPE_STRUCTURE);
+		gst_value_set_structure(&value, pid_structure);
+		gst_value_array_append_value(&pid_array, &value);
+		g_value_unset(&value);
+		gst_structure_free(pid_structure);
+
+		// The next window starts
+		stats->window_packets = 0;
+		stats->table_max_interval = 0;
+		stats->pcr_max_interval = 0;
+		stats->pcr_jitter_max = 0;
+		stats->pcr_jitter_sum = 0;
+		stats->pcr_jitter_count = 0;
+	}
+
+	structure = gst_structure_new("ts-monitor",
+		"window", G_TYPE_UINT64, TS_TICKS_TO_TIME(window),
+		"packets", G_TYPE_UINT64, inspector->packets,
+		"bitrate", G_TYPE_UINT64, bitrate,
+		"sync-losses", G_TYPE_UINT64, inspector->sync_losses,
+		"transport-errors", G_TYPE_UINT64, inspector->transport_errors,
+		"pcr-pid", G_TYPE_INT, inspector->clock_pid, NULL);
+	gst_structure_take_value(structure, "pids", &pid_array);
+
+	inspector->window_start = inspector->now;
+
+	return structure;
+}
+
+/*
+* Look into the header and the adaptation field of a TS packet
+*/
+static void
+gst_ts_inspector_parse_packet(GstTsInspector * inspector, const guint8 * packet)
+{
+	guint16 pid = ((packet[1] & 0x1f) << 8) | packet[2];
+	guint8 adaptation_field_control = (packet[3] >> 4) & 0x3;
+	guint8 af_length, af_flags;
+	gboolean has_pcr = FALSE;
+	gboolean discontinuity = FALSE;
+	guint64 pcr = 0;
+
+	inspector->packets++;
+
+	if (adaptation_field_control & 0x2) {
+		af_length = packet[4];
+		af_flags = packet[5];
+
+		if (af_length > 0 && af_length <= TS_PACKET_SIZE - 5) {
+			discontinuity = (af_flags & 0x80) != 0;
+
+			if (af_length >= 7 && (af_flags & 0x10)) {
+				guint64 pcr_base = ((guint64)packet[6] << 25) | (packet[7] << 17) | (packet[8] << 9) |
+					(packet[9] << 1) | (packet[10] >> 7);
+				guint64 pcr_ext = ((packet[10] & 0x1) << 8) | packet[11];
+
+				pcr = pcr_base * 300 + pcr_ext;
+				has_pcr = TRUE;
+			}
+		}
+	}
+
+	if (inspector->monitor)
+		gst_ts_inspector_monitor_packet(inspector, packet, pid, has_pcr, pcr, discontinuity);
+
+	if (has_pcr && (pid == inspector->pcr_pid || inspector->pcr_pid == TS_INSPECT_ANY_PID) && inspector->pcr_func != NULL)
+		inspector->pcr_func(pid, pcr, discontinuity, inspector->pcr_user_data);
+}
+
+/*
+* Count the packet, check its continuity counter and the repetition of the tables
+*/
+static void
+gst_ts_inspector_monitor_packet(GstTsInspector * inspector, const guint8 * packet, guint16 pid,
+	gboolean has_pcr, guint64 pcr, gboolean discontinuity)
+{
+	GstTsPidStats *stats;
+	gint cc = packet[3] & 0x0f;
+
+	if (packet[1] & 0x80)
+		inspector->transport_errors++;
+
+	if (pid == TS_NULL_PID)
+		return;
+
+	stats = gst_ts_inspector_get_pid_stats(inspector, pid);
+	stats->packets++;
+	stats->window_packets++;
+
+	// Only the packets with payload advance the counter. A packet may be sent twice, but not three times (1.4).
+	if (packet[3] & 0x10) {
+		if (stats->last_cc < 0 || discontinuity) {
+			stats->cc_repeats = 0;
+		}
+		else if (cc == stats->last_cc) {
+			if (++stats->cc_repeats > 1) {
+				GST_LOG("Continuity error on PID %u: %d sent %u times", pid, cc, stats->cc_repeats + 1);
+				stats->cc_errors++;
+			}
+		}
+		else {
+			stats->cc_repeats = 0;
+			if (cc != ((stats->last_cc + 1) & 0x0f)) {
+				GST_LOG("Continuity error on PID %u: %d after %d", pid, cc, stats->last_cc);
+				stats->cc_errors++;
+			}
+		}
+		stats->last_cc = cc;
+	}
+
+	if (has_pcr)
+		gst_ts_inspector_monitor_pcr(inspector, stats, pid, pcr, discontinuity);
+
+	// A section starts
+	if (stats->is_table && (packet[1] & 0x40)) {
+		if (stats->table_last_seen != TS_INSPECT_NONE) {
+			guint64 interval = inspector->now - stats->table_last_seen;
+
+			stats->table_max_interval = MAX(stats->table_max_interval, interval);
+			if (interval > TS_TIME_TO_TICKS(TS_INSPECT_TABLE_INTERVAL) && !stats->table_missing)
+				stats->table_errors++;
+		}
+
+		stats->table_last_seen = inspector->now;
+		stats->table_missing = FALSE;
+
+		if (pid == TS_PAT_PID)
+			gst_ts_inspector_monitor_pat(inspector, packet);
+	}
+}
+
+/*
+* Check the interval and the jitter of the PCR. The jitter is the distance from where the PCR would be
+* if the bytes had kept the rate between the previous two PCR.
+*/
+static void
+gst_ts_inspector_monitor_pcr(GstTsInspector * inspector, GstTsPidStats * stats, guint16 pid,
+	guint64 pcr, gboolean discontinuity)
+{
+	gboolean is_continuous = FALSE;
+
+	stats->pcr_count++;
+
+	if (inspector->clock_pid < 0)
+		inspector->clock_pid = pid;
+
+	if (stats->last_pcr_packet != TS_INSPECT_NONE && !discontinuity) {
+		guint64 delta = (pcr + TS_PCR_WRAP - stats->last_pcr) % TS_PCR_WRAP;
+
+		if (delta <= TS_TIME_TO_TICKS(TS_INSPECT_MAX_PCR_GAP)) {
+			is_continuous = TRUE;
+
+			stats->pcr_max_interval = MAX(stats->pcr_max_interval, delta);
+			if (delta > TS_TIME_TO_TICKS(TS_INSPECT_PCR_INTERVAL))
+				stats->pcr_interval_errors++;
+
+			if (stats->prev_pcr_packet != TS_INSPECT_NONE) {
+				guint64 rate_ticks = (stats->last_pcr + TS_PCR_WRAP - stats->prev_pcr) % TS_PCR_WRAP;
+				guint64 rate_packets = stats->last_pcr_packet - stats->prev_pcr_packet;
+				guint64 expected, jitter;
+
+				if (rate_packets > 0) {
+					expected = rate_ticks * (inspector->packets - stats->last_pcr_packet) / rate_packets;
+					jitter = delta > expected ? delta - expected : expected - delta;
+
+					stats->pcr_jitter_max = MAX(stats->pcr_jitter_max, jitter);
+					stats->pcr_jitter_sum += jitter;
+					stats->pcr_jitter_count++;
+				}
+			}
+
+			// The first PID carrying the PCR drives the timeline
+			if (pid == inspector->clock_pid)
+				inspector->now += delta;
+		}
+	}
+
+	stats->prev_pcr = stats->last_pcr;
+	stats->prev_pcr_packet = is_continuous ? stats->last_pcr_packet : TS_INSPECT_NONE;
+	stats->last_pcr = pcr;
+	stats->last_pcr_packet = inspector->packets;
+}
+
+/*
+* The PMT PIDs listed in the PAT are checked for their repetition as well
+*/
+static void
+gst_ts_inspector_monitor_pat(GstTsInspector * inspector, const guint8 * packet)
+{
+	guint pos = 4;
+	guint section_end;
+
+	if (!(packet[3] & 0x10))
+		return;
+
+	if (packet[3] & 0x20)
+		pos += 1 + packet[4];
+
+	// Skip the pointer field. Only the section contained in the packet is looked into.
+	if (pos >= TS_PACKET_SIZE)
+		return;
+	pos += 1 + packet[pos];
+
+	if (pos + 8 > TS_PACKET_SIZE || packet[pos] != 0x00)
+		return;
+
+	section_end = pos + 3 + (((packet[pos + 1] & 0x0f) << 8) | packet[pos + 2]);
+	if (section_end > TS_PACKET_SIZE)
+		return;
+
+	// The program loop ends before the CRC
+	for (pos += 8; pos + 4 <= section_end - 4; pos += 4) {
+		guint16 number = (packet[pos] << 8) | packet[pos + 1];
+		guint16 pmt_pid = ((packet[pos + 2] & 0x1f) << 8) | packet[pos + 3];
+
+		// The program 0 is the network PID
+		if (number != 0)
+			gst_ts_inspector_get_pid_stats(inspector, pmt_pid)->is_table = TRUE;
+	}
+}
+
+/*
+* Find the statistics of the PID or start them
+*/
+static GstTsPidStats *
+gst_ts_inspector_get_pid_stats(GstTsInspector * inspector, guint16 pid)
+{
+	GstTsPidStats *stats = inspector->pid_stats[pid];
+
+	if (stats != NULL)
+		return stats;
+
+	stats = g_new0(GstTsPidStats, 1);
+	stats->last_cc = -1;
+	stats->is_table = (pid == TS_PAT_PID);
+	stats->table_last_seen = TS_INSPECT_NONE;
+	stats->last_pcr_packet = TS_INSPECT_NONE;
+	stats->prev_pcr_packet = TS_INSPECT_NONE;
+
+	inspector->pid_stats[pid] = stats;
+
+	return stats;
+}
+
+/*
+* Set the debug category
+*/
+void
+init_tsinspect(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_tsinspect_debug, "tsinspect", 0, "TS Packet Inspector");
+}
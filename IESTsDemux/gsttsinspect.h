@@ -0,0 +1,116 @@
+#ifndef __GST_TSINSPECT_H__
+#define __GST_TSINSPECT_H__
+
+#include <gst/gst.h>
+
+#include "gsttsscan.h"
+
+G_BEGIN_DECLS
+
+// TR 101 290 limits. The PAT and the PMT repeat within 0.5 s and the PCR within 40 ms.
+#define TS_INSPECT_TABLE_INTERVAL	(500 * GST_MSECOND)
+#define TS_INSPECT_PCR_INTERVAL		(40 * GST_MSECOND)
+
+// A PCR further than this from the previous one does not advance the timeline
+#define TS_INSPECT_MAX_PCR_GAP		(1 * GST_SECOND)
+
+// Reports the PCR of every PID while the program is not known yet
+#define TS_INSPECT_ANY_PID			(-2)
+
+// The last byte of the PCR in a packet carrying one
+#define TS_INSPECT_PCR_END			11
+
+typedef struct _GstTsPidStats	GstTsPidStats;
+typedef struct _GstTsInspector	GstTsInspector;
+
+/*
+* Called for every PCR of the selected PID. The PCR is in 27 MHz and not unwrapped.
+*/
+typedef void (*GstTsInspectorPcrFunc)(guint16 pid, guint64 pcr, gboolean discontinuity, gpointer user_data);
+
+/*
+* The health of a PID. The counters add up from the start. The maximums, the jitter and the bitrate are over the window.
+* The times are in 27 MHz.
+*/
+struct _GstTsPidStats
+{
+	guint64		packets;
+	guint64		window_packets;
+
+	// The packets sent again with the last counter in a row
+	gint		last_cc;
+	guint		cc_repeats;
+	guint64		cc_errors;
+
+	// The PAT or a PMT
+	gboolean	is_table;
+	guint64		table_last_seen;
+	gboolean	table_missing;
+	guint64		table_errors;
+	guint64		table_max_interval;
+
+	// The last two PCR and the packet index where they were
+	guint64		pcr_count;
+	guint64		last_pcr;
+	guint64		last_pcr_packet;
+	guint64		prev_pcr;
+	guint64		prev_pcr_packet;
+	guint64		pcr_interval_errors;
+	guint64		pcr_max_interval;
+	guint64		pcr_jitter_max;
+	guint64		pcr_jitter_sum;
+	guint64		pcr_jitter_count;
+};
+
+/*
+* Looks into the TS packets on their way to libav
+*/
+struct _GstTsInspector
+{
+	// The partial TS packet left over from the previous read
+	guint8		carry[TS_PACKET_SIZE];
+	guint		carry_size;
+
+	// Where the packet being parsed starts in the data given to the parse. It is negative for the packet
+	// completed from the carry.
+	gint64		packet_position;
+
+	gint		pcr_pid;
+	GstTsInspectorPcrFunc	pcr_func;
+	gpointer	pcr_user_data;
+
+	// Statistics
+	guint64		packets;
+	guint64		sync_losses;
+
+	// Transport monitoring. The PCR of the first PID carrying one is the timeline of the windows.
+	gboolean	monitor;
+	GstClockTime	monitor_interval;
+	GstTsPidStats	**pid_stats;
+	gint		clock_pid;
+	guint64		now;
+	guint64		window_start;
+	guint64		transport_errors;
+};
+
+void init_tsinspect(void);
+
+GstTsInspector * gst_ts_inspector_new(void);
+
+void gst_ts_inspector_free(GstTsInspector * inspector);
+
+void gst_ts_inspector_reset(GstTsInspector * inspector);
+
+void gst_ts_inspector_discontinue(GstTsInspector * inspector);
+
+void gst_ts_inspector_set_pcr_func(GstTsInspector * inspector, gint pid, GstTsInspectorPcrFunc func, gpointer user_data);
+
+void gst_ts_inspector_parse(GstTsInspector * inspector, const guint8 * data, gsize size);
+
+void gst_ts_inspector_set_monitor(GstTsInspector * inspector, gboolean monitor, GstClockTime interval);
+
+GstStructure * gst_ts_inspector_take_stats(GstTsInspector * inspector);
+
+G_END_DECLS
+
+#endif /* __GST_TSINSPECT_H__ */
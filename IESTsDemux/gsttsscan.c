@@ -0,0 +1,578 @@
+#include "gsttsscan.h"
+
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glib/gstdio.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(gst_tsscan_debug);
+#define GST_CAT_DEFAULT gst_tsscan_debug
+
+// Each worker reads this many TS packets at once
+#define TS_SCAN_READ_SIZE		(TS_PACKET_SIZE * 4096)
+
+// A range smaller than this is not worth a thread
+#define TS_SCAN_MIN_RANGE_SIZE	(TS_SCAN_READ_SIZE * 4)
+
+#define TS_SCAN_MAX_THREADS		64
+
+#define TS_PTS_WRAP				(G_GINT64_CONSTANT(1) << 33)
+#define TS_PCR_WRAP				(TS_PTS_WRAP * 300)
+
+typedef struct _GstTsScanSource	GstTsScanSource;
+typedef struct _GstTsScanPes	GstTsScanPes;
+typedef struct _GstTsScanWorker	GstTsScanWorker;
+
+/*
+* Where the workers read from. The file is read directly when the upstream is a local file.
+*/
+struct _GstTsScanSource
+{
+	GstPad		*sinkpad;
+	gint		fd;
+	guint64		size;
+};
+
+/*
+* The metadata PES being reassembled
+*/
+struct _GstTsScanPes
+{
+	gboolean	is_open;
+
+	guint64		offset;
+	gint64		pts;
+
+	// The payload size signalled in the PES header. It is 0 when it is unbounded.
+	gsize		expected_size;
+	GByteArray	*data;
+};
+
+/*
+* One byte range of the input and what has been found in it
+*/
+struct _GstTsScanWorker
+{
+	const GstTsScanConfig	*config;
+	GstTsScanSource			*source;
+
+	// The TS packets starting in [start, end) belong to this worker
+	guint64		start;
+	guint64		end;
+
+	GstTsScanPes	pes;
+	gboolean		is_done;
+
+	GArray		*entries;
+	guint64		bytes_read;
+	guint		sync_errors;
+};
+
+static gssize gst_ts_scan_read(GstTsScanSource * source, guint64 offset, guint8 * data, gsize size);
+static gint gst_ts_scan_open_file(GstPad * sinkpad);
+static gint64 gst_ts_scan_find_sync(GstTsScanSource * source);
+static gpointer gst_ts_scan_worker_run(gpointer data);
+static void gst_ts_scan_parse_packet(GstTsScanWorker * worker, const guint8 * packet, guint64 offset, gboolean in_range);
+static void gst_ts_scan_begin_pes(GstTsScanWorker * worker, guint64 offset, const guint8 * payload, gint size);
+static void gst_ts_scan_end_pes(GstTsScanWorker * worker);
+static void gst_ts_scan_add_entry(GstTsScanWorker * worker, GstTsScanEntryType type, guint16 pid, guint64 offset, gint64 value, GstBuffer * payload);
+static gint64 gst_ts_scan_parse_pts(const guint8 * pes, gint size);
+static gboolean gst_ts_scan_has_keyframe(const GstTsScanConfig * config, const guint8 * payload, gint size);
+static void gst_ts_scan_unwrap(GArray * entries);
+static void gst_ts_scan_entry_clear(gpointer data);
+
+/*
+* Scan the input with parallel workers. Each worker reads its own byte range aligned to the TS packets.
+* The entries are returned in the order of the byte offset, or NULL if the input can not be scanned.
+*/
+GArray *
+gst_ts_scan_run(GstPad * sinkpad, guint64 size, const GstTsScanConfig * config)
+{
+	GstTsScanSource source;
+	GstTsScanWorker *workers = NULL;
+	GThread **threads = NULL;
+	GArray *entries = NULL;
+	gint64 sync_offset;
+	guint64 range_size, bytes_read = 0;
+	guint num_workers, sync_errors = 0;
+	gint64 started, elapsed;
+
+	g_return_val_if_fail(GST_IS_PAD(sinkpad), NULL);
+	g_return_val_if_fail(config != NULL, NULL);
+
+	source.sinkpad = sinkpad;
+	source.fd = gst_ts_scan_open_file(sinkpad);
+	source.size = size;
+
+	sync_offset = gst_ts_scan_find_sync(&source);
+	if (sync_offset < 0) {
+		GST_WARNING("Could not find the TS sync byte. The input is not scanned.");
+		goto fn_done;
+	}
+
+	// Split the input into ranges of whole TS packets
+	num_workers = config->num_threads > 0 ? config->num_threads : g_get_num_processors();
+	num_workers = CLAMP(num_workers, 1, TS_SCAN_MAX_THREADS);
+	num_workers = MIN(num_workers, MAX(1, (size - sync_offset) / TS_SCAN_MIN_RANGE_SIZE));
+
+	range_size = (size - sync_offset) / num_workers;
+	range_size -= range_size % TS_PACKET_SIZE;
+
+	workers = g_new0(GstTsScanWorker, num_workers);
+	threads = g_new0(GThread *, num_workers);
+
+	started = g_get_monotonic_time();
+
+	for (guint i = 0; i < num_workers; i++) {
+		GstTsScanWorker *worker = &workers[i];
+
+		worker->config = config;
+		worker->source = &source;
+		worker->start = sync_offset + i * range_size;
+		worker->end = (i + 1 < num_workers) ? worker->start + range_size : size;
+		worker->entries = g_array_new(FALSE, FALSE, sizeof(GstTsScanEntry));
+
+		// The first range is scanned in the calling thread
+		if (i > 0)
+			threads[i] = g_thread_new("tsscan", gst_ts_scan_worker_run, worker);
+	}
+
+	gst_ts_scan_worker_run(&workers[0]);
+
+	// Merge the results of the ranges in order
+	entries = g_array_new(FALSE, FALSE, sizeof(GstTsScanEntry));
+	g_array_set_clear_func(entries, gst_ts_scan_entry_clear);
+
+	for (guint i = 0; i < num_workers; i++) {
+		GstTsScanWorker *worker = &workers[i];
+
+		if (threads[i] != NULL)
+			g_thread_join(threads[i]);
+
+		g_array_append_vals(entries, worker->entries->data, worker->entries->len);
+		g_array_free(worker->entries, TRUE);
+
+		bytes_read += worker->bytes_read;
+		sync_errors += worker->sync_errors;
+	}
+
+	gst_ts_scan_unwrap(entries);
+
+	elapsed = g_get_monotonic_time() - started;
+	GST_INFO("Scanned %" G_GUINT64_FORMAT " bytes with %u worker(s) in %" GST_TIME_FORMAT " (%.1f MB/s), %u entries, %u sync errors",
+		bytes_read, num_workers, GST_TIME_ARGS(elapsed * GST_USECOND),
+		elapsed > 0 ? (gdouble)bytes_read / elapsed : 0.0, entries->len, sync_errors);
+
+fn_done:
+	g_free(workers);
+	g_free(threads);
+
+	if (source.fd >= 0)
+		g_close(source.fd, NULL);
+
+	return entries;
+}
+
+/*
+* Read from the source at the given offset. Several workers can read at the same time.
+*/
+static gssize
+gst_ts_scan_read(GstTsScanSource * source, guint64 offset, guint8 * data, gsize size)
+{
+	GstBuffer *buff_read = NULL;
+	GstFlowReturn ret;
+	gsize bytes_read = 0;
+
+#ifdef G_OS_UNIX
+	// Each worker has its own offset on the same file descriptor
+	if (source->fd >= 0) {
+		gssize result;
+
+		while (bytes_read < size) {
+			result = pread(source->fd, data + bytes_read, size - bytes_read, (off_t)(offset + bytes_read));
+			if (result < 0 && errno == EINTR)
+				continue;
+			if (result <= 0)
+				break;
+			bytes_read += result;
+		}
+
+		return bytes_read > 0 ? (gssize)bytes_read : -1;
+	}
+#endif
+
+	// The upstream serializes the pull requests of the workers
+	ret = gst_pad_pull_range(source->sinkpad, offset, (guint)size, &buff_read);
+	if (ret != GST_FLOW_OK)
+		return -1;
+
+	bytes_read = gst_buffer_extract(buff_read, 0, data, size);
+	gst_buffer_unref(buff_read);
+
+	return (gssize)bytes_read;
+}
+
+/*
+* Open the file behind the upstream for the positional reads. It returns -1 unless the upstream is a file source
+* linked directly. An element in between, a parser or a decryptor, may change the data read from the file.
+*/
+static gint
+gst_ts_scan_open_file(GstPad * sinkpad)
+{
+	static const gchar *file_sources[] = { "filesrc", "giosrc" };
+	GstQuery *query;
+	GstPad *peer;
+	GstElement *peer_element = NULL;
+	GstElementFactory *factory;
+	gboolean is_file_source = FALSE;
+	gchar *uri = NULL;
+	gchar *filename = NULL;
+	gint fd = -1;
+
+#ifdef G_OS_UNIX
+	peer = gst_pad_get_peer(sinkpad);
+	if (peer != NULL) {
+		peer_element = gst_pad_get_parent_element(peer);
+		gst_object_unref(peer);
+	}
+
+	factory = peer_element != NULL ? gst_element_get_factory(peer_element) : NULL;
+	for (guint i = 0; factory != NULL && i < G_N_ELEMENTS(file_sources); i++) {
+		if (g_strcmp0(gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory)), file_sources[i]) == 0)
+			is_file_source = TRUE;
+	}
+
+	if (peer_element != NULL)
+		gst_object_unref(peer_element);
+
+	if (!is_file_source) {
+		GST_DEBUG("The upstream is not a file source. Reading through the upstream.");
+		return -1;
+	}
+
+	query = gst_query_new_uri();
+	if (gst_pad_peer_query(sinkpad, query))
+		gst_query_parse_uri(query, &uri);
+	gst_query_unref(query);
+
+	if (uri != NULL && g_str_has_prefix(uri, "file:"))
+		filename = g_filename_from_uri(uri, NULL, NULL);
+
+	if (filename != NULL)
+		fd = g_open(filename, O_RDONLY, 0);
+
+	GST_DEBUG("Reading %s %s", uri ? uri : "(unknown)", fd >= 0 ? "directly" : "through the upstream");
+
+	g_free(filename);
+	g_free(uri);
+#endif
+
+	return fd;
+}
+
+/*
+* Find the offset of the first TS packet. Three sync bytes in a row are required.
+*/
+static gint64
+gst_ts_scan_find_sync(GstTsScanSource * source)
+{
+	guint8 data[TS_PACKET_SIZE * 3];
+	gint64 sync_offset = -1;
+
+	if (gst_ts_scan_read(source, 0, data, sizeof(data)) != (gssize)sizeof(data))
+		return -1;
+
+	for (gint i = 0; i < TS_PACKET_SIZE; i++) {
+		if (data[i] == TS_SYNC_BYTE && data[i + TS_PACKET_SIZE] == TS_SYNC_BYTE &&
+			data[i + TS_PACKET_SIZE * 2] == TS_SYNC_BYTE) {
+			sync_offset = i;
+			break;
+		}
+	}
+
+	return sync_offset;
+}
+
+/*
+* Scan one range. A metadata PES which starts in the range is completed even when it crosses the end.
+*/
+static gpointer
+gst_ts_scan_worker_run(gpointer data)
+{
+	GstTsScanWorker *worker = (GstTsScanWorker *)data;
+	guint8 *block = g_malloc(TS_SCAN_READ_SIZE);
+	guint64 offset = worker->start;
+
+	while (!worker->is_done && offset < worker->source->size) {
+		gsize size = (gsize)MIN(TS_SCAN_READ_SIZE, worker->source->size - offset);
+		gssize bytes_read = gst_ts_scan_read(worker->source, offset, block, size);
+
+		if (bytes_read < TS_PACKET_SIZE)
+			break;
+
+		bytes_read -= bytes_read % TS_PACKET_SIZE;
+		worker->bytes_read += bytes_read;
+
+		for (gssize pos = 0; pos < bytes_read; pos += TS_PACKET_SIZE) {
+			gboolean in_range = offset + pos < worker->end;
+
+			// Nothing is pending beyond the end of the range
+			if (!in_range && !worker->pes.is_open) {
+				worker->is_done = TRUE;
+				break;
+			}
+
+			if (block[pos] != TS_SYNC_BYTE) {
+				worker->sync_errors++;
+				continue;
+			}
+
+			gst_ts_scan_parse_packet(worker, block + pos, offset + pos, in_range);
+		}
+
+		offset += bytes_read;
+	}
+
+	// The last PES of the input has no following packet to terminate it
+	if (worker->pes.is_open) {
+		if (offset >= worker->source->size)
+			gst_ts_scan_end_pes(worker);
+		else
+			g_byte_array_unref(worker->pes.data);
+	}
+
+	g_free(block);
+
+	return NULL;
+}
+
+/*
+* Collect the PCR, the keyframe and the metadata found in a TS packet
+*/
+static void
+gst_ts_scan_parse_packet(GstTsScanWorker * worker, const guint8 * packet, guint64 offset, gboolean in_range)
+{
+	const GstTsScanConfig *config = worker->config;
+	guint16 pid = ((packet[1] & 0x1f) << 8) | packet[2];
+	gboolean unit_start = (packet[1] & 0x40) != 0;
+	guint8 adaptation_field_control = (packet[3] >> 4) & 0x3;
+	gboolean random_access = FALSE;
+	const guint8 *payload = packet + 4;
+	gint payload_size = 0;
+
+	if (adaptation_field_control & 0x2) {
+		guint8 af_length = packet[4];
+
+		if (af_length > TS_PACKET_SIZE - 5)
+			return;
+
+		if (af_length > 0) {
+			guint8 af_flags = packet[5];
+
+			random_access = (af_flags & 0x40) != 0;
+
+			if (in_range && pid == config->pcr_pid && (af_flags & 0x10) && af_length >= 7) {
+				guint64 pcr_base = ((guint64)packet[6] << 25) | (packet[7] << 17) | (packet[8] << 9) |
+					(packet[9] << 1) | (packet[10] >> 7);
+				guint64 pcr_ext = ((packet[10] & 0x1) << 8) | packet[11];
+
+				gst_ts_scan_add_entry(worker, GST_TS_SCAN_ENTRY_PCR, pid, offset, pcr_base * 300 + pcr_ext, NULL);
+			}
+		}
+
+		payload = packet + 5 + af_length;
+	}
+
+	if (adaptation_field_control & 0x1)
+		payload_size = (gint)(packet + TS_PACKET_SIZE - payload);
+
+	if (pid == config->metadata_pid) {
+		if (unit_start) {
+			if (worker->pes.is_open)
+				gst_ts_scan_end_pes(worker);
+
+			// The next PES belongs to the next range
+			if (!in_range) {
+				worker->is_done = TRUE;
+				return;
+			}
+
+			gst_ts_scan_begin_pes(worker, offset, payload, payload_size);
+		}
+		else if (worker->pes.is_open && payload_size > 0) {
+			g_byte_array_append(worker->pes.data, payload, payload_size);
+		}
+
+		if (worker->pes.is_open && worker->pes.expected_size > 0 && worker->pes.data->len >= worker->pes.expected_size)
+			gst_ts_scan_end_pes(worker);
+	}
+	else if (in_range && pid == config->video_pid && unit_start && payload_size > 0) {
+		if (random_access || gst_ts_scan_has_keyframe(config, payload, payload_size)) {
+			gst_ts_scan_add_entry(worker, GST_TS_SCAN_ENTRY_KEYFRAME, pid, offset,
+				gst_ts_scan_parse_pts(payload, payload_size), NULL);
+		}
+	}
+}
+
+/*
+* Start reassembling a metadata PES
+*/
+static void
+gst_ts_scan_begin_pes(GstTsScanWorker * worker, guint64 offset, const guint8 * payload, gint size)
+{
+	GstTsScanPes *pes = &worker->pes;
+	guint pes_length, header_length;
+
+	// The PES header has to fit in the first TS packet
+	if (size < 9 || payload[0] != 0x00 || payload[1] != 0x00 || payload[2] != 0x01)
+		return;
+
+	pes_length = (payload[4] << 8) | payload[5];
+	header_length = 9 + payload[8];
+	if ((gint)header_length > size)
+		return;
+
+	pes->is_open = TRUE;
+	pes->offset = offset;
+	pes->pts = gst_ts_scan_parse_pts(payload, size);
+	pes->expected_size = pes_length > header_length - 6 ? pes_length - (header_length - 6) : 0;
+	pes->data = g_byte_array_sized_new(pes->expected_size > 0 ? pes->expected_size : TS_PACKET_SIZE);
+
+	g_byte_array_append(pes->data, payload + header_length, size - header_length);
+}
+
+/*
+* Complete the metadata PES and add it to the entries
+*/
+static void
+gst_ts_scan_end_pes(GstTsScanWorker * worker)
+{
+	GstTsScanPes *pes = &worker->pes;
+	GstBuffer *payload;
+	gsize size;
+
+	// The padding of the last TS packet is not a part of the payload
+	size = pes->expected_size > 0 ? MIN(pes->expected_size, pes->data->len) : pes->data->len;
+	payload = gst_buffer_new_wrapped(g_byte_array_free(pes->data, FALSE), size);
+
+	gst_ts_scan_add_entry(worker, GST_TS_SCAN_ENTRY_METADATA, (guint16)worker->config->metadata_pid,
+		pes->offset, pes->pts, payload);
+
+	pes->is_open = FALSE;
+	pes->data = NULL;
+}
+
+static void
+gst_ts_scan_add_entry(GstTsScanWorker * worker, GstTsScanEntryType type, guint16 pid, guint64 offset, gint64 value, GstBuffer * payload)
+{
+	GstTsScanEntry entry;
+
+	entry.type = type;
+	entry.pid = pid;
+	entry.offset = offset;
+	entry.value = value;
+	entry.payload = payload;
+
+	g_array_append_val(worker->entries, entry);
+}
+
+/*
+* Get the PTS from the PES header
+*/
+static gint64
+gst_ts_scan_parse_pts(const guint8 * pes, gint size)
+{
+	if (size < 14 || pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01 || !(pes[7] & 0x80))
+		return GST_TS_SCAN_NO_VALUE;
+
+	return ((gint64)((pes[9] >> 1) & 0x7) << 30) | (pes[10] << 22) | ((pes[11] >> 1) << 15) |
+		(pes[12] << 7) | (pes[13] >> 1);
+}
+
+/*
+* Check the NAL units in the first TS packet of a video PES when the random access indicator is not set
+*/
+static gboolean
+gst_ts_scan_has_keyframe(const GstTsScanConfig * config, const guint8 * payload, gint size)
+{
+	gint pos;
+
+	if (size < 9)
+		return FALSE;
+
+	for (pos = 9 + payload[8]; pos + 3 < size; pos++) {
+		guint8 nal_type;
+
+		if (payload[pos] != 0x00 || payload[pos + 1] != 0x00 || payload[pos + 2] != 0x01)
+			continue;
+
+		if (config->is_hevc) {
+			nal_type = (payload[pos + 3] >> 1) & 0x3f;
+
+			// IRAP pictures or VPS
+			if ((nal_type >= 16 && nal_type <= 21) || nal_type == 32)
+				return TRUE;
+		}
+		else {
+			nal_type = payload[pos + 3] & 0x1f;
+
+			// IDR picture or SPS
+			if (nal_type == 5 || nal_type == 7)
+				return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/*
+* Unwrap the 33 bit timestamps. The entries are in the order of the byte offset.
+*/
+static void
+gst_ts_scan_unwrap(GArray * entries)
+{
+	gint64 last_pts = GST_TS_SCAN_NO_VALUE, last_pcr = GST_TS_SCAN_NO_VALUE;
+	gint64 pts_offset = 0, pcr_offset = 0;
+
+	for (guint i = 0; i < entries->len; i++) {
+		GstTsScanEntry *entry = &g_array_index(entries, GstTsScanEntry, i);
+
+		if (entry->value == GST_TS_SCAN_NO_VALUE)
+			continue;
+
+		if (entry->type == GST_TS_SCAN_ENTRY_PCR) {
+			if (last_pcr != GST_TS_SCAN_NO_VALUE && entry->value + TS_PCR_WRAP / 2 < last_pcr)
+				pcr_offset += TS_PCR_WRAP;
+			last_pcr = entry->value;
+			entry->value += pcr_offset;
+		}
+		else {
+			if (last_pts != GST_TS_SCAN_NO_VALUE && entry->value + TS_PTS_WRAP / 2 < last_pts)
+				pts_offset += TS_PTS_WRAP;
+			last_pts = entry->value;
+			entry->value += pts_offset;
+		}
+	}
+}
+
+static void
+gst_ts_scan_entry_clear(gpointer data)
+{
+	GstTsScanEntry *entry = (GstTsScanEntry *)data;
+
+	if (entry->payload != NULL)
+		gst_buffer_unref(entry->payload);
+}
+
+/*
+* Set the debug category
+*/
+void
+init_tsscan(void)
+{
+	GST_DEBUG_CATEGORY_INIT(gst_tsscan_debug, "tsscan", 0, "Parallel TS Scanner");
+}
@@ -0,0 +1,69 @@
+#ifndef __GST_TSSCAN_H__
+#define __GST_TSSCAN_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define TS_PACKET_SIZE			188
+#define TS_SYNC_BYTE			0x47
+#define TS_MAX_PIDS				8192
+#define TS_PAT_PID				0x0000
+#define TS_NULL_PID				0x1fff
+
+// The value of the entry is unknown
+#define GST_TS_SCAN_NO_VALUE	(-1)
+
+typedef enum
+{
+	GST_TS_SCAN_ENTRY_KEYFRAME,
+	GST_TS_SCAN_ENTRY_PCR,
+	GST_TS_SCAN_ENTRY_METADATA
+} GstTsScanEntryType;
+
+typedef struct _GstTsScanEntry	GstTsScanEntry;
+typedef struct _GstTsScanConfig	GstTsScanConfig;
+
+/*
+* A result of the scan. The entries are ordered by the byte offset.
+*/
+struct _GstTsScanEntry
+{
+	GstTsScanEntryType	type;
+
+	guint16		pid;
+
+	// The offset of the TS packet which starts the entry
+	guint64		offset;
+
+	// PTS in 90 kHz for the keyframes and the metadata, PCR in 27 MHz for the PCR samples.
+	// The values are unwrapped over the whole input.
+	gint64		value;
+
+	// The PES payload of the metadata
+	GstBuffer	*payload;
+};
+
+/*
+* What to collect from the input. The PIDs are -1 when they are not collected.
+*/
+struct _GstTsScanConfig
+{
+	gint		video_pid;
+	gboolean	is_hevc;
+
+	gint		pcr_pid;
+
+	gint		metadata_pid;
+
+	// The number of workers. It is the number of processors when it is 0.
+	guint		num_threads;
+};
+
+void init_tsscan(void);
+
+GArray * gst_ts_scan_run(GstPad * sinkpad, guint64 size, const GstTsScanConfig * config);
+
+G_END_DECLS
+
+#endif /* __GST_TSSCAN_H__ */
@@ -0,0 +1,291 @@
+/*
+* Checks the AES-128-CBC decryption with the FIPS-197 and SP 800-38A vectors, the PKCS#7 padding and the chain
+* starting over at the segment boundaries. AES-NI and the tables give the same blocks to the bit.
+*/
+#include "../gstaesdecrypt.c"
+
+#include <stdio.h>
+
+#define TEST_RANDOM_BLOCKS		37
+
+static gboolean test_ok = TRUE;
+
+#define TEST_CHECK(cond) \
+	G_STMT_START { \
+		if (!(cond)) { \
+			printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+			test_ok = FALSE; \
+		} \
+	} G_STMT_END
+
+// FIPS-197 C.1
+static const gchar *fips_key = "000102030405060708090a0b0c0d0e0f";
+static const gchar *fips_plain = "00112233445566778899aabbccddeeff";
+static const gchar *fips_cipher = "69c4e0d86a7b0430d8cdb78070b4c55a";
+
+// SP 800-38A F.2.2 CBC-AES128.Decrypt
+static const gchar *cbc_key = "2b7e151628aed2a6abf7158809cf4f3c";
+static const gchar *cbc_iv = "000102030405060708090a0b0c0d0e0f";
+static const gchar *cbc_cipher[4] = {
+	"7649abac8119b246cee98e9b12e9197d", "5086cb9b507219ee95db113a917678b2",
+	"73bed6b8e3c1743b7116e69e22229516", "3ff1caa1681fac09120eca307586e1a7"
+};
+static const gchar *cbc_plain[4] = {
+	"6bc1bee22e409f96e93d7e117393172a", "ae2d8a571e03ac9c9eb76fac45af8e51",
+	"30c81c46a35ce411e5fbc1191a0a52ef", "f69f2445df4f9b17ad2b417be66c3710"
+};
+
+static void
+test_parse_blocks(const gchar ** hex, guint8 * out, guint blocks)
+{
+	for (guint i = 0; i < blocks; i++)
+		gst_aes_parse_hex(hex[i], out + i * AES_BLOCK_SIZE);
+}
+
+static GstAesDecryptor *
+test_new_decryptor(gboolean use_aesni, const gchar * key_hex, const gchar * iv_hex)
+{
+	GstAesDecryptor *decryptor = gst_aes_decryptor_new();
+	guint8 key[AES_KEY_SIZE], iv[AES_BLOCK_SIZE];
+
+	gst_aes_parse_hex(key_hex, key);
+	if (iv_hex != NULL)
+		gst_aes_parse_hex(iv_hex, iv);
+	else
+		memset(iv, 0, sizeof(iv));
+
+	decryptor->use_aesni = use_aesni;
+	gst_aes_decryptor_set_key(decryptor, key, iv);
+
+	return decryptor;
+}
+
+/*
+* One block with the zero IV is the inverse cipher alone
+*/
+static void
+test_fips197(gboolean use_aesni)
+{
+	GstAesDecryptor *decryptor = test_new_decryptor(use_aesni, fips_key, NULL);
+	guint8 cipher[AES_BLOCK_SIZE], plain[AES_BLOCK_SIZE], out[AES_BLOCK_SIZE];
+
+	gst_aes_parse_hex(fips_cipher, cipher);
+	gst_aes_parse_hex(fips_plain, plain);
+
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 1);
+	TEST_CHECK(memcmp(out, plain, AES_BLOCK_SIZE) == 0);
+
+	gst_aes_decryptor_free(decryptor);
+}
+
+/*
+* The four blocks at once, one by one and in place. The chain carries over the calls.
+*/
+static void
+test_sp800_38a(gboolean use_aesni)
+{
+	GstAesDecryptor *decryptor = test_new_decryptor(use_aesni, cbc_key, cbc_iv);
+	guint8 cipher[4 * AES_BLOCK_SIZE], plain[4 * AES_BLOCK_SIZE], out[4 * AES_BLOCK_SIZE];
+
+	test_parse_blocks(cbc_cipher, cipher, 4);
+	test_parse_blocks(cbc_plain, plain, 4);
+
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 4);
+	TEST_CHECK(memcmp(out, plain, sizeof(plain)) == 0);
+	TEST_CHECK(decryptor->next_offset == sizeof(cipher));
+
+	gst_aes_decryptor_reset(decryptor);
+	memset(out, 0, sizeof(out));
+	for (guint i = 0; i < 4; i++)
+		gst_aes_decryptor_decrypt(decryptor, cipher + i * AES_BLOCK_SIZE, out + i * AES_BLOCK_SIZE, 1);
+	TEST_CHECK(memcmp(out, plain, sizeof(plain)) == 0);
+
+	gst_aes_decryptor_reset(decryptor);
+	memcpy(out, cipher, sizeof(cipher));
+	gst_aes_decryptor_decrypt(decryptor, out, out, 4);
+	TEST_CHECK(memcmp(out, plain, sizeof(plain)) == 0);
+
+	gst_aes_decryptor_free(decryptor);
+}
+
+/*
+* A read ending in the middle of a block steps back and decrypts it again. A jump continues from the block before.
+*/
+static void
+test_step_back(gboolean use_aesni)
+{
+	GstAesDecryptor *decryptor = test_new_decryptor(use_aesni, cbc_key, cbc_iv);
+	guint8 cipher[4 * AES_BLOCK_SIZE], plain[4 * AES_BLOCK_SIZE], out[4 * AES_BLOCK_SIZE];
+
+	test_parse_blocks(cbc_cipher, cipher, 4);
+	test_parse_blocks(cbc_plain, plain, 4);
+
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 3);
+	TEST_CHECK(gst_aes_decryptor_step_back(decryptor));
+	TEST_CHECK(!gst_aes_decryptor_step_back(decryptor));
+	TEST_CHECK(decryptor->next_offset == 2 * AES_BLOCK_SIZE);
+
+	gst_aes_decryptor_decrypt(decryptor, cipher + 2 * AES_BLOCK_SIZE, out + 2 * AES_BLOCK_SIZE, 2);
+	TEST_CHECK(memcmp(out, plain, sizeof(plain)) == 0);
+
+	memset(out, 0, sizeof(out));
+	gst_aes_decryptor_set_iv(decryptor, cipher, AES_BLOCK_SIZE);
+	gst_aes_decryptor_decrypt(decryptor, cipher + AES_BLOCK_SIZE, out + AES_BLOCK_SIZE, 3);
+	TEST_CHECK(memcmp(out + AES_BLOCK_SIZE, plain + AES_BLOCK_SIZE, 3 * AES_BLOCK_SIZE) == 0);
+
+	gst_aes_decryptor_free(decryptor);
+}
+
+/*
+* Every segment of a concatenated input starts over with the IV. A new IV is taken at the next boundary, while the
+* blocks before it keep their chain.
+*/
+static void
+test_boundaries(gboolean use_aesni)
+{
+	GstAesDecryptor *decryptor = test_new_decryptor(use_aesni, cbc_key, cbc_iv);
+	guint8 cipher[4 * AES_BLOCK_SIZE], plain[4 * AES_BLOCK_SIZE], out[4 * AES_BLOCK_SIZE];
+	guint8 iv[AES_BLOCK_SIZE];
+
+	test_parse_blocks(cbc_cipher, cipher, 4);
+	test_parse_blocks(cbc_plain, plain, 4);
+
+	// The first segment ends in the middle of the chain
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 2);
+	TEST_CHECK(memcmp(out, plain, 2 * AES_BLOCK_SIZE) == 0);
+
+	gst_aes_decryptor_reset(decryptor);
+	TEST_CHECK(decryptor->next_offset == 0);
+	TEST_CHECK(!gst_aes_decryptor_step_back(decryptor));
+
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 4);
+	TEST_CHECK(memcmp(out, plain, sizeof(plain)) == 0);
+
+	// The next segment is encrypted with the second block as its IV. It is the same chain from the third block on.
+	memcpy(iv, cipher + AES_BLOCK_SIZE, AES_BLOCK_SIZE);
+	gst_aes_decryptor_reset(decryptor);
+	gst_aes_decryptor_decrypt(decryptor, cipher, out, 1);
+	gst_aes_decryptor_set_initial_iv(decryptor, iv);
+	gst_aes_decryptor_decrypt(decryptor, cipher + AES_BLOCK_SIZE, out + AES_BLOCK_SIZE, 1);
+	TEST_CHECK(memcmp(out, plain, 2 * AES_BLOCK_SIZE) == 0);
+
+	gst_aes_decryptor_reset(decryptor);
+	gst_aes_decryptor_decrypt(decryptor, cipher + 2 * AES_BLOCK_SIZE, out, 2);
+	TEST_CHECK(memcmp(out, plain + 2 * AES_BLOCK_SIZE, 2 * AES_BLOCK_SIZE) == 0);
+
+	gst_aes_decryptor_free(decryptor);
+}
+
+/*
+* The last block decrypts to the padding which is cut off. The IV is chosen so the known block decrypts to it.
+*/
+static void
+test_padding(gboolean use_aesni)
+{
+	GstAesDecryptor *decryptor = test_new_decryptor(use_aesni, cbc_key, cbc_iv);
+	guint8 cipher[AES_BLOCK_SIZE], inverse[AES_BLOCK_SIZE], iv[AES_BLOCK_SIZE], block[AES_BLOCK_SIZE];
+
+	gst_aes_parse_hex(cbc_cipher[0], cipher);
+	gst_aes_parse_hex(cbc_plain[0], inverse);
+	gst_aes_parse_hex(cbc_iv, iv);
+
+	// The inverse cipher of the first block, without the chain
+	for (guint i = 0; i < AES_BLOCK_SIZE; i++)
+		inverse[i] ^= iv[i];
+
+	for (guint padding = 1; padding <= AES_BLOCK_SIZE; padding++) {
+		for (guint i = 0; i < AES_BLOCK_SIZE; i++) {
+			guint8 want = i < AES_BLOCK_SIZE - padding ? (guint8)(0x40 + i) : (guint8)padding;
+
+			iv[i] = inverse[i] ^ want;
+		}
+
+		gst_aes_decryptor_set_iv(decryptor, iv, 0);
+		gst_aes_decryptor_decrypt(decryptor, cipher, block, 1);
+		TEST_CHECK(gst_aes_decryptor_get_padding(block) == padding);
+	}
+
+	// The padding is 1 to 16 bytes, all of them the same
+	memset(block, 0x10, AES_BLOCK_SIZE);
+	TEST_CHECK(gst_aes_decryptor_get_padding(block) == AES_BLOCK_SIZE);
+	block[AES_BLOCK_SIZE - 1] = 0x00;
+	TEST_CHECK(gst_aes_decryptor_get_padding(block) == 0);
+	block[AES_BLOCK_SIZE - 1] = 0x11;
+	TEST_CHECK(gst_aes_decryptor_get_padding(block) == 0);
+	memset(block + AES_BLOCK_SIZE - 4, 0x04, 4);
+	block[AES_BLOCK_SIZE - 3] = 0x05;
+	TEST_CHECK(gst_aes_decryptor_get_padding(block) == 0);
+
+	gst_aes_decryptor_free(decryptor);
+}
+
+/*
+* AES-NI decrypts 8 blocks at once. Every count around the batches gives the blocks of the tables.
+*/
+static void
+test_paths_agree(void)
+{
+	GstAesDecryptor *aesni = test_new_decryptor(TRUE, cbc_key, cbc_iv);
+	GstAesDecryptor *table = test_new_decryptor(FALSE, cbc_key, cbc_iv);
+	GRand *rand = g_rand_new_with_seed(0x61657331);
+	guint8 cipher[TEST_RANDOM_BLOCKS * AES_BLOCK_SIZE];
+	guint8 out_aesni[TEST_RANDOM_BLOCKS * AES_BLOCK_SIZE], out_table[TEST_RANDOM_BLOCKS * AES_BLOCK_SIZE];
+
+	for (gsize i = 0; i < sizeof(cipher); i++)
+		cipher[i] = (guint8)g_rand_int(rand);
+
+	for (guint blocks = 1; blocks <= TEST_RANDOM_BLOCKS; blocks++) {
+		gst_aes_decryptor_reset(aesni);
+		gst_aes_decryptor_reset(table);
+
+		// Split in two calls so the chain carries over the batches
+		gst_aes_decryptor_decrypt(aesni, cipher, out_aesni, blocks / 2);
+		gst_aes_decryptor_decrypt(aesni, cipher + blocks / 2 * AES_BLOCK_SIZE,
+			out_aesni + blocks / 2 * AES_BLOCK_SIZE, blocks - blocks / 2);
+		gst_aes_decryptor_decrypt(table, cipher, out_table, blocks);
+
+		TEST_CHECK(memcmp(out_aesni, out_table, blocks * AES_BLOCK_SIZE) == 0);
+		TEST_CHECK(memcmp(aesni->iv, table->iv, AES_BLOCK_SIZE) == 0);
+		TEST_CHECK(memcmp(aesni->last_iv, table->last_iv, AES_BLOCK_SIZE) == 0);
+	}
+
+	g_rand_free(rand);
+	gst_aes_decryptor_free(table);
+	gst_aes_decryptor_free(aesni);
+}
+
+static void
+test_path(gboolean use_aesni)
+{
+	test_fips197(use_aesni);
+	test_sp800_38a(use_aesni);
+	test_step_back(use_aesni);
+	test_boundaries(use_aesni);
+	test_padding(use_aesni);
+}
+
+int
+main(int argc, char *argv[])
+{
+	gboolean ok;
+
+	gst_init(&argc, &argv);
+	init_aesdecrypt();
+
+	test_path(FALSE);
+	printf("tables: %s\n", test_ok ? "ok" : "FAILED");
+	ok = test_ok;
+
+	if (aes_has_aesni) {
+		test_ok = TRUE;
+		test_path(TRUE);
+		test_paths_agree();
+		printf("AES-NI: %s\n", test_ok ? "ok" : "FAILED");
+		ok &= test_ok;
+	}
+	else {
+		printf("AES-NI: skipped, the CPU does not support it\n");
+	}
+
+	return ok ? 0 : 1;
+}
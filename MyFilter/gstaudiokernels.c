@@ -0,0 +1,546 @@
+#include "gstaudiokernels.h"
+
+#include <math.h>
+#include <string.h>
+
+// The vector kernels are picked at runtime. The other CPUs and compilers use the scalar ones.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AUDIO_HAVE_X86			1
+#include <immintrin.h>
+#define AUDIO_TARGET_SSE2		__attribute__((target("sse2")))
+#define AUDIO_TARGET_AVX2		__attribute__((target("avx2")))
+#define AUDIO_TARGET_AVX512		__attribute__((target("avx512f")))
+#endif
+
+// The S32 samples are scaled in double so the 32 bits are kept
+#define AUDIO_S32_MAX			2147483647.0
+#define AUDIO_S32_MIN			-2147483648.0
+
+// The centre channels go to both sides of a stereo downmix at -3 dB
+#define AUDIO_CENTER_GAIN		0.70710678f
+
+// The environment variable which caps the kernels, as "scalar", "sse2", "avx2" or "avx512"
+#define AUDIO_KERNELS_ENV		"MYFILTER_AUDIO_KERNELS"
+
+typedef struct
+{
+	const gchar	*name;
+	void		(*gain_s16) (gint16 * samples, gsize count, gfloat gain);
+	void		(*gain_s32) (gint32 * samples, gsize count, gdouble gain);
+	void		(*gain_f32) (gfloat * samples, gsize count, gfloat gain);
+} GstAudioKernels;
+
+static void audio_gain_s16_scalar(gint16 * samples, gsize count, gfloat gain);
+static void audio_gain_s32_scalar(gint32 * samples, gsize count, gdouble gain);
+static void audio_gain_f32_scalar(gfloat * samples, gsize count, gfloat gain);
+#ifdef AUDIO_HAVE_X86
+static void audio_gain_s16_sse2(gint16 * samples, gsize count, gfloat gain);
+static void audio_gain_s32_sse2(gint32 * samples, gsize count, gdouble gain);
+static void audio_gain_f32_sse2(gfloat * samples, gsize count, gfloat gain);
+static void audio_gain_s16_avx2(gint16 * samples, gsize count, gfloat gain);
+static void audio_gain_s32_avx2(gint32 * samples, gsize count, gdouble gain);
+static void audio_gain_f32_avx2(gfloat * samples, gsize count, gfloat gain);
+static void audio_gain_s16_avx512(gint16 * samples, gsize count, gfloat gain);
+static void audio_gain_s32_avx512(gint32 * samples, gsize count, gdouble gain);
+static void audio_gain_f32_avx512(gfloat * samples, gsize count, gfloat gain);
+#endif
+
+// From the slowest to the fastest
+static const GstAudioKernels audio_kernels_table[] = {
+	{ "scalar", audio_gain_s16_scalar, audio_gain_s32_scalar, audio_gain_f32_scalar },
+#ifdef AUDIO_HAVE_X86
+	{ "sse2", audio_gain_s16_sse2, audio_gain_s32_sse2, audio_gain_f32_sse2 },
+	{ "avx2", audio_gain_s16_avx2, audio_gain_s32_avx2, audio_gain_f32_avx2 },
+	{ "avx512", audio_gain_s16_avx512, audio_gain_s32_avx512, audio_gain_f32_avx512 },
+#endif
+};
+
+// Picked when the plugin is loaded
+static const GstAudioKernels *audio_kernels = &audio_kernels_table[0];
+
+/*
+* The index in the table of the fastest kernels the CPU runs
+*/
+static guint
+audio_kernels_get_best(void)
+{
+	guint best = 0;
+
+#ifdef AUDIO_HAVE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse2")) {
+		best = 1;
+		if (__builtin_cpu_supports("avx2")) {
+			best = 2;
+			if (__builtin_cpu_supports("avx512f"))
+				best = 3;
+		}
+	}
+#endif
+
+	return best;
+}
+
+/*
+* Pick the fastest kernels the CPU runs. The environment variable can cap them, to compare with the scalar ones.
+*/
+void
+gst_audio_kernels_init(void)
+{
+	const gchar *cap = g_getenv(AUDIO_KERNELS_ENV);
+	guint best = audio_kernels_get_best();
+
+	for (guint i = 0; cap != NULL && i < best; i++) {
+		if (g_strcmp0(cap, audio_kernels_table[i].name) == 0)
+			best = i;
+	}
+
+	audio_kernels = &audio_kernels_table[best];
+}
+
+const gchar *
+gst_audio_kernels_get_name(void)
+{
+	return audio_kernels->name;
+}
+
+/*
+* The native S16, S32 and F32 are processed. The other formats go through as they are.
+*/
+gboolean
+gst_audio_kernels_supports(GstAudioFormat format)
+{
+	return format == GST_AUDIO_FORMAT_S16 || format == GST_AUDIO_FORMAT_S32 || format == GST_AUDIO_FORMAT_F32;
+}
+
+void
+gst_audio_gain_reset(GstAudioGain * gain, gdouble value)
+{
+	gain->current = value;
+	gain->target = value;
+	gain->step = 0.0;
+	gain->ramp_frames = 0;
+}
+
+/*
+* Ramp from the current gain to the target one over the frames. 0 frames jump to it.
+*/
+void
+gst_audio_gain_set_target(GstAudioGain * gain, gdouble target, guint64 ramp_frames)
+{
+	gain->target = target;
+
+	if (ramp_frames == 0) {
+		gst_audio_gain_reset(gain, target);
+		return;
+	}
+
+	gain->step = (target - gain->current) / ramp_frames;
+	gain->ramp_frames = ramp_frames;
+}
+
+gboolean
+gst_audio_gain_is_unity(const GstAudioGain * gain)
+{
+	return gain->ramp_frames == 0 && gain->current == 1.0;
+}
+
+static void
+gst_audio_gain_apply_constant(GstAudioFormat format, gpointer samples, gsize count, gdouble gain)
+{
+	switch (format) {
+	case GST_AUDIO_FORMAT_S16:
+		audio_kernels->gain_s16(samples, count, (gfloat)gain);
+		break;
+	case GST_AUDIO_FORMAT_S32:
+		audio_kernels->gain_s32(samples, count, gain);
+		break;
+	case GST_AUDIO_FORMAT_F32:
+		audio_kernels->gain_f32(samples, count, (gfloat)gain);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+* Scale the interleaved frames in place. A ramp goes a block at a time with the gain of the middle of the block, the
+* frames after it with the target gain.
+*/
+void
+gst_audio_gain_apply(GstAudioGain * gain, GstAudioFormat format, gpointer samples, gsize frames, guint channels)
+{
+	gsize width = format == GST_AUDIO_FORMAT_S16 ? sizeof(gint16) : sizeof(gint32);
+	guint8 *data = samples;
+
+	while (frames > 0 && gain->ramp_frames > 0) {
+		gsize block = MIN(frames, AUDIO_RAMP_BLOCK);
+
+		block = MIN(block, gain->ramp_frames);
+		gst_audio_gain_apply_constant(format, data, block * channels, gain->current + gain->step * block / 2);
+
+		gain->current += gain->step * block;
+		gain->ramp_frames -= block;
+		if (gain->ramp_frames == 0)
+			gst_audio_gain_reset(gain, gain->target);
+
+		data += block * channels * width;
+		frames -= block;
+	}
+
+	if (frames > 0 && gain->current != 1.0)
+		gst_audio_gain_apply_constant(format, data, frames * channels, gain->current);
+}
+
+static gboolean
+audio_position_is_left(GstAudioChannelPosition position)
+{
+	switch (position) {
+	case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT_OF_CENTER:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_FRONT_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_REAR_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_SIDE_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_WIDE_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_SURROUND_LEFT:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+static gboolean
+audio_position_is_right(GstAudioChannelPosition position)
+{
+	switch (position) {
+	case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT_OF_CENTER:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_FRONT_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_REAR_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_TOP_SIDE_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_WIDE_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_SURROUND_RIGHT:
+		return TRUE;
+	default:
+		return FALSE;
+	}
+}
+
+/*
+* The coefficients of each output channel for the input channels, out_channels rows of info->channels.
+* - To mono every channel counts the same.
+* - To stereo the left and the right channels go to their side and the centre ones to both. The LFE is left out.
+*   The unpositioned channels go to the sides in turn. The rows are scaled down so they cannot clip.
+* - Otherwise the output channels repeat the input ones in order.
+*/
+gfloat *
+gst_audio_mix_matrix_new(const GstAudioInfo * info, guint out_channels)
+{
+	guint in_channels = GST_AUDIO_INFO_CHANNELS(info);
+	gfloat *matrix = g_new0(gfloat, (gsize)out_channels * in_channels);
+
+	if (out_channels == 1) {
+		for (guint i = 0; i < in_channels; i++)
+			matrix[i] = 1.0f / in_channels;
+	}
+	else if (out_channels == 2 && in_channels > 2) {
+		gfloat sums[2] = { 0.0f, 0.0f };
+
+		for (guint i = 0; i < in_channels; i++) {
+			GstAudioChannelPosition position = GST_AUDIO_INFO_IS_UNPOSITIONED(info) ?
+				GST_AUDIO_CHANNEL_POSITION_NONE : GST_AUDIO_INFO_POSITION(info, i);
+			gfloat left, right;
+
+			if (audio_position_is_left(position)) {
+				left = 1.0f;
+				right = 0.0f;
+			}
+			else if (audio_position_is_right(position)) {
+				left = 0.0f;
+				right = 1.0f;
+			}
+			else if (position == GST_AUDIO_CHANNEL_POSITION_LFE1 || position == GST_AUDIO_CHANNEL_POSITION_LFE2) {
+				left = 0.0f;
+				right = 0.0f;
+			}
+			else if (position == GST_AUDIO_CHANNEL_POSITION_NONE) {
+				left = i % 2 == 0 ? 1.0f : 0.0f;
+				right = 1.0f - left;
+			}
+			else {
+				left = AUDIO_CENTER_GAIN;
+				right = AUDIO_CENTER_GAIN;
+			}
+
+			matrix[i] = left;
+			matrix[in_channels + i] = right;
+			sums[0] += left;
+			sums[1] += right;
+		}
+
+		for (guint o = 0; o < 2; o++) {
+			for (guint i = 0; sums[o] > 1.0f && i < in_channels; i++)
+				matrix[o * in_channels + i] /= sums[o];
+		}
+	}
+	else {
+		for (guint o = 0; o < out_channels; o++)
+			matrix[o * in_channels + o % in_channels] = 1.0f;
+	}
+
+	return matrix;
+}
+
+/*
+* Mix the interleaved frames into the output channels with the matrix. The sums of the integer samples are rounded
+* and saturated like the gain.
+*/
+void
+gst_audio_mix(GstAudioFormat format, gconstpointer in, gpointer out, gsize frames, guint in_channels,
+	guint out_channels, const gfloat * matrix)
+{
+	switch (format) {
+	case GST_AUDIO_FORMAT_S16:
+	{
+		const gint16 *src = in;
+		gint16 *dst = out;
+
+		for (gsize f = 0; f < frames; f++, src += in_channels) {
+			for (guint o = 0; o < out_channels; o++) {
+				const gfloat *row = matrix + o * in_channels;
+				gfloat sum = 0.0f;
+
+				for (guint i = 0; i < in_channels; i++)
+					sum += row[i] * src[i];
+				*dst++ = (gint16)CLAMP(lrintf(sum), G_MININT16, G_MAXINT16);
+			}
+		}
+		break;
+	}
+	case GST_AUDIO_FORMAT_S32:
+	{
+		const gint32 *src = in;
+		gint32 *dst = out;
+
+		for (gsize f = 0; f < frames; f++, src += in_channels) {
+			for (guint o = 0; o < out_channels; o++) {
+				const gfloat *row = matrix + o * in_channels;
+				gdouble sum = 0.0;
+
+				for (guint i = 0; i < in_channels; i++)
+					sum += (gdouble)row[i] * src[i];
+				*dst++ = (gint32)lrint(CLAMP(sum, AUDIO_S32_MIN, AUDIO_S32_MAX));
+			}
+		}
+		break;
+	}
+	case GST_AUDIO_FORMAT_F32:
+	{
+		const gfloat *src = in;
+		gfloat *dst = out;
+
+		for (gsize f = 0; f < frames; f++, src += in_channels) {
+			for (guint o = 0; o < out_channels; o++) {
+				const gfloat *row = matrix + o * in_channels;
+				gfloat sum = 0.0f;
+
+				for (guint i = 0; i < in_channels; i++)
+					sum += row[i] * src[i];
+				*dst++ = sum;
+			}
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/*
+* The reference kernels. The vector ones round to nearest even and saturate the same way, so they give the same
+* samples.
+*/
+static void
+audio_gain_s16_scalar(gint16 * samples, gsize count, gfloat gain)
+{
+	for (gsize i = 0; i < count; i++)
+		samples[i] = (gint16)CLAMP(lrintf(samples[i] * gain), G_MININT16, G_MAXINT16);
+}
+
+static void
+audio_gain_s32_scalar(gint32 * samples, gsize count, gdouble gain)
+{
+	for (gsize i = 0; i < count; i++)
+		samples[i] = (gint32)lrint(CLAMP(samples[i] * gain, AUDIO_S32_MIN, AUDIO_S32_MAX));
+}
+
+static void
+audio_gain_f32_scalar(gfloat * samples, gsize count, gfloat gain)
+{
+	for (gsize i = 0; i < count; i++)
+		samples[i] *= gain;
+}
+
+#ifdef AUDIO_HAVE_X86
+
+static AUDIO_TARGET_SSE2 void
+audio_gain_s16_sse2(gint16 * samples, gsize count, gfloat gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+		// Sign extend by moving the samples to the high halves
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+
+		lo = _mm_mul_ps(lo, g);
+		hi = _mm_mul_ps(hi, g);
+		_mm_storeu_si128((__m128i *)(samples + i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+
+	audio_gain_s16_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_SSE2 void
+audio_gain_s32_sse2(gint32 * samples, gsize count, gdouble gain)
+{
+	const __m128d g = _mm_set1_pd(gain);
+	const __m128d max = _mm_set1_pd(AUDIO_S32_MAX);
+	const __m128d min = _mm_set1_pd(AUDIO_S32_MIN);
+	gsize i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+		__m128d lo = _mm_mul_pd(_mm_cvtepi32_pd(s), g);
+		__m128d hi = _mm_mul_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2))), g);
+
+		lo = _mm_max_pd(_mm_min_pd(lo, max), min);
+		hi = _mm_max_pd(_mm_min_pd(hi, max), min);
+		_mm_storeu_si128((__m128i *)(samples + i), _mm_unpacklo_epi64(_mm_cvtpd_epi32(lo), _mm_cvtpd_epi32(hi)));
+	}
+
+	audio_gain_s32_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_SSE2 void
+audio_gain_f32_sse2(gfloat * samples, gsize count, gfloat gain)
+{
+	const __m128 g = _mm_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+		_mm_storeu_ps(samples + i + 4, _mm_mul_ps(_mm_loadu_ps(samples + i + 4), g));
+	}
+
+	audio_gain_f32_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX2 void
+audio_gain_s16_avx2(gint16 * samples, gsize count, gfloat gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i lo = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i)));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(samples + i + 8)));
+
+		lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(lo), g));
+		hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(hi), g));
+		// The packing works within the 128-bit lanes, the permutation puts the halves back in order
+		_mm256_storeu_si256((__m256i *)(samples + i), _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xd8));
+	}
+
+	audio_gain_s16_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX2 void
+audio_gain_s32_avx2(gint32 * samples, gsize count, gdouble gain)
+{
+	const __m256d g = _mm256_set1_pd(gain);
+	const __m256d max = _mm256_set1_pd(AUDIO_S32_MAX);
+	const __m256d min = _mm256_set1_pd(AUDIO_S32_MIN);
+	gsize i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256d lo = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(samples + i))), g);
+		__m256d hi = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)(samples + i + 4))), g);
+
+		lo = _mm256_max_pd(_mm256_min_pd(lo, max), min);
+		hi = _mm256_max_pd(_mm256_min_pd(hi, max), min);
+		_mm_storeu_si128((__m128i *)(samples + i), _mm256_cvtpd_epi32(lo));
+		_mm_storeu_si128((__m128i *)(samples + i + 4), _mm256_cvtpd_epi32(hi));
+	}
+
+	audio_gain_s32_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX2 void
+audio_gain_f32_avx2(gfloat * samples, gsize count, gfloat gain)
+{
+	const __m256 g = _mm256_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		_mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+		_mm256_storeu_ps(samples + i + 8, _mm256_mul_ps(_mm256_loadu_ps(samples + i + 8), g));
+	}
+
+	audio_gain_f32_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX512 void
+audio_gain_s16_avx512(gint16 * samples, gsize count, gfloat gain)
+{
+	const __m512 g = _mm512_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m512i s = _mm512_cvtepi16_epi32(_mm256_loadu_si256((const __m256i *)(samples + i)));
+
+		s = _mm512_cvtps_epi32(_mm512_mul_ps(_mm512_cvtepi32_ps(s), g));
+		_mm256_storeu_si256((__m256i *)(samples + i), _mm512_cvtsepi32_epi16(s));
+	}
+
+	audio_gain_s16_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX512 void
+audio_gain_s32_avx512(gint32 * samples, gsize count, gdouble gain)
+{
+	const __m512d g = _mm512_set1_pd(gain);
+	const __m512d max = _mm512_set1_pd(AUDIO_S32_MAX);
+	const __m512d min = _mm512_set1_pd(AUDIO_S32_MIN);
+	gsize i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m512d s = _mm512_mul_pd(_mm512_cvtepi32_pd(_mm256_loadu_si256((const __m256i *)(samples + i))), g);
+
+		s = _mm512_max_pd(_mm512_min_pd(s, max), min);
+		_mm256_storeu_si256((__m256i *)(samples + i), _mm512_cvtpd_epi32(s));
+	}
+
+	audio_gain_s32_scalar(samples + i, count - i, gain);
+}
+
+static AUDIO_TARGET_AVX512 void
+audio_gain_f32_avx512(gfloat * samples, gsize count, gfloat gain)
+{
+	const __m512 g = _mm512_set1_ps(gain);
+	gsize i = 0;
+
+	for (; i + 16 <= count; i += 16)
+		_mm512_storeu_ps(samples + i, _mm512_mul_ps(_mm512_loadu_ps(samples + i), g));
+
+	audio_gain_f32_scalar(samples + i, count - i, gain);
+}
+
+#endif
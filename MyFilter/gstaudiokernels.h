@@ -0,0 +1,47 @@
+#ifndef __GST_AUDIOKERNELS_H__
+#define __GST_AUDIOKERNELS_H__
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+G_BEGIN_DECLS
+
+// The gain steps at this many frames while it ramps
+#define AUDIO_RAMP_BLOCK		32
+
+typedef struct _GstAudioGain	GstAudioGain;
+
+/*
+* The gain of a stream. While it ramps it moves linearly from the current gain to the target one, a step per block.
+*/
+struct _GstAudioGain
+{
+	gdouble		current;
+	gdouble		target;
+	gdouble		step;
+	guint64		ramp_frames;
+};
+
+void gst_audio_kernels_init(void);
+
+const gchar * gst_audio_kernels_get_name(void);
+
+gboolean gst_audio_kernels_supports(GstAudioFormat format);
+
+void gst_audio_gain_reset(GstAudioGain * gain, gdouble value);
+
+void gst_audio_gain_set_target(GstAudioGain * gain, gdouble target, guint64 ramp_frames);
+
+gboolean gst_audio_gain_is_unity(const GstAudioGain * gain);
+
+void gst_audio_gain_apply(GstAudioGain * gain, GstAudioFormat format, gpointer samples, gsize frames,
+	guint channels);
+
+gfloat * gst_audio_mix_matrix_new(const GstAudioInfo * info, guint out_channels);
+
+void gst_audio_mix(GstAudioFormat format, gconstpointer in, gpointer out, gsize frames, guint in_channels,
+	guint out_channels, const gfloat * matrix);
+
+G_END_DECLS
+
+#endif /* __GST_AUDIOKERNELS_H__ */
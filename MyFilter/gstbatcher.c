@@ -0,0 +1,103 @@
+#include "gstbatcher.h"
+
+// The list grows beyond it when there is no buffer limit
+#define BATCHER_DEFAULT_SIZE	16
+
+GstBatcher *
+gst_batcher_new(void)
+{
+	GstBatcher *batcher = g_new0(GstBatcher, 1);
+
+	batcher->max_time = GST_CLOCK_TIME_NONE;
+	batcher->first_arrival = GST_CLOCK_TIME_NONE;
+
+	return batcher;
+}
+
+void
+gst_batcher_free(GstBatcher * batcher)
+{
+	if (batcher == NULL)
+		return;
+
+	gst_batcher_clear(batcher);
+	g_free(batcher);
+}
+
+/*
+* Set the limits. They apply from the next buffer on, so the pending batch may already be beyond them.
+*/
+void
+gst_batcher_set_limits(GstBatcher * batcher, guint max_buffers, guint max_bytes, GstClockTime max_time)
+{
+	batcher->max_buffers = max_buffers;
+	batcher->max_bytes = max_bytes;
+	batcher->max_time = max_time > 0 ? max_time : GST_CLOCK_TIME_NONE;
+}
+
+/*
+* Take the buffer into the pending batch. It returns TRUE when the batch is full and has to be taken.
+* The time limit is checked when a buffer arrives. The owner pushes a batch that stays pending past it without one.
+*/
+gboolean
+gst_batcher_add(GstBatcher * batcher, GstBuffer * buffer, GstClockTime now)
+{
+	if (batcher->list == NULL) {
+		batcher->list = gst_buffer_list_new_sized(batcher->max_buffers > 0 ? batcher->max_buffers :
+			BATCHER_DEFAULT_SIZE);
+		batcher->bytes = 0;
+		batcher->first_arrival = now;
+	}
+
+	batcher->bytes += gst_buffer_get_size(buffer);
+	gst_buffer_list_add(batcher->list, buffer);
+
+	if (batcher->max_buffers > 0 && gst_buffer_list_length(batcher->list) >= batcher->max_buffers)
+		return TRUE;
+
+	if (batcher->max_bytes > 0 && batcher->bytes >= batcher->max_bytes)
+		return TRUE;
+
+	if (GST_CLOCK_TIME_IS_VALID(batcher->max_time))
+		return now >= batcher->first_arrival + batcher->max_time;
+
+	return batcher->max_buffers == 0 && batcher->max_bytes == 0;
+}
+
+gboolean
+gst_batcher_is_empty(GstBatcher * batcher)
+{
+	return batcher->list == NULL;
+}
+
+/*
+* Hand over the pending batch. It is NULL when there is none.
+*/
+GstBufferList *
+gst_batcher_take(GstBatcher * batcher)
+{
+	GstBufferList *list = batcher->list;
+
+	if (list != NULL)
+		batcher->batches++;
+
+	batcher->list = NULL;
+	batcher->bytes = 0;
+	batcher->first_arrival = GST_CLOCK_TIME_NONE;
+
+	return list;
+}
+
+/*
+* Drop the pending batch, as on a flush.
+*/
+void
+gst_batcher_clear(GstBatcher * batcher)
+{
+	if (batcher->list != NULL)
+		gst_buffer_list_unref(batcher->list);
+
+	batcher->list = NULL;
+	batcher->bytes = 0;
+	batcher->first_arrival = GST_CLOCK_TIME_NONE;
+}
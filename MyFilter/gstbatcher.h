@@ -0,0 +1,45 @@
+#ifndef __GST_BATCHER_H__
+#define __GST_BATCHER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstBatcher GstBatcher;
+
+/*
+* Gathers the buffers into a list until one of the limits is reached. A limit of 0, or GST_CLOCK_TIME_NONE for the
+* time, is not checked. With no limit at all every buffer is a batch.
+*/
+struct _GstBatcher
+{
+	guint			max_buffers;
+	guint			max_bytes;
+	GstClockTime	max_time;
+
+	// The pending batch. The time is the arrival of its first buffer.
+	GstBufferList	*list;
+	gsize			bytes;
+	GstClockTime	first_arrival;
+
+	// Statistics
+	guint64			batches;
+};
+
+GstBatcher * gst_batcher_new(void);
+
+void gst_batcher_free(GstBatcher * batcher);
+
+void gst_batcher_set_limits(GstBatcher * batcher, guint max_buffers, guint max_bytes, GstClockTime max_time);
+
+gboolean gst_batcher_add(GstBatcher * batcher, GstBuffer * buffer, GstClockTime now);
+
+gboolean gst_batcher_is_empty(GstBatcher * batcher);
+
+GstBufferList * gst_batcher_take(GstBatcher * batcher);
+
+void gst_batcher_clear(GstBatcher * batcher);
+
+G_END_DECLS
+
+#endif /* __GST_BATCHER_H__ */
@@ -0,0 +1,81 @@
+#include "gstchecksummeta.h"
+
+static gboolean gst_checksum_meta_init(GstMeta * meta, gpointer params, GstBuffer * buffer);
+static gboolean gst_checksum_meta_transform(GstBuffer * dest, GstMeta * meta, GstBuffer * buffer, GQuark type,
+	gpointer data);
+
+GType
+gst_checksum_meta_api_get_type(void)
+{
+	static volatile GType type = 0;
+	static const gchar *tags[] = { GST_META_TAG_MEMORY_STR, NULL };
+
+	if (g_once_init_enter(&type)) {
+		GType api_type = gst_meta_api_type_register("GstMyFilterChecksumMetaAPI", tags);
+		g_once_init_leave(&type, api_type);
+	}
+
+	return type;
+}
+
+const GstMetaInfo *
+gst_checksum_meta_get_info(void)
+{
+	static const GstMetaInfo *meta_info = NULL;
+
+	if (g_once_init_enter(&meta_info)) {
+		const GstMetaInfo *info = gst_meta_register(GST_CHECKSUM_META_API_TYPE, "GstMyFilterChecksumMeta",
+			sizeof(GstChecksumMeta), gst_checksum_meta_init, NULL, gst_checksum_meta_transform);
+		g_once_init_leave(&meta_info, info);
+	}
+
+	return meta_info;
+}
+
+/*
+* Stamp the buffer. A checksum from further upstream is replaced. The buffer has to be writable.
+*/
+GstChecksumMeta *
+gst_buffer_set_checksum_meta(GstBuffer * buffer, guint32 crc32c, gsize size)
+{
+	GstChecksumMeta *meta = gst_buffer_get_checksum_meta(buffer);
+
+	if (meta == NULL)
+		meta = (GstChecksumMeta *)gst_buffer_add_meta(buffer, GST_CHECKSUM_META_INFO, NULL);
+
+	if (meta != NULL) {
+		meta->crc32c = crc32c;
+		meta->size = size;
+	}
+
+	return meta;
+}
+
+static gboolean
+gst_checksum_meta_init(GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+	GstChecksumMeta *checksum_meta = (GstChecksumMeta *)meta;
+
+	checksum_meta->crc32c = 0;
+	checksum_meta->size = 0;
+
+	return TRUE;
+}
+
+/*
+* The checksum only holds for a copy of all the bytes. A part of them goes without it.
+*/
+static gboolean
+gst_checksum_meta_transform(GstBuffer * dest, GstMeta * meta, GstBuffer * buffer, GQuark type, gpointer data)
+{
+	GstChecksumMeta *checksum_meta = (GstChecksumMeta *)meta;
+	GstMetaTransformCopy *copy = data;
+
+	if (!GST_META_TRANSFORM_IS_COPY(type))
+		return FALSE;
+
+	if (copy->region && (copy->offset != 0 || (copy->size != (gsize)-1 && copy->size != checksum_meta->size)))
+		return TRUE;
+
+	return gst_buffer_set_checksum_meta(dest, checksum_meta->crc32c, checksum_meta->size) != NULL;
+}
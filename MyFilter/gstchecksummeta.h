@@ -0,0 +1,35 @@
+#ifndef __GST_CHECKSUMMETA_H__
+#define __GST_CHECKSUMMETA_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_CHECKSUM_META_API_TYPE	(gst_checksum_meta_api_get_type())
+#define GST_CHECKSUM_META_INFO		(gst_checksum_meta_get_info())
+
+typedef struct _GstChecksumMeta GstChecksumMeta;
+
+/*
+* The CRC32C of the bytes of a buffer and their number, as the stamping myfilter saw them. The meta has no tags and
+* is only copied with all the bytes, so an element changing them drops it or gets it counted as a mismatch.
+*/
+struct _GstChecksumMeta
+{
+	GstMeta		meta;
+
+	guint32		crc32c;
+	gsize		size;
+};
+
+GType gst_checksum_meta_api_get_type(void);
+
+const GstMetaInfo * gst_checksum_meta_get_info(void);
+
+GstChecksumMeta * gst_buffer_set_checksum_meta(GstBuffer * buffer, guint32 crc32c, gsize size);
+
+#define gst_buffer_get_checksum_meta(b) ((GstChecksumMeta *)gst_buffer_get_meta((b), GST_CHECKSUM_META_API_TYPE))
+
+G_END_DECLS
+
+#endif /* __GST_CHECKSUMMETA_H__ */
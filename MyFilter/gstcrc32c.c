@@ -0,0 +1,280 @@
+#include "gstcrc32c.h"
+
+#include <string.h>
+
+// The crc32 instruction is picked at runtime. The other CPUs and compilers use the tables.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32C_HAVE_X86			1
+#include <immintrin.h>
+#define CRC32C_TARGET_SSE42		__attribute__((target("sse4.2")))
+#endif
+
+// The Castagnoli polynomial, reflected
+#define CRC32C_POLY				0x82f63b78
+
+// The instruction takes 3 cycles and a new one each cycle, so three streams run side by side. The long streams are
+// for the large buffers, the short ones for the rest. They are powers of two for the zeros operators.
+#define CRC32C_LONG				8192
+#define CRC32C_SHORT			256
+
+typedef struct
+{
+	const gchar	*name;
+	guint32		(*update) (guint32 crc, const guint8 * data, gsize size);
+} GstCrc32cCode;
+
+static guint32 crc32c_update_table(guint32 crc, const guint8 * data, gsize size);
+#ifdef CRC32C_HAVE_X86
+static guint32 crc32c_update_sse42(guint32 crc, const guint8 * data, gsize size);
+#endif
+
+// From the slowest to the fastest
+static const GstCrc32cCode crc32c_code_table[] = {
+	{ "table", crc32c_update_table },
+#ifdef CRC32C_HAVE_X86
+	{ "sse4.2", crc32c_update_sse42 },
+#endif
+};
+
+// Picked when the plugin is loaded
+static const GstCrc32cCode *crc32c_code = &crc32c_code_table[0];
+
+// Slicing by 8 for the tables, the operators appending the zeros of a stream for the instruction
+static guint32 crc32c_table[8][256];
+static guint32 crc32c_long[4][256];
+static guint32 crc32c_short[4][256];
+
+static guint32
+crc32c_matrix_times(const guint32 * matrix, guint32 vector)
+{
+	guint32 sum = 0;
+
+	for (; vector != 0; vector >>= 1, matrix++) {
+		if (vector & 1)
+			sum ^= *matrix;
+	}
+
+	return sum;
+}
+
+static void
+crc32c_matrix_square(guint32 * square, const guint32 * matrix)
+{
+	for (guint n = 0; n < 32; n++)
+		square[n] = crc32c_matrix_times(matrix, matrix[n]);
+}
+
+/*
+* The tables of the operator appending the zero bytes to a CRC. The length is a power of two.
+*/
+static void
+crc32c_init_zeros(guint32 zeros[4][256], gsize size)
+{
+	guint32 even[32], odd[32];
+
+	// One zero bit
+	odd[0] = CRC32C_POLY;
+	for (guint n = 1; n < 32; n++)
+		odd[n] = 1u << (n - 1);
+
+	// Two, then four of them
+	crc32c_matrix_square(even, odd);
+	crc32c_matrix_square(odd, even);
+
+	// Squared into a byte, then into two bytes and so on. The last square ends in even.
+	for (;;) {
+		crc32c_matrix_square(even, odd);
+		size >>= 1;
+		if (size == 0)
+			break;
+
+		crc32c_matrix_square(odd, even);
+		size >>= 1;
+		if (size == 0) {
+			memcpy(even, odd, sizeof(even));
+			break;
+		}
+	}
+
+	for (guint n = 0; n < 256; n++) {
+		zeros[0][n] = crc32c_matrix_times(even, n);
+		zeros[1][n] = crc32c_matrix_times(even, n << 8);
+		zeros[2][n] = crc32c_matrix_times(even, n << 16);
+		zeros[3][n] = crc32c_matrix_times(even, n << 24);
+	}
+}
+
+/*
+* Fill the tables and pick the fastest code the CPU runs. The environment variable can cap it, to compare with the
+* tables.
+*/
+void
+gst_crc32c_init(void)
+{
+	const gchar *cap = g_getenv(CRC32C_ENV);
+	guint best = 0;
+
+	for (guint n = 0; n < 256; n++) {
+		guint32 crc = n;
+
+		for (guint k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc32c_table[0][n] = crc;
+	}
+
+	for (guint n = 0; n < 256; n++) {
+		for (guint k = 1; k < 8; k++)
+			crc32c_table[k][n] = (crc32c_table[k - 1][n] >> 8) ^ crc32c_table[0][crc32c_table[k - 1][n] & 0xff];
+	}
+
+	crc32c_init_zeros(crc32c_long, CRC32C_LONG);
+	crc32c_init_zeros(crc32c_short, CRC32C_SHORT);
+
+#ifdef CRC32C_HAVE_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("sse4.2"))
+		best = 1;
+#endif
+
+	for (guint i = 0; cap != NULL && i < best; i++) {
+		if (g_strcmp0(cap, crc32c_code_table[i].name) == 0)
+			best = i;
+	}
+
+	crc32c_code = &crc32c_code_table[best];
+}
+
+const gchar *
+gst_crc32c_get_name(void)
+{
+	return crc32c_code->name;
+}
+
+/*
+* Add the bytes to the CRC. The CRC of nothing is 0, so the CRC of a buffer is the one of its memories in turn.
+*/
+guint32
+gst_crc32c_update(guint32 crc, gconstpointer data, gsize size)
+{
+	return crc32c_code->update(crc, data, size);
+}
+
+/*
+* The CRC of the bytes of all the memories of the buffer. They are mapped one by one, so none is merged.
+*/
+guint32
+gst_crc32c_buffer(GstBuffer * buffer)
+{
+	guint32 crc = 0;
+	guint n = gst_buffer_n_memory(buffer);
+
+	for (guint i = 0; i < n; i++) {
+		GstMemory *memory = gst_buffer_peek_memory(buffer, i);
+		GstMapInfo map;
+
+		if (!gst_memory_map(memory, &map, GST_MAP_READ))
+			continue;
+
+		crc = gst_crc32c_update(crc, map.data, map.size);
+		gst_memory_unmap(memory, &map);
+	}
+
+	return crc;
+}
+
+static guint32
+crc32c_update_table(guint32 crc, const guint8 * data, gsize size)
+{
+	crc = ~crc;
+
+	while (size > 0 && ((guintptr)data & 7) != 0) {
+		crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xff];
+		size--;
+	}
+
+	for (; size >= 8; size -= 8, data += 8) {
+		guint32 low = crc ^ GUINT32_FROM_LE(*(const guint32 *)data);
+		guint32 high = GUINT32_FROM_LE(*(const guint32 *)(data + 4));
+
+		crc = crc32c_table[7][low & 0xff] ^ crc32c_table[6][(low >> 8) & 0xff] ^
+			crc32c_table[5][(low >> 16) & 0xff] ^ crc32c_table[4][low >> 24] ^
+			crc32c_table[3][high & 0xff] ^ crc32c_table[2][(high >> 8) & 0xff] ^
+			crc32c_table[1][(high >> 16) & 0xff] ^ crc32c_table[0][high >> 24];
+	}
+
+	while (size > 0) {
+		crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *data++) & 0xff];
+		size--;
+	}
+
+	return ~crc;
+}
+
+#ifdef CRC32C_HAVE_X86
+
+static inline guint32
+crc32c_shift(guint32 zeros[4][256], guint32 crc)
+{
+	return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^ zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+#ifdef __x86_64__
+#define CRC32C_WORD				8
+#define crc32c_word(crc, p)		((guint32)_mm_crc32_u64((crc), *(const guint64 *)(p)))
+#else
+#define CRC32C_WORD				4
+#define crc32c_word(crc, p)		_mm_crc32_u32((crc), *(const guint32 *)(p))
+#endif
+
+/*
+* Three streams of a block each, then the CRCs of the first two are moved past the zeros of the next blocks and
+* added up.
+*/
+CRC32C_TARGET_SSE42 static guint32
+crc32c_update_sse42(guint32 crc, const guint8 * data, gsize size)
+{
+	guint32 crc0 = ~crc, crc1, crc2;
+	const guint8 *end;
+
+	while (size > 0 && ((guintptr)data & (CRC32C_WORD - 1)) != 0) {
+		crc0 = _mm_crc32_u8(crc0, *data++);
+		size--;
+	}
+
+	for (; size >= 3 * CRC32C_LONG; size -= 3 * CRC32C_LONG, data += 2 * CRC32C_LONG) {
+		crc1 = 0;
+		crc2 = 0;
+		for (end = data + CRC32C_LONG; data < end; data += CRC32C_WORD) {
+			crc0 = crc32c_word(crc0, data);
+			crc1 = crc32c_word(crc1, data + CRC32C_LONG);
+			crc2 = crc32c_word(crc2, data + 2 * CRC32C_LONG);
+		}
+		crc0 = crc32c_shift(crc32c_long, crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_long, crc0) ^ crc2;
+	}
+
+	for (; size >= 3 * CRC32C_SHORT; size -= 3 * CRC32C_SHORT, data += 2 * CRC32C_SHORT) {
+		crc1 = 0;
+		crc2 = 0;
+		for (end = data + CRC32C_SHORT; data < end; data += CRC32C_WORD) {
+			crc0 = crc32c_word(crc0, data);
+			crc1 = crc32c_word(crc1, data + CRC32C_SHORT);
+			crc2 = crc32c_word(crc2, data + 2 * CRC32C_SHORT);
+		}
+		crc0 = crc32c_shift(crc32c_short, crc0) ^ crc1;
+		crc0 = crc32c_shift(crc32c_short, crc0) ^ crc2;
+	}
+
+	for (; size >= CRC32C_WORD; size -= CRC32C_WORD, data += CRC32C_WORD)
+		crc0 = crc32c_word(crc0, data);
+
+	while (size > 0) {
+		crc0 = _mm_crc32_u8(crc0, *data++);
+		size--;
+	}
+
+	return ~crc0;
+}
+
+#endif
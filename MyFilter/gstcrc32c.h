@@ -0,0 +1,21 @@
+#ifndef __GST_CRC32C_H__
+#define __GST_CRC32C_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// The environment variable which caps the code, as "table" or "sse4.2"
+#define CRC32C_ENV			"MYFILTER_CRC32C"
+
+void gst_crc32c_init(void);
+
+const gchar * gst_crc32c_get_name(void);
+
+guint32 gst_crc32c_update(guint32 crc, gconstpointer data, gsize size);
+
+guint32 gst_crc32c_buffer(GstBuffer * buffer);
+
+G_END_DECLS
+
+#endif /* __GST_CRC32C_H__ */
@@ -0,0 +1,174 @@
+#include "gstfreezedetect.h"
+
+#include <string.h>
+
+// SSE2 is there on every x86-64 CPU. PSADBW takes the absolute differences of 16 bytes at a time.
+#if defined(__GNUC__) && defined(__SSE2__)
+#define FREEZE_HAVE_SSE2		1
+#include <emmintrin.h>
+#endif
+
+static gdouble gst_freeze_detector_compare(GstFreezeDetector * detector, const guint8 * plane, gint stride);
+static void gst_freeze_detector_copy(GstFreezeDetector * detector, const guint8 * plane, gint stride);
+
+/*
+* Allocate a detector for the first plane of the frames. The edges past the last whole cell are left out.
+*/
+GstFreezeDetector *
+gst_freeze_detector_new(guint row_bytes, guint height)
+{
+	GstFreezeDetector *detector = g_new0(GstFreezeDetector, 1);
+
+	detector->row_bytes = row_bytes;
+	detector->height = height;
+
+	detector->columns = MAX(MIN(FREEZE_COLUMNS, row_bytes), 1);
+	detector->rows = MAX(MIN(FREEZE_ROWS, height), 1);
+	detector->cell_width = row_bytes / detector->columns;
+	detector->cell_height = height / detector->rows;
+	detector->row_step = MAX(detector->cell_height / FREEZE_ROWS_PER_CELL, 1);
+	detector->cell_rows = (detector->cell_height + detector->row_step - 1) / detector->row_step;
+	detector->cell_samples = MAX(detector->cell_width * detector->cell_rows, 1);
+
+	detector->reference = g_malloc0((gsize)detector->rows * detector->cell_rows * detector->columns *
+		detector->cell_width);
+	detector->sums = g_new0(guint32, detector->columns);
+
+	gst_freeze_detector_reset(detector);
+
+	return detector;
+}
+
+void
+gst_freeze_detector_free(GstFreezeDetector * detector)
+{
+	if (detector == NULL)
+		return;
+
+	g_free(detector->reference);
+	g_free(detector->sums);
+	g_free(detector);
+}
+
+/*
+* Forget the reference. The next frame is not a duplicate.
+*/
+void
+gst_freeze_detector_reset(GstFreezeDetector * detector)
+{
+	detector->has_reference = FALSE;
+	detector->difference = 0.0;
+}
+
+void
+gst_freeze_detector_set_threshold(GstFreezeDetector * detector, gdouble threshold)
+{
+	detector->threshold = threshold;
+}
+
+/*
+* Compare a frame to the reference. It returns TRUE when no cell differs by more than the threshold, otherwise the
+* frame becomes the reference.
+*/
+gboolean
+gst_freeze_detector_add(GstFreezeDetector * detector, const guint8 * plane, gint stride)
+{
+	if (detector->has_reference) {
+		detector->difference = gst_freeze_detector_compare(detector, plane, stride);
+		if (detector->difference <= detector->threshold)
+			return TRUE;
+	}
+	else {
+		detector->difference = G_MAXDOUBLE;
+	}
+
+	gst_freeze_detector_copy(detector, plane, stride);
+	detector->has_reference = TRUE;
+
+	return FALSE;
+}
+
+#ifdef FREEZE_HAVE_SSE2
+
+static guint32
+gst_freeze_detector_sad(const guint8 * a, const guint8 * b, guint size)
+{
+	__m128i sum = _mm_setzero_si128();
+	guint i = 0;
+	guint32 total;
+
+	// A row of a cell is far too short for the 32 bit sums to overflow
+	for (; i + 16 <= size; i += 16)
+		sum = _mm_add_epi32(sum, _mm_sad_epu8(_mm_loadu_si128((const __m128i *)(a + i)),
+			_mm_loadu_si128((const __m128i *)(b + i))));
+
+	total = (guint32)_mm_cvtsi128_si32(sum) + (guint32)_mm_cvtsi128_si32(_mm_srli_si128(sum, 8));
+	for (; i < size; i++)
+		total += ABS(a[i] - b[i]);
+
+	return total;
+}
+
+#else
+
+static guint32
+gst_freeze_detector_sad(const guint8 * a, const guint8 * b, guint size)
+{
+	guint32 total = 0;
+
+	for (guint i = 0; i < size; i++)
+		total += ABS(a[i] - b[i]);
+
+	return total;
+}
+
+#endif
+
+/*
+* The largest mean absolute difference of a cell to the reference
+*/
+static gdouble
+gst_freeze_detector_compare(GstFreezeDetector * detector, const guint8 * plane, gint stride)
+{
+	guint width = detector->columns * detector->cell_width;
+	const guint8 *reference = detector->reference;
+	guint32 largest = 0;
+
+	for (guint r = 0; r < detector->rows; r++) {
+		guint top = r * detector->cell_height;
+
+		memset(detector->sums, 0, sizeof(guint32) * detector->columns);
+
+		for (guint y = top; y < top + detector->cell_height; y += detector->row_step, reference += width) {
+			const guint8 *line = plane + (gssize)y * stride;
+
+			for (guint c = 0; c < detector->columns; c++) {
+				guint offset = c * detector->cell_width;
+
+				detector->sums[c] += gst_freeze_detector_sad(line + offset, reference + offset, detector->cell_width);
+			}
+		}
+
+		for (guint c = 0; c < detector->columns; c++)
+			largest = MAX(largest, detector->sums[c]);
+	}
+
+	return (gdouble)largest / detector->cell_samples;
+}
+
+/*
+* Keep the compared rows of the frame as the reference
+*/
+static void
+gst_freeze_detector_copy(GstFreezeDetector * detector, const guint8 * plane, gint stride)
+{
+	guint width = detector->columns * detector->cell_width;
+	guint8 *reference = detector->reference;
+
+	for (guint r = 0; r < detector->rows; r++) {
+		guint top = r * detector->cell_height;
+
+		for (guint y = top; y < top + detector->cell_height; y += detector->row_step, reference += width)
+			memcpy(reference, plane + (gssize)y * stride, width);
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef __GST_FREEZEDETECT_H__
+#define __GST_FREEZEDETECT_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// The frame is split into a grid of cells. A frame with fewer rows or bytes per row has one cell for each.
+#define FREEZE_COLUMNS			32
+#define FREEZE_ROWS				18
+
+// The rows compared in each cell. The ones in between are skipped.
+#define FREEZE_ROWS_PER_CELL	8
+
+typedef struct _GstFreezeDetector GstFreezeDetector;
+
+/*
+* Tells the frames that are the same as a reference one. The frame is compared on every few rows, by the mean
+* absolute difference of the bytes of each cell, so a change in any part of the picture counts alone. A frame that
+* differs becomes the reference, so a slow fade does not pass as a freeze.
+*/
+struct _GstFreezeDetector
+{
+	// The first plane, in bytes
+	guint		row_bytes;
+	guint		height;
+
+	guint		columns;
+	guint		rows;
+	guint		cell_width;
+	guint		cell_height;
+	guint		row_step;
+	guint		cell_rows;
+	guint		cell_samples;
+
+	// The largest difference of a cell mean a duplicate may have
+	gdouble		threshold;
+
+	// The compared rows of the reference, one after the other
+	guint8		*reference;
+	gboolean	has_reference;
+	guint32		*sums;
+
+	// Of the latest frame to the reference
+	gdouble		difference;
+};
+
+GstFreezeDetector * gst_freeze_detector_new(guint row_bytes, guint height);
+
+void gst_freeze_detector_free(GstFreezeDetector * detector);
+
+void gst_freeze_detector_reset(GstFreezeDetector * detector);
+
+void gst_freeze_detector_set_threshold(GstFreezeDetector * detector, gdouble threshold);
+
+gboolean gst_freeze_detector_add(GstFreezeDetector * detector, const guint8 * plane, gint stride);
+
+G_END_DECLS
+
+#endif /* __GST_FREEZEDETECT_H__ */
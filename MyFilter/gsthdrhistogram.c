@@ -0,0 +1,103 @@
+#include "gsthdrhistogram.h"
+
+#include <string.h>
+
+static guint gst_hdr_histogram_get_index(guint64 value);
+static guint64 gst_hdr_histogram_get_value(guint index);
+
+GstHdrHistogram *
+gst_hdr_histogram_new(void)
+{
+	GstHdrHistogram *histogram = g_new0(GstHdrHistogram, 1);
+
+	gst_hdr_histogram_reset(histogram);
+
+	return histogram;
+}
+
+void
+gst_hdr_histogram_free(GstHdrHistogram * histogram)
+{
+	g_free(histogram);
+}
+
+void
+gst_hdr_histogram_reset(GstHdrHistogram * histogram)
+{
+	memset(histogram->counts, 0, sizeof(histogram->counts));
+	histogram->total = 0;
+	histogram->min = G_MAXUINT64;
+	histogram->max = 0;
+	histogram->sum = 0;
+}
+
+void
+gst_hdr_histogram_record(GstHdrHistogram * histogram, guint64 value)
+{
+	histogram->counts[gst_hdr_histogram_get_index(value)]++;
+	histogram->total++;
+	histogram->min = MIN(histogram->min, value);
+	histogram->max = MAX(histogram->max, value);
+	histogram->sum += (gdouble)value;
+}
+
+/*
+* Find the value at the percentile. It is the highest value of its bucket, so it is never below the exact one.
+*/
+guint64
+gst_hdr_histogram_get_percentile(GstHdrHistogram * histogram, gdouble percentile)
+{
+	guint64 target, count = 0;
+
+	if (histogram->total == 0)
+		return 0;
+
+	target = (guint64)(percentile / 100.0 * histogram->total + 0.5);
+	target = CLAMP(target, 1, histogram->total);
+
+	for (guint i = 0; i < HDR_HISTOGRAM_BUCKETS; i++) {
+		count += histogram->counts[i];
+		if (count >= target)
+			return MIN(gst_hdr_histogram_get_value(i), histogram->max);
+	}
+
+	return histogram->max;
+}
+
+gdouble
+gst_hdr_histogram_get_mean(GstHdrHistogram * histogram)
+{
+	return histogram->total > 0 ? histogram->sum / histogram->total : 0;
+}
+
+/*
+* The values below 128 have their own buckets. The others keep the 7 bits below their most significant one.
+*/
+static guint
+gst_hdr_histogram_get_index(guint64 value)
+{
+	guint shift;
+
+	if (value < HDR_HISTOGRAM_SUB_COUNT)
+		return (guint)value;
+
+	value = MIN(value, (G_GUINT64_CONSTANT(1) << HDR_HISTOGRAM_MAX_BITS) - 1);
+	shift = g_bit_storage(value) - 1 - HDR_HISTOGRAM_SUB_BITS;
+
+	return HDR_HISTOGRAM_SUB_COUNT * (shift + 1) + (guint)(value >> shift) - HDR_HISTOGRAM_SUB_COUNT;
+}
+
+static guint64
+gst_hdr_histogram_get_value(guint index)
+{
+	guint shift;
+	guint64 sub;
+
+	if (index < HDR_HISTOGRAM_SUB_COUNT)
+		return index;
+
+	shift = index / HDR_HISTOGRAM_SUB_COUNT - 1;
+	sub = index % HDR_HISTOGRAM_SUB_COUNT + HDR_HISTOGRAM_SUB_COUNT;
+
+	return (sub << shift) + ((G_GUINT64_CONSTANT(1) << shift) - 1);
+}
@@ -0,0 +1,44 @@
+#ifndef __GST_HDRHISTOGRAM_H__
+#define __GST_HDRHISTOGRAM_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// Each power of two is split into 128 buckets, so the values are kept within 1 %. The values up to 128 are exact.
+#define HDR_HISTOGRAM_SUB_BITS		7
+#define HDR_HISTOGRAM_SUB_COUNT		(1 << HDR_HISTOGRAM_SUB_BITS)
+
+// The largest value kept is 2^40 - 1 ns, about 18 minutes. The larger ones count as it.
+#define HDR_HISTOGRAM_MAX_BITS		40
+#define HDR_HISTOGRAM_BUCKETS		(HDR_HISTOGRAM_SUB_COUNT * (HDR_HISTOGRAM_MAX_BITS - HDR_HISTOGRAM_SUB_BITS + 1))
+
+typedef struct _GstHdrHistogram GstHdrHistogram;
+
+/*
+* A log-linear histogram as in HdrHistogram. Recording is an index computation and an increment.
+*/
+struct _GstHdrHistogram
+{
+	guint64		counts[HDR_HISTOGRAM_BUCKETS];
+	guint64		total;
+	guint64		min;
+	guint64		max;
+	gdouble		sum;
+};
+
+GstHdrHistogram * gst_hdr_histogram_new(void);
+
+void gst_hdr_histogram_free(GstHdrHistogram * histogram);
+
+void gst_hdr_histogram_reset(GstHdrHistogram * histogram);
+
+void gst_hdr_histogram_record(GstHdrHistogram * histogram, guint64 value);
+
+guint64 gst_hdr_histogram_get_percentile(GstHdrHistogram * histogram, gdouble percentile);
+
+gdouble gst_hdr_histogram_get_mean(GstHdrHistogram * histogram);
+
+G_END_DECLS
+
+#endif /* __GST_HDRHISTOGRAM_H__ */
@@ -0,0 +1,74 @@
+#include "gstlatencymeta.h"
+
+static gboolean gst_latency_meta_init(GstMeta * meta, gpointer params, GstBuffer * buffer);
+static gboolean gst_latency_meta_transform(GstBuffer * dest, GstMeta * meta, GstBuffer * buffer, GQuark type,
+	gpointer data);
+
+GType
+gst_latency_meta_api_get_type(void)
+{
+	static volatile GType type = 0;
+	static const gchar *tags[] = { NULL };
+
+	if (g_once_init_enter(&type)) {
+		GType api_type = gst_meta_api_type_register("GstMyFilterLatencyMetaAPI", tags);
+		g_once_init_leave(&type, api_type);
+	}
+
+	return type;
+}
+
+const GstMetaInfo *
+gst_latency_meta_get_info(void)
+{
+	static const GstMetaInfo *meta_info = NULL;
+
+	if (g_once_init_enter(&meta_info)) {
+		const GstMetaInfo *info = gst_meta_register(GST_LATENCY_META_API_TYPE, "GstMyFilterLatencyMeta",
+			sizeof(GstLatencyMeta), gst_latency_meta_init, NULL, gst_latency_meta_transform);
+		g_once_init_leave(&meta_info, info);
+	}
+
+	return meta_info;
+}
+
+/*
+* Stamp the buffer. A stamp from further upstream is replaced. The buffer has to be writable.
+*/
+GstLatencyMeta *
+gst_buffer_set_latency_meta(GstBuffer * buffer, GstClockTime stamp, guint64 seqnum)
+{
+	GstLatencyMeta *meta = gst_buffer_get_latency_meta(buffer);
+
+	if (meta == NULL)
+		meta = (GstLatencyMeta *)gst_buffer_add_meta(buffer, GST_LATENCY_META_INFO, NULL);
+
+	if (meta != NULL) {
+		meta->stamp = stamp;
+		meta->seqnum = seqnum;
+	}
+
+	return meta;
+}
+
+static gboolean
+gst_latency_meta_init(GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+	GstLatencyMeta *latency_meta = (GstLatencyMeta *)meta;
+
+	latency_meta->stamp = GST_CLOCK_TIME_NONE;
+	latency_meta->seqnum = 0;
+
+	return TRUE;
+}
+
+/*
+* The stamp goes with the content whatever the transform is
+*/
+static gboolean
+gst_latency_meta_transform(GstBuffer * dest, GstMeta * meta, GstBuffer * buffer, GQuark type, gpointer data)
+{
+	GstLatencyMeta *latency_meta = (GstLatencyMeta *)meta;
+
+	return gst_buffer_set_latency_meta(dest, latency_meta->stamp, latency_meta->seqnum) != NULL;
+}
@@ -0,0 +1,35 @@
+#ifndef __GST_LATENCYMETA_H__
+#define __GST_LATENCYMETA_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_LATENCY_META_API_TYPE	(gst_latency_meta_api_get_type())
+#define GST_LATENCY_META_INFO		(gst_latency_meta_get_info())
+
+typedef struct _GstLatencyMeta GstLatencyMeta;
+
+/*
+* The monotonic time a buffer went through the stamping myfilter and its number there. The meta has no tags, so the
+* elements keeping the metas of any kind, the decoders among them, pass it on.
+*/
+struct _GstLatencyMeta
+{
+	GstMeta			meta;
+
+	GstClockTime	stamp;
+	guint64			seqnum;
+};
+
+GType gst_latency_meta_api_get_type(void);
+
+const GstMetaInfo * gst_latency_meta_get_info(void);
+
+GstLatencyMeta * gst_buffer_set_latency_meta(GstBuffer * buffer, GstClockTime stamp, guint64 seqnum);
+
+#define gst_buffer_get_latency_meta(b) ((GstLatencyMeta *)gst_buffer_get_meta((b), GST_LATENCY_META_API_TYPE))
+
+G_END_DECLS
+
+#endif /* __GST_LATENCYMETA_H__ */
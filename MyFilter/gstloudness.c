@@ -0,0 +1,489 @@
+#include "gstloudness.h"
+
+#include <math.h>
+#include <string.h>
+
+// SSE2 is there on every x86-64 CPU. The other CPUs filter a lane at a time.
+#if defined(__GNUC__) && defined(__SSE2__)
+#define LOUDNESS_HAVE_SSE2			1
+#include <emmintrin.h>
+#endif
+
+// The weight of the surround channels, +1.5 dB
+#define LOUDNESS_SURROUND_WEIGHT	1.41f
+
+static void loudness_design_k_weighting(GstLoudnessMeter * meter);
+static void loudness_design_fir(GstLoudnessMeter * meter);
+static void loudness_convert(GstLoudnessMeter * meter, GstAudioFormat format, gconstpointer samples, guint frames);
+static void loudness_process(GstLoudnessMeter * meter, const gfloat * x, guint frames);
+static void loudness_end_block(GstLoudnessMeter * meter);
+
+static gdouble
+loudness_to_lufs(gdouble energy)
+{
+	return energy > 0.0 ? MAX(-0.691 + 10.0 * log10(energy), LOUDNESS_SILENCE) : LOUDNESS_SILENCE;
+}
+
+static gfloat
+loudness_get_weight(GstAudioChannelPosition position)
+{
+	switch (position) {
+	case GST_AUDIO_CHANNEL_POSITION_LFE1:
+	case GST_AUDIO_CHANNEL_POSITION_LFE2:
+		return 0.0f;
+	case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_SIDE_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_SIDE_RIGHT:
+	case GST_AUDIO_CHANNEL_POSITION_SURROUND_LEFT:
+	case GST_AUDIO_CHANNEL_POSITION_SURROUND_RIGHT:
+		return LOUDNESS_SURROUND_WEIGHT;
+	default:
+		return 1.0f;
+	}
+}
+
+/*
+* Allocate a meter for the interleaved channels. Without positions every channel weighs the same.
+*/
+GstLoudnessMeter *
+gst_loudness_meter_new(guint rate, guint channels, const GstAudioChannelPosition * positions)
+{
+	GstLoudnessMeter *meter = g_new0(GstLoudnessMeter, 1);
+	guint lanes = (channels + LOUDNESS_LANES - 1) / LOUDNESS_LANES * LOUDNESS_LANES;
+
+	meter->rate = rate;
+	meter->channels = channels;
+	meter->lanes = lanes;
+	meter->block_frames = MAX(rate / 10, 1);
+
+	// The padding lanes weigh nothing, so they need no care
+	meter->weights = g_new0(gfloat, lanes);
+	for (guint c = 0; c < channels; c++)
+		meter->weights[c] = positions != NULL ? loudness_get_weight(positions[c]) : 1.0f;
+
+	// The rates above 96 kHz are their own true peak
+	meter->oversampling = rate < 96000 ? 4 : rate < 192000 ? 2 : 1;
+
+	meter->state = g_new0(gfloat, 4 * lanes);
+	meter->squares = g_new0(gfloat, lanes);
+	meter->fir = g_new0(gfloat, meter->oversampling * LOUDNESS_PEAK_TAPS);
+	meter->history = g_new0(gfloat, 2 * LOUDNESS_PEAK_TAPS * lanes);
+	meter->peaks = g_new0(gfloat, lanes);
+	meter->chunk = g_new0(gfloat, LOUDNESS_CHUNK * lanes);
+
+	loudness_design_k_weighting(meter);
+	loudness_design_fir(meter);
+	gst_loudness_meter_reset(meter);
+
+	return meter;
+}
+
+void
+gst_loudness_meter_free(GstLoudnessMeter * meter)
+{
+	if (meter == NULL)
+		return;
+
+	g_free(meter->weights);
+	g_free(meter->state);
+	g_free(meter->squares);
+	g_free(meter->fir);
+	g_free(meter->history);
+	g_free(meter->peaks);
+	g_free(meter->chunk);
+	g_free(meter);
+}
+
+void
+gst_loudness_meter_reset(GstLoudnessMeter * meter)
+{
+	memset(meter->state, 0, sizeof(gfloat) * 4 * meter->lanes);
+	memset(meter->squares, 0, sizeof(gfloat) * meter->lanes);
+	memset(meter->history, 0, sizeof(gfloat) * 2 * LOUDNESS_PEAK_TAPS * meter->lanes);
+	memset(meter->peaks, 0, sizeof(gfloat) * meter->lanes);
+	memset(meter->blocks, 0, sizeof(meter->blocks));
+	memset(meter->gate_counts, 0, sizeof(meter->gate_counts));
+	memset(meter->gate_sums, 0, sizeof(meter->gate_sums));
+
+	meter->block_position = 0;
+	meter->block_count = 0;
+	meter->history_position = 0;
+	meter->frames = 0;
+}
+
+/*
+* Measure the interleaved frames in the native S16, S32 or F32.
+*/
+void
+gst_loudness_meter_add(GstLoudnessMeter * meter, GstAudioFormat format, gconstpointer samples, gsize frames)
+{
+	gsize frame_size = meter->channels * (format == GST_AUDIO_FORMAT_S16 ? sizeof(gint16) : sizeof(gint32));
+	const guint8 *data = samples;
+
+	while (frames > 0) {
+		guint chunk = (guint)MIN(frames, LOUDNESS_CHUNK);
+
+		loudness_convert(meter, format, data, chunk);
+		loudness_process(meter, meter->chunk, chunk);
+
+		data += chunk * frame_size;
+		frames -= chunk;
+		meter->frames += chunk;
+	}
+}
+
+/*
+* The loudness of the latest 400 ms. The first blocks count for what there is of them.
+*/
+gdouble
+gst_loudness_meter_get_momentary(GstLoudnessMeter * meter)
+{
+	guint count = (guint)MIN(meter->block_count, LOUDNESS_MOMENTARY_BLOCKS);
+	gdouble sum = 0.0;
+
+	for (guint i = 1; i <= count; i++)
+		sum += meter->blocks[(meter->block_count - i) % LOUDNESS_SHORT_TERM_BLOCKS];
+
+	return count > 0 ? loudness_to_lufs(sum / count) : LOUDNESS_SILENCE;
+}
+
+/*
+* The loudness of the latest 3 s
+*/
+gdouble
+gst_loudness_meter_get_short_term(GstLoudnessMeter * meter)
+{
+	guint count = (guint)MIN(meter->block_count, LOUDNESS_SHORT_TERM_BLOCKS);
+	gdouble sum = 0.0;
+
+	for (guint i = 0; i < count; i++)
+		sum += meter->blocks[i];
+
+	return count > 0 ? loudness_to_lufs(sum / count) : LOUDNESS_SILENCE;
+}
+
+/*
+* The gated loudness since the reset. The relative gate falls on a 0.1 LU bin, the bins from it on count.
+*/
+gdouble
+gst_loudness_meter_get_integrated(GstLoudnessMeter * meter)
+{
+	guint64 count = 0;
+	gdouble sum = 0.0, gate;
+	gint first;
+
+	for (guint i = 0; i < LOUDNESS_HISTOGRAM_BINS; i++) {
+		count += meter->gate_counts[i];
+		sum += meter->gate_sums[i];
+	}
+
+	if (count == 0)
+		return LOUDNESS_SILENCE;
+
+	gate = loudness_to_lufs(sum / count) + LOUDNESS_RELATIVE_GATE;
+	first = (gint)floor((gate - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+	first = CLAMP(first, 0, LOUDNESS_HISTOGRAM_BINS - 1);
+
+	count = 0;
+	sum = 0.0;
+	for (guint i = (guint)first; i < LOUDNESS_HISTOGRAM_BINS; i++) {
+		count += meter->gate_counts[i];
+		sum += meter->gate_sums[i];
+	}
+
+	return count > 0 ? loudness_to_lufs(sum / count) : LOUDNESS_SILENCE;
+}
+
+/*
+* The highest true peak of all the channels since the reset, in dBTP
+*/
+gdouble
+gst_loudness_meter_get_true_peak(GstLoudnessMeter * meter)
+{
+	gfloat peak = 0.0f;
+
+	for (guint c = 0; c < meter->channels; c++)
+		peak = MAX(peak, meter->peaks[c]);
+
+	return peak > 0.0f ? MAX(20.0 * log10(peak), LOUDNESS_SILENCE) : LOUDNESS_SILENCE;
+}
+
+GstStructure *
+gst_loudness_meter_get_structure(GstLoudnessMeter * meter)
+{
+	return gst_structure_new("myfilter-loudness",
+		"momentary", G_TYPE_DOUBLE, gst_loudness_meter_get_momentary(meter),
+		"short-term", G_TYPE_DOUBLE, gst_loudness_meter_get_short_term(meter),
+		"integrated", G_TYPE_DOUBLE, gst_loudness_meter_get_integrated(meter),
+		"true-peak", G_TYPE_DOUBLE, gst_loudness_meter_get_true_peak(meter),
+		"duration", G_TYPE_UINT64, gst_util_uint64_scale(meter->frames, GST_SECOND, meter->rate), NULL);
+}
+
+/*
+* The two filters of BS.1770 for the sample rate, from their analog prototypes
+*/
+static void
+loudness_design_k_weighting(GstLoudnessMeter * meter)
+{
+	gdouble f0, q, k, vh, vb, a0;
+
+	// The high shelf of the head
+	f0 = 1681.974450955533;
+	q = 0.7071752369554196;
+	k = tan(G_PI * f0 / meter->rate);
+	vh = pow(10.0, 3.999843853973347 / 20.0);
+	vb = pow(vh, 0.4996667741545416);
+	a0 = 1.0 + k / q + k * k;
+	meter->coefficients[0][0] = (gfloat)((vh + vb * k / q + k * k) / a0);
+	meter->coefficients[0][1] = (gfloat)(2.0 * (k * k - vh) / a0);
+	meter->coefficients[0][2] = (gfloat)((vh - vb * k / q + k * k) / a0);
+	meter->coefficients[0][3] = (gfloat)(2.0 * (k * k - 1.0) / a0);
+	meter->coefficients[0][4] = (gfloat)((1.0 - k / q + k * k) / a0);
+
+	// The RLB high-pass
+	f0 = 38.13547087602444;
+	q = 0.5003270373238773;
+	k = tan(G_PI * f0 / meter->rate);
+	a0 = 1.0 + k / q + k * k;
+	meter->coefficients[1][0] = 1.0f;
+	meter->coefficients[1][1] = -2.0f;
+	meter->coefficients[1][2] = 1.0f;
+	meter->coefficients[1][3] = (gfloat)(2.0 * (k * k - 1.0) / a0);
+	meter->coefficients[1][4] = (gfloat)((1.0 - k / q + k * k) / a0);
+}
+
+/*
+* A windowed sinc interpolator split into its phases. The taps of each phase are reversed to run over the history
+* from the oldest frame and scaled to a gain of one.
+*/
+static void
+loudness_design_fir(GstLoudnessMeter * meter)
+{
+	guint phases = meter->oversampling;
+	guint length = phases * LOUDNESS_PEAK_TAPS;
+	gdouble center = (length - 1) / 2.0;
+
+	for (guint p = 0; p < phases; p++) {
+		gfloat *taps = meter->fir + p * LOUDNESS_PEAK_TAPS;
+		gdouble sum = 0.0;
+
+		for (guint j = 0; j < LOUDNESS_PEAK_TAPS; j++) {
+			guint n = p + phases * (LOUDNESS_PEAK_TAPS - 1 - j);
+			gdouble t = (n - center) / phases;
+			gdouble sinc = t == 0.0 ? 1.0 : sin(G_PI * t) / (G_PI * t);
+			// Blackman
+			gdouble window = 0.42 - 0.5 * cos(2.0 * G_PI * (n + 0.5) / length) +
+				0.08 * cos(4.0 * G_PI * (n + 0.5) / length);
+
+			taps[j] = (gfloat)(sinc * window);
+			sum += taps[j];
+		}
+
+		for (guint j = 0; j < LOUDNESS_PEAK_TAPS; j++)
+			taps[j] = (gfloat)(taps[j] / sum);
+	}
+}
+
+/*
+* Convert the frames to float in the lanes of the chunk. The padding lanes stay zero.
+*/
+static void
+loudness_convert(GstLoudnessMeter * meter, GstAudioFormat format, gconstpointer samples, guint frames)
+{
+	guint channels = meter->channels;
+	guint lanes = meter->lanes;
+	gfloat *out = meter->chunk;
+
+	switch (format) {
+	case GST_AUDIO_FORMAT_S16:
+	{
+		const gint16 *in = samples;
+
+		for (guint f = 0; f < frames; f++, in += channels, out += lanes) {
+			for (guint c = 0; c < channels; c++)
+				out[c] = in[c] * (1.0f / 32768.0f);
+		}
+		break;
+	}
+	case GST_AUDIO_FORMAT_S32:
+	{
+		const gint32 *in = samples;
+
+		for (guint f = 0; f < frames; f++, in += channels, out += lanes) {
+			for (guint c = 0; c < channels; c++)
+				out[c] = in[c] * (1.0f / 2147483648.0f);
+		}
+		break;
+	}
+	default:
+	{
+		const gfloat *in = samples;
+
+		for (guint f = 0; f < frames; f++, in += channels, out += lanes)
+			memcpy(out, in, channels * sizeof(gfloat));
+		break;
+	}
+	}
+}
+
+/*
+* Keep the frame twice in the history, so the latest taps are always in one run from the position on.
+*/
+static const gfloat *
+loudness_push_history(GstLoudnessMeter * meter, const gfloat * frame)
+{
+	guint lanes = meter->lanes;
+	guint position = meter->history_position;
+	const gfloat *window = meter->history + (position + 1) * lanes;
+
+	memcpy(meter->history + position * lanes, frame, lanes * sizeof(gfloat));
+	memcpy(meter->history + (position + LOUDNESS_PEAK_TAPS) * lanes, frame, lanes * sizeof(gfloat));
+	meter->history_position = (position + 1) % LOUDNESS_PEAK_TAPS;
+
+	return window;
+}
+
+#ifdef LOUDNESS_HAVE_SSE2
+
+/*
+* Filter, square and interpolate a frame at a time, four channels per vector.
+*/
+static void
+loudness_process(GstLoudnessMeter * meter, const gfloat * x, guint frames)
+{
+	const guint lanes = meter->lanes;
+	const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const gfloat *k1 = meter->coefficients[0];
+	const gfloat *k2 = meter->coefficients[1];
+	gfloat *state = meter->state;
+
+	for (guint f = 0; f < frames; f++, x += lanes) {
+		const gfloat *window = loudness_push_history(meter, x);
+
+		for (guint l = 0; l < lanes; l += LOUDNESS_LANES) {
+			__m128 in = _mm_loadu_ps(x + l);
+			__m128 s1 = _mm_loadu_ps(state + l);
+			__m128 s2 = _mm_loadu_ps(state + lanes + l);
+			__m128 s3 = _mm_loadu_ps(state + 2 * lanes + l);
+			__m128 s4 = _mm_loadu_ps(state + 3 * lanes + l);
+			__m128 y, z, peak;
+
+			// Transposed direct form II
+			y = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(k1[0]), in), s1);
+			s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k1[1]), in), _mm_mul_ps(_mm_set1_ps(k1[3]), y)), s2);
+			s2 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k1[2]), in), _mm_mul_ps(_mm_set1_ps(k1[4]), y));
+
+			z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(k2[0]), y), s3);
+			s3 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k2[1]), y), _mm_mul_ps(_mm_set1_ps(k2[3]), z)), s4);
+			s4 = _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(k2[2]), y), _mm_mul_ps(_mm_set1_ps(k2[4]), z));
+
+			_mm_storeu_ps(state + l, s1);
+			_mm_storeu_ps(state + lanes + l, s2);
+			_mm_storeu_ps(state + 2 * lanes + l, s3);
+			_mm_storeu_ps(state + 3 * lanes + l, s4);
+			_mm_storeu_ps(meter->squares + l, _mm_add_ps(_mm_loadu_ps(meter->squares + l), _mm_mul_ps(z, z)));
+
+			peak = _mm_loadu_ps(meter->peaks + l);
+			if (meter->oversampling == 1) {
+				peak = _mm_max_ps(peak, _mm_and_ps(in, sign));
+			}
+			else {
+				for (guint p = 0; p < meter->oversampling; p++) {
+					const gfloat *taps = meter->fir + p * LOUDNESS_PEAK_TAPS;
+					__m128 sum = _mm_setzero_ps();
+
+					for (guint j = 0; j < LOUDNESS_PEAK_TAPS; j++)
+						sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(taps[j]), _mm_loadu_ps(window + j * lanes + l)));
+					peak = _mm_max_ps(peak, _mm_and_ps(sum, sign));
+				}
+			}
+			_mm_storeu_ps(meter->peaks + l, peak);
+		}
+
+		if (++meter->block_position == meter->block_frames)
+			loudness_end_block(meter);
+	}
+}
+
+#else
+
+static void
+loudness_process(GstLoudnessMeter * meter, const gfloat * x, guint frames)
+{
+	const guint lanes = meter->lanes;
+	const gfloat *k1 = meter->coefficients[0];
+	const gfloat *k2 = meter->coefficients[1];
+	gfloat *s1 = meter->state, *s2 = s1 + lanes, *s3 = s2 + lanes, *s4 = s3 + lanes;
+
+	for (guint f = 0; f < frames; f++, x += lanes) {
+		const gfloat *window = loudness_push_history(meter, x);
+
+		for (guint l = 0; l < meter->channels; l++) {
+			gfloat y, z;
+
+			y = k1[0] * x[l] + s1[l];
+			s1[l] = k1[1] * x[l] - k1[3] * y + s2[l];
+			s2[l] = k1[2] * x[l] - k1[4] * y;
+
+			z = k2[0] * y + s3[l];
+			s3[l] = k2[1] * y - k2[3] * z + s4[l];
+			s4[l] = k2[2] * y - k2[4] * z;
+
+			meter->squares[l] += z * z;
+
+			if (meter->oversampling == 1) {
+				meter->peaks[l] = MAX(meter->peaks[l], fabsf(x[l]));
+				continue;
+			}
+
+			for (guint p = 0; p < meter->oversampling; p++) {
+				const gfloat *taps = meter->fir + p * LOUDNESS_PEAK_TAPS;
+				gfloat sum = 0.0f;
+
+				for (guint j = 0; j < LOUDNESS_PEAK_TAPS; j++)
+					sum += taps[j] * window[j * lanes + l];
+				meter->peaks[l] = MAX(meter->peaks[l], fabsf(sum));
+			}
+		}
+
+		if (++meter->block_position == meter->block_frames)
+			loudness_end_block(meter);
+	}
+}
+
+#endif
+
+/*
+* Close the 100 ms block. From the fourth one on, each closes a 400 ms gating block too.
+*/
+static void
+loudness_end_block(GstLoudnessMeter * meter)
+{
+	gdouble energy = 0.0;
+
+	for (guint c = 0; c < meter->channels; c++)
+		energy += meter->weights[c] * meter->squares[c];
+	memset(meter->squares, 0, sizeof(gfloat) * meter->lanes);
+
+	meter->blocks[meter->block_count % LOUDNESS_SHORT_TERM_BLOCKS] = energy / meter->block_frames;
+	meter->block_count++;
+	meter->block_position = 0;
+
+	if (meter->block_count >= LOUDNESS_MOMENTARY_BLOCKS) {
+		gdouble momentary = 0.0, loudness;
+
+		for (guint i = 1; i <= LOUDNESS_MOMENTARY_BLOCKS; i++)
+			momentary += meter->blocks[(meter->block_count - i) % LOUDNESS_SHORT_TERM_BLOCKS];
+		momentary /= LOUDNESS_MOMENTARY_BLOCKS;
+
+		loudness = loudness_to_lufs(momentary);
+		if (loudness >= LOUDNESS_ABSOLUTE_GATE) {
+			gint bin = (gint)((loudness - LOUDNESS_ABSOLUTE_GATE) / LOUDNESS_HISTOGRAM_STEP);
+
+			bin = MIN(bin, LOUDNESS_HISTOGRAM_BINS - 1);
+			meter->gate_counts[bin]++;
+			meter->gate_sums[bin] += momentary;
+		}
+	}
+}
@@ -0,0 +1,90 @@
+#ifndef __GST_LOUDNESS_H__
+#define __GST_LOUDNESS_H__
+
+#include <gst/gst.h>
+#include <gst/audio/audio.h>
+
+G_BEGIN_DECLS
+
+// The channels are filtered four at a time, the lanes past the last channel are zero
+#define LOUDNESS_LANES				4
+
+// The loudness is measured over blocks of 100 ms. The momentary one spans 4 of them, the short-term one 30.
+#define LOUDNESS_MOMENTARY_BLOCKS	4
+#define LOUDNESS_SHORT_TERM_BLOCKS	30
+
+// The gating blocks are kept as a histogram of 0.1 LU bins from the absolute gate up
+#define LOUDNESS_ABSOLUTE_GATE		-70.0
+#define LOUDNESS_RELATIVE_GATE		-10.0
+#define LOUDNESS_HISTOGRAM_STEP		0.1
+#define LOUDNESS_HISTOGRAM_BINS		800
+
+// What silence reads as, in LUFS and in dBTP
+#define LOUDNESS_SILENCE			-120.0
+
+// The taps of each phase of the true peak interpolation
+#define LOUDNESS_PEAK_TAPS			12
+
+// The frames converted to float at a time
+#define LOUDNESS_CHUNK				256
+
+typedef struct _GstLoudnessMeter GstLoudnessMeter;
+
+/*
+* Measures the loudness as in ITU-R BS.1770-4 and EBU R128. The K-weighting filters, the mean squares and the true
+* peak run on all the channels at once, a lane per channel.
+*/
+struct _GstLoudnessMeter
+{
+	guint		rate;
+	guint		channels;
+	guint		lanes;
+	gfloat		*weights;
+
+	// K-weighting, the shelf and the high-pass. The coefficients are b0 b1 b2 a1 a2.
+	gfloat		coefficients[2][5];
+	gfloat		*state;
+
+	// The sums of squares of the current block, the mean squares of the latest blocks
+	guint		block_frames;
+	guint		block_position;
+	gfloat		*squares;
+	gdouble		blocks[LOUDNESS_SHORT_TERM_BLOCKS];
+	guint64		block_count;
+
+	// The 400 ms blocks above the absolute gate, as counts and sums of mean squares
+	guint64		gate_counts[LOUDNESS_HISTOGRAM_BINS];
+	gdouble		gate_sums[LOUDNESS_HISTOGRAM_BINS];
+
+	// The oversampled peak. The history is twice as long so the taps are read in one run.
+	guint		oversampling;
+	gfloat		*fir;
+	gfloat		*history;
+	guint		history_position;
+	gfloat		*peaks;
+
+	gfloat		*chunk;
+	guint64		frames;
+};
+
+GstLoudnessMeter * gst_loudness_meter_new(guint rate, guint channels, const GstAudioChannelPosition * positions);
+
+void gst_loudness_meter_free(GstLoudnessMeter * meter);
+
+void gst_loudness_meter_reset(GstLoudnessMeter * meter);
+
+void gst_loudness_meter_add(GstLoudnessMeter * meter, GstAudioFormat format, gconstpointer samples, gsize frames);
+
+gdouble gst_loudness_meter_get_momentary(GstLoudnessMeter * meter);
+
+gdouble gst_loudness_meter_get_short_term(GstLoudnessMeter * meter);
+
+gdouble gst_loudness_meter_get_integrated(GstLoudnessMeter * meter);
+
+gdouble gst_loudness_meter_get_true_peak(GstLoudnessMeter * meter);
+
+GstStructure * gst_loudness_meter_get_structure(GstLoudnessMeter * meter);
+
+G_END_DECLS
+
+#endif /* __GST_LOUDNESS_H__ */
@@ -0,0 +1,246 @@
+#include "gstmeterstats.h"
+
+#include <string.h>
+
+static GstMeterSlot * gst_meter_stats_get_slot(GstMeterStats * stats);
+static void gst_meter_stats_add_to_slot(GstMeterSlot * slot, GstBuffer * buffer, GstClockTime now);
+static void gst_meter_stats_sum(GstMeterStats * stats, GstMeterSlot * sum);
+static GstStructure * gst_meter_stats_new_structure(const GstMeterSlot * sum);
+
+/*
+* Allocate the counters. The slots start on a cache line so no two threads share one.
+*/
+GstMeterStats *
+gst_meter_stats_new(void)
+{
+	GstMeterStats *stats = g_new0(GstMeterStats, 1);
+
+	stats->slots_memory = g_malloc0(sizeof(GstMeterSlot) * METER_STATS_MAX_THREADS + METER_STATS_CACHE_LINE);
+	stats->slots = (GstMeterSlot *)(((guintptr)stats->slots_memory + METER_STATS_CACHE_LINE - 1) &
+		~(guintptr)(METER_STATS_CACHE_LINE - 1));
+
+	gst_meter_stats_reset(stats);
+
+	return stats;
+}
+
+void
+gst_meter_stats_free(GstMeterStats * stats)
+{
+	if (stats == NULL)
+		return;
+
+	g_free(stats->slots_memory);
+	g_free(stats);
+}
+
+/*
+* Clear the counters. No buffer may be counted meanwhile.
+*/
+void
+gst_meter_stats_reset(GstMeterStats * stats)
+{
+	memset(stats->slots, 0, sizeof(GstMeterSlot) * METER_STATS_MAX_THREADS);
+
+	for (guint i = 0; i < METER_STATS_MAX_THREADS; i++) {
+		stats->slots[i].last_arrival = GST_CLOCK_TIME_NONE;
+		stats->slots[i].last_timestamp = GST_CLOCK_TIME_NONE;
+		stats->slots[i].last_end = GST_CLOCK_TIME_NONE;
+	}
+
+	// The first buffer takes the snapshot the rates start from
+	stats->next_snapshot = 0;
+	stats->snapshot_busy = 0;
+	stats->last_snapshot = GST_CLOCK_TIME_NONE;
+	stats->last_buffers = 0;
+	stats->last_bytes = 0;
+}
+
+/*
+* Set the interval of the snapshots. 0 disables them.
+*/
+void
+gst_meter_stats_set_interval(GstMeterStats * stats, GstClockTime interval)
+{
+	stats->interval = interval;
+}
+
+/*
+* Count a buffer arrived at the monotonic time. It returns TRUE when the calling thread has to take the snapshot.
+*/
+gboolean
+gst_meter_stats_add(GstMeterStats * stats, GstBuffer * buffer, GstClockTime now)
+{
+	GstMeterSlot *slot = gst_meter_stats_get_slot(stats);
+
+	// The arrivals of the threads sharing the slot interleave, so they give neither the jitter nor the gaps
+	if (slot == &stats->slots[METER_STATS_SHARED_SLOT]) {
+		__atomic_fetch_add(&slot->buffers, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&slot->bytes, (guint64)gst_buffer_get_size(buffer), __ATOMIC_RELAXED);
+	}
+	else {
+		gst_meter_stats_add_to_slot(slot, buffer, now);
+	}
+
+	return stats->interval > 0 && now >= stats->next_snapshot &&
+		g_atomic_int_compare_and_exchange(&stats->snapshot_busy, 0, 1);
+}
+
+/*
+* Count a buffer in the slot of the calling thread
+*/
+static void
+gst_meter_stats_add_to_slot(GstMeterSlot * slot, GstBuffer * buffer, GstClockTime now)
+{
+	GstClockTime timestamp = GST_BUFFER_DTS_OR_PTS(buffer);
+	GstClockTime duration = GST_BUFFER_DURATION(buffer);
+
+	slot->buffers++;
+	slot->bytes += gst_buffer_get_size(buffer);
+
+	// A discontinuity is neither a gap nor a jitter
+	if (GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DISCONT)) {
+		slot->last_timestamp = GST_CLOCK_TIME_NONE;
+		slot->last_end = GST_CLOCK_TIME_NONE;
+	}
+
+	if (GST_CLOCK_TIME_IS_VALID(slot->last_arrival)) {
+		GstClockTime interval = now - slot->last_arrival;
+
+		if (interval > slot->max_interval)
+			slot->max_interval = interval;
+
+		// J += (|D| - J) / 16 with D the difference of the arrival and the timestamp intervals
+		if (GST_CLOCK_TIME_IS_VALID(timestamp) && GST_CLOCK_TIME_IS_VALID(slot->last_timestamp)) {
+			gint64 difference = (gint64)interval - GST_CLOCK_DIFF(slot->last_timestamp, timestamp);
+
+			slot->jitter16 += ABS(difference) - (slot->jitter16 >> 4);
+		}
+	}
+	slot->last_arrival = now;
+
+	if (GST_CLOCK_TIME_IS_VALID(timestamp)) {
+		if (GST_CLOCK_TIME_IS_VALID(slot->last_end) && timestamp > slot->last_end + METER_STATS_GAP_TOLERANCE) {
+			slot->gaps++;
+			slot->gap_time += timestamp - slot->last_end;
+		}
+
+		slot->last_timestamp = timestamp;
+		slot->last_end = GST_CLOCK_TIME_IS_VALID(duration) ? timestamp + duration : GST_CLOCK_TIME_NONE;
+	}
+}
+
+/*
+* Add up the slots with the rates since the previous snapshot. The first one gives NULL since it has no rates.
+*/
+GstStructure *
+gst_meter_stats_take_snapshot(GstMeterStats * stats, GstClockTime now)
+{
+	GstStructure *snapshot = NULL;
+	GstMeterSlot sum;
+
+	gst_meter_stats_sum(stats, &sum);
+
+	if (GST_CLOCK_TIME_IS_VALID(stats->last_snapshot) && now > stats->last_snapshot) {
+		gdouble elapsed = (gdouble)(now - stats->last_snapshot) / GST_SECOND;
+
+		snapshot = gst_meter_stats_new_structure(&sum);
+		gst_structure_set(snapshot,
+			"buffer-rate", G_TYPE_DOUBLE, (sum.buffers - stats->last_buffers) / elapsed,
+			"bitrate", G_TYPE_DOUBLE, (sum.bytes - stats->last_bytes) * 8 / elapsed, NULL);
+	}
+
+	stats->last_snapshot = now;
+	stats->last_buffers = sum.buffers;
+	stats->last_bytes = sum.bytes;
+	stats->next_snapshot = now + stats->interval;
+	g_atomic_int_set(&stats->snapshot_busy, 0);
+
+	return snapshot;
+}
+
+/*
+* The totals since the reset. The jitter is the largest one of the threads.
+*/
+GstStructure *
+gst_meter_stats_get_structure(GstMeterStats * stats)
+{
+	GstMeterSlot sum;
+
+	gst_meter_stats_sum(stats, &sum);
+
+	return gst_meter_stats_new_structure(&sum);
+}
+
+void
+gst_meter_stats_get_totals(GstMeterStats * stats, guint64 * buffers, guint64 * bytes)
+{
+	GstMeterSlot sum;
+
+	gst_meter_stats_sum(stats, &sum);
+
+	*buffers = sum.buffers;
+	*bytes = sum.bytes;
+}
+
+/*
+* Find the slot of the calling thread. The slots are taken in order and kept until the reset, so the own slot comes
+* before any free one. The shared slot is given once all the others are taken.
+*/
+static GstMeterSlot *
+gst_meter_stats_get_slot(GstMeterStats * stats)
+{
+	gpointer self = g_thread_self();
+
+	for (guint i = 0; i < METER_STATS_SHARED_SLOT; i++) {
+		gpointer owner = g_atomic_pointer_get(&stats->slots[i].owner);
+
+		if (owner == self)
+			return &stats->slots[i];
+
+		if (owner == NULL && g_atomic_pointer_compare_and_exchange(&stats->slots[i].owner, NULL, self))
+			return &stats->slots[i];
+	}
+
+	return &stats->slots[METER_STATS_SHARED_SLOT];
+}
+
+/*
+* Add up the slots. The counters are read as the owners leave them.
+*/
+static void
+gst_meter_stats_sum(GstMeterStats * stats, GstMeterSlot * sum)
+{
+	GstMeterSlot *shared = &stats->slots[METER_STATS_SHARED_SLOT];
+
+	memset(sum, 0, sizeof(GstMeterSlot));
+
+	for (guint i = 0; i < METER_STATS_SHARED_SLOT; i++) {
+		GstMeterSlot *slot = &stats->slots[i];
+
+		if (g_atomic_pointer_get(&slot->owner) == NULL)
+			break;
+
+		sum->buffers += slot->buffers;
+		sum->bytes += slot->bytes;
+		sum->gaps += slot->gaps;
+		sum->gap_time += slot->gap_time;
+		sum->jitter16 = MAX(sum->jitter16, slot->jitter16);
+		sum->max_interval = MAX(sum->max_interval, slot->max_interval);
+	}
+
+	sum->buffers += __atomic_load_n(&shared->buffers, __ATOMIC_RELAXED);
+	sum->bytes += __atomic_load_n(&shared->bytes, __ATOMIC_RELAXED);
+}
+
+static GstStructure *
+gst_meter_stats_new_structure(const GstMeterSlot * sum)
+{
+	return gst_structure_new("myfilter-stats",
+		"buffers", G_TYPE_UINT64, sum->buffers,
+		"bytes", G_TYPE_UINT64, sum->bytes,
+		"jitter", G_TYPE_UINT64, (guint64)(sum->jitter16 >> 4),
+		"max-interval", G_TYPE_UINT64, sum->max_interval,
+		"gaps", G_TYPE_UINT64, sum->gaps,
+		"gap-time", G_TYPE_UINT64, sum->gap_time, NULL);
+}
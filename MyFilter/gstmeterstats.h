@@ -0,0 +1,84 @@
+#ifndef __GST_METERSTATS_H__
+#define __GST_METERSTATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+// The streaming threads counted apart. The threads beyond the first ones share the last slot, which only counts
+// the buffers and the bytes with atomic adds.
+#define METER_STATS_MAX_THREADS		16
+#define METER_STATS_SHARED_SLOT		(METER_STATS_MAX_THREADS - 1)
+#define METER_STATS_CACHE_LINE		64
+
+// A buffer starting later than the end of the previous one by more than this is a gap
+#define METER_STATS_GAP_TOLERANCE	(1 * GST_MSECOND)
+
+typedef struct _GstMeterSlot	GstMeterSlot;
+typedef struct _GstMeterStats	GstMeterStats;
+
+/*
+* The counters of one streaming thread. Only the owner writes them, so they are plain stores. Each slot has its
+* own cache lines. The shared slot has no owner.
+*/
+struct _GstMeterSlot
+{
+	union {
+		struct {
+			gpointer		owner;
+
+			guint64			buffers;
+			guint64			bytes;
+
+			// The inter-arrival jitter as in RFC 3550, 16 times the estimate
+			GstClockTime	last_arrival;
+			GstClockTime	last_timestamp;
+			gint64			jitter16;
+			GstClockTime	max_interval;
+
+			GstClockTime	last_end;
+			guint64			gaps;
+			GstClockTime	gap_time;
+		};
+		guint8	padding[METER_STATS_CACHE_LINE * 2];
+	};
+};
+
+/*
+* Counts the buffers going through a pad. The snapshots add up the slots of every thread.
+*/
+struct _GstMeterStats
+{
+	gpointer		slots_memory;
+	GstMeterSlot	*slots;
+
+	// The time of the next snapshot. The thread which takes the flag posts it.
+	GstClockTime	interval;
+	GstClockTime	next_snapshot;
+	gint			snapshot_busy;
+
+	// The totals of the previous snapshot for the rates
+	GstClockTime	last_snapshot;
+	guint64			last_buffers;
+	guint64			last_bytes;
+};
+
+GstMeterStats * gst_meter_stats_new(void);
+
+void gst_meter_stats_free(GstMeterStats * stats);
+
+void gst_meter_stats_reset(GstMeterStats * stats);
+
+void gst_meter_stats_set_interval(GstMeterStats * stats, GstClockTime interval);
+
+gboolean gst_meter_stats_add(GstMeterStats * stats, GstBuffer * buffer, GstClockTime now);
+
+GstStructure * gst_meter_stats_take_snapshot(GstMeterStats * stats, GstClockTime now);
+
+GstStructure * gst_meter_stats_get_structure(GstMeterStats * stats);
+
+void gst_meter_stats_get_totals(GstMeterStats * stats, guint64 * buffers, guint64 * bytes);
+
+G_END_DECLS
+
+#endif /* __GST_METERSTATS_H__ */
@@ -62,6 +62,7 @@
 
 #include <gst/gst.h>
 #include <gst/audio/audio.h>
+#include <gst/video/video.h>
 
 #include "gstmyfilter.h"
 
@@ -71,16 +72,192 @@ GST_DEBUG_CATEGORY_STATIC(gst_my_filter_debug);
 /* Filter signals and args */
 enum
 {
-	/* FILL ME */
+	SIGNAL_HANDOFF,
 	LAST_SIGNAL
 };
 
+static guint gst_my_filter_signals[LAST_SIGNAL] = { 0 };
+
 enum
 {
 	PROP_0,
-	PROP_SILENT
+	PROP_SILENT,
+	PROP_STATS_INTERVAL,
+	PROP_STATS,
+	PROP_BUFFERS,
+	PROP_BYTES,
+	PROP_LATENCY_MODE,
+	PROP_LATENCY_INTERVAL,
+	PROP_FLOW_MODE,
+	PROP_BATCH_BUFFERS,
+	PROP_BATCH_BYTES,
+	PROP_BATCH_TIME,
+	PROP_DECOUPLE_BUFFERS,
+	PROP_DECOUPLE_BYTES,
+	PROP_DECOUPLE_TIME,
+	PROP_PARALLEL_WORKERS,
+	PROP_PARALLEL_WINDOW,
+	PROP_PARALLEL_FUNCTION,
+	PROP_VOLUME,
+	PROP_RAMP_TIME,
+	PROP_CHANNELS,
+	PROP_LOUDNESS_INTERVAL,
+	PROP_FREEZE_MODE,
+	PROP_FREEZE_THRESHOLD,
+	PROP_FREEZE_TIME,
+	PROP_CHECKSUM_MODE,
+	PROP_CHECKSUM_MISMATCHES,
+	PROP_CHECKSUM_MISSING
 };
 
+#define DEFAULT_STATS_INTERVAL	(1 * GST_SECOND)
+#define DEFAULT_LATENCY_MODE	GST_MY_FILTER_LATENCY_NONE
+#define DEFAULT_LATENCY_INTERVAL	(1 * GST_SECOND)
+#define DEFAULT_FLOW_MODE		GST_MY_FILTER_FLOW_PASSTHROUGH
+#define DEFAULT_BATCH_BUFFERS	32
+#define DEFAULT_BATCH_BYTES		0
+#define DEFAULT_BATCH_TIME		(10 * GST_MSECOND)
+
+/* the custom downstream event that follows every batch */
+#define BATCH_BOUNDARY_EVENT	"GstMyFilterBatch"
+#define DEFAULT_DECOUPLE_BUFFERS	200
+#define DEFAULT_DECOUPLE_BYTES		(10 * 1024 * 1024)
+#define DEFAULT_DECOUPLE_TIME		GST_SECOND
+#define DEFAULT_PARALLEL_WORKERS	0
+#define DEFAULT_PARALLEL_WINDOW		32
+#define DEFAULT_PARALLEL_FUNCTION	GST_MY_FILTER_PARALLEL_NONE
+#define DEFAULT_VOLUME				1.0
+#define DEFAULT_RAMP_TIME			(10 * GST_MSECOND)
+#define DEFAULT_CHANNELS			0
+#define DEFAULT_LOUDNESS_INTERVAL	0
+#define DEFAULT_FREEZE_MODE			GST_MY_FILTER_FREEZE_NONE
+#define DEFAULT_FREEZE_THRESHOLD	1.0
+#define DEFAULT_FREEZE_TIME			GST_SECOND
+#define DEFAULT_CHECKSUM_MODE		GST_MY_FILTER_CHECKSUM_NONE
+
+/* the stamping modes add metas, so the buffers have to be writable */
+#define GST_MY_FILTER_STAMPS(filter) \
+	((filter)->latency_mode == GST_MY_FILTER_LATENCY_STAMP || (filter)->checksum_mode == GST_MY_FILTER_CHECKSUM_STAMP)
+
+/* the alignment asked for upstream as a mask, a cache line */
+#define MEMORY_ALIGN	63
+
+/* the duration of the audio buffers of a proposed pool. upstream sets the size it pushes when it configures it */
+#define ALLOCATION_AUDIO_DURATION	(10 * GST_MSECOND)
+
+/* the largest run of bytes an Adler-32 sum can take before the modulo */
+#define ADLER32_BASE	65521
+#define ADLER32_NMAX	5552
+
+/* the measuring instance has not seen a stamp yet */
+#define LATENCY_NO_SEQNUM		G_MAXUINT64
+
+#define GST_TYPE_MY_FILTER_LATENCY_MODE (gst_my_filter_latency_mode_get_type())
+static GType
+gst_my_filter_latency_mode_get_type(void)
+{
+	static GType latency_mode_type = 0;
+	static const GEnumValue latency_modes[] = {
+		{GST_MY_FILTER_LATENCY_NONE, "No latency tracing", "none"},
+		{GST_MY_FILTER_LATENCY_STAMP, "Stamp the buffers with the time and a sequence number", "stamp"},
+		{GST_MY_FILTER_LATENCY_MEASURE, "Measure the delay since the stamp", "measure"},
+		{0, NULL, NULL}
+	};
+
+	if (!latency_mode_type) {
+		latency_mode_type = g_enum_register_static("GstMyFilterLatencyMode", latency_modes);
+	}
+
+	return latency_mode_type;
+}
+
+#define GST_TYPE_MY_FILTER_FLOW_MODE (gst_my_filter_flow_mode_get_type())
+static GType
+gst_my_filter_flow_mode_get_type(void)
+{
+	static GType flow_mode_type = 0;
+	static const GEnumValue flow_modes[] = {
+		{GST_MY_FILTER_FLOW_PASSTHROUGH, "Push the buffers and the lists as they come", "passthrough"},
+		{GST_MY_FILTER_FLOW_BATCH, "Gather the buffers into lists", "batch"},
+		{GST_MY_FILTER_FLOW_UNBATCH, "Push the buffers of the lists one by one", "unbatch"},
+		{GST_MY_FILTER_FLOW_DECOUPLE, "Push from a thread of its own like a queue", "decouple"},
+		{GST_MY_FILTER_FLOW_PARALLEL, "Run the parallel function in worker threads and push in order", "parallel"},
+		{0, NULL, NULL}
+	};
+
+	if (!flow_mode_type) {
+		flow_mode_type = g_enum_register_static("GstMyFilterFlowMode", flow_modes);
+	}
+
+	return flow_mode_type;
+}
+
+#define GST_TYPE_MY_FILTER_PARALLEL_FUNCTION (gst_my_filter_parallel_function_get_type())
+static GType
+gst_my_filter_parallel_function_get_type(void)
+{
+	static GType parallel_function_type = 0;
+	static const GEnumValue parallel_functions[] = {
+		{GST_MY_FILTER_PARALLEL_NONE, "Nothing, only the hand over", "none"},
+		{GST_MY_FILTER_PARALLEL_CHECKSUM, "Log the Adler-32 of the data", "checksum"},
+		{GST_MY_FILTER_PARALLEL_HANDOFF, "Emit handoff with the writable buffer", "handoff"},
+		{0, NULL, NULL}
+	};
+
+	if (!parallel_function_type) {
+		parallel_function_type = g_enum_register_static("GstMyFilterParallelFunction", parallel_functions);
+	}
+
+	return parallel_function_type;
+}
+
+#define GST_TYPE_MY_FILTER_FREEZE_MODE (gst_my_filter_freeze_mode_get_type())
+static GType
+gst_my_filter_freeze_mode_get_type(void)
+{
+	static GType freeze_mode_type = 0;
+	static const GEnumValue freeze_modes[] = {
+		{GST_MY_FILTER_FREEZE_NONE, "No freeze detection", "none"},
+		{GST_MY_FILTER_FREEZE_DETECT, "Post the start and the end of the freezes", "detect"},
+		{GST_MY_FILTER_FREEZE_MARK, "Post the freezes and mark the duplicates droppable", "mark"},
+		{GST_MY_FILTER_FREEZE_DROP, "Post the freezes and drop the duplicates", "drop"},
+		{0, NULL, NULL}
+	};
+
+	if (!freeze_mode_type) {
+		freeze_mode_type = g_enum_register_static("GstMyFilterFreezeMode", freeze_modes);
+	}
+
+	return freeze_mode_type;
+}
+
+#define GST_TYPE_MY_FILTER_CHECKSUM_MODE (gst_my_filter_checksum_mode_get_type())
+static GType
+gst_my_filter_checksum_mode_get_type(void)
+{
+	static GType checksum_mode_type = 0;
+	static const GEnumValue checksum_modes[] = {
+		{GST_MY_FILTER_CHECKSUM_NONE, "No checksum", "none"},
+		{GST_MY_FILTER_CHECKSUM_STAMP, "Stamp the buffers with their CRC32C", "stamp"},
+		{GST_MY_FILTER_CHECKSUM_VERIFY, "Check the CRC32C of the stamped buffers", "verify"},
+		{0, NULL, NULL}
+	};
+
+	if (!checksum_mode_type) {
+		checksum_mode_type = g_enum_register_static("GstMyFilterChecksumMode", checksum_modes);
+	}
+
+	return checksum_mode_type;
+}
+
+/* the buffers of a list being pushed one by one or batched */
+typedef struct
+{
+	GstMyFilter *filter;
+	GstClockTime now;
+	GstFlowReturn ret;
+} GstMyFilterListPush;
+
 /* the capabilities of the inputs and outputs.
  *
  * describe the real formats here.
@@ -115,12 +292,49 @@ static void gst_my_filter_set_property(GObject * object, guint prop_id,
 	const GValue * value, GParamSpec * pspec);
 static void gst_my_filter_get_property(GObject * object, guint prop_id,
 	GValue * value, GParamSpec * pspec);
+static void gst_my_filter_finalize(GObject * object);
 
 static gboolean gst_my_filter_sink_event(GstPad * pad, GstObject * parent, GstEvent * event);
 static GstFlowReturn gst_my_filter_chain(GstPad * pad, GstObject * parent, GstBuffer * buf);
+static GstFlowReturn gst_my_filter_chain_list(GstPad * pad, GstObject * parent, GstBufferList * list);
 static gboolean gst_my_filter_src_query(GstPad * pad, GstObject * parent, GstQuery * query);
+static gboolean gst_my_filter_src_activate_mode(GstPad * pad, GstObject * parent, GstPadMode mode, gboolean active);
+static void gst_my_filter_loop(GstMyFilter * filter);
+static void gst_my_filter_batch_loop(GstMyFilter * filter);
+static gboolean gst_my_filter_decouple_event(GstMyFilter * filter, GstEvent * event);
+static void gst_my_filter_drop_flushed(gpointer item, gpointer user_data);
+static void gst_my_filter_drop_item(gpointer item, gpointer user_data);
+static gboolean gst_my_filter_decouple_query(GstMyFilter * filter, GstQuery * query);
+static gboolean gst_my_filter_query_downstream(GstMyFilter * filter, GstQuery * query);
+static void gst_my_filter_answer_decouple_query(GstMyFilter * filter, GstQuery * query);
+static void gst_my_filter_wake_query(GstMyFilter * filter);
 static gboolean gst_my_filter_sink_query(GstPad * pad, GstObject * parent, GstQuery * query);
 static GstStateChangeReturn gst_my_filter_change_state(GstElement *element, GstStateChange transition);
+static void gst_my_filter_process(GstMyFilter * filter, GstBuffer * buf, GstClockTime now);
+static GstFlowReturn gst_my_filter_push(GstMyFilter * filter, GstBuffer * buf, GstClockTime now);
+static GstFlowReturn gst_my_filter_push_batch(GstMyFilter * filter);
+static GstFlowReturn gst_my_filter_push_list(GstMyFilter * filter, GstBufferList * list);
+static GstFlowReturn gst_my_filter_push_parallel(GstMyFilter * filter, GstBuffer * buf);
+static GstFlowReturn gst_my_filter_push_pending(GstMyFilter * filter);
+static GstBuffer * gst_my_filter_run_parallel(GstBuffer * buf, gpointer user_data);
+static gboolean gst_my_filter_propose_allocation(GstMyFilter * filter, GstQuery * query);
+static gboolean gst_my_filter_answer_allocation(GstMyFilter * filter, GstQuery * query, guint held);
+static guint gst_my_filter_get_buffer_size(GstCaps * caps);
+static GstBuffer * gst_my_filter_process_audio(GstMyFilter * filter, GstBuffer * buf);
+static GstEvent * gst_my_filter_set_audio_caps(GstMyFilter * filter, GstEvent * event);
+static void gst_my_filter_setup_loudness(GstMyFilter * filter);
+static void gst_my_filter_meter_loudness(GstMyFilter * filter, GstBuffer * buf);
+static GstBuffer * gst_my_filter_process_video(GstMyFilter * filter, GstBuffer * buf);
+static void gst_my_filter_set_video_caps(GstMyFilter * filter, GstEvent * event);
+static void gst_my_filter_end_freeze(GstMyFilter * filter, GstClockTime timestamp);
+static void gst_my_filter_reset_freeze(GstMyFilter * filter);
+static GstCaps * gst_my_filter_transform_caps(GstMyFilter * filter, GstCaps * caps, GstPadDirection direction);
+static gboolean gst_my_filter_query_mixed_caps(GstMyFilter * filter, GstPad * pad, GstQuery * query);
+static void gst_my_filter_post_stats(GstMyFilter * filter, GstClockTime now);
+static void gst_my_filter_post_latency(GstMyFilter * filter);
+static void gst_my_filter_measure_latency(GstMyFilter * filter, GstBuffer * buf, GstClockTime now);
+static void gst_my_filter_reset_latency(GstMyFilter * filter);
+static void gst_my_filter_verify_checksum(GstMyFilter * filter, GstBuffer * buf);
 
 /* GObject vmethod implementations */
 
@@ -138,11 +352,155 @@ gst_my_filter_class_init(GstMyFilterClass * klass)
 
 	gobject_class->set_property = gst_my_filter_set_property;
 	gobject_class->get_property = gst_my_filter_get_property;
+	gobject_class->finalize = gst_my_filter_finalize;
+
+	/* emitted on the worker threads with parallel-function=handoff */
+	gst_my_filter_signals[SIGNAL_HANDOFF] = g_signal_new("handoff", G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1, GST_TYPE_BUFFER | G_SIGNAL_TYPE_STATIC_SCOPE);
 
 	g_object_class_install_property(gobject_class, PROP_SILENT,
 		g_param_spec_boolean("silent", "Silent", "Produce verbose output ?",
 			FALSE, G_PARAM_READWRITE));
 
+	g_object_class_install_property(gobject_class, PROP_STATS_INTERVAL,
+		g_param_spec_uint64("stats-interval", "Stats interval",
+			"Interval of the myfilter-stats messages in nanoseconds (0 = disabled)",
+			0, G_MAXUINT64, DEFAULT_STATS_INTERVAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_STATS,
+		g_param_spec_boxed("stats", "Stats",
+			"Buffers, bytes, inter-arrival jitter and timestamp gaps since the start",
+			GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BUFFERS,
+		g_param_spec_uint64("buffers", "Buffers", "Number of buffers since the start",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BYTES,
+		g_param_spec_uint64("bytes", "Bytes", "Number of bytes since the start",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_LATENCY_MODE,
+		g_param_spec_enum("latency-mode", "Latency mode",
+			"Stamp the buffers, or measure the delay since the stamp and post myfilter-latency every latency-interval",
+			GST_TYPE_MY_FILTER_LATENCY_MODE, DEFAULT_LATENCY_MODE,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_LATENCY_INTERVAL,
+		g_param_spec_uint64("latency-interval", "Latency interval",
+			"Interval of the myfilter-latency messages in nanoseconds, apart from stats-interval. "
+			"The rest is posted at EOS and when stopping (0 = only then)",
+			0, G_MAXUINT64, DEFAULT_LATENCY_INTERVAL,
+			G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_FLOW_MODE,
+		g_param_spec_enum("flow-mode", "Flow mode", "How the buffers are pushed",
+			GST_TYPE_MY_FILTER_FLOW_MODE, DEFAULT_FLOW_MODE,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BATCH_BUFFERS,
+		g_param_spec_uint("batch-buffers", "Batch buffers",
+			"Push the batch when it has this many buffers (0 = no limit)",
+			0, G_MAXUINT, DEFAULT_BATCH_BUFFERS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BATCH_BYTES,
+		g_param_spec_uint("batch-bytes", "Batch bytes",
+			"Push the batch when it has this many bytes (0 = no limit)",
+			0, G_MAXUINT, DEFAULT_BATCH_BYTES, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_BATCH_TIME,
+		g_param_spec_uint64("batch-time", "Batch time",
+			"Push the batch this long after its first buffer arrived in ns (0 = no limit)",
+			0, G_MAXUINT64, DEFAULT_BATCH_TIME, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_DECOUPLE_BUFFERS,
+		g_param_spec_uint("decouple-buffers", "Decouple buffers",
+			"Block when this many buffers, lists and events are waiting for the task",
+			1, G_MAXINT / 2, DEFAULT_DECOUPLE_BUFFERS,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_DECOUPLE_BYTES,
+		g_param_spec_uint("decouple-bytes", "Decouple bytes",
+			"Block when this many bytes are waiting for the task (0 = no limit)",
+			0, G_MAXUINT, DEFAULT_DECOUPLE_BYTES,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_DECOUPLE_TIME,
+		g_param_spec_uint64("decouple-time", "Decouple time",
+			"Block when the buffers waiting for the task span this long in ns (0 = no limit)",
+			0, G_MAXUINT64, DEFAULT_DECOUPLE_TIME,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PARALLEL_WORKERS,
+		g_param_spec_uint("parallel-workers", "Parallel workers",
+			"Number of worker threads (0 = one per processor)",
+			0, 1024, DEFAULT_PARALLEL_WORKERS,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PARALLEL_WINDOW,
+		g_param_spec_uint("parallel-window", "Parallel window",
+			"Number of buffers in flight before the oldest one is waited for, at least one per worker",
+			1, 65536, DEFAULT_PARALLEL_WINDOW,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_PARALLEL_FUNCTION,
+		g_param_spec_enum("parallel-function", "Parallel function", "What the workers do with each buffer",
+			GST_TYPE_MY_FILTER_PARALLEL_FUNCTION, DEFAULT_PARALLEL_FUNCTION,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_VOLUME,
+		g_param_spec_double("volume", "Volume", "Gain of raw S16, S32 and F32 audio",
+			0.0, 10.0, DEFAULT_VOLUME,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_RAMP_TIME,
+		g_param_spec_uint64("ramp-time", "Ramp time", "Time in ns the gain takes to reach a new volume",
+			0, G_MAXUINT64, DEFAULT_RAMP_TIME,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_CHANNELS,
+		g_param_spec_uint("channels", "Channels", "Mix raw audio to this many channels (0 = keep them)",
+			0, 1024, DEFAULT_CHANNELS,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_LOUDNESS_INTERVAL,
+		g_param_spec_uint64("loudness-interval", "Loudness interval",
+			"Stream time in ns between the loudness messages of raw audio (0 = no metering)",
+			0, G_MAXUINT64, DEFAULT_LOUDNESS_INTERVAL,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_FREEZE_MODE,
+		g_param_spec_enum("freeze-mode", "Freeze mode", "What is done with the duplicate frames of raw video",
+			GST_TYPE_MY_FILTER_FREEZE_MODE, DEFAULT_FREEZE_MODE,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_FREEZE_THRESHOLD,
+		g_param_spec_double("freeze-threshold", "Freeze threshold",
+			"Largest mean absolute difference of a cell of a duplicate frame, in levels of the first plane",
+			0.0, 255.0, DEFAULT_FREEZE_THRESHOLD,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_FREEZE_TIME,
+		g_param_spec_uint64("freeze-time", "Freeze time", "Time in ns the duplicate frames span before it is a freeze",
+			0, G_MAXUINT64, DEFAULT_FREEZE_TIME,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_CHECKSUM_MODE,
+		g_param_spec_enum("checksum-mode", "Checksum mode",
+			"Stamp the buffers with their CRC32C, or check it and post myfilter-checksum-mismatch",
+			GST_TYPE_MY_FILTER_CHECKSUM_MODE, DEFAULT_CHECKSUM_MODE,
+			G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_CHECKSUM_MISMATCHES,
+		g_param_spec_uint64("checksum-mismatches", "Checksum mismatches",
+			"Number of buffers whose CRC32C or size differed from the stamp",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+	g_object_class_install_property(gobject_class, PROP_CHECKSUM_MISSING,
+		g_param_spec_uint64("checksum-missing", "Checksum missing", "Number of buffers checked without a stamp",
+			0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
 	gst_element_class_set_details_simple(gstelement_class,
 		"An example plugin",
 		"Example/FirstExample",
@@ -154,7 +512,6 @@ gst_my_filter_class_init(GstMyFilterClass * klass)
 	gst_element_class_add_pad_template(gstelement_class,
 		gst_static_pad_template_get(&sink_factory));
 
-	g_print("JK DEBUG::gst_my_filter_class_init().\n");
 }
 
 /* initialize the new element
@@ -170,17 +527,94 @@ gst_my_filter_init(GstMyFilter * filter)
 		GST_DEBUG_FUNCPTR(gst_my_filter_sink_event));
 	gst_pad_set_chain_function(filter->sinkpad,
 		GST_DEBUG_FUNCPTR(gst_my_filter_chain));
+	gst_pad_set_chain_list_function(filter->sinkpad,
+		GST_DEBUG_FUNCPTR(gst_my_filter_chain_list));
 	gst_pad_set_query_function(filter->sinkpad, GST_DEBUG_FUNCPTR(gst_my_filter_sink_query));
 	GST_PAD_SET_PROXY_CAPS(filter->sinkpad);
 	gst_element_add_pad(GST_ELEMENT(filter), filter->sinkpad);
 
 	filter->srcpad = gst_pad_new_from_static_template(&src_factory, "src");
 	gst_pad_set_query_function(filter->srcpad, GST_DEBUG_FUNCPTR(gst_my_filter_src_query));
+	gst_pad_set_activatemode_function(filter->srcpad, GST_DEBUG_FUNCPTR(gst_my_filter_src_activate_mode));
 	GST_PAD_SET_PROXY_CAPS(filter->srcpad);
 	gst_element_add_pad(GST_ELEMENT(filter), filter->srcpad);
 
 	filter->silent = FALSE;
-	g_print("JK DEBUG::gst_my_filter_init().\n");
+
+	filter->stats_interval = DEFAULT_STATS_INTERVAL;
+	filter->stats = gst_meter_stats_new();
+	gst_meter_stats_set_interval(filter->stats, filter->stats_interval);
+
+	filter->latency_mode = DEFAULT_LATENCY_MODE;
+	filter->latency_histogram = gst_hdr_histogram_new();
+	filter->latency_interval = DEFAULT_LATENCY_INTERVAL;
+	gst_my_filter_reset_latency(filter);
+
+	filter->flow_mode = DEFAULT_FLOW_MODE;
+	filter->batch_buffers = DEFAULT_BATCH_BUFFERS;
+	filter->batch_bytes = DEFAULT_BATCH_BYTES;
+	filter->batch_time = DEFAULT_BATCH_TIME;
+	filter->batcher = gst_batcher_new();
+	gst_batcher_set_limits(filter->batcher, filter->batch_buffers, filter->batch_bytes, filter->batch_time);
+	g_mutex_init(&filter->batch_lock);
+	g_cond_init(&filter->batch_cond);
+	filter->batch_flushing = TRUE;
+	filter->batch_result = GST_FLOW_OK;
+
+	filter->decouple_buffers = DEFAULT_DECOUPLE_BUFFERS;
+	filter->decouple_bytes = DEFAULT_DECOUPLE_BYTES;
+	filter->decouple_time = DEFAULT_DECOUPLE_TIME;
+	filter->ring = gst_spsc_ring_new();
+	gst_spsc_ring_set_limits(filter->ring, filter->decouple_buffers, filter->decouple_bytes, filter->decouple_time);
+	filter->srcresult = GST_FLOW_FLUSHING;
+	g_mutex_init(&filter->query_lock);
+	g_cond_init(&filter->query_cond);
+	filter->decouple_query = NULL;
+	filter->decouple_query_running = FALSE;
+	filter->decouple_query_result = FALSE;
+
+	filter->parallel_workers = DEFAULT_PARALLEL_WORKERS;
+	filter->parallel_window = DEFAULT_PARALLEL_WINDOW;
+	filter->parallel_function = DEFAULT_PARALLEL_FUNCTION;
+
+	filter->volume = DEFAULT_VOLUME;
+	filter->ramp_time = DEFAULT_RAMP_TIME;
+	filter->channels = DEFAULT_CHANNELS;
+	gst_audio_gain_reset(&filter->gain, filter->volume);
+	filter->loudness_interval = DEFAULT_LOUDNESS_INTERVAL;
+
+	filter->freeze_mode = DEFAULT_FREEZE_MODE;
+	filter->freeze_threshold = DEFAULT_FREEZE_THRESHOLD;
+	filter->freeze_time = DEFAULT_FREEZE_TIME;
+	gst_my_filter_reset_freeze(filter);
+
+	filter->checksum_mode = DEFAULT_CHECKSUM_MODE;
+	filter->checksum_mismatches = 0;
+	filter->checksum_missing = 0;
+
+	GST_DEBUG_OBJECT(filter, "Initialized");
+}
+
+static void
+gst_my_filter_finalize(GObject * object)
+{
+	GstMyFilter *filter = GST_MYFILTER(object);
+
+	gst_meter_stats_free(filter->stats);
+	gst_hdr_histogram_free(filter->latency_histogram);
+	gst_batcher_free(filter->batcher);
+	g_mutex_clear(&filter->batch_lock);
+	g_cond_clear(&filter->batch_cond);
+	gst_spsc_ring_drain(filter->ring, gst_my_filter_drop_item, NULL);
+	gst_spsc_ring_free(filter->ring);
+	g_mutex_clear(&filter->query_lock);
+	g_cond_clear(&filter->query_cond);
+	gst_worker_pool_free(filter->workers);
+	g_free(filter->mix_matrix);
+	gst_loudness_meter_free(filter->loudness);
+	gst_freeze_detector_free(filter->freeze_detector);
+
+	G_OBJECT_CLASS(parent_class)->finalize(object);
 }
 
 static void
@@ -192,7 +626,90 @@ gst_my_filter_set_property(GObject * object, guint prop_id,
 	switch (prop_id) {
 	case PROP_SILENT:
 		filter->silent = g_value_get_boolean(value);
-		g_print("JK DEBUG::Silent argument was changed to %s\n", filter->silent ? "true" : "false");
+		GST_DEBUG_OBJECT(filter, "silent is %s", filter->silent ? "true" : "false");
+		break;
+	case PROP_STATS_INTERVAL:
+		GST_OBJECT_LOCK(filter);
+		filter->stats_interval = g_value_get_uint64(value);
+		gst_meter_stats_set_interval(filter->stats, filter->stats_interval);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_LATENCY_MODE:
+		filter->latency_mode = g_value_get_enum(value);
+		break;
+	case PROP_LATENCY_INTERVAL:
+		filter->latency_interval = g_value_get_uint64(value);
+		break;
+	case PROP_FLOW_MODE:
+		filter->flow_mode = g_value_get_enum(value);
+		break;
+	/* the task of the batch mode reads the time limit */
+	case PROP_BATCH_BUFFERS:
+		g_mutex_lock(&filter->batch_lock);
+		filter->batch_buffers = g_value_get_uint(value);
+		gst_batcher_set_limits(filter->batcher, filter->batch_buffers, filter->batch_bytes, filter->batch_time);
+		g_mutex_unlock(&filter->batch_lock);
+		break;
+	/* the ring takes the limits in READY to PAUSED, before either side runs */
+	case PROP_DECOUPLE_BUFFERS:
+		filter->decouple_buffers = g_value_get_uint(value);
+		break;
+	case PROP_DECOUPLE_BYTES:
+		filter->decouple_bytes = g_value_get_uint(value);
+		break;
+	case PROP_DECOUPLE_TIME:
+		filter->decouple_time = g_value_get_uint64(value);
+		break;
+	case PROP_PARALLEL_WORKERS:
+		filter->parallel_workers = g_value_get_uint(value);
+		break;
+	case PROP_PARALLEL_WINDOW:
+		filter->parallel_window = g_value_get_uint(value);
+		break;
+	case PROP_PARALLEL_FUNCTION:
+		filter->parallel_function = g_value_get_enum(value);
+		break;
+	case PROP_VOLUME:
+		GST_OBJECT_LOCK(filter);
+		filter->volume = g_value_get_double(value);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_RAMP_TIME:
+		GST_OBJECT_LOCK(filter);
+		filter->ramp_time = g_value_get_uint64(value);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_CHANNELS:
+		filter->channels = g_value_get_uint(value);
+		break;
+	case PROP_LOUDNESS_INTERVAL:
+		filter->loudness_interval = g_value_get_uint64(value);
+		break;
+	case PROP_FREEZE_MODE:
+		filter->freeze_mode = g_value_get_enum(value);
+		break;
+	case PROP_FREEZE_THRESHOLD:
+		filter->freeze_threshold = g_value_get_double(value);
+		break;
+	case PROP_FREEZE_TIME:
+		filter->freeze_time = g_value_get_uint64(value);
+		break;
+	case PROP_CHECKSUM_MODE:
+		filter->checksum_mode = g_value_get_enum(value);
+		break;
+	case PROP_BATCH_BYTES:
+		g_mutex_lock(&filter->batch_lock);
+		filter->batch_bytes = g_value_get_uint(value);
+		gst_batcher_set_limits(filter->batcher, filter->batch_buffers, filter->batch_bytes, filter->batch_time);
+		g_mutex_unlock(&filter->batch_lock);
+		break;
+	case PROP_BATCH_TIME:
+		g_mutex_lock(&filter->batch_lock);
+		filter->batch_time = g_value_get_uint64(value);
+		gst_batcher_set_limits(filter->batcher, filter->batch_buffers, filter->batch_bytes, filter->batch_time);
+		/* the pending batch is due at the new time */
+		g_cond_signal(&filter->batch_cond);
+		g_mutex_unlock(&filter->batch_lock);
 		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -210,6 +727,93 @@ gst_my_filter_get_property(GObject * object, guint prop_id,
 	case PROP_SILENT:
 		g_value_set_boolean(value, filter->silent);
 		break;
+	case PROP_STATS_INTERVAL:
+		GST_OBJECT_LOCK(filter);
+		g_value_set_uint64(value, filter->stats_interval);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_STATS:
+		g_value_take_boxed(value, gst_meter_stats_get_structure(filter->stats));
+		break;
+	case PROP_BUFFERS:
+	case PROP_BYTES:
+	{
+		guint64 buffers, bytes;
+
+		gst_meter_stats_get_totals(filter->stats, &buffers, &bytes);
+		g_value_set_uint64(value, prop_id == PROP_BUFFERS ? buffers : bytes);
+		break;
+	}
+	case PROP_LATENCY_MODE:
+		g_value_set_enum(value, filter->latency_mode);
+		break;
+	case PROP_LATENCY_INTERVAL:
+		g_value_set_uint64(value, filter->latency_interval);
+		break;
+	case PROP_FLOW_MODE:
+		g_value_set_enum(value, filter->flow_mode);
+		break;
+	case PROP_BATCH_BUFFERS:
+		g_value_set_uint(value, filter->batch_buffers);
+		break;
+	case PROP_BATCH_BYTES:
+		g_value_set_uint(value, filter->batch_bytes);
+		break;
+	case PROP_BATCH_TIME:
+		g_value_set_uint64(value, filter->batch_time);
+		break;
+	case PROP_DECOUPLE_BUFFERS:
+		g_value_set_uint(value, filter->decouple_buffers);
+		break;
+	case PROP_DECOUPLE_BYTES:
+		g_value_set_uint(value, filter->decouple_bytes);
+		break;
+	case PROP_DECOUPLE_TIME:
+		g_value_set_uint64(value, filter->decouple_time);
+		break;
+	case PROP_PARALLEL_WORKERS:
+		g_value_set_uint(value, filter->parallel_workers);
+		break;
+	case PROP_PARALLEL_WINDOW:
+		g_value_set_uint(value, filter->parallel_window);
+		break;
+	case PROP_PARALLEL_FUNCTION:
+		g_value_set_enum(value, filter->parallel_function);
+		break;
+	case PROP_VOLUME:
+		GST_OBJECT_LOCK(filter);
+		g_value_set_double(value, filter->volume);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_RAMP_TIME:
+		GST_OBJECT_LOCK(filter);
+		g_value_set_uint64(value, filter->ramp_time);
+		GST_OBJECT_UNLOCK(filter);
+		break;
+	case PROP_CHANNELS:
+		g_value_set_uint(value, filter->channels);
+		break;
+	case PROP_LOUDNESS_INTERVAL:
+		g_value_set_uint64(value, filter->loudness_interval);
+		break;
+	case PROP_FREEZE_MODE:
+		g_value_set_enum(value, filter->freeze_mode);
+		break;
+	case PROP_FREEZE_THRESHOLD:
+		g_value_set_double(value, filter->freeze_threshold);
+		break;
+	case PROP_FREEZE_TIME:
+		g_value_set_uint64(value, filter->freeze_time);
+		break;
+	case PROP_CHECKSUM_MODE:
+		g_value_set_enum(value, filter->checksum_mode);
+		break;
+	case PROP_CHECKSUM_MISMATCHES:
+		g_value_set_uint64(value, filter->checksum_mismatches);
+		break;
+	case PROP_CHECKSUM_MISSING:
+		g_value_set_uint64(value, filter->checksum_missing);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -227,11 +831,57 @@ gst_my_filter_sink_event(GstPad * pad, GstObject * parent, GstEvent * event)
 
 	filter = GST_MYFILTER(parent);
 
-	g_print("JK DEBUG::gst_my_filter_sink_event():Received %s event.\n", GST_EVENT_TYPE_NAME(event));
-
-	GST_INFO_OBJECT(filter, "JK DEBUG1::Received %s event: %" GST_PTR_FORMAT,
+	GST_LOG_OBJECT(filter, "Received %s event: %" GST_PTR_FORMAT,
 		GST_EVENT_TYPE_NAME(event), event);
 
+	/* neither a batch nor the buffers in the workers span an event, so the event is not held back behind the
+	 * buffers before it */
+	if ((filter->flow_mode == GST_MY_FILTER_FLOW_BATCH || filter->flow_mode == GST_MY_FILTER_FLOW_PARALLEL) &&
+		GST_EVENT_IS_SERIALIZED(event)) {
+		if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+			if (filter->flow_mode == GST_MY_FILTER_FLOW_BATCH) {
+				g_mutex_lock(&filter->batch_lock);
+				gst_batcher_clear(filter->batcher);
+				filter->batch_result = GST_FLOW_OK;
+				g_mutex_unlock(&filter->batch_lock);
+			}
+			else
+				gst_worker_pool_flush(filter->workers);
+		}
+		else {
+			GstFlowReturn flow = gst_my_filter_push_pending(filter);
+
+			if (flow != GST_FLOW_OK)
+				GST_DEBUG_OBJECT(filter, "Pushing the pending buffers before %s returned %s",
+					GST_EVENT_TYPE_NAME(event), gst_flow_get_name(flow));
+		}
+	}
+
+	/* the caps of raw audio change when it is mixed */
+	if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS) {
+		event = gst_my_filter_set_audio_caps(filter, event);
+		if (event == NULL)
+			return FALSE;
+
+		gst_my_filter_set_video_caps(filter, event);
+	}
+
+	/* a freeze ends with the stream, and a flush starts over without a reference frame */
+	if (filter->video_active) {
+		if (GST_EVENT_TYPE(event) == GST_EVENT_EOS || GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+			gst_my_filter_end_freeze(filter, filter->freeze_end);
+
+		if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+			gst_my_filter_reset_freeze(filter);
+	}
+
+	/* the latency measured since the last message is posted before the stream ends */
+	if (GST_EVENT_TYPE(event) == GST_EVENT_EOS)
+		gst_my_filter_post_latency(filter);
+
+	if (filter->flow_mode == GST_MY_FILTER_FLOW_DECOUPLE)
+		return gst_my_filter_decouple_event(filter, event);
+
 	switch (GST_EVENT_TYPE(event)) {
 	case GST_EVENT_CAPS:
 	{
@@ -262,139 +912,1456 @@ static GstFlowReturn
 gst_my_filter_chain(GstPad * pad, GstObject * parent, GstBuffer * buf)
 {
 	GstMyFilter *filter;
+	GstClockTime now;
 
 	filter = GST_MYFILTER(parent);
 
-	// JK DEBUG
-   /* if (filter->silent == FALSE)
-	  g_print ("I'm plugged, therefore I'm in.\n");*/
+	/* the stamp covers the data as it arrived, before the audio or the video is touched */
+	if (filter->checksum_mode == GST_MY_FILTER_CHECKSUM_VERIFY)
+		gst_my_filter_verify_checksum(filter, buf);
 
-	if (!filter->silent)
-	{
-		g_print("JK DEBUG::gst_my_filter_chain():Have data of size %" G_GSIZE_FORMAT" bytes!\n", gst_buffer_get_size(buf));
+	if (filter->audio_active)
+		buf = gst_my_filter_process_audio(filter, buf);
+
+	if (filter->video_active) {
+		buf = gst_my_filter_process_video(filter, buf);
+		if (buf == NULL)
+			return GST_FLOW_OK;
 	}
 
-	/* just push out the incoming buffer without touching it */
-	return gst_pad_push(filter->srcpad, buf);
+	/* the modes only change in READY */
+	if (GST_MY_FILTER_STAMPS(filter))
+		buf = gst_buffer_make_writable(buf);
+
+	now = gst_util_get_timestamp();
+	gst_my_filter_process(filter, buf, now);
+
+	return gst_my_filter_push(filter, buf, now);
 }
 
+/* push the buffers of a list one by one or into the batch. they are taken out of the list, so they stay writable */
 static gboolean
-gst_my_filter_src_query(GstPad * pad, GstObject * parent, GstQuery  * query)
+gst_my_filter_push_list_buffer(GstBuffer ** buffer, guint idx, gpointer user_data)
 {
-	gboolean ret = FALSE;
-	GstMyFilter *filter = GST_MYFILTER(parent);
+	GstMyFilterListPush *push = user_data;
 
-	g_print("JK DEBUG::gst_my_filter_src_query():Received %s query.\n", GST_QUERY_TYPE_NAME(query));
+	push->ret = gst_my_filter_push(push->filter, *buffer, push->now);
+	*buffer = NULL;
 
-	switch (GST_QUERY_TYPE(query)) {
-		//case GST_QUERY_POSITION:
-		//	/* we should report the current position */
-		//	break;
-		//
-		//case GST_QUERY_DURATION:
-		//	/* we should report the duration here */
-		//	break;
-		//
-		//case GST_QUERY_CAPS:
-		//	/* we should report the supported caps here */
-		//	break;
+	return push->ret == GST_FLOW_OK;
+}
+
+/* check the stamps of the buffers of a list as they arrived */
+static gboolean
+gst_my_filter_verify_list_checksum(GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+	gst_my_filter_verify_checksum(GST_MYFILTER(user_data), *buffer);
+
+	return TRUE;
+}
+
+/* process the audio of the buffers of a list in place of them */
+static gboolean
+gst_my_filter_process_list_audio(GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+	*buffer = gst_my_filter_process_audio(GST_MYFILTER(user_data), *buffer);
+
+	return TRUE;
+}
+
+/* compare the frames of a list. the dropped ones are taken out of it */
+static gboolean
+gst_my_filter_process_list_video(GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+	*buffer = gst_my_filter_process_video(GST_MYFILTER(user_data), *buffer);
+
+	return TRUE;
+}
+
+/* chain list function
+ * the buffers of the list arrived together, so they get the same arrival time
+ */
+static GstFlowReturn
+gst_my_filter_chain_list(GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+	GstMyFilter *filter;
+	GstMyFilterListPush push;
+	guint i, length;
+
+	filter = GST_MYFILTER(parent);
+
+	push.filter = filter;
+	push.now = gst_util_get_timestamp();
+	push.ret = GST_FLOW_OK;
+
+	if (filter->checksum_mode == GST_MY_FILTER_CHECKSUM_VERIFY)
+		gst_buffer_list_foreach(list, gst_my_filter_verify_list_checksum, filter);
+
+	if (filter->audio_active) {
+		list = gst_buffer_list_make_writable(list);
+		gst_buffer_list_foreach(list, gst_my_filter_process_list_audio, filter);
+	}
+
+	if (filter->video_active) {
+		list = gst_buffer_list_make_writable(list);
+		gst_buffer_list_foreach(list, gst_my_filter_process_list_video, filter);
 
+		if (gst_buffer_list_length(list) == 0) {
+			gst_buffer_list_unref(list);
+			return GST_FLOW_OK;
+		}
+	}
+
+	if (GST_MY_FILTER_STAMPS(filter) || (filter->flow_mode != GST_MY_FILTER_FLOW_PASSTHROUGH &&
+		filter->flow_mode != GST_MY_FILTER_FLOW_DECOUPLE))
+		list = gst_buffer_list_make_writable(list);
+
+	length = gst_buffer_list_length(list);
+	for (i = 0; i < length; i++) {
+		GstBuffer *buf = GST_MY_FILTER_STAMPS(filter) ?
+			gst_buffer_list_get_writable(list, i) : gst_buffer_list_get(list, i);
+
+		gst_my_filter_process(filter, buf, push.now);
+	}
+
+	if (filter->flow_mode == GST_MY_FILTER_FLOW_PASSTHROUGH || filter->flow_mode == GST_MY_FILTER_FLOW_DECOUPLE)
+		return gst_my_filter_push_list(filter, list);
+
+	gst_buffer_list_foreach(list, gst_my_filter_push_list_buffer, &push);
+	gst_buffer_list_unref(list);
+
+	return push.ret;
+}
+
+/* count the buffer with the monotonic time it arrived at and trace its latency.
+ * the buffer has to be writable when it is stamped
+ */
+static void
+gst_my_filter_process(GstMyFilter * filter, GstBuffer * buf, GstClockTime now)
+{
+	gboolean post_stats = gst_meter_stats_add(filter->stats, buf, now);
+
+	switch (filter->latency_mode) {
+	case GST_MY_FILTER_LATENCY_STAMP:
+		gst_buffer_set_latency_meta(buf, now, filter->latency_seqnum++);
+		break;
+	case GST_MY_FILTER_LATENCY_MEASURE:
+		gst_my_filter_measure_latency(filter, buf, now);
+
+		/* the interval starts with the first buffer */
+		if (!GST_CLOCK_TIME_IS_VALID(filter->latency_next))
+			filter->latency_next = now + filter->latency_interval;
+		else if (filter->latency_interval > 0 && now >= filter->latency_next) {
+			gst_my_filter_post_latency(filter);
+			filter->latency_next = now + filter->latency_interval;
+		}
+		break;
 	default:
-		/* just call the default handler */
-		ret = gst_pad_query_default(pad, parent, query);
 		break;
 	}
 
-	return ret;
+	/* the stamp covers the data going out. the verify mode has checked the buffer as it arrived */
+	if (filter->checksum_mode == GST_MY_FILTER_CHECKSUM_STAMP)
+		gst_buffer_set_checksum_meta(buf, gst_crc32c_buffer(buf), gst_buffer_get_size(buf));
+
+	if (post_stats)
+		gst_my_filter_post_stats(filter, now);
+
+	if (!filter->silent)
+		GST_LOG_OBJECT(filter, "Have data of size %" G_GSIZE_FORMAT " bytes", gst_buffer_get_size(buf));
 }
 
-static gboolean
-gst_my_filter_sink_query(GstPad * pad, GstObject * parent, GstQuery  * query)
+/* push out the buffer without touching it, keep it in the batch or hand it over to the task */
+static GstFlowReturn
+gst_my_filter_push(GstMyFilter * filter, GstBuffer * buf, GstClockTime now)
 {
-	gboolean ret = FALSE;
-	GstMyFilter *filter = GST_MYFILTER(parent);
+	GstFlowReturn ret;
+	gboolean started;
+
+	switch (filter->flow_mode) {
+	case GST_MY_FILTER_FLOW_BATCH:
+		g_mutex_lock(&filter->batch_lock);
+		ret = filter->batch_result;
+		if (ret != GST_FLOW_OK) {
+			gst_buffer_unref(buf);
+		}
+		else {
+			started = gst_batcher_is_empty(filter->batcher);
+			if (gst_batcher_add(filter->batcher, buf, now))
+				ret = gst_my_filter_push_batch(filter);
+			else if (started)
+				g_cond_signal(&filter->batch_cond);
+		}
+		g_mutex_unlock(&filter->batch_lock);
+		return ret;
 
-	g_print("JK DEBUG::gst_my_filter_sink_query():Received %s query.\n", GST_QUERY_TYPE_NAME(query));
+	case GST_MY_FILTER_FLOW_DECOUPLE:
+		/* the ring only flushes on a flush, a deactivation or when the task failed */
+		if (!gst_spsc_ring_push(filter->ring, buf, gst_buffer_get_size(buf), GST_BUFFER_DTS_OR_PTS(buf))) {
+			gst_buffer_unref(buf);
+			return (GstFlowReturn)g_atomic_int_get(&filter->srcresult);
+		}
+		return GST_FLOW_OK;
 
-	switch (GST_QUERY_TYPE(query)) {
-		//case GST_QUERY_CAPS:
-		//case GST_QUERY_ACCEPT_CAPS:
-		//case GST_QUERY_ALLOCATION:
+	case GST_MY_FILTER_FLOW_PARALLEL:
+		return gst_my_filter_push_parallel(filter, buf);
 
 	default:
-		/* just call the default handler */
-		ret = gst_pad_query_default(pad, parent, query);
-		break;
+		return gst_pad_push(filter->srcpad, buf);
+	}
+}
+
+/* hand the buffer out to the workers and push the ones done in order. a full window waits for the oldest one,
+ * so downstream blocking holds the chain function back
+ */
+static GstFlowReturn
+gst_my_filter_push_parallel(GstMyFilter * filter, GstBuffer * buf)
+{
+	GstFlowReturn ret = GST_FLOW_OK;
+	GstBuffer *done;
+
+	while (ret == GST_FLOW_OK && gst_worker_pool_is_full(filter->workers))
+		ret = gst_pad_push(filter->srcpad, gst_worker_pool_take(filter->workers, TRUE));
+
+	if (ret != GST_FLOW_OK) {
+		gst_buffer_unref(buf);
+		goto error;
 	}
 
+	gst_worker_pool_submit(filter->workers, buf);
+
+	while (ret == GST_FLOW_OK && (done = gst_worker_pool_take(filter->workers, FALSE)) != NULL)
+		ret = gst_pad_push(filter->srcpad, done);
+
+	if (ret != GST_FLOW_OK)
+		goto error;
+
+	return GST_FLOW_OK;
+
+error:
+	/* what follows the failed buffer is not pushed either */
+	gst_worker_pool_flush(filter->workers);
+
 	return ret;
 }
 
-static GstStateChangeReturn
-gst_my_filter_change_state(GstElement *element, GstStateChange transition)
+/* push what the batch or the workers still hold */
+static GstFlowReturn
+gst_my_filter_push_pending(GstMyFilter * filter)
 {
-	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
-	GstMyFilter *filter = GST_MYFILTER(element);
+	GstFlowReturn ret = GST_FLOW_OK;
+	GstBuffer *done;
 
-	switch (transition) {
-	case GST_STATE_CHANGE_NULL_TO_READY:
-		//if (!gst_my_filter_allocate_memory(filter))
-		//	return GST_STATE_CHANGE_FAILURE;
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from NULL to READY.\n");
+	if (filter->flow_mode == GST_MY_FILTER_FLOW_BATCH) {
+		g_mutex_lock(&filter->batch_lock);
+		ret = gst_my_filter_push_batch(filter);
+		g_mutex_unlock(&filter->batch_lock);
+		return ret;
+	}
 
-	case GST_STATE_CHANGE_READY_TO_PAUSED:
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from READY to PAUSED.\n");
-		break;
+	while (ret == GST_FLOW_OK && (done = gst_worker_pool_take(filter->workers, TRUE)) != NULL)
+		ret = gst_pad_push(filter->srcpad, done);
 
-	case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from PAUSED to PLAYING.\n");
-		break;
+	if (ret != GST_FLOW_OK)
+		gst_worker_pool_flush(filter->workers);
 
-	default:
-		break;
+	return ret;
+}
+
+/* the Adler-32 of the data as in zlib */
+static guint32
+gst_my_filter_adler32(const guint8 * data, gsize size)
+{
+	guint32 a = 1, b = 0;
+
+	while (size > 0) {
+		gsize n = MIN(size, ADLER32_NMAX);
+
+		size -= n;
+		while (n--) {
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER32_BASE;
+		b %= ADLER32_BASE;
 	}
 
-	ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
-	if (ret == GST_STATE_CHANGE_FAILURE)
-		return ret;
+	return (b << 16) | a;
+}
 
-	switch (transition) {
+/* mix, scale and meter raw audio. it takes the buffer and gives back the one to pass on */
+static GstBuffer *
+gst_my_filter_process_audio(GstMyFilter * filter, GstBuffer * buf)
+{
+	GstAudioInfo *info = &filter->audio_info;
+	GstAudioFormat format = GST_AUDIO_INFO_FORMAT(info);
+	guint channels = GST_AUDIO_INFO_CHANNELS(info);
+	guint sample_size = GST_AUDIO_INFO_WIDTH(info) / 8;
+	GstMapInfo map;
+	gdouble volume;
+	GstClockTime ramp_time;
+
+	GST_OBJECT_LOCK(filter);
+	volume = filter->volume;
+	ramp_time = filter->ramp_time;
+	GST_OBJECT_UNLOCK(filter);
+
+	if (volume != filter->gain.target)
+		gst_audio_gain_set_target(&filter->gain, volume,
+			gst_util_uint64_scale(ramp_time, GST_AUDIO_INFO_RATE(info), GST_SECOND));
+
+	if (filter->mix_matrix != NULL) {
+		GstAllocationParams params;
+		GstMapInfo out_map;
+		GstBuffer *out;
+		gsize frames;
+
+		if (!gst_buffer_map(buf, &map, GST_MAP_READ)) {
+			GST_WARNING_OBJECT(filter, "Could not map the buffer to mix it");
+			return buf;
+		}
+
+		frames = map.size / GST_AUDIO_INFO_BPF(info);
+		gst_allocation_params_init(&params);
+		params.align = MEMORY_ALIGN;
+		out = gst_buffer_new_allocate(NULL, frames * filter->audio_out_channels * sample_size, &params);
+		gst_buffer_copy_into(out, buf, GST_BUFFER_COPY_METADATA, 0, -1);
+
+		if (!gst_buffer_map(out, &out_map, GST_MAP_WRITE)) {
+			GST_WARNING_OBJECT(filter, "Could not map the buffer to mix into");
+			gst_buffer_unref(out);
+			gst_buffer_unmap(buf, &map);
+			return buf;
+		}
+		gst_audio_mix(format, map.data, out_map.data, frames, channels, filter->audio_out_channels,
+			filter->mix_matrix);
+		gst_buffer_unmap(out, &out_map);
+
+		gst_buffer_unmap(buf, &map);
+		gst_buffer_unref(buf);
+		buf = out;
+		channels = filter->audio_out_channels;
+	}
 
-	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from PLAYING to PAUSED.\n");
-		break;
+	if (!gst_audio_gain_is_unity(&filter->gain)) {
+		buf = gst_buffer_make_writable(buf);
+		if (!gst_buffer_map(buf, &map, GST_MAP_READWRITE)) {
+			GST_WARNING_OBJECT(filter, "Could not map the buffer to scale it");
+			return buf;
+		}
 
-	case GST_STATE_CHANGE_PAUSED_TO_READY:
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from PAUSED to READY.\n");
-		break;
+		gst_audio_gain_apply(&filter->gain, format, map.data, map.size / (channels * sample_size), channels);
+		gst_buffer_unmap(buf, &map);
+	}
 
-	case GST_STATE_CHANGE_READY_TO_NULL:
-		//gst_my_filter_free_memory(filter);
-		g_print("JK DEBUG::gst_my_filter_change_state():The state is changed from READY to NULL.\n");
-		break;
+	if (filter->loudness != NULL)
+		gst_my_filter_meter_loudness(filter, buf);
 
-	default:
-		break;
+	return buf;
+}
+
+/* measure the loudness of the audio passed on. the messages follow the stream time, so a burst of buffers posts
+ * as many of them as it spans
+ */
+static void
+gst_my_filter_meter_loudness(GstMyFilter * filter, GstBuffer * buf)
+{
+	GstLoudnessMeter *meter = filter->loudness;
+	GstMapInfo map;
+	GstStructure *loudness;
+
+	if (!gst_buffer_map(buf, &map, GST_MAP_READ)) {
+		GST_WARNING_OBJECT(filter, "Could not map the buffer to meter it");
+		return;
 	}
 
-	return ret;
+	gst_loudness_meter_add(meter, GST_AUDIO_INFO_FORMAT(&filter->audio_info), map.data,
+		map.size / (meter->channels * (GST_AUDIO_INFO_WIDTH(&filter->audio_info) / 8)));
+	gst_buffer_unmap(buf, &map);
+
+	if (meter->frames < filter->loudness_next_post)
+		return;
+
+	filter->loudness_next_post = meter->frames +
+		MAX(gst_util_uint64_scale(filter->loudness_interval, meter->rate, GST_SECOND), 1);
+
+	loudness = gst_loudness_meter_get_structure(meter);
+	gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), loudness));
 }
 
-/* entry point to initialize the plug-in
- * initialize the plug-in itself
- * register the element factories and other features
+/* keep a loudness meter for the audio passed on. the same rate and channels keep the measurement going */
+static void
+gst_my_filter_setup_loudness(GstMyFilter * filter)
+{
+	static const GstAudioChannelPosition stereo[] = {
+		GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT, GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT
+	};
+	GstAudioInfo *info = &filter->audio_info;
+	const GstAudioChannelPosition *positions = NULL;
+	guint rate = GST_AUDIO_INFO_RATE(info);
+	guint channels = filter->audio_out_channels;
+
+	if (filter->loudness_interval == 0)
+		return;
+
+	if (GST_AUDIO_INFO_LAYOUT(info) != GST_AUDIO_LAYOUT_INTERLEAVED) {
+		GST_WARNING_OBJECT(filter, "Only interleaved audio is metered");
+		gst_loudness_meter_free(filter->loudness);
+		filter->loudness = NULL;
+		return;
+	}
+
+	if (filter->loudness != NULL && filter->loudness->rate == rate && filter->loudness->channels == channels)
+		return;
+
+	gst_loudness_meter_free(filter->loudness);
+
+	/* the mixed channels only have positions when they are stereo */
+	if (filter->mix_matrix == NULL && !GST_AUDIO_INFO_IS_UNPOSITIONED(info))
+		positions = info->position;
+	else if (filter->mix_matrix != NULL && channels == 2)
+		positions = stereo;
+
+	filter->loudness = gst_loudness_meter_new(rate, channels, positions);
+	filter->loudness_next_post = MAX(gst_util_uint64_scale(filter->loudness_interval, rate, GST_SECOND), 1);
+}
+
+/* compare a frame to the latest one that differed. it gives back the buffer to pass on, or NULL when the frame is
+ * dropped
  */
-static gboolean
-myfilter_init(GstPlugin * myfilter)
+static GstBuffer *
+gst_my_filter_process_video(GstMyFilter * filter, GstBuffer * buf)
 {
-	g_print("JK DEBUG::myfilter_init().\n");
-	/* debug category for fltering log messages
-	 *
-	 * exchange the string 'Template myfilter' with your description
-	 */
-	GST_DEBUG_CATEGORY_INIT(gst_my_filter_debug, "myfilter",
+	guint plane = GST_VIDEO_INFO_COMP_PLANE(&filter->video_info, 0);
+	GstClockTime timestamp = GST_BUFFER_PTS(buf);
+	GstVideoFrame frame;
+	gboolean duplicate;
+
+	if (!gst_video_frame_map(&frame, &filter->video_info, buf, GST_MAP_READ)) {
+		GST_WARNING_OBJECT(filter, "Could not map the frame to compare it");
+		return buf;
+	}
+
+	duplicate = gst_freeze_detector_add(filter->freeze_detector, GST_VIDEO_FRAME_PLANE_DATA(&frame, plane),
+		GST_VIDEO_FRAME_PLANE_STRIDE(&frame, plane));
+	gst_video_frame_unmap(&frame);
+
+	/* the frame is the start of the next run */
+	if (!duplicate) {
+		gst_my_filter_end_freeze(filter, timestamp);
+		filter->freeze_start = timestamp;
+		filter->freeze_end = timestamp;
+		filter->freeze_frames = 0;
+		return buf;
+	}
+
+	filter->freeze_frames++;
+	filter->freeze_end = GST_CLOCK_TIME_IS_VALID(timestamp) && GST_BUFFER_DURATION_IS_VALID(buf) ?
+		timestamp + GST_BUFFER_DURATION(buf) : timestamp;
+
+	/* without timestamps the duplicates are still handled, only no freeze is told */
+	if (!filter->frozen && GST_CLOCK_TIME_IS_VALID(timestamp) && GST_CLOCK_TIME_IS_VALID(filter->freeze_start) &&
+		timestamp >= filter->freeze_start + filter->freeze_time) {
+		GstStructure *freeze = gst_structure_new("myfilter-freeze-start",
+			"timestamp", G_TYPE_UINT64, filter->freeze_start,
+			"difference", G_TYPE_DOUBLE, filter->freeze_detector->difference, NULL);
+
+		filter->frozen = TRUE;
+		gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), freeze));
+	}
+
+	switch (filter->freeze_mode) {
+	case GST_MY_FILTER_FREEZE_MARK:
+		buf = gst_buffer_make_writable(buf);
+		GST_BUFFER_FLAG_SET(buf, GST_BUFFER_FLAG_DROPPABLE);
+		break;
+	case GST_MY_FILTER_FREEZE_DROP:
+		gst_buffer_unref(buf);
+		buf = NULL;
+		break;
+	default:
+		break;
+	}
+
+	return buf;
+}
+
+/* post the end of the freeze, if there is one. the timestamp is the one of the frame that differs or the end of
+ * the last duplicate
+ */
+static void
+gst_my_filter_end_freeze(GstMyFilter * filter, GstClockTime timestamp)
+{
+	GstStructure *freeze;
+
+	if (!filter->frozen)
+		return;
+
+	filter->frozen = FALSE;
+	freeze = gst_structure_new("myfilter-freeze-end",
+		"timestamp", G_TYPE_UINT64, timestamp,
+		"duration", G_TYPE_UINT64, GST_CLOCK_TIME_IS_VALID(timestamp) && timestamp >= filter->freeze_start ?
+			timestamp - filter->freeze_start : GST_CLOCK_TIME_NONE,
+		"frames", G_TYPE_UINT64, filter->freeze_frames, NULL);
+	gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), freeze));
+}
+
+static void
+gst_my_filter_reset_freeze(GstMyFilter * filter)
+{
+	if (filter->freeze_detector != NULL)
+		gst_freeze_detector_reset(filter->freeze_detector);
+
+	filter->freeze_start = GST_CLOCK_TIME_NONE;
+	filter->freeze_end = GST_CLOCK_TIME_NONE;
+	filter->freeze_frames = 0;
+	filter->frozen = FALSE;
+}
+
+/* take the video format from the caps. the frames are compared on the first plane, so its samples have to be
+ * bytes
+ */
+static void
+gst_my_filter_set_video_caps(GstMyFilter * filter, GstEvent * event)
+{
+	GstCaps *caps;
+	GstVideoInfo info;
+
+	if (filter->video_active)
+		gst_my_filter_end_freeze(filter, filter->freeze_end);
+
+	filter->video_active = FALSE;
+	gst_freeze_detector_free(filter->freeze_detector);
+	filter->freeze_detector = NULL;
+	gst_my_filter_reset_freeze(filter);
+
+	if (filter->freeze_mode == GST_MY_FILTER_FREEZE_NONE)
+		return;
+
+	gst_event_parse_caps(event, &caps);
+	if (!gst_structure_has_name(gst_caps_get_structure(caps, 0), "video/x-raw"))
+		return;
+
+	if (!gst_video_info_from_caps(&info, caps) || GST_VIDEO_INFO_COMP_DEPTH(&info, 0) != 8 ||
+		GST_VIDEO_INFO_COMP_PSTRIDE(&info, 0) == 0) {
+		GST_WARNING_OBJECT(filter, "Cannot compare the frames of %" GST_PTR_FORMAT, caps);
+		return;
+	}
+
+	filter->video_info = info;
+	filter->freeze_detector = gst_freeze_detector_new(
+		GST_VIDEO_INFO_COMP_WIDTH(&info, 0) * GST_VIDEO_INFO_COMP_PSTRIDE(&info, 0),
+		GST_VIDEO_INFO_COMP_HEIGHT(&info, 0));
+	gst_freeze_detector_set_threshold(filter->freeze_detector, filter->freeze_threshold);
+	filter->video_active = TRUE;
+}
+
+/* take the audio format from the caps. when the channels are mixed, the caps event downstream gets the mixed ones.
+ * it gives NULL when the caps cannot be mixed
+ */
+static GstEvent *
+gst_my_filter_set_audio_caps(GstMyFilter * filter, GstEvent * event)
+{
+	GstCaps *caps, *out_caps;
+	GstAudioInfo info;
+	gboolean is_audio;
+
+	gst_event_parse_caps(event, &caps);
+	is_audio = gst_structure_has_name(gst_caps_get_structure(caps, 0), "audio/x-raw");
+
+	filter->audio_active = FALSE;
+	g_free(filter->mix_matrix);
+	filter->mix_matrix = NULL;
+
+	if (!is_audio)
+		return event;
+
+	if (!gst_audio_info_from_caps(&info, caps) || !gst_audio_kernels_supports(GST_AUDIO_INFO_FORMAT(&info))) {
+		if (filter->channels == 0)
+			return event;
+
+		GST_WARNING_OBJECT(filter, "Cannot mix %" GST_PTR_FORMAT, caps);
+		goto error;
+	}
+
+	filter->audio_info = info;
+	filter->audio_out_channels = GST_AUDIO_INFO_CHANNELS(&info);
+	filter->audio_active = TRUE;
+
+	if (filter->channels == 0 || filter->channels == (guint)GST_AUDIO_INFO_CHANNELS(&info)) {
+		gst_my_filter_setup_loudness(filter);
+		return event;
+	}
+
+	if (GST_AUDIO_INFO_LAYOUT(&info) != GST_AUDIO_LAYOUT_INTERLEAVED) {
+		GST_WARNING_OBJECT(filter, "Only interleaved audio is mixed");
+		goto error;
+	}
+
+	filter->audio_out_channels = filter->channels;
+	filter->mix_matrix = gst_audio_mix_matrix_new(&info, filter->channels);
+	gst_my_filter_setup_loudness(filter);
+
+	out_caps = gst_my_filter_transform_caps(filter, caps, GST_PAD_SINK);
+	gst_event_unref(event);
+	event = gst_event_new_caps(out_caps);
+	gst_caps_unref(out_caps);
+
+	return event;
+
+error:
+	filter->audio_active = FALSE;
+	gst_event_unref(event);
+
+	return NULL;
+}
+
+/* the caps on the other side of the element when it mixes the channels. the caps of the sink pad get the mixed
+ * channels, the ones of the source pad any number of them
+ */
+static GstCaps *
+gst_my_filter_transform_caps(GstMyFilter * filter, GstCaps * caps, GstPadDirection direction)
+{
+	GstCaps *result = gst_caps_copy(caps);
+	guint i;
+
+	for (i = 0; i < gst_caps_get_size(result); i++) {
+		GstStructure *structure = gst_caps_get_structure(result, i);
+
+		if (!gst_structure_has_name(structure, "audio/x-raw"))
+			continue;
+
+		gst_structure_remove_field(structure, "channel-mask");
+
+		if (direction == GST_PAD_SRC) {
+			gst_structure_set(structure, "channels", GST_TYPE_INT_RANGE, 1, G_MAXINT, NULL);
+			continue;
+		}
+
+		/* stereo is front left and right, more channels are unpositioned */
+		gst_structure_set(structure, "channels", G_TYPE_INT, filter->channels, NULL);
+		if (filter->channels > 1)
+			gst_structure_set(structure, "channel-mask", GST_TYPE_BITMASK,
+				filter->channels == 2 ? (guint64)0x3 : (guint64)0, NULL);
+	}
+
+	return result;
+}
+
+/* answer the caps queries across the mix, since the channels differ on the two sides */
+static gboolean
+gst_my_filter_query_mixed_caps(GstMyFilter * filter, GstPad * pad, GstQuery * query)
+{
+	GstPad *otherpad = pad == filter->sinkpad ? filter->srcpad : filter->sinkpad;
+	GstCaps *caps, *peer_caps, *result;
+
+	if (GST_QUERY_TYPE(query) == GST_QUERY_ACCEPT_CAPS) {
+		gst_query_parse_accept_caps(query, &caps);
+		caps = gst_my_filter_transform_caps(filter, caps, GST_PAD_DIRECTION(pad));
+		gst_query_set_accept_caps_result(query, gst_pad_peer_query_accept_caps(otherpad, caps));
+		gst_caps_unref(caps);
+		return TRUE;
+	}
+
+	gst_query_parse_caps(query, &caps);
+	peer_caps = gst_pad_peer_query_caps(otherpad, NULL);
+	result = gst_my_filter_transform_caps(filter, peer_caps, GST_PAD_DIRECTION(otherpad));
+	gst_caps_unref(peer_caps);
+
+	if (caps != NULL) {
+		GstCaps *intersection = gst_caps_intersect_full(caps, result, GST_CAPS_INTERSECT_FIRST);
+
+		gst_caps_unref(result);
+		result = intersection;
+	}
+
+	gst_query_set_caps_result(query, result);
+	gst_caps_unref(result);
+
+	return TRUE;
+}
+
+/* the parallel function. it runs on the worker threads */
+static GstBuffer *
+gst_my_filter_run_parallel(GstBuffer * buf, gpointer user_data)
+{
+	GstMyFilter *filter = GST_MYFILTER(user_data);
+	GstMapInfo map;
+
+	switch (filter->parallel_function) {
+	case GST_MY_FILTER_PARALLEL_CHECKSUM:
+		if (gst_buffer_map(buf, &map, GST_MAP_READ)) {
+			GST_LOG_OBJECT(filter, "Adler-32 %08x of %" G_GSIZE_FORMAT " bytes at %" GST_TIME_FORMAT,
+				gst_my_filter_adler32(map.data, map.size), map.size, GST_TIME_ARGS(GST_BUFFER_PTS(buf)));
+			gst_buffer_unmap(buf, &map);
+		}
+		break;
+
+	case GST_MY_FILTER_PARALLEL_HANDOFF:
+		buf = gst_buffer_make_writable(buf);
+		g_signal_emit(filter, gst_my_filter_signals[SIGNAL_HANDOFF], 0, buf);
+		break;
+
+	default:
+		break;
+	}
+
+	return buf;
+}
+
+/* push out the list as a whole or hand it over to the task */
+static GstFlowReturn
+gst_my_filter_push_list(GstMyFilter * filter, GstBufferList * list)
+{
+	GstBuffer *first;
+
+	if (filter->flow_mode != GST_MY_FILTER_FLOW_DECOUPLE)
+		return gst_pad_push_list(filter->srcpad, list);
+
+	first = gst_buffer_list_length(list) > 0 ? gst_buffer_list_get(list, 0) : NULL;
+	if (!gst_spsc_ring_push(filter->ring, list, gst_buffer_list_calculate_size(list),
+		first != NULL ? GST_BUFFER_DTS_OR_PTS(first) : GST_CLOCK_TIME_NONE)) {
+		gst_buffer_list_unref(list);
+		return (GstFlowReturn)g_atomic_int_get(&filter->srcresult);
+	}
+
+	return GST_FLOW_OK;
+}
+
+/* the serialized events go through the ring behind the buffers before them. a flush empties the ring */
+static gboolean
+gst_my_filter_decouple_event(GstMyFilter * filter, GstEvent * event)
+{
+	gboolean ret;
+
+	switch (GST_EVENT_TYPE(event)) {
+	case GST_EVENT_FLUSH_START:
+		/* downstream lets go of the task first, then both sides stop waiting */
+		ret = gst_pad_push_event(filter->srcpad, event);
+		g_atomic_int_set(&filter->srcresult, GST_FLOW_FLUSHING);
+		gst_spsc_ring_set_flushing(filter->ring, TRUE);
+		gst_my_filter_wake_query(filter);
+		gst_pad_pause_task(filter->srcpad);
+		break;
+
+	case GST_EVENT_FLUSH_STOP:
+		/* the task may still run when no flush start came before */
+		gst_spsc_ring_set_flushing(filter->ring, TRUE);
+		gst_pad_pause_task(filter->srcpad);
+
+		ret = gst_pad_push_event(filter->srcpad, event);
+
+		/* the sticky events still waiting are kept on the source pad and go out before the next buffer */
+		gst_spsc_ring_drain(filter->ring, gst_my_filter_drop_flushed, filter);
+
+		if (gst_pad_is_active(filter->srcpad)) {
+			g_atomic_int_set(&filter->srcresult, GST_FLOW_OK);
+			gst_spsc_ring_set_flushing(filter->ring, FALSE);
+			gst_pad_start_task(filter->srcpad, (GstTaskFunction)gst_my_filter_loop, filter, NULL);
+		}
+		break;
+
+	default:
+		if (!GST_EVENT_IS_SERIALIZED(event)) {
+			ret = gst_pad_push_event(filter->srcpad, event);
+			break;
+		}
+
+		ret = gst_spsc_ring_push(filter->ring, event, 0, GST_CLOCK_TIME_NONE);
+		if (!ret) {
+			GST_DEBUG_OBJECT(filter, "Dropping %s, the task is not running", GST_EVENT_TYPE_NAME(event));
+			gst_event_unref(event);
+		}
+		break;
+	}
+
+	return ret;
+}
+
+/* drop what a flush leaves in the ring, except the sticky events. the segment and the eos do not outlive the flush */
+static void
+gst_my_filter_drop_flushed(gpointer item, gpointer user_data)
+{
+	GstMyFilter *filter = GST_MYFILTER(user_data);
+
+	/* the query belongs to the thread which waited for it */
+	if (GST_IS_QUERY(item))
+		return;
+
+	if (GST_IS_EVENT(item) && GST_EVENT_IS_STICKY(item) &&
+		GST_EVENT_TYPE(item) != GST_EVENT_SEGMENT && GST_EVENT_TYPE(item) != GST_EVENT_EOS)
+		gst_pad_store_sticky_event(filter->srcpad, GST_EVENT_CAST(item));
+
+	gst_mini_object_unref(GST_MINI_OBJECT_CAST(item));
+}
+
+/* drop an item left in the ring, but a query */
+static void
+gst_my_filter_drop_item(gpointer item, gpointer user_data)
+{
+	if (!GST_IS_QUERY(item))
+		gst_mini_object_unref(GST_MINI_OBJECT_CAST(item));
+}
+
+/* send the query on from the task, behind the buffers and the events before it, and wait for the answer like a
+ * queue. a flush or a failed task makes the wait give up, but not before the task is done with the query
+ */
+static gboolean
+gst_my_filter_decouple_query(GstMyFilter * filter, GstQuery * query)
+{
+	gboolean ret = FALSE;
+
+	g_mutex_lock(&filter->query_lock);
+	filter->decouple_query = query;
+	filter->decouple_query_result = FALSE;
+	g_mutex_unlock(&filter->query_lock);
+
+	if (!gst_spsc_ring_push(filter->ring, query, 0, GST_CLOCK_TIME_NONE)) {
+		GST_DEBUG_OBJECT(filter, "Not sending %s on, the task is not running", GST_QUERY_TYPE_NAME(query));
+		g_mutex_lock(&filter->query_lock);
+		filter->decouple_query = NULL;
+		g_mutex_unlock(&filter->query_lock);
+		return FALSE;
+	}
+
+	g_mutex_lock(&filter->query_lock);
+	while (filter->decouple_query == query &&
+		(filter->decouple_query_running || g_atomic_int_get(&filter->srcresult) == GST_FLOW_OK))
+		g_cond_wait(&filter->query_cond, &filter->query_lock);
+
+	if (filter->decouple_query == query)
+		filter->decouple_query = NULL;
+	else
+		ret = filter->decouple_query_result;
+	g_mutex_unlock(&filter->query_lock);
+
+	return ret;
+}
+
+/* answer the query the task took out of the ring, unless its thread has given up on it */
+static void
+gst_my_filter_answer_decouple_query(GstMyFilter * filter, GstQuery * query)
+{
+	gboolean res;
+
+	g_mutex_lock(&filter->query_lock);
+	if (filter->decouple_query != query) {
+		g_mutex_unlock(&filter->query_lock);
+		return;
+	}
+	filter->decouple_query_running = TRUE;
+	g_mutex_unlock(&filter->query_lock);
+
+	res = gst_pad_peer_query(filter->srcpad, query);
+
+	g_mutex_lock(&filter->query_lock);
+	filter->decouple_query_result = res;
+	filter->decouple_query_running = FALSE;
+	filter->decouple_query = NULL;
+	g_cond_broadcast(&filter->query_cond);
+	g_mutex_unlock(&filter->query_lock);
+}
+
+/* let the thread waiting for a query see the result of the task is not ok any more */
+static void
+gst_my_filter_wake_query(GstMyFilter * filter)
+{
+	g_mutex_lock(&filter->query_lock);
+	g_cond_broadcast(&filter->query_cond);
+	g_mutex_unlock(&filter->query_lock);
+}
+
+/* the task of the source pad in the decouple mode
+ * it pushes what the chain function hands over and pauses like a queue when downstream fails
+ */
+static void
+gst_my_filter_loop(GstMyFilter * filter)
+{
+	GstMiniObject *item = gst_spsc_ring_pop(filter->ring);
+	GstFlowReturn ret = GST_FLOW_OK;
+	gboolean eos = FALSE;
+
+	if (item == NULL) {
+		ret = GST_FLOW_FLUSHING;
+	}
+	else if (GST_IS_BUFFER(item)) {
+		ret = gst_pad_push(filter->srcpad, GST_BUFFER_CAST(item));
+	}
+	else if (GST_IS_BUFFER_LIST(item)) {
+		ret = gst_pad_push_list(filter->srcpad, GST_BUFFER_LIST_CAST(item));
+	}
+	else if (GST_IS_QUERY(item)) {
+		gst_my_filter_answer_decouple_query(filter, GST_QUERY_CAST(item));
+	}
+	else {
+		eos = GST_EVENT_TYPE(item) == GST_EVENT_EOS;
+		gst_pad_push_event(filter->srcpad, GST_EVENT_CAST(item));
+		if (eos)
+			ret = GST_FLOW_EOS;
+	}
+
+	if (ret == GST_FLOW_OK)
+		return;
+
+	GST_DEBUG_OBJECT(filter, "Pausing the task, %s", gst_flow_get_name(ret));
+
+	/* the chain function returns the result from now on */
+	g_atomic_int_set(&filter->srcresult, ret);
+	gst_spsc_ring_set_flushing(filter->ring, TRUE);
+	gst_my_filter_wake_query(filter);
+	gst_pad_pause_task(filter->srcpad);
+
+	if (!eos && (ret == GST_FLOW_NOT_LINKED || ret < GST_FLOW_EOS)) {
+		GST_ELEMENT_FLOW_ERROR(filter, ret);
+		gst_pad_push_event(filter->srcpad, gst_event_new_eos());
+	}
+}
+
+/* the task of the source pad in the batch mode
+ * it pushes the batch pending for the batch time, so a stalled stream does not hold it until the next event
+ */
+static void
+gst_my_filter_batch_loop(GstMyFilter * filter)
+{
+	GstBatcher *batcher = filter->batcher;
+	GstClockTime now, due;
+	GstFlowReturn ret;
+
+	g_mutex_lock(&filter->batch_lock);
+
+	if (filter->batch_flushing) {
+		g_mutex_unlock(&filter->batch_lock);
+		gst_pad_pause_task(filter->srcpad);
+		return;
+	}
+
+	if (gst_batcher_is_empty(batcher) || !GST_CLOCK_TIME_IS_VALID(batcher->max_time)) {
+		g_cond_wait(&filter->batch_cond, &filter->batch_lock);
+		g_mutex_unlock(&filter->batch_lock);
+		return;
+	}
+
+	/* the arrival times are monotonic like the time of the condition, only on another base */
+	now = gst_util_get_timestamp();
+	due = batcher->first_arrival + batcher->max_time;
+	if (now < due) {
+		g_cond_wait_until(&filter->batch_cond, &filter->batch_lock,
+			g_get_monotonic_time() + (gint64)((due - now + GST_USECOND - 1) / GST_USECOND));
+		g_mutex_unlock(&filter->batch_lock);
+		return;
+	}
+
+	ret = gst_my_filter_push_batch(filter);
+	if (ret != GST_FLOW_OK) {
+		GST_DEBUG_OBJECT(filter, "Pushing the batch after the batch time returned %s", gst_flow_get_name(ret));
+		filter->batch_result = ret;
+	}
+
+	g_mutex_unlock(&filter->batch_lock);
+}
+
+/* push the pending batch as one list, followed by the event that marks its end. called with the batch lock */
+static GstFlowReturn
+gst_my_filter_push_batch(GstMyFilter * filter)
+{
+	gsize bytes = filter->batcher->bytes;
+	GstBufferList *list = gst_batcher_take(filter->batcher);
+	GstStructure *boundary;
+	GstFlowReturn ret;
+	guint length;
+
+	if (list == NULL)
+		return GST_FLOW_OK;
+
+	length = gst_buffer_list_length(list);
+	ret = gst_pad_push_list(filter->srcpad, list);
+	if (ret != GST_FLOW_OK)
+		return ret;
+
+	/* downstream sees where a batch ends without waiting for the next one */
+	boundary = gst_structure_new(BATCH_BOUNDARY_EVENT,
+		"batch", G_TYPE_UINT64, filter->batcher->batches,
+		"buffers", G_TYPE_UINT, length,
+		"bytes", G_TYPE_UINT64, (guint64)bytes, NULL);
+	gst_pad_push_event(filter->srcpad, gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, boundary));
+
+	return GST_FLOW_OK;
+}
+
+/* post the snapshot of the counters as an element message */
+static void
+gst_my_filter_post_stats(GstMyFilter * filter, GstClockTime now)
+{
+	GstStructure *snapshot = gst_meter_stats_take_snapshot(filter->stats, now);
+
+	if (snapshot == NULL)
+		return;
+
+	gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), snapshot));
+}
+
+/* post the latency histogram since the previous one as an element message. it is posted on the latency interval
+ * whatever the stats interval is, at EOS and when stopping
+ */
+static void
+gst_my_filter_post_latency(GstMyFilter * filter)
+{
+	GstHdrHistogram *histogram = filter->latency_histogram;
+	GstStructure *snapshot;
+
+	if (filter->latency_mode != GST_MY_FILTER_LATENCY_MEASURE || histogram->total == 0)
+		return;
+
+	snapshot = gst_structure_new("myfilter-latency",
+		"count", G_TYPE_UINT64, histogram->total,
+		"lost", G_TYPE_UINT64, filter->latency_lost,
+		"min", G_TYPE_UINT64, histogram->min,
+		"max", G_TYPE_UINT64, histogram->max,
+		"mean", G_TYPE_DOUBLE, gst_hdr_histogram_get_mean(histogram),
+		"p50", G_TYPE_UINT64, gst_hdr_histogram_get_percentile(histogram, 50.0),
+		"p99", G_TYPE_UINT64, gst_hdr_histogram_get_percentile(histogram, 99.0),
+		"p999", G_TYPE_UINT64, gst_hdr_histogram_get_percentile(histogram, 99.9), NULL);
+	gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), snapshot));
+
+	gst_hdr_histogram_reset(histogram);
+}
+
+/* record the delay since the buffer was stamped. the missing sequence numbers are the buffers lost on the way */
+static void
+gst_my_filter_measure_latency(GstMyFilter * filter, GstBuffer * buf, GstClockTime now)
+{
+	GstLatencyMeta *meta = gst_buffer_get_latency_meta(buf);
+
+	if (meta == NULL || !GST_CLOCK_TIME_IS_VALID(meta->stamp))
+		return;
+
+	if (filter->latency_seqnum != LATENCY_NO_SEQNUM && meta->seqnum > filter->latency_seqnum)
+		filter->latency_lost += meta->seqnum - filter->latency_seqnum;
+	filter->latency_seqnum = meta->seqnum + 1;
+
+	gst_hdr_histogram_record(filter->latency_histogram, now > meta->stamp ? now - meta->stamp : 0);
+}
+
+static void
+gst_my_filter_reset_latency(GstMyFilter * filter)
+{
+	filter->latency_seqnum = filter->latency_mode == GST_MY_FILTER_LATENCY_STAMP ? 0 : LATENCY_NO_SEQNUM;
+	filter->latency_lost = 0;
+	filter->latency_next = GST_CLOCK_TIME_NONE;
+	gst_hdr_histogram_reset(filter->latency_histogram);
+}
+
+/* check the CRC32C of the buffer against its stamp. a mismatch is counted and posted, a buffer without a stamp is
+ * only counted
+ */
+static void
+gst_my_filter_verify_checksum(GstMyFilter * filter, GstBuffer * buf)
+{
+	GstChecksumMeta *meta = gst_buffer_get_checksum_meta(buf);
+	GstStructure *mismatch;
+	gsize size;
+	guint32 crc32c;
+
+	if (meta == NULL) {
+		filter->checksum_missing++;
+		return;
+	}
+
+	size = gst_buffer_get_size(buf);
+	crc32c = gst_crc32c_buffer(buf);
+	if (crc32c == meta->crc32c && size == meta->size)
+		return;
+
+	filter->checksum_mismatches++;
+	GST_WARNING_OBJECT(filter, "The buffer at %" GST_TIME_FORMAT " has the CRC32C %08x of %" G_GSIZE_FORMAT
+		" bytes, stamped %08x of %" G_GSIZE_FORMAT, GST_TIME_ARGS(GST_BUFFER_DTS_OR_PTS(buf)), crc32c, size,
+		meta->crc32c, meta->size);
+
+	mismatch = gst_structure_new("myfilter-checksum-mismatch",
+		"timestamp", G_TYPE_UINT64, GST_BUFFER_DTS_OR_PTS(buf),
+		"offset", G_TYPE_UINT64, GST_BUFFER_OFFSET(buf),
+		"size", G_TYPE_UINT64, (guint64)size,
+		"stamped-size", G_TYPE_UINT64, (guint64)meta->size,
+		"crc32c", G_TYPE_UINT, crc32c,
+		"stamped-crc32c", G_TYPE_UINT, meta->crc32c,
+		"mismatches", G_TYPE_UINT64, filter->checksum_mismatches, NULL);
+	gst_element_post_message(GST_ELEMENT(filter), gst_message_new_element(GST_OBJECT(filter), mismatch));
+}
+
+static gboolean
+gst_my_filter_src_query(GstPad * pad, GstObject * parent, GstQuery  * query)
+{
+	gboolean ret = FALSE;
+	GstMyFilter *filter = GST_MYFILTER(parent);
+
+	GST_LOG_OBJECT(filter, "Received %s query", GST_QUERY_TYPE_NAME(query));
+
+	switch (GST_QUERY_TYPE(query)) {
+		//case GST_QUERY_POSITION:
+		//	/* we should report the current position */
+		//	break;
+		//
+		//case GST_QUERY_DURATION:
+		//	/* we should report the duration here */
+		//	break;
+		//
+	case GST_QUERY_CAPS:
+		if (filter->channels != 0) {
+			ret = gst_my_filter_query_mixed_caps(filter, pad, query);
+			break;
+		}
+		ret = gst_pad_query_default(pad, parent, query);
+		break;
+
+	default:
+		/* just call the default handler */
+		ret = gst_pad_query_default(pad, parent, query);
+		break;
+	}
+
+	return ret;
+}
+
+/* the task runs while the source pad is active in the decouple mode */
+static gboolean
+gst_my_filter_src_activate_mode(GstPad * pad, GstObject * parent, GstPadMode mode, gboolean active)
+{
+	GstMyFilter *filter = GST_MYFILTER(parent);
+	gboolean ret;
+
+	if (mode != GST_PAD_MODE_PUSH)
+		return TRUE;
+
+	if (filter->flow_mode == GST_MY_FILTER_FLOW_BATCH) {
+		g_mutex_lock(&filter->batch_lock);
+		filter->batch_flushing = !active;
+		filter->batch_result = GST_FLOW_OK;
+		g_cond_signal(&filter->batch_cond);
+		g_mutex_unlock(&filter->batch_lock);
+
+		if (active)
+			return gst_pad_start_task(pad, (GstTaskFunction)gst_my_filter_batch_loop, filter, NULL);
+		return gst_pad_stop_task(pad);
+	}
+
+	if (filter->flow_mode != GST_MY_FILTER_FLOW_DECOUPLE)
+		return TRUE;
+
+	if (active) {
+		g_atomic_int_set(&filter->srcresult, GST_FLOW_OK);
+		gst_spsc_ring_set_flushing(filter->ring, FALSE);
+		ret = gst_pad_start_task(pad, (GstTaskFunction)gst_my_filter_loop, filter, NULL);
+	}
+	else {
+		/* the chain function may wait for room or for a query, the task for data */
+		g_atomic_int_set(&filter->srcresult, GST_FLOW_FLUSHING);
+		gst_spsc_ring_set_flushing(filter->ring, TRUE);
+		gst_my_filter_wake_query(filter);
+		ret = gst_pad_stop_task(pad);
+	}
+
+	return ret;
+}
+
+static gboolean
+gst_my_filter_sink_query(GstPad * pad, GstObject * parent, GstQuery  * query)
+{
+	gboolean ret = FALSE;
+	GstMyFilter *filter = GST_MYFILTER(parent);
+
+	GST_LOG_OBJECT(filter, "Received %s query", GST_QUERY_TYPE_NAME(query));
+
+	switch (GST_QUERY_TYPE(query)) {
+	case GST_QUERY_CAPS:
+	case GST_QUERY_ACCEPT_CAPS:
+		if (filter->channels != 0)
+			ret = gst_my_filter_query_mixed_caps(filter, pad, query);
+		else
+			ret = gst_pad_query_default(pad, parent, query);
+		break;
+
+	case GST_QUERY_ALLOCATION:
+		ret = gst_my_filter_propose_allocation(filter, query);
+		break;
+
+	default:
+		/* a serialized query, like a drain, does not overtake the buffers and the events held in the element */
+		if (GST_QUERY_IS_SERIALIZED(query))
+			ret = gst_my_filter_query_downstream(filter, query);
+		else
+			ret = gst_pad_query_default(pad, parent, query);
+		break;
+	}
+
+	return ret;
+}
+
+/* ask downstream once what the element holds has been pushed. in the decouple mode the task asks it once the
+ * buffers and the events queued before the query are pushed
+ */
+static gboolean
+gst_my_filter_query_downstream(GstMyFilter * filter, GstQuery * query)
+{
+	GstFlowReturn flow;
+
+	switch (filter->flow_mode) {
+	case GST_MY_FILTER_FLOW_DECOUPLE:
+		return gst_my_filter_decouple_query(filter, query);
+
+	case GST_MY_FILTER_FLOW_BATCH:
+	case GST_MY_FILTER_FLOW_PARALLEL:
+		flow = gst_my_filter_push_pending(filter);
+		if (flow != GST_FLOW_OK)
+			GST_DEBUG_OBJECT(filter, "Pushing the pending buffers before the %s query returned %s",
+				GST_QUERY_TYPE_NAME(query), gst_flow_get_name(flow));
+		break;
+
+	default:
+		break;
+	}
+
+	return gst_pad_peer_query(filter->srcpad, query);
+}
+
+/* proxy the allocation query downstream, so upstream allocates into memory downstream can take as it is.
+ * the buffers held in the element come on top of what downstream needs. when downstream has no pool,
+ * upstream gets one of ours to recycle its buffers
+ */
+static gboolean
+gst_my_filter_propose_allocation(GstMyFilter * filter, GstQuery * query)
+{
+	GstCaps *caps;
+	gboolean need_pool;
+	GstBufferPool *pool = NULL;
+	GstAllocator *allocator = NULL;
+	GstAllocationParams params;
+	guint size = 0, min = 0, max = 0, held;
+	gboolean answered;
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	switch (filter->flow_mode) {
+	case GST_MY_FILTER_FLOW_BATCH:
+		held = filter->batch_buffers;
+		break;
+	case GST_MY_FILTER_FLOW_DECOUPLE:
+		held = filter->decouple_buffers;
+		break;
+	case GST_MY_FILTER_FLOW_PARALLEL:
+		held = filter->parallel_window;
+		break;
+	default:
+		held = 0;
+		break;
+	}
+
+	/* when the channels are mixed, the buffers of upstream are not sent on but mixed into new ones, so the
+	 * allocation of downstream, with the channels of the src caps, does not apply to them
+	 */
+	if (filter->mix_matrix != NULL)
+		return gst_my_filter_answer_allocation(filter, query, held);
+
+	answered = gst_my_filter_query_downstream(filter, query);
+	if (!answered)
+		GST_DEBUG_OBJECT(filter, "Downstream did not answer the allocation query");
+
+	/* keep the alignment and the padding of downstream, at least a cache line aligned */
+	if (gst_query_get_n_allocation_params(query) > 0) {
+		gst_query_parse_nth_allocation_param(query, 0, &allocator, &params);
+		params.align = MAX(params.align, MEMORY_ALIGN);
+		gst_query_set_nth_allocation_param(query, 0, allocator, &params);
+	}
+	else {
+		gst_allocation_params_init(&params);
+		params.align = MEMORY_ALIGN;
+		gst_query_add_allocation_param(query, NULL, &params);
+	}
+
+	if (gst_query_get_n_allocation_pools(query) > 0) {
+		gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+		min += held;
+		if (max != 0 && max < min)
+			max = min;
+		gst_query_set_nth_allocation_pool(query, 0, pool, size, min, max);
+	}
+	else if (need_pool && (size = gst_my_filter_get_buffer_size(caps)) > 0) {
+		pool = gst_buffer_pool_new();
+		gst_query_add_allocation_pool(query, pool, size, held, 0);
+		GST_DEBUG_OBJECT(filter, "Proposing our pool of %u bytes for %" GST_PTR_FORMAT, size, caps);
+	}
+
+	if (pool != NULL)
+		gst_object_unref(pool);
+	if (allocator != NULL)
+		gst_object_unref(allocator);
+
+	return TRUE;
+}
+
+/* answer the allocation query without downstream. the buffers upstream allocates are not the ones downstream
+ * gets, so they only need to be aligned. the pool is sized for the sink caps and covers the buffers held in the
+ * element
+ */
+static gboolean
+gst_my_filter_answer_allocation(GstMyFilter * filter, GstQuery * query, guint held)
+{
+	GstCaps *caps;
+	gboolean need_pool;
+	GstBufferPool *pool;
+	GstAllocationParams params;
+	guint size;
+
+	gst_query_parse_allocation(query, &caps, &need_pool);
+
+	gst_allocation_params_init(&params);
+	params.align = MEMORY_ALIGN;
+	gst_query_add_allocation_param(query, NULL, &params);
+
+	size = gst_my_filter_get_buffer_size(caps);
+	if (need_pool && size > 0) {
+		pool = gst_buffer_pool_new();
+		gst_query_add_allocation_pool(query, pool, size, held, 0);
+		gst_object_unref(pool);
+	}
+
+	GST_DEBUG_OBJECT(filter, "Answered the allocation query for %" GST_PTR_FORMAT " with buffers of %u bytes",
+		caps, size);
+
+	return TRUE;
+}
+
+/* the size of a buffer of the caps, as the pool takes it. 0 when the caps do not tell it */
+static guint
+gst_my_filter_get_buffer_size(GstCaps * caps)
+{
+	GstStructure *structure;
+	GstVideoInfo video_info;
+	GstAudioInfo audio_info;
+
+	if (caps == NULL || gst_caps_is_empty(caps))
+		return 0;
+
+	structure = gst_caps_get_structure(caps, 0);
+
+	if (gst_structure_has_name(structure, "video/x-raw") && gst_video_info_from_caps(&video_info, caps))
+		return (guint)GST_VIDEO_INFO_SIZE(&video_info);
+
+	if (gst_structure_has_name(structure, "audio/x-raw") && gst_audio_info_from_caps(&audio_info, caps))
+		return GST_AUDIO_INFO_BPF(&audio_info) *
+			(guint)gst_util_uint64_scale_int(ALLOCATION_AUDIO_DURATION, GST_AUDIO_INFO_RATE(&audio_info), GST_SECOND);
+
+	return 0;
+}
+
+static GstStateChangeReturn
+gst_my_filter_change_state(GstElement *element, GstStateChange transition)
+{
+	GstStateChangeReturn ret = GST_STATE_CHANGE_SUCCESS;
+	GstMyFilter *filter = GST_MYFILTER(element);
+
+	switch (transition) {
+	case GST_STATE_CHANGE_NULL_TO_READY:
+		//if (!gst_my_filter_allocate_memory(filter))
+		//	return GST_STATE_CHANGE_FAILURE;
+		GST_DEBUG_OBJECT(filter, "State change: NULL to READY");
+
+	case GST_STATE_CHANGE_READY_TO_PAUSED:
+		GST_DEBUG_OBJECT(filter, "State change: READY to PAUSED");
+		gst_meter_stats_reset(filter->stats);
+		gst_my_filter_reset_latency(filter);
+		filter->checksum_mismatches = 0;
+		filter->checksum_missing = 0;
+
+		/* the pads are not active yet, so the ring can be reallocated */
+		gst_spsc_ring_set_limits(filter->ring, filter->decouple_buffers, filter->decouple_bytes, filter->decouple_time);
+
+		/* the first buffer starts at the volume, without a ramp */
+		GST_OBJECT_LOCK(filter);
+		gst_audio_gain_reset(&filter->gain, filter->volume);
+		GST_OBJECT_UNLOCK(filter);
+
+		if (filter->flow_mode == GST_MY_FILTER_FLOW_PARALLEL && filter->workers == NULL) {
+			GError *error = NULL;
+
+			filter->workers = gst_worker_pool_new(filter->parallel_workers, filter->parallel_window,
+				gst_my_filter_run_parallel, filter, &error);
+			if (filter->workers == NULL) {
+				GST_ELEMENT_ERROR(filter, RESOURCE, FAILED, ("Could not start the worker threads"),
+					("%s", error->message));
+				g_clear_error(&error);
+				return GST_STATE_CHANGE_FAILURE;
+			}
+		}
+		break;
+
+	case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+		GST_DEBUG_OBJECT(filter, "State change: PAUSED to PLAYING");
+		break;
+
+	default:
+		break;
+	}
+
+	ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+	if (ret == GST_STATE_CHANGE_FAILURE)
+		return ret;
+
+	switch (transition) {
+
+	case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+		GST_DEBUG_OBJECT(filter, "State change: PLAYING to PAUSED");
+		break;
+
+	case GST_STATE_CHANGE_PAUSED_TO_READY:
+		GST_DEBUG_OBJECT(filter, "State change: PAUSED to READY");
+		gst_batcher_clear(filter->batcher);
+		/* both pads are inactive, so neither side of the ring runs */
+		gst_spsc_ring_drain(filter->ring, gst_my_filter_drop_item, NULL);
+		gst_worker_pool_free(filter->workers);
+		filter->workers = NULL;
+		/* the rest of the latency when the stream is stopped before EOS */
+		gst_my_filter_post_latency(filter);
+		/* the next stream is measured from its start */
+		gst_loudness_meter_free(filter->loudness);
+		filter->loudness = NULL;
+		filter->video_active = FALSE;
+		gst_freeze_detector_free(filter->freeze_detector);
+		filter->freeze_detector = NULL;
+		gst_my_filter_reset_freeze(filter);
+		break;
+
+	case GST_STATE_CHANGE_READY_TO_NULL:
+		//gst_my_filter_free_memory(filter);
+		GST_DEBUG_OBJECT(filter, "State change: READY to NULL");
+		break;
+
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+/* entry point to initialize the plug-in
+ * initialize the plug-in itself
+ * register the element factories and other features
+ */
+static gboolean
+myfilter_init(GstPlugin * myfilter)
+{
+	/* debug category for fltering log messages
+	 *
+	 * exchange the string 'Template myfilter' with your description
+	 */
+	GST_DEBUG_CATEGORY_INIT(gst_my_filter_debug, "myfilter",
 		0, "Template myfilter");
 
+	gst_audio_kernels_init();
+	GST_INFO("The audio is processed with the %s kernels", gst_audio_kernels_get_name());
+
+	gst_crc32c_init();
+	GST_INFO("The CRC32C is computed with the %s code", gst_crc32c_get_name());
+
 	return gst_element_register(myfilter, "myfilter", GST_RANK_NONE,
 		GST_TYPE_MYFILTER);
 }
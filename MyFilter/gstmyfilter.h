@@ -48,6 +48,20 @@
 
 #include <gst/gst.h>
 
+#include "gstmeterstats.h"
+#include "gsthdrhistogram.h"
+#include "gstlatencymeta.h"
+#include "gstbatcher.h"
+#include "gstspscring.h"
+#include "gstworkerpool.h"
+#include "gstaudiokernels.h"
+#include "gstloudness.h"
+#include "gstfreezedetect.h"
+#include "gstcrc32c.h"
+#include "gstchecksummeta.h"
+
+#include <gst/video/video.h>
+
 G_BEGIN_DECLS
 
 /* #defines don't like whitespacey bits */
@@ -62,6 +76,44 @@ G_BEGIN_DECLS
 #define GST_IS_MYFILTER_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_MYFILTER))
 
+typedef enum
+{
+  GST_MY_FILTER_LATENCY_NONE,
+  GST_MY_FILTER_LATENCY_STAMP,
+  GST_MY_FILTER_LATENCY_MEASURE
+} GstMyFilterLatencyMode;
+
+typedef enum
+{
+  GST_MY_FILTER_FLOW_PASSTHROUGH,
+  GST_MY_FILTER_FLOW_BATCH,
+  GST_MY_FILTER_FLOW_UNBATCH,
+  GST_MY_FILTER_FLOW_DECOUPLE,
+  GST_MY_FILTER_FLOW_PARALLEL
+} GstMyFilterFlowMode;
+
+typedef enum
+{
+  GST_MY_FILTER_PARALLEL_NONE,
+  GST_MY_FILTER_PARALLEL_CHECKSUM,
+  GST_MY_FILTER_PARALLEL_HANDOFF
+} GstMyFilterParallelFunction;
+
+typedef enum
+{
+  GST_MY_FILTER_FREEZE_NONE,
+  GST_MY_FILTER_FREEZE_DETECT,
+  GST_MY_FILTER_FREEZE_MARK,
+  GST_MY_FILTER_FREEZE_DROP
+} GstMyFilterFreezeMode;
+
+typedef enum
+{
+  GST_MY_FILTER_CHECKSUM_NONE,
+  GST_MY_FILTER_CHECKSUM_STAMP,
+  GST_MY_FILTER_CHECKSUM_VERIFY
+} GstMyFilterChecksumMode;
+
 typedef struct _GstMyFilter      GstMyFilter;
 typedef struct _GstMyFilterClass GstMyFilterClass;
 
@@ -72,6 +124,97 @@ struct _GstMyFilter
   GstPad *sinkpad, *srcpad;
 
   gboolean silent;
+
+  /* throughput and jitter of the buffers going through */
+  GstMeterStats *stats;
+  GstClockTime stats_interval;
+
+  /* end-to-end latency from a stamping instance to a measuring one.
+   * the sequence number is the next one to stamp or to expect. the histogram
+   * is posted on its own interval, not with the stats */
+  GstMyFilterLatencyMode latency_mode;
+  guint64 latency_seqnum;
+  guint64 latency_lost;
+  GstHdrHistogram *latency_histogram;
+  GstClockTime latency_interval;
+  GstClockTime latency_next;
+
+  /* how the buffers are pushed. batch gathers them into lists, unbatch
+   * pushes the buffers of the lists one by one */
+  GstMyFilterFlowMode flow_mode;
+  GstBatcher *batcher;
+  guint batch_buffers;
+  guint batch_bytes;
+  GstClockTime batch_time;
+
+  /* the task of the source pad pushes the batch that is pending for the
+   * batch time when no buffer comes to push it. the lock serializes the
+   * task with the chain function, and the chain function returns what a
+   * push of the task failed with */
+  GMutex batch_lock;
+  GCond batch_cond;
+  gboolean batch_flushing;
+  GstFlowReturn batch_result;
+
+  /* decouple hands the buffers over to the task of the source pad.
+   * the result of the task is a GstFlowReturn read atomically */
+  GstSpscRing *ring;
+  guint decouple_buffers;
+  guint decouple_bytes;
+  GstClockTime decouple_time;
+  gint srcresult;
+
+  /* a serialized query goes through the ring too. the task answers it
+   * and the sink thread waits for it, the lock guards the handover */
+  GMutex query_lock;
+  GCond query_cond;
+  GstQuery *decouple_query;
+  gboolean decouple_query_running;
+  gboolean decouple_query_result;
+
+  /* parallel runs a function on the buffers in worker threads and
+   * pushes them in the order they came in */
+  GstWorkerPool *workers;
+  guint parallel_workers;
+  guint parallel_window;
+  GstMyFilterParallelFunction parallel_function;
+
+  /* raw audio is scaled by the volume, ramping over the ramp time, and
+   * mixed to the given number of channels. the rest is set by the caps */
+  gdouble volume;
+  GstClockTime ramp_time;
+  guint channels;
+  gboolean audio_active;
+  GstAudioInfo audio_info;
+  guint audio_out_channels;
+  gfloat *mix_matrix;
+  GstAudioGain gain;
+
+  /* the loudness of the audio passed on, posted every interval of
+   * stream time. the next post is counted in frames */
+  GstLoudnessMeter *loudness;
+  GstClockTime loudness_interval;
+  guint64 loudness_next_post;
+
+  /* raw video is compared to the latest frame that differed. the
+   * duplicates are marked droppable or dropped, and a run of them that
+   * spans the freeze time is a freeze */
+  GstMyFilterFreezeMode freeze_mode;
+  gdouble freeze_threshold;
+  GstClockTime freeze_time;
+  gboolean video_active;
+  GstVideoInfo video_info;
+  GstFreezeDetector *freeze_detector;
+  GstClockTime freeze_start;
+  GstClockTime freeze_end;
+  guint64 freeze_frames;
+  gboolean frozen;
+
+  /* the CRC32C of the buffers, stamped as a meta by one instance and
+   * checked by another one further down */
+  GstMyFilterChecksumMode checksum_mode;
+  guint64 checksum_mismatches;
+  guint64 checksum_missing;
 };
 
 struct _GstMyFilterClass 
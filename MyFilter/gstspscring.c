@@ -0,0 +1,226 @@
+#include "gstspscring.h"
+
+// The limits before any are set
+#define SPSC_RING_DEFAULT_ITEMS		200
+
+static gboolean gst_spsc_ring_is_full(GstSpscRing * ring);
+static void gst_spsc_ring_wake(GstSpscRing * ring);
+
+GstSpscRing *
+gst_spsc_ring_new(void)
+{
+	GstSpscRing *ring = g_new0(GstSpscRing, 1);
+
+	g_mutex_init(&ring->lock);
+	g_cond_init(&ring->cond);
+	ring->in_time = GST_CLOCK_TIME_NONE;
+
+	gst_spsc_ring_set_limits(ring, SPSC_RING_DEFAULT_ITEMS, 0, GST_CLOCK_TIME_NONE);
+
+	return ring;
+}
+
+void
+gst_spsc_ring_free(GstSpscRing * ring)
+{
+	if (ring == NULL)
+		return;
+
+	gst_spsc_ring_clear(ring);
+	g_free(ring->slots);
+	g_mutex_clear(&ring->lock);
+	g_cond_clear(&ring->cond);
+	g_free(ring);
+}
+
+/*
+* Set the limits. The slots are allocated for the item limit rounded up to a power of two, so the ring has to be
+* empty with neither side running.
+*/
+void
+gst_spsc_ring_set_limits(GstSpscRing * ring, guint max_items, guint max_bytes, GstClockTime max_time)
+{
+	guint size = 1;
+
+	max_items = CLAMP(max_items, 1, G_MAXINT / 2);
+	while (size < max_items)
+		size <<= 1;
+
+	if (ring->slots == NULL || ring->mask + 1 != size) {
+		gst_spsc_ring_clear(ring);
+		g_free(ring->slots);
+		ring->slots = g_new0(GstSpscSlot, size);
+		ring->mask = size - 1;
+	}
+
+	ring->max_items = max_items;
+	ring->max_bytes = max_bytes;
+	ring->max_time = max_time > 0 ? max_time : GST_CLOCK_TIME_NONE;
+}
+
+/*
+* Hand the item over to the consumer. It waits while the ring is full and returns FALSE, keeping the item, when the
+* ring is flushing.
+*/
+gboolean
+gst_spsc_ring_push(GstSpscRing * ring, gpointer item, guint size, GstClockTime timestamp)
+{
+	guint head = (guint)ring->head;
+	GstSpscSlot *slot;
+
+	if (gst_spsc_ring_is_full(ring)) {
+		// The consumer checks the flag after it moves the tail, so either it sees the flag or this sees the tail.
+		// The consumer clears the flag when it wakes this side, so it takes the lock once per wait.
+		g_mutex_lock(&ring->lock);
+		for (;;) {
+			g_atomic_int_set(&ring->producer_waiting, 1);
+			if (!gst_spsc_ring_is_full(ring) || g_atomic_int_get(&ring->flushing))
+				break;
+			g_cond_wait(&ring->cond, &ring->lock);
+		}
+		g_atomic_int_set(&ring->producer_waiting, 0);
+		g_mutex_unlock(&ring->lock);
+	}
+
+	if (g_atomic_int_get(&ring->flushing))
+		return FALSE;
+
+	slot = &ring->slots[head & ring->mask];
+	slot->item = item;
+	slot->size = size;
+	slot->timestamp = timestamp;
+
+	ring->in_bytes += size;
+	if (GST_CLOCK_TIME_IS_VALID(timestamp))
+		ring->in_time = timestamp;
+
+	// Publish the slot
+	g_atomic_int_set(&ring->head, (gint)(head + 1));
+
+	if (g_atomic_int_compare_and_exchange(&ring->consumer_waiting, 1, 0))
+		gst_spsc_ring_wake(ring);
+
+	return TRUE;
+}
+
+/*
+* Take the oldest item. It waits while the ring is empty and returns NULL when the ring is flushing.
+*/
+gpointer
+gst_spsc_ring_pop(GstSpscRing * ring)
+{
+	guint tail = (guint)ring->tail;
+	GstSpscSlot *slot;
+	gpointer item;
+
+	if ((guint)g_atomic_int_get(&ring->head) == tail) {
+		g_mutex_lock(&ring->lock);
+		for (;;) {
+			g_atomic_int_set(&ring->consumer_waiting, 1);
+			if ((guint)g_atomic_int_get(&ring->head) != tail || g_atomic_int_get(&ring->flushing))
+				break;
+			g_cond_wait(&ring->cond, &ring->lock);
+		}
+		g_atomic_int_set(&ring->consumer_waiting, 0);
+		g_mutex_unlock(&ring->lock);
+	}
+
+	if (g_atomic_int_get(&ring->flushing))
+		return NULL;
+
+	slot = &ring->slots[tail & ring->mask];
+	item = slot->item;
+
+	// The byte counters wrap, only their difference counts
+	g_atomic_int_set(&ring->out_bytes, (gint)((guint)ring->out_bytes + slot->size));
+	g_atomic_int_set(&ring->tail, (gint)(tail + 1));
+
+	if (g_atomic_int_compare_and_exchange(&ring->producer_waiting, 1, 0))
+		gst_spsc_ring_wake(ring);
+
+	return item;
+}
+
+/*
+* Make both sides give up waiting, or let them go on.
+*/
+void
+gst_spsc_ring_set_flushing(GstSpscRing * ring, gboolean flushing)
+{
+	g_atomic_int_set(&ring->flushing, flushing);
+
+	g_mutex_lock(&ring->lock);
+	g_cond_broadcast(&ring->cond);
+	g_mutex_unlock(&ring->lock);
+}
+
+/*
+* Drop the items left. Neither side may run meanwhile.
+*/
+void
+gst_spsc_ring_clear(GstSpscRing * ring)
+{
+	gst_spsc_ring_drain(ring, (GFunc)gst_mini_object_unref, NULL);
+}
+
+/*
+* Hand the items left over to the function, oldest first, and empty the ring. The function owns the items.
+* Neither side may run meanwhile.
+*/
+void
+gst_spsc_ring_drain(GstSpscRing * ring, GFunc func, gpointer user_data)
+{
+	guint head = (guint)ring->head;
+	guint tail = (guint)ring->tail;
+
+	for (; tail != head; tail++) {
+		GstSpscSlot *slot = &ring->slots[tail & ring->mask];
+
+		func(slot->item, user_data);
+		slot->item = NULL;
+	}
+
+	g_atomic_int_set(&ring->head, 0);
+	g_atomic_int_set(&ring->tail, 0);
+	g_atomic_int_set(&ring->out_bytes, 0);
+	ring->in_bytes = 0;
+	ring->in_time = GST_CLOCK_TIME_NONE;
+}
+
+/*
+* Check the limits from the producer side. The slot at the tail is only rewritten by the producer, so its timestamp
+* can be read even when the consumer has just taken it.
+*/
+static gboolean
+gst_spsc_ring_is_full(GstSpscRing * ring)
+{
+	guint head = (guint)ring->head;
+	guint tail = (guint)g_atomic_int_get(&ring->tail);
+	guint count = head - tail;
+
+	if (count == 0)
+		return FALSE;
+
+	if (count >= ring->max_items)
+		return TRUE;
+
+	if (ring->max_bytes > 0 && ring->in_bytes - (guint)g_atomic_int_get(&ring->out_bytes) >= ring->max_bytes)
+		return TRUE;
+
+	if (GST_CLOCK_TIME_IS_VALID(ring->max_time) && GST_CLOCK_TIME_IS_VALID(ring->in_time)) {
+		GstClockTime oldest = ring->slots[tail & ring->mask].timestamp;
+
+		if (GST_CLOCK_TIME_IS_VALID(oldest) && ring->in_time > oldest && ring->in_time - oldest >= ring->max_time)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+gst_spsc_ring_wake(GstSpscRing * ring)
+{
+	g_mutex_lock(&ring->lock);
+	g_cond_signal(&ring->cond);
+	g_mutex_unlock(&ring->lock);
+}
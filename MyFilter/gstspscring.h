@@ -0,0 +1,81 @@
+#ifndef __GST_SPSCRING_H__
+#define __GST_SPSCRING_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define SPSC_RING_CACHE_LINE	64
+
+typedef struct _GstSpscSlot		GstSpscSlot;
+typedef struct _GstSpscRing		GstSpscRing;
+
+/*
+* An item of the ring with what the limits need. The events have no size and no timestamp.
+*/
+struct _GstSpscSlot
+{
+	gpointer		item;
+	guint			size;
+	GstClockTime	timestamp;
+};
+
+/*
+* A bounded ring between one producer and one consumer. Each side only writes its own index, so handing an item over
+* is a store and a load. The sides only take the lock to sleep when the ring is full or empty.
+*/
+struct _GstSpscRing
+{
+	GstSpscSlot		*slots;
+	guint			mask;
+
+	// A limit of 0, or GST_CLOCK_TIME_NONE for the time, is not checked. One item always fits.
+	guint			max_items;
+	guint			max_bytes;
+	GstClockTime	max_time;
+
+	// Written by the producer only. The time is the one of the latest item with a timestamp.
+	union {
+		struct {
+			volatile gint	head;
+			guint			in_bytes;
+			GstClockTime	in_time;
+		};
+		guint8	producer_padding[SPSC_RING_CACHE_LINE];
+	};
+
+	// Written by the consumer only
+	union {
+		struct {
+			volatile gint	tail;
+			volatile gint	out_bytes;
+		};
+		guint8	consumer_padding[SPSC_RING_CACHE_LINE];
+	};
+
+	volatile gint	flushing;
+	volatile gint	producer_waiting;
+	volatile gint	consumer_waiting;
+	GMutex			lock;
+	GCond			cond;
+};
+
+GstSpscRing * gst_spsc_ring_new(void);
+
+void gst_spsc_ring_free(GstSpscRing * ring);
+
+void gst_spsc_ring_set_limits(GstSpscRing * ring, guint max_items, guint max_bytes, GstClockTime max_time);
+
+gboolean gst_spsc_ring_push(GstSpscRing * ring, gpointer item, guint size, GstClockTime timestamp);
+
+gpointer gst_spsc_ring_pop(GstSpscRing * ring);
+
+void gst_spsc_ring_set_flushing(GstSpscRing * ring, gboolean flushing);
+
+void gst_spsc_ring_clear(GstSpscRing * ring);
+
+void gst_spsc_ring_drain(GstSpscRing * ring, GFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GST_SPSCRING_H__ */
@@ -0,0 +1,142 @@
+#include "gstworkerpool.h"
+
+static void gst_worker_pool_run(gpointer data, gpointer user_data);
+
+/*
+* Start the workers. 0 workers are as many as the processors. The window is at least one buffer per worker.
+*/
+GstWorkerPool *
+gst_worker_pool_new(guint workers, guint window, GstWorkerFunc func, gpointer user_data, GError ** error)
+{
+	GstWorkerPool *pool = g_new0(GstWorkerPool, 1);
+
+	if (workers == 0)
+		workers = g_get_num_processors();
+
+	pool->func = func;
+	pool->user_data = user_data;
+	pool->window = MAX(window, workers);
+	pool->slots = g_new0(GstWorkerSlot, pool->window);
+	g_mutex_init(&pool->lock);
+	g_cond_init(&pool->cond);
+
+	// Exclusive threads are started at once and kept, so no buffer waits for a thread to start
+	pool->threads = g_thread_pool_new(gst_worker_pool_run, pool, workers, TRUE, error);
+	if (pool->threads == NULL)
+		goto error;
+
+	return pool;
+
+error:
+	g_free(pool->slots);
+	g_mutex_clear(&pool->lock);
+	g_cond_clear(&pool->cond);
+	g_free(pool);
+
+	return NULL;
+}
+
+/*
+* Drop the buffers in flight and join the workers.
+*/
+void
+gst_worker_pool_free(GstWorkerPool * pool)
+{
+	if (pool == NULL)
+		return;
+
+	gst_worker_pool_flush(pool);
+	g_thread_pool_free(pool->threads, FALSE, TRUE);
+
+	g_free(pool->slots);
+	g_mutex_clear(&pool->lock);
+	g_cond_clear(&pool->cond);
+	g_free(pool);
+}
+
+gboolean
+gst_worker_pool_is_full(GstWorkerPool * pool)
+{
+	return pool->tail - pool->head >= pool->window;
+}
+
+gboolean
+gst_worker_pool_is_empty(GstWorkerPool * pool)
+{
+	return pool->tail == pool->head;
+}
+
+/*
+* Hand the buffer out. The window must not be full.
+*/
+void
+gst_worker_pool_submit(GstWorkerPool * pool, GstBuffer * buffer)
+{
+	GstWorkerSlot *slot = &pool->slots[pool->tail % pool->window];
+
+	g_return_if_fail(!gst_worker_pool_is_full(pool));
+
+	// The worker only sees the slot once it is queued, so these need no lock
+	slot->buffer = buffer;
+	slot->done = FALSE;
+	pool->tail++;
+
+	g_thread_pool_push(pool->threads, slot, NULL);
+}
+
+/*
+* Take the oldest buffer when its work is done. It is NULL when the pool is empty, or when the buffer is not done and
+* the caller does not wait.
+*/
+GstBuffer *
+gst_worker_pool_take(GstWorkerPool * pool, gboolean wait)
+{
+	GstWorkerSlot *slot;
+	GstBuffer *buffer = NULL;
+
+	if (gst_worker_pool_is_empty(pool))
+		return NULL;
+
+	slot = &pool->slots[pool->head % pool->window];
+
+	g_mutex_lock(&pool->lock);
+	while (!slot->done && wait)
+		g_cond_wait(&pool->cond, &pool->lock);
+
+	if (slot->done) {
+		buffer = slot->buffer;
+		slot->buffer = NULL;
+		pool->head++;
+	}
+	g_mutex_unlock(&pool->lock);
+
+	return buffer;
+}
+
+/*
+* Wait for the work in flight and drop the buffers.
+*/
+void
+gst_worker_pool_flush(GstWorkerPool * pool)
+{
+	while (!gst_worker_pool_is_empty(pool)) {
+		GstBuffer *buffer = gst_worker_pool_take(pool, TRUE);
+
+		if (buffer != NULL)
+			gst_buffer_unref(buffer);
+	}
+}
+
+static void
+gst_worker_pool_run(gpointer data, gpointer user_data)
+{
+	GstWorkerPool *pool = user_data;
+	GstWorkerSlot *slot = data;
+	GstBuffer *buffer = pool->func(slot->buffer, pool->user_data);
+
+	g_mutex_lock(&pool->lock);
+	slot->buffer = buffer;
+	slot->done = TRUE;
+	g_cond_signal(&pool->cond);
+	g_mutex_unlock(&pool->lock);
+}
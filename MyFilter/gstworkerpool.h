@@ -0,0 +1,62 @@
+#ifndef __GST_WORKERPOOL_H__
+#define __GST_WORKERPOOL_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstWorkerSlot	GstWorkerSlot;
+typedef struct _GstWorkerPool	GstWorkerPool;
+
+/*
+* The work done on each buffer. It takes the buffer and gives back the one to push, which may be another one.
+* It runs on the worker threads, several at once.
+*/
+typedef GstBuffer * (*GstWorkerFunc) (GstBuffer * buffer, gpointer user_data);
+
+struct _GstWorkerSlot
+{
+	GstBuffer	*buffer;
+	gboolean	done;
+};
+
+/*
+* Hands the buffers out to worker threads and gives the results back in the order they came in. At most a window of
+* buffers are in flight, the oldest one holds the others back.
+*/
+struct _GstWorkerPool
+{
+	GThreadPool		*threads;
+	GstWorkerFunc	func;
+	gpointer		user_data;
+
+	GstWorkerSlot	*slots;
+	guint			window;
+
+	// Only the thread submitting and taking the buffers moves them
+	guint64			head;
+	guint64			tail;
+
+	// The done flags of the slots
+	GMutex			lock;
+	GCond			cond;
+};
+
+GstWorkerPool * gst_worker_pool_new(guint workers, guint window, GstWorkerFunc func, gpointer user_data,
+	GError ** error);
+
+void gst_worker_pool_free(GstWorkerPool * pool);
+
+gboolean gst_worker_pool_is_full(GstWorkerPool * pool);
+
+gboolean gst_worker_pool_is_empty(GstWorkerPool * pool);
+
+void gst_worker_pool_submit(GstWorkerPool * pool, GstBuffer * buffer);
+
+GstBuffer * gst_worker_pool_take(GstWorkerPool * pool, gboolean wait);
+
+void gst_worker_pool_flush(GstWorkerPool * pool);
+
+G_END_DECLS
+
+#endif /* __GST_WORKERPOOL_H__ */
@@ -0,0 +1,103 @@
+/*
+* Runs every kernel level the CPU supports against the scalar kernels. The results are the same to the bit.
+*/
+#include "../gstaudiokernels.c"
+
+#include <stdio.h>
+
+#define TEST_SAMPLES			1003
+#define TEST_ROUNDS				16
+
+static const gfloat test_gains[] = { 0.0f, 0.25f, 0.5f, 0.70710678f, 1.0f, 1.3f, 3.9f, 10.0f, 1000.0f };
+
+/*
+* Random samples, with the extremes at the start, in the middle and at the end so the vector tails see them
+*/
+static void
+test_fill(GRand * rand, gint16 * s16, gint32 * s32, gfloat * f32)
+{
+	static const gsize extremes[] = { 0, 1, TEST_SAMPLES / 2, TEST_SAMPLES - 2, TEST_SAMPLES - 1 };
+
+	for (gsize i = 0; i < TEST_SAMPLES; i++) {
+		s16[i] = (gint16)g_rand_int_range(rand, G_MININT16, G_MAXINT16 + 1);
+		s32[i] = (gint32)g_rand_int(rand);
+		f32[i] = (gfloat)g_rand_double_range(rand, -1.0, 1.0);
+	}
+
+	for (gsize i = 0; i < G_N_ELEMENTS(extremes); i++) {
+		gsize at = extremes[i];
+
+		s16[at] = i % 2 == 0 ? G_MININT16 : G_MAXINT16;
+		s32[at] = i % 2 == 0 ? G_MININT32 : G_MAXINT32;
+		f32[at] = i % 2 == 0 ? -1.0f : 1.0f;
+	}
+}
+
+static gboolean
+test_level(GRand * rand, guint level)
+{
+	const GstAudioKernels *kernels = &audio_kernels_table[level];
+	gint16 s16[TEST_SAMPLES], ref_s16[TEST_SAMPLES];
+	gint32 s32[TEST_SAMPLES], ref_s32[TEST_SAMPLES];
+	gfloat f32[TEST_SAMPLES], ref_f32[TEST_SAMPLES];
+	gboolean ok = TRUE;
+
+	for (guint round = 0; round < TEST_ROUNDS; round++) {
+		for (gsize g = 0; g < G_N_ELEMENTS(test_gains); g++) {
+			// Every count up to a few vectors, then the whole buffer, so every tail length is covered
+			gsize count = round < TEST_ROUNDS - 1 ? round * 5 + 1 : TEST_SAMPLES;
+
+			test_fill(rand, s16, s32, f32);
+			memcpy(ref_s16, s16, sizeof(s16));
+			memcpy(ref_s32, s32, sizeof(s32));
+			memcpy(ref_f32, f32, sizeof(f32));
+
+			kernels->gain_s16(s16, count, test_gains[g]);
+			audio_gain_s16_scalar(ref_s16, count, test_gains[g]);
+			kernels->gain_s32(s32, count, test_gains[g]);
+			audio_gain_s32_scalar(ref_s32, count, test_gains[g]);
+			kernels->gain_f32(f32, count, test_gains[g]);
+			audio_gain_f32_scalar(ref_f32, count, test_gains[g]);
+
+			if (memcmp(s16, ref_s16, sizeof(s16)) != 0) {
+				printf("%s: S16 differs with the gain %f over %" G_GSIZE_FORMAT " samples\n", kernels->name,
+					test_gains[g], count);
+				ok = FALSE;
+			}
+			if (memcmp(s32, ref_s32, sizeof(s32)) != 0) {
+				printf("%s: S32 differs with the gain %f over %" G_GSIZE_FORMAT " samples\n", kernels->name,
+					test_gains[g], count);
+				ok = FALSE;
+			}
+			if (memcmp(f32, ref_f32, sizeof(f32)) != 0) {
+				printf("%s: F32 differs with the gain %f over %" G_GSIZE_FORMAT " samples\n", kernels->name,
+					test_gains[g], count);
+				ok = FALSE;
+			}
+		}
+	}
+
+	return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+	GRand *rand = g_rand_new_with_seed(0x6d796669);
+	guint best = audio_kernels_get_best();
+	gboolean ok = TRUE;
+
+	for (guint level = 1; level <= best; level++) {
+		gboolean level_ok = test_level(rand, level);
+
+		printf("%s: %s\n", audio_kernels_table[level].name, level_ok ? "ok" : "FAILED");
+		ok &= level_ok;
+	}
+
+	for (guint level = best + 1; level < G_N_ELEMENTS(audio_kernels_table); level++)
+		printf("%s: skipped, the CPU does not support it\n", audio_kernels_table[level].name);
+
+	g_rand_free(rand);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,113 @@
+/*
+* Checks the CRC32C codes against the known answer and a bitwise reference. Every code the CPU runs gives the same
+* CRC over every length up to a few streams and from every start in a word.
+*/
+#include "../gstcrc32c.c"
+
+#include <stdio.h>
+
+// Every length up to two rounds of the short streams, then around the long streams
+#define TEST_SHORT_LENGTHS		(6 * CRC32C_SHORT + 64)
+#define TEST_DATA_SIZE			(7 * CRC32C_LONG + 64)
+#define TEST_STARTS				8
+
+static const gsize test_long_lengths[] = {
+	3 * CRC32C_LONG - 1, 3 * CRC32C_LONG, 3 * CRC32C_LONG + 1, 3 * CRC32C_LONG + 3 * CRC32C_SHORT + 13,
+	6 * CRC32C_LONG, 7 * CRC32C_LONG + 5
+};
+
+/*
+* One bit at a time, without the tables
+*/
+static guint32
+test_crc32c_bitwise(guint32 crc, const guint8 * data, gsize size)
+{
+	crc = ~crc;
+
+	while (size-- > 0) {
+		crc ^= *data++;
+		for (guint k = 0; k < 8; k++)
+			crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+	}
+
+	return ~crc;
+}
+
+static gboolean
+test_known_answer(const GstCrc32cCode * code)
+{
+	static const guint8 check[] = "123456789";
+	guint32 crc = code->update(0, check, 9);
+	guint32 split = code->update(code->update(0, check, 4), check + 4, 5);
+
+	if (crc != 0xe3069283 || split != crc) {
+		printf("%s: CRC32C(\"123456789\") is %08x, %08x in two parts, not e3069283\n", code->name, crc, split);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+test_compare(const GstCrc32cCode * code, const guint8 * data, gsize size)
+{
+	guint32 crc = code->update(0, data, size);
+	guint32 ref = test_crc32c_bitwise(0, data, size);
+
+	if (crc != ref) {
+		printf("%s: %08x instead of %08x over %" G_GSIZE_FORMAT " bytes from the offset %u\n", code->name, crc, ref,
+			size, (guint)((guintptr)data & (TEST_STARTS - 1)));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+test_code(const GstCrc32cCode * code, const guint8 * data)
+{
+	gboolean ok = test_known_answer(code);
+
+	for (guint start = 0; start < TEST_STARTS && ok; start++) {
+		for (gsize size = 0; size <= TEST_SHORT_LENGTHS && ok; size++)
+			ok = test_compare(code, data + start, size);
+
+		for (gsize i = 0; i < G_N_ELEMENTS(test_long_lengths) && ok; i++)
+			ok = test_compare(code, data + start, test_long_lengths[i]);
+	}
+
+	return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+	GRand *rand = g_rand_new_with_seed(0x63726333);
+	guint8 *memory = g_malloc(TEST_DATA_SIZE + TEST_STARTS + 7);
+	guint8 *data = (guint8 *)(((guintptr)memory + 7) & ~(guintptr)7);
+	guint best;
+	gboolean ok = TRUE;
+
+	for (gsize i = 0; i < TEST_DATA_SIZE + TEST_STARTS; i++)
+		data[i] = (guint8)g_rand_int(rand);
+
+	// The fastest code the CPU runs is picked unless the environment caps it
+	g_unsetenv(CRC32C_ENV);
+	gst_crc32c_init();
+	best = (guint)(crc32c_code - crc32c_code_table);
+
+	for (guint i = 0; i <= best; i++) {
+		gboolean code_ok = test_code(&crc32c_code_table[i], data);
+
+		printf("%s: %s\n", crc32c_code_table[i].name, code_ok ? "ok" : "FAILED");
+		ok &= code_ok;
+	}
+
+	for (guint i = best + 1; i < G_N_ELEMENTS(crc32c_code_table); i++)
+		printf("%s: skipped, the CPU does not support it\n", crc32c_code_table[i].name);
+
+	g_free(memory);
+	g_rand_free(rand);
+
+	return ok ? 0 : 1;
+}
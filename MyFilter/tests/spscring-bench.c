@@ -0,0 +1,160 @@
+/*
+* Measures the handoff rate of the SPSC ring against a queue like the one of the queue element, which takes its
+* mutex for every item and signals its condition when the other side waits. Both hold the same number of items.
+*/
+#include "../gstspscring.h"
+
+#include <stdio.h>
+
+#define BENCH_ITEMS				(2 * 1000 * 1000)
+
+static const guint bench_capacities[] = { 4, 64, 1024 };
+
+typedef struct
+{
+	GMutex		lock;
+	GCond		item_add;
+	GCond		item_del;
+	GQueue		items;
+	guint		max_items;
+	gboolean	waiting_add;
+	gboolean	waiting_del;
+} BenchQueue;
+
+static void
+bench_queue_push(BenchQueue * queue, gpointer item)
+{
+	g_mutex_lock(&queue->lock);
+	while (g_queue_get_length(&queue->items) >= queue->max_items) {
+		queue->waiting_del = TRUE;
+		g_cond_wait(&queue->item_del, &queue->lock);
+		queue->waiting_del = FALSE;
+	}
+	g_queue_push_tail(&queue->items, item);
+	if (queue->waiting_add)
+		g_cond_signal(&queue->item_add);
+	g_mutex_unlock(&queue->lock);
+}
+
+static gpointer
+bench_queue_pop(BenchQueue * queue)
+{
+	gpointer item;
+
+	g_mutex_lock(&queue->lock);
+	while (g_queue_get_length(&queue->items) == 0) {
+		queue->waiting_add = TRUE;
+		g_cond_wait(&queue->item_add, &queue->lock);
+		queue->waiting_add = FALSE;
+	}
+	item = g_queue_pop_head(&queue->items);
+	if (queue->waiting_del)
+		g_cond_signal(&queue->item_del);
+	g_mutex_unlock(&queue->lock);
+
+	return item;
+}
+
+static gpointer
+bench_queue_consume(gpointer user_data)
+{
+	for (guint i = 1; i <= BENCH_ITEMS; i++) {
+		if (GPOINTER_TO_UINT(bench_queue_pop(user_data)) != i)
+			return GUINT_TO_POINTER(FALSE);
+	}
+
+	return GUINT_TO_POINTER(TRUE);
+}
+
+static gpointer
+bench_ring_consume(gpointer user_data)
+{
+	for (guint i = 1; i <= BENCH_ITEMS; i++) {
+		if (GPOINTER_TO_UINT(gst_spsc_ring_pop(user_data)) != i)
+			return GUINT_TO_POINTER(FALSE);
+	}
+
+	return GUINT_TO_POINTER(TRUE);
+}
+
+/*
+* The handoffs per second of the queue
+*/
+static gdouble
+bench_queue(guint capacity, gboolean * ok)
+{
+	BenchQueue queue;
+	GThread *consumer;
+	gint64 start, end;
+
+	g_mutex_init(&queue.lock);
+	g_cond_init(&queue.item_add);
+	g_cond_init(&queue.item_del);
+	g_queue_init(&queue.items);
+	queue.max_items = capacity;
+	queue.waiting_add = FALSE;
+	queue.waiting_del = FALSE;
+
+	start = g_get_monotonic_time();
+	consumer = g_thread_new("bench-queue", bench_queue_consume, &queue);
+	for (guint i = 1; i <= BENCH_ITEMS; i++)
+		bench_queue_push(&queue, GUINT_TO_POINTER(i));
+	*ok = GPOINTER_TO_UINT(g_thread_join(consumer));
+	end = g_get_monotonic_time();
+
+	g_queue_clear(&queue.items);
+	g_mutex_clear(&queue.lock);
+	g_cond_clear(&queue.item_add);
+	g_cond_clear(&queue.item_del);
+
+	return BENCH_ITEMS * 1000000.0 / MAX(end - start, 1);
+}
+
+/*
+* The handoffs per second of the ring
+*/
+static gdouble
+bench_ring(guint capacity, gboolean * ok)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	GThread *consumer;
+	gint64 start, end;
+
+	gst_spsc_ring_set_limits(ring, capacity, 0, GST_CLOCK_TIME_NONE);
+
+	start = g_get_monotonic_time();
+	consumer = g_thread_new("bench-ring", bench_ring_consume, ring);
+	for (guint i = 1; i <= BENCH_ITEMS; i++)
+		gst_spsc_ring_push(ring, GUINT_TO_POINTER(i), 1, GST_CLOCK_TIME_NONE);
+	*ok = GPOINTER_TO_UINT(g_thread_join(consumer));
+	end = g_get_monotonic_time();
+
+	// The items are not mini objects, so nothing is left to drop
+	gst_spsc_ring_free(ring);
+
+	return BENCH_ITEMS * 1000000.0 / MAX(end - start, 1);
+}
+
+int
+main(int argc, char *argv[])
+{
+	gboolean ok = TRUE;
+
+	gst_init(&argc, &argv);
+
+	printf("%-10s %16s %16s %8s\n", "capacity", "queue items/s", "ring items/s", "ratio");
+
+	for (gsize i = 0; i < G_N_ELEMENTS(bench_capacities); i++) {
+		gboolean queue_ok, ring_ok;
+		gdouble queue_rate = bench_queue(bench_capacities[i], &queue_ok);
+		gdouble ring_rate = bench_ring(bench_capacities[i], &ring_ok);
+
+		printf("%-10u %16.0f %16.0f %8.2f\n", bench_capacities[i], queue_rate, ring_rate, ring_rate / queue_rate);
+		ok &= queue_ok && ring_ok;
+	}
+
+	if (!ok)
+		printf("The items came out of order\n");
+
+	return ok ? 0 : 1;
+}
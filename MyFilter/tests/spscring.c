@@ -0,0 +1,238 @@
+/*
+* Checks the SPSC ring: the handover between two threads, the limits, the flushing, the drain and the clear
+*/
+#include "../gstspscring.c"
+
+#include <stdio.h>
+
+#define TEST_ITEMS				200000
+#define TEST_CAPACITY			8
+
+static gboolean test_ok = TRUE;
+
+#define TEST_CHECK(cond) \
+	G_STMT_START { \
+		if (!(cond)) { \
+			printf("%s:%d: %s failed\n", __FILE__, __LINE__, #cond); \
+			test_ok = FALSE; \
+		} \
+	} G_STMT_END
+
+static gpointer
+test_consume(gpointer user_data)
+{
+	GstSpscRing *ring = user_data;
+
+	for (guint i = 1; i <= TEST_ITEMS; i++) {
+		if (GPOINTER_TO_UINT(gst_spsc_ring_pop(ring)) != i)
+			return GUINT_TO_POINTER(FALSE);
+	}
+
+	return GUINT_TO_POINTER(TRUE);
+}
+
+static gpointer
+test_pop(gpointer user_data)
+{
+	return gst_spsc_ring_pop(user_data);
+}
+
+static gpointer
+test_push(gpointer user_data)
+{
+	return GUINT_TO_POINTER(gst_spsc_ring_push(user_data, GUINT_TO_POINTER(1), 1, GST_CLOCK_TIME_NONE));
+}
+
+static void
+test_collect(gpointer item, gpointer user_data)
+{
+	guint *collected = user_data;
+
+	collected[collected[0]++ + 1] = GPOINTER_TO_UINT(item);
+}
+
+/*
+* A producer and a consumer thread hand the items over through a small ring, in order and without losing one
+*/
+static void
+test_threads(void)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	GThread *consumer;
+
+	gst_spsc_ring_set_limits(ring, TEST_CAPACITY, 0, GST_CLOCK_TIME_NONE);
+
+	consumer = g_thread_new("test-consumer", test_consume, ring);
+	for (guint i = 1; i <= TEST_ITEMS; i++)
+		TEST_CHECK(gst_spsc_ring_push(ring, GUINT_TO_POINTER(i), 1, GST_CLOCK_TIME_NONE));
+
+	TEST_CHECK(GPOINTER_TO_UINT(g_thread_join(consumer)));
+	TEST_CHECK(ring->head == ring->tail);
+
+	gst_spsc_ring_free(ring);
+}
+
+/*
+* The item, byte and time limits. The producer side checks them before it pushes.
+*/
+static void
+test_limits(void)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	guint collected[5] = { 0 };
+
+	// Items
+	gst_spsc_ring_set_limits(ring, 4, 0, GST_CLOCK_TIME_NONE);
+	for (guint i = 1; i <= 3; i++)
+		gst_spsc_ring_push(ring, GUINT_TO_POINTER(i), 1, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(4), 1, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(gst_spsc_ring_is_full(ring));
+	TEST_CHECK(GPOINTER_TO_UINT(gst_spsc_ring_pop(ring)) == 1);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_drain(ring, test_collect, collected);
+	TEST_CHECK(collected[0] == 3);
+
+	// Bytes, with one item always fitting
+	gst_spsc_ring_set_limits(ring, 100, 1000, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(1), 1500, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_pop(ring);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(2), 600, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(3), 600, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_pop(ring);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_pop(ring);
+
+	// Time, from the oldest item to the latest one with a timestamp
+	gst_spsc_ring_set_limits(ring, 100, 0, GST_SECOND);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(1), 1, 0);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(2), 1, GST_SECOND / 2);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(3), 0, GST_CLOCK_TIME_NONE);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(4), 1, GST_SECOND);
+	TEST_CHECK(gst_spsc_ring_is_full(ring));
+	gst_spsc_ring_pop(ring);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+
+	// The items are not mini objects, so the drain takes them instead of the clear
+	collected[0] = 0;
+	gst_spsc_ring_drain(ring, test_collect, collected);
+	TEST_CHECK(collected[0] == 3);
+
+	gst_spsc_ring_free(ring);
+}
+
+/*
+* A full ring blocks the producer until an item is taken out
+*/
+static void
+test_wait_full(void)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	GThread *producer;
+
+	gst_spsc_ring_set_limits(ring, 1, 0, GST_CLOCK_TIME_NONE);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(1), 1, GST_CLOCK_TIME_NONE);
+
+	producer = g_thread_new("test-producer", test_push, ring);
+	g_usleep(20000);
+	TEST_CHECK(ring->head - ring->tail == 1);
+
+	TEST_CHECK(GPOINTER_TO_UINT(gst_spsc_ring_pop(ring)) == 1);
+	TEST_CHECK(GPOINTER_TO_UINT(g_thread_join(producer)));
+	TEST_CHECK(GPOINTER_TO_UINT(gst_spsc_ring_pop(ring)) == 1);
+
+	gst_spsc_ring_free(ring);
+}
+
+/*
+* Flushing makes both sides give up waiting, and the ring works again once it stops
+*/
+static void
+test_flushing(void)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	GThread *thread;
+
+	// The consumer waits on the empty ring
+	thread = g_thread_new("test-consumer", test_pop, ring);
+	g_usleep(20000);
+	gst_spsc_ring_set_flushing(ring, TRUE);
+	TEST_CHECK(g_thread_join(thread) == NULL);
+
+	// The producer waits on the full ring
+	gst_spsc_ring_set_flushing(ring, FALSE);
+	gst_spsc_ring_set_limits(ring, 1, 0, GST_CLOCK_TIME_NONE);
+	gst_spsc_ring_push(ring, GUINT_TO_POINTER(1), 1, GST_CLOCK_TIME_NONE);
+	thread = g_thread_new("test-producer", test_push, ring);
+	g_usleep(20000);
+	gst_spsc_ring_set_flushing(ring, TRUE);
+	TEST_CHECK(!GPOINTER_TO_UINT(g_thread_join(thread)));
+
+	TEST_CHECK(!gst_spsc_ring_push(ring, GUINT_TO_POINTER(2), 1, GST_CLOCK_TIME_NONE));
+	TEST_CHECK(gst_spsc_ring_pop(ring) == NULL);
+
+	gst_spsc_ring_set_flushing(ring, FALSE);
+	TEST_CHECK(GPOINTER_TO_UINT(gst_spsc_ring_pop(ring)) == 1);
+
+	gst_spsc_ring_free(ring);
+}
+
+/*
+* The drain hands the items over oldest first, the clear drops the references, and the ring starts over empty
+*/
+static void
+test_drain_clear(void)
+{
+	GstSpscRing *ring = gst_spsc_ring_new();
+	guint collected[5] = { 0 };
+	GstBuffer *buffer;
+
+	gst_spsc_ring_set_limits(ring, 4, 100, GST_SECOND);
+
+	// Around the end of the slots
+	for (guint i = 0; i < 3; i++) {
+		gst_spsc_ring_push(ring, GUINT_TO_POINTER(i), 10, i * GST_MSECOND);
+		gst_spsc_ring_pop(ring);
+	}
+	for (guint i = 1; i <= 4; i++)
+		gst_spsc_ring_push(ring, GUINT_TO_POINTER(i), 10, i * GST_MSECOND);
+
+	gst_spsc_ring_drain(ring, test_collect, collected);
+	TEST_CHECK(collected[0] == 4);
+	for (guint i = 1; i <= 4; i++)
+		TEST_CHECK(collected[i] == i);
+	TEST_CHECK(ring->head == 0 && ring->tail == 0);
+	TEST_CHECK(ring->in_bytes == 0 && ring->out_bytes == 0);
+	TEST_CHECK(!GST_CLOCK_TIME_IS_VALID(ring->in_time));
+
+	buffer = gst_buffer_new();
+	gst_spsc_ring_push(ring, gst_buffer_ref(buffer), 10, 0);
+	gst_spsc_ring_push(ring, gst_buffer_ref(buffer), 10, 0);
+	gst_spsc_ring_clear(ring);
+	TEST_CHECK(GST_MINI_OBJECT_REFCOUNT_VALUE(buffer) == 1);
+	TEST_CHECK(!gst_spsc_ring_is_full(ring));
+	gst_buffer_unref(buffer);
+
+	gst_spsc_ring_free(ring);
+}
+
+int
+main(int argc, char *argv[])
+{
+	gst_init(&argc, &argv);
+
+	test_threads();
+	test_limits();
+	test_wait_full();
+	test_flushing();
+	test_drain_clear();
+
+	printf("%s\n", test_ok ? "ok" : "FAILED");
+
+	return test_ok ? 0 : 1;
+}